@@ -91,3 +91,44 @@ LOCAL_WHOLE_STATIC_LIBRARIES += cpufeatures
 LOCAL_SHARED_LIBRARIES += liblog
 
 include $(BUILD_SHARED_LIBRARY)
+
+#=====================================================================
+# Device test program for the epoll_wait and poll translations,
+# which also reports the number of events returned per system call
+#=====================================================================
+
+ifneq ($(filter mips x86,$(TARGET_ARCH)),)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libportable_test_poll
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/common/include
+LOCAL_SRC_FILES := tests/poll_test.c
+
+LOCAL_SHARED_LIBRARIES += libportable
+
+include $(BUILD_EXECUTABLE)
+endif
+
+#=====================================================================
+# Device test program comparing the table driven errno, signal and
+# flag translations with switch based ones
+#=====================================================================
+
+ifeq ($(TARGET_ARCH),mips)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libportable_test_translate
+LOCAL_MODULE_TAGS := tests
+
+# errno.c and signal.c are included by the benchmark itself
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/common/include
+LOCAL_SRC_FILES := \
+			tests/translate_benchmark.c \
+			$(filter-out arch-mips/errno.c arch-mips/signal.c,$(libportable_arch_src_files))
+
+LOCAL_SHARED_LIBRARIES += liblog
+
+include $(BUILD_EXECUTABLE)
+endif
@@ -27,210 +27,131 @@
 #error Bad build environment
 #endif
 
+/*
+ * Native errno values that differ from the portable ones, as
+ * X(native, portable) pairs. Both translation tables below are
+ * generated from this list, values that aren't listed are the same
+ * on both sides.
+ */
+#define ERRNO_MAP(X) \
+    X(ENAMETOOLONG,    ENAMETOOLONG_PORTABLE) \
+    X(ENOLCK,          ENOLCK_PORTABLE) \
+    X(ENOSYS,          ENOSYS_PORTABLE) \
+    X(ENOTEMPTY,       ENOTEMPTY_PORTABLE) \
+    X(ELOOP,           ELOOP_PORTABLE) \
+    X(EWOULDBLOCK,     EWOULDBLOCK_PORTABLE) \
+    X(ENOMSG,          ENOMSG_PORTABLE) \
+    X(EIDRM,           EIDRM_PORTABLE) \
+    X(ECHRNG,          ECHRNG_PORTABLE) \
+    X(EL2NSYNC,        EL2NSYNC_PORTABLE) \
+    X(EL3HLT,          EL3HLT_PORTABLE) \
+    X(EL3RST,          EL3RST_PORTABLE) \
+    X(ELNRNG,          ELNRNG_PORTABLE) \
+    X(EUNATCH,         EUNATCH_PORTABLE) \
+    X(ENOCSI,          ENOCSI_PORTABLE) \
+    X(EL2HLT,          EL2HLT_PORTABLE) \
+    X(EBADE,           EBADE_PORTABLE) \
+    X(EBADR,           EBADR_PORTABLE) \
+    X(EXFULL,          EXFULL_PORTABLE) \
+    X(ENOANO,          ENOANO_PORTABLE) \
+    X(EBADRQC,         EBADRQC_PORTABLE) \
+    X(EBADSLT,         EBADSLT_PORTABLE) \
+    X(EDEADLOCK,       EDEADLOCK_PORTABLE) \
+    X(EBFONT,          EBFONT_PORTABLE) \
+    X(ENOSTR,          ENOSTR_PORTABLE) \
+    X(ENODATA,         ENODATA_PORTABLE) \
+    X(ETIME,           ETIME_PORTABLE) \
+    X(ENOSR,           ENOSR_PORTABLE) \
+    X(ENONET,          ENONET_PORTABLE) \
+    X(ENOPKG,          ENOPKG_PORTABLE) \
+    X(EREMOTE,         EREMOTE_PORTABLE) \
+    X(ENOLINK,         ENOLINK_PORTABLE) \
+    X(EADV,            EADV_PORTABLE) \
+    X(ESRMNT,          ESRMNT_PORTABLE) \
+    X(ECOMM,           ECOMM_PORTABLE) \
+    X(EPROTO,          EPROTO_PORTABLE) \
+    X(EMULTIHOP,       EMULTIHOP_PORTABLE) \
+    X(EDOTDOT,         EDOTDOT_PORTABLE) \
+    X(EBADMSG,         EBADMSG_PORTABLE) \
+    X(EOVERFLOW,       EOVERFLOW_PORTABLE) \
+    X(ENOTUNIQ,        ENOTUNIQ_PORTABLE) \
+    X(EBADFD,          EBADFD_PORTABLE) \
+    X(EREMCHG,         EREMCHG_PORTABLE) \
+    X(ELIBACC,         ELIBACC_PORTABLE) \
+    X(ELIBBAD,         ELIBBAD_PORTABLE) \
+    X(ELIBSCN,         ELIBSCN_PORTABLE) \
+    X(ELIBMAX,         ELIBMAX_PORTABLE) \
+    X(ELIBEXEC,        ELIBEXEC_PORTABLE) \
+    X(EILSEQ,          EILSEQ_PORTABLE) \
+    X(ERESTART,        ERESTART_PORTABLE) \
+    X(ESTRPIPE,        ESTRPIPE_PORTABLE) \
+    X(EUSERS,          EUSERS_PORTABLE) \
+    X(ENOTSOCK,        ENOTSOCK_PORTABLE) \
+    X(EDESTADDRREQ,    EDESTADDRREQ_PORTABLE) \
+    X(EMSGSIZE,        EMSGSIZE_PORTABLE) \
+    X(EPROTOTYPE,      EPROTOTYPE_PORTABLE) \
+    X(ENOPROTOOPT,     ENOPROTOOPT_PORTABLE) \
+    X(EPROTONOSUPPORT, EPROTONOSUPPORT_PORTABLE) \
+    X(ESOCKTNOSUPPORT, ESOCKTNOSUPPORT_PORTABLE) \
+    X(EOPNOTSUPP,      EOPNOTSUPP_PORTABLE) \
+    X(EPFNOSUPPORT,    EPFNOSUPPORT_PORTABLE) \
+    X(EAFNOSUPPORT,    EAFNOSUPPORT_PORTABLE) \
+    X(EADDRINUSE,      EADDRINUSE_PORTABLE) \
+    X(EADDRNOTAVAIL,   EADDRNOTAVAIL_PORTABLE) \
+    X(ENETDOWN,        ENETDOWN_PORTABLE) \
+    X(ENETUNREACH,     ENETUNREACH_PORTABLE) \
+    X(ENETRESET,       ENETRESET_PORTABLE) \
+    X(ECONNABORTED,    ECONNABORTED_PORTABLE) \
+    X(ECONNRESET,      ECONNRESET_PORTABLE) \
+    X(ENOBUFS,         ENOBUFS_PORTABLE) \
+    X(EISCONN,         EISCONN_PORTABLE) \
+    X(ENOTCONN,        ENOTCONN_PORTABLE) \
+    X(ESHUTDOWN,       ESHUTDOWN_PORTABLE) \
+    X(ETOOMANYREFS,    ETOOMANYREFS_PORTABLE) \
+    X(ETIMEDOUT,       ETIMEDOUT_PORTABLE) \
+    X(ECONNREFUSED,    ECONNREFUSED_PORTABLE) \
+    X(EHOSTDOWN,       EHOSTDOWN_PORTABLE) \
+    X(EHOSTUNREACH,    EHOSTUNREACH_PORTABLE) \
+    X(EALREADY,        EALREADY_PORTABLE) \
+    X(EINPROGRESS,     EINPROGRESS_PORTABLE) \
+    X(ESTALE,          ESTALE_PORTABLE) \
+    X(EUCLEAN,         EUCLEAN_PORTABLE) \
+    X(ENOTNAM,         ENOTNAM_PORTABLE) \
+    X(ENAVAIL,         ENAVAIL_PORTABLE) \
+    X(EISNAM,          EISNAM_PORTABLE) \
+    X(EREMOTEIO,       EREMOTEIO_PORTABLE) \
+    X(EDQUOT,          EDQUOT_PORTABLE) \
+    X(ENOMEDIUM,       ENOMEDIUM_PORTABLE) \
+    X(EMEDIUMTYPE,     EMEDIUMTYPE_PORTABLE) \
+    X(ECANCELED,       ECANCELED_PORTABLE) \
+    X(ENOKEY,          ENOKEY_PORTABLE) \
+    X(EKEYEXPIRED,     EKEYEXPIRED_PORTABLE) \
+    X(EKEYREVOKED,     EKEYREVOKED_PORTABLE) \
+    X(EKEYREJECTED,    EKEYREJECTED_PORTABLE) \
+    X(EOWNERDEAD,      EOWNERDEAD_PORTABLE) \
+    X(ENOTRECOVERABLE, ENOTRECOVERABLE_PORTABLE)
+
+/* A zero entry means that the errno doesn't need to be translated */
+#define ERRNO_NTOP_ENTRY(native, portable) [native] = portable,
+static const unsigned short errno_ntop_table[] = { ERRNO_MAP(ERRNO_NTOP_ENTRY) };
+
+#define ERRNO_PTON_ENTRY(native, portable) [portable] = native,
+static const unsigned short errno_pton_table[] = { ERRNO_MAP(ERRNO_PTON_ENTRY) };
+
 __hidden int errno_ntop(int native_errno)
 {
-    switch (native_errno) {
-      case ENAMETOOLONG: return ENAMETOOLONG_PORTABLE;
-      case ENOLCK: return ENOLCK_PORTABLE;
-      case ENOSYS: return ENOSYS_PORTABLE;
-      case ENOTEMPTY: return ENOTEMPTY_PORTABLE;
-      case ELOOP: return ELOOP_PORTABLE;
-      case EWOULDBLOCK: return EWOULDBLOCK_PORTABLE;
-      case ENOMSG: return ENOMSG_PORTABLE;
-      case EIDRM: return EIDRM_PORTABLE;
-      case ECHRNG: return ECHRNG_PORTABLE;
-      case EL2NSYNC: return EL2NSYNC_PORTABLE;
-      case EL3HLT: return EL3HLT_PORTABLE;
-      case EL3RST: return EL3RST_PORTABLE;
-      case ELNRNG: return ELNRNG_PORTABLE;
-      case EUNATCH: return EUNATCH_PORTABLE;
-      case ENOCSI: return ENOCSI_PORTABLE;
-      case EL2HLT: return EL2HLT_PORTABLE;
-      case EBADE: return EBADE_PORTABLE;
-      case EBADR: return EBADR_PORTABLE;
-      case EXFULL: return EXFULL_PORTABLE;
-      case ENOANO: return ENOANO_PORTABLE;
-      case EBADRQC: return EBADRQC_PORTABLE;
-      case EBADSLT: return EBADSLT_PORTABLE;
-      case EDEADLOCK: return EDEADLOCK_PORTABLE;
-      case EBFONT: return EBFONT_PORTABLE;
-      case ENOSTR: return ENOSTR_PORTABLE;
-      case ENODATA: return ENODATA_PORTABLE;
-      case ETIME: return ETIME_PORTABLE;
-      case ENOSR: return ENOSR_PORTABLE;
-      case ENONET: return ENONET_PORTABLE;
-      case ENOPKG: return ENOPKG_PORTABLE;
-      case EREMOTE: return EREMOTE_PORTABLE;
-      case ENOLINK: return ENOLINK_PORTABLE;
-      case EADV: return EADV_PORTABLE;
-      case ESRMNT: return ESRMNT_PORTABLE;
-      case ECOMM: return ECOMM_PORTABLE;
-      case EPROTO: return EPROTO_PORTABLE;
-      case EMULTIHOP: return EMULTIHOP_PORTABLE;
-      case EDOTDOT: return EDOTDOT_PORTABLE;
-      case EBADMSG: return EBADMSG_PORTABLE;
-      case EOVERFLOW: return EOVERFLOW_PORTABLE;
-      case ENOTUNIQ: return ENOTUNIQ_PORTABLE;
-      case EBADFD: return EBADFD_PORTABLE;
-      case EREMCHG: return EREMCHG_PORTABLE;
-      case ELIBACC: return ELIBACC_PORTABLE;
-      case ELIBBAD: return ELIBBAD_PORTABLE;
-      case ELIBSCN: return ELIBSCN_PORTABLE;
-      case ELIBMAX: return ELIBMAX_PORTABLE;
-      case ELIBEXEC: return ELIBEXEC_PORTABLE;
-      case EILSEQ: return EILSEQ_PORTABLE;
-      case ERESTART: return ERESTART_PORTABLE;
-      case ESTRPIPE: return ESTRPIPE_PORTABLE;
-      case EUSERS: return EUSERS_PORTABLE;
-      case ENOTSOCK: return ENOTSOCK_PORTABLE;
-      case EDESTADDRREQ: return EDESTADDRREQ_PORTABLE;
-      case EMSGSIZE: return EMSGSIZE_PORTABLE;
-      case EPROTOTYPE: return EPROTOTYPE_PORTABLE;
-      case ENOPROTOOPT: return ENOPROTOOPT_PORTABLE;
-      case EPROTONOSUPPORT: return EPROTONOSUPPORT_PORTABLE;
-      case ESOCKTNOSUPPORT: return ESOCKTNOSUPPORT_PORTABLE;
-      case EOPNOTSUPP: return EOPNOTSUPP_PORTABLE;
-      case EPFNOSUPPORT: return EPFNOSUPPORT_PORTABLE;
-      case EAFNOSUPPORT: return EAFNOSUPPORT_PORTABLE;
-      case EADDRINUSE: return EADDRINUSE_PORTABLE;
-      case EADDRNOTAVAIL: return EADDRNOTAVAIL_PORTABLE;
-      case ENETDOWN: return ENETDOWN_PORTABLE;
-      case ENETUNREACH: return ENETUNREACH_PORTABLE;
-      case ENETRESET: return ENETRESET_PORTABLE;
-      case ECONNABORTED: return ECONNABORTED_PORTABLE;
-      case ECONNRESET: return ECONNRESET_PORTABLE;
-      case ENOBUFS: return ENOBUFS_PORTABLE;
-      case EISCONN: return EISCONN_PORTABLE;
-      case ENOTCONN: return ENOTCONN_PORTABLE;
-      case ESHUTDOWN: return ESHUTDOWN_PORTABLE;
-      case ETOOMANYREFS: return ETOOMANYREFS_PORTABLE;
-      case ETIMEDOUT: return ETIMEDOUT_PORTABLE;
-      case ECONNREFUSED: return ECONNREFUSED_PORTABLE;
-      case EHOSTDOWN: return EHOSTDOWN_PORTABLE;
-      case EHOSTUNREACH: return EHOSTUNREACH_PORTABLE;
-      case EALREADY: return EALREADY_PORTABLE;
-      case EINPROGRESS: return EINPROGRESS_PORTABLE;
-      case ESTALE: return ESTALE_PORTABLE;
-      case EUCLEAN: return EUCLEAN_PORTABLE;
-      case ENOTNAM: return ENOTNAM_PORTABLE;
-      case ENAVAIL: return ENAVAIL_PORTABLE;
-      case EISNAM: return EISNAM_PORTABLE;
-      case EREMOTEIO: return EREMOTEIO_PORTABLE;
-      case EDQUOT: return EDQUOT_PORTABLE;
-      case ENOMEDIUM: return ENOMEDIUM_PORTABLE;
-      case EMEDIUMTYPE: return EMEDIUMTYPE_PORTABLE;
-      case ECANCELED: return ECANCELED_PORTABLE;
-      case ENOKEY: return ENOKEY_PORTABLE;
-      case EKEYEXPIRED: return EKEYEXPIRED_PORTABLE;
-      case EKEYREVOKED: return EKEYREVOKED_PORTABLE;
-      case EKEYREJECTED: return EKEYREJECTED_PORTABLE;
-      case EOWNERDEAD: return EOWNERDEAD_PORTABLE;
-      case ENOTRECOVERABLE: return ENOTRECOVERABLE_PORTABLE;
-    }
-    return native_errno;
+    unsigned int index = (unsigned int)native_errno;
+    int portable_errno = errno_ntop_table[index < ARRAY_SIZE(errno_ntop_table) ? index : 0];
+
+    return portable_errno ? portable_errno : native_errno;
 }
 
 __hidden int errno_pton(int portable_errno)
 {
-    switch (portable_errno) {
-      case ENAMETOOLONG_PORTABLE: return ENAMETOOLONG;
-      case ENOLCK_PORTABLE: return ENOLCK;
-      case ENOSYS_PORTABLE: return ENOSYS;
-      case ENOTEMPTY_PORTABLE: return ENOTEMPTY;
-      case ELOOP_PORTABLE: return ELOOP;
-      case EWOULDBLOCK_PORTABLE: return EWOULDBLOCK;
-      case ENOMSG_PORTABLE: return ENOMSG;
-      case EIDRM_PORTABLE: return EIDRM;
-      case ECHRNG_PORTABLE: return ECHRNG;
-      case EL2NSYNC_PORTABLE: return EL2NSYNC;
-      case EL3HLT_PORTABLE: return EL3HLT;
-      case EL3RST_PORTABLE: return EL3RST;
-      case ELNRNG_PORTABLE: return ELNRNG;
-      case EUNATCH_PORTABLE: return EUNATCH;
-      case ENOCSI_PORTABLE: return ENOCSI;
-      case EL2HLT_PORTABLE: return EL2HLT;
-      case EBADE_PORTABLE: return EBADE;
-      case EBADR_PORTABLE: return EBADR;
-      case EXFULL_PORTABLE: return EXFULL;
-      case ENOANO_PORTABLE: return ENOANO;
-      case EBADRQC_PORTABLE: return EBADRQC;
-      case EBADSLT_PORTABLE: return EBADSLT;
-      case EDEADLOCK_PORTABLE: return EDEADLOCK;
-      case EBFONT_PORTABLE: return EBFONT;
-      case ENOSTR_PORTABLE: return ENOSTR;
-      case ENODATA_PORTABLE: return ENODATA;
-      case ETIME_PORTABLE: return ETIME;
-      case ENOSR_PORTABLE: return ENOSR;
-      case ENONET_PORTABLE: return ENONET;
-      case ENOPKG_PORTABLE: return ENOPKG;
-      case EREMOTE_PORTABLE: return EREMOTE;
-      case ENOLINK_PORTABLE: return ENOLINK;
-      case EADV_PORTABLE: return EADV;
-      case ESRMNT_PORTABLE: return ESRMNT;
-      case ECOMM_PORTABLE: return ECOMM;
-      case EPROTO_PORTABLE: return EPROTO;
-      case EMULTIHOP_PORTABLE: return EMULTIHOP;
-      case EDOTDOT_PORTABLE: return EDOTDOT;
-      case EBADMSG_PORTABLE: return EBADMSG;
-      case EOVERFLOW_PORTABLE: return EOVERFLOW;
-      case ENOTUNIQ_PORTABLE: return ENOTUNIQ;
-      case EBADFD_PORTABLE: return EBADFD;
-      case EREMCHG_PORTABLE: return EREMCHG;
-      case ELIBACC_PORTABLE: return ELIBACC;
-      case ELIBBAD_PORTABLE: return ELIBBAD;
-      case ELIBSCN_PORTABLE: return ELIBSCN;
-      case ELIBMAX_PORTABLE: return ELIBMAX;
-      case ELIBEXEC_PORTABLE: return ELIBEXEC;
-      case EILSEQ_PORTABLE: return EILSEQ;
-      case ERESTART_PORTABLE: return ERESTART;
-      case ESTRPIPE_PORTABLE: return ESTRPIPE;
-      case EUSERS_PORTABLE: return EUSERS;
-      case ENOTSOCK_PORTABLE: return ENOTSOCK;
-      case EDESTADDRREQ_PORTABLE: return EDESTADDRREQ;
-      case EMSGSIZE_PORTABLE: return EMSGSIZE;
-      case EPROTOTYPE_PORTABLE: return EPROTOTYPE;
-      case ENOPROTOOPT_PORTABLE: return ENOPROTOOPT;
-      case EPROTONOSUPPORT_PORTABLE: return EPROTONOSUPPORT;
-      case ESOCKTNOSUPPORT_PORTABLE: return ESOCKTNOSUPPORT;
-      case EOPNOTSUPP_PORTABLE: return EOPNOTSUPP;
-      case EPFNOSUPPORT_PORTABLE: return EPFNOSUPPORT;
-      case EAFNOSUPPORT_PORTABLE: return EAFNOSUPPORT;
-      case EADDRINUSE_PORTABLE: return EADDRINUSE;
-      case EADDRNOTAVAIL_PORTABLE: return EADDRNOTAVAIL;
-      case ENETDOWN_PORTABLE: return ENETDOWN;
-      case ENETUNREACH_PORTABLE: return ENETUNREACH;
-      case ENETRESET_PORTABLE: return ENETRESET;
-      case ECONNABORTED_PORTABLE: return ECONNABORTED;
-      case ECONNRESET_PORTABLE: return ECONNRESET;
-      case ENOBUFS_PORTABLE: return ENOBUFS;
-      case EISCONN_PORTABLE: return EISCONN;
-      case ENOTCONN_PORTABLE: return ENOTCONN;
-      case ESHUTDOWN_PORTABLE: return ESHUTDOWN;
-      case ETOOMANYREFS_PORTABLE: return ETOOMANYREFS;
-      case ETIMEDOUT_PORTABLE: return ETIMEDOUT;
-      case ECONNREFUSED_PORTABLE: return ECONNREFUSED;
-      case EHOSTDOWN_PORTABLE: return EHOSTDOWN;
-      case EHOSTUNREACH_PORTABLE: return EHOSTUNREACH;
-      case EALREADY_PORTABLE: return EALREADY;
-      case EINPROGRESS_PORTABLE: return EINPROGRESS;
-      case ESTALE_PORTABLE: return ESTALE;
-      case EUCLEAN_PORTABLE: return EUCLEAN;
-      case ENOTNAM_PORTABLE: return ENOTNAM;
-      case ENAVAIL_PORTABLE: return ENAVAIL;
-      case EISNAM_PORTABLE: return EISNAM;
-      case EREMOTEIO_PORTABLE: return EREMOTEIO;
-      case EDQUOT_PORTABLE: return EDQUOT;
-      case ENOMEDIUM_PORTABLE: return ENOMEDIUM;
-      case EMEDIUMTYPE_PORTABLE: return EMEDIUMTYPE;
-      case ECANCELED_PORTABLE: return ECANCELED;
-      case ENOKEY_PORTABLE: return ENOKEY;
-      case EKEYEXPIRED_PORTABLE: return EKEYEXPIRED;
-      case EKEYREVOKED_PORTABLE: return EKEYREVOKED;
-      case EKEYREJECTED_PORTABLE: return EKEYREJECTED;
-      case EOWNERDEAD_PORTABLE: return EOWNERDEAD;
-      case ENOTRECOVERABLE_PORTABLE: return ENOTRECOVERABLE;
-    }
-    return portable_errno;
+    unsigned int index = (unsigned int)portable_errno;
+    int native_errno = errno_pton_table[index < ARRAY_SIZE(errno_pton_table) ? index : 0];
+
+    return native_errno ? native_errno : portable_errno;
 }
 
 /* Key for the thread-specific portable errno */
@@ -177,36 +177,7 @@ done:
 
 static int fcntl_flags_pton(int flags)
 {
-    int mipsflags = flags & O_ACCMODE_PORTABLE;
-
-    if (flags & O_CREAT_PORTABLE)
-        mipsflags |= O_CREAT;
-    if (flags & O_EXCL_PORTABLE)
-        mipsflags |= O_EXCL;
-    if (flags & O_NOCTTY_PORTABLE)
-        mipsflags |= O_NOCTTY;
-    if (flags & O_TRUNC_PORTABLE)
-        mipsflags |= O_TRUNC;
-    if (flags & O_APPEND_PORTABLE)
-        mipsflags |= O_APPEND;
-    if (flags & O_NONBLOCK_PORTABLE)
-        mipsflags |= O_NONBLOCK;
-    if (flags & O_SYNC_PORTABLE)
-        mipsflags |= O_SYNC;
-    if (flags & FASYNC_PORTABLE)
-        mipsflags |= FASYNC;
-    if (flags & O_DIRECT_PORTABLE)
-        mipsflags |= O_DIRECT;
-    if (flags & O_LARGEFILE_PORTABLE)
-        mipsflags |= O_LARGEFILE;
-    if (flags & O_DIRECTORY_PORTABLE)
-        mipsflags |= O_DIRECTORY;
-    if (flags & O_NOFOLLOW_PORTABLE)
-        mipsflags |= O_NOFOLLOW;
-    if (flags & O_NOATIME_PORTABLE)
-        mipsflags |= O_NOATIME;
-    if (flags & O_NDELAY_PORTABLE)
-        mipsflags |= O_NDELAY;
+    int mipsflags = (flags & O_ACCMODE_PORTABLE) O_FLAGS_MAP(O_FLAG_PTON);
 
     ALOGV("%s(flags:0x%x): return(mipsflags:0x%x);", __func__,
               flags,              mipsflags);
@@ -216,36 +187,7 @@ static int fcntl_flags_pton(int flags)
 
 static int fcntl_flags_ntop(int flags)
 {
-    int portableflags = flags & O_ACCMODE_PORTABLE;
-
-    if (flags & O_CREAT)
-        portableflags |= O_CREAT_PORTABLE;
-    if (flags & O_EXCL)
-        portableflags |= O_EXCL_PORTABLE;
-    if (flags & O_NOCTTY)
-        portableflags |= O_NOCTTY_PORTABLE;
-    if (flags & O_TRUNC)
-        portableflags |= O_TRUNC_PORTABLE;
-    if (flags & O_APPEND)
-        portableflags |= O_APPEND_PORTABLE;
-    if (flags & O_NONBLOCK)
-        portableflags |= O_NONBLOCK_PORTABLE;
-    if (flags & O_SYNC)
-        portableflags |= O_SYNC_PORTABLE;
-    if (flags & FASYNC)
-        portableflags |= FASYNC_PORTABLE;
-    if (flags & O_DIRECT)
-        portableflags |= O_DIRECT_PORTABLE;
-    if (flags & O_LARGEFILE)
-        portableflags |= O_LARGEFILE_PORTABLE;
-    if (flags & O_DIRECTORY)
-        portableflags |= O_DIRECTORY_PORTABLE;
-    if (flags & O_NOFOLLOW)
-        portableflags |= O_NOFOLLOW_PORTABLE;
-    if (flags & O_NOATIME)
-        portableflags |= O_NOATIME_PORTABLE;
-    if (flags & O_NDELAY)
-        portableflags |= O_NDELAY_PORTABLE;
+    int portableflags = (flags & O_ACCMODE_PORTABLE) O_FLAGS_MAP(O_FLAG_NTOP);
 
     ALOGV("%s(flags:0x%x): return(portableflags:0x%x);", __func__,
               flags,              portableflags);
@@ -30,24 +30,18 @@ int
 WRAP(__sflags)(const char *mode, int *optr)
 {
     int rv;
-    int nflags, pflags;
+    int flags, pflags;
 
     ALOGV(" ");
     ALOGV("%s(mode:%p, optr:%p) {", __func__, mode, optr);
 
-    rv = __sflags(mode, &nflags);
+    rv = __sflags(mode, &flags);
 
     /* error - no change to *optr */
     if (rv == 0)
         goto done;
 
-    pflags = nflags & O_ACCMODE;
-    if (nflags & O_CREAT)
-        pflags |= O_CREAT_PORTABLE;
-    if (nflags & O_TRUNC)
-        pflags |= O_TRUNC_PORTABLE;
-    if (nflags & O_APPEND)
-        pflags |= O_APPEND_PORTABLE;
+    pflags = (flags & O_ACCMODE) O_FLAGS_MAP(O_FLAG_NTOP);
 
     /* Set *optr to portable flags */
     *optr = pflags;
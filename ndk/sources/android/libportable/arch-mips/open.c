@@ -33,38 +33,11 @@
 
 static inline int open_flags_pton(int flags)
 {
-    int mipsflags = flags & O_ACCMODE_PORTABLE;
+    int mipsflags;
 
     ALOGV("%s(flags:0x%x) {", __func__, flags);
 
-    if (flags & O_CREAT_PORTABLE)
-        mipsflags |= O_CREAT;
-    if (flags & O_EXCL_PORTABLE)
-        mipsflags |= O_EXCL;
-    if (flags & O_NOCTTY_PORTABLE)
-        mipsflags |= O_NOCTTY;
-    if (flags & O_TRUNC_PORTABLE)
-        mipsflags |= O_TRUNC;
-    if (flags & O_APPEND_PORTABLE)
-        mipsflags |= O_APPEND;
-    if (flags & O_NONBLOCK_PORTABLE)
-        mipsflags |= O_NONBLOCK;
-    if (flags & O_SYNC_PORTABLE)
-        mipsflags |= O_SYNC;
-    if (flags & FASYNC_PORTABLE)
-        mipsflags |= FASYNC;
-    if (flags & O_DIRECT_PORTABLE)
-        mipsflags |= O_DIRECT;
-    if (flags & O_LARGEFILE_PORTABLE)
-        mipsflags |= O_LARGEFILE;
-    if (flags & O_DIRECTORY_PORTABLE)
-        mipsflags |= O_DIRECTORY;
-    if (flags & O_NOFOLLOW_PORTABLE)
-        mipsflags |= O_NOFOLLOW;
-    if (flags & O_NOATIME_PORTABLE)
-        mipsflags |= O_NOATIME;
-    if (flags & O_NDELAY_PORTABLE)
-        mipsflags |= O_NDELAY;
+    mipsflags = (flags & O_ACCMODE_PORTABLE) O_FLAGS_MAP(O_FLAG_PTON);
 
     ALOGV("%s: return(mipsflags:0x%x); }", __func__, mipsflags);
     return mipsflags;
@@ -75,33 +75,33 @@
 #error Bad build environment
 #endif
 
+#if (POLLWRNORM_PORTABLE >> 6)!=POLLWRNORM || (POLLWRBAND_PORTABLE >> 1)!=POLLWRBAND
+#error Bad build environment
+#endif
+
+/*
+ * The translations below are branch-free, so the loops over the pollfd
+ * array in WRAP(poll) stay cheap for large numbers of descriptors.
+ */
 static inline short mips_change_portable_events(short portable_events)
 {
-    /* MIPS has different POLLWRNORM and POLLWRBAND. */
-    if (portable_events & POLLWRNORM_PORTABLE) {
-        portable_events &= ~POLLWRNORM_PORTABLE;
-        portable_events |= POLLWRNORM;
-    }
-    if (portable_events & POLLWRBAND_PORTABLE) {
-        portable_events &= ~POLLWRBAND_PORTABLE;
-        portable_events |= POLLWRBAND;
-    }
-
-    return portable_events;
+    /*
+     * MIPS has different POLLWRNORM and POLLWRBAND:
+     *     POLLWRNORM_PORTABLE:0x100 >> 6 == POLLWRNORM:0x004
+     *     POLLWRBAND_PORTABLE:0x200 >> 1 == POLLWRBAND:0x100
+     */
+    return (portable_events & ~(POLLWRNORM_PORTABLE | POLLWRBAND_PORTABLE))
+         | ((portable_events & POLLWRNORM_PORTABLE) >> 6)
+         | ((portable_events & POLLWRBAND_PORTABLE) >> 1);
 }
 
 static inline short change_mips_events(short mips_events)
 {
     /*
      * MIPS POLLWRNORM equals MIPS POLLOUT, which is the same as POLLOUT_PORTABLE;
-     * so we just map POLLWRBAND to POLLWRBAND_PORTABLE.
+     * so we just map POLLWRBAND:0x100 to POLLWRBAND_PORTABLE:0x200.
      */
-    if (mips_events & POLLWRBAND) {
-        mips_events &= ~POLLWRBAND;
-        mips_events |= POLLWRBAND_PORTABLE;
-    }
-
-    return mips_events;
+    return (mips_events & ~POLLWRBAND) | ((mips_events & POLLWRBAND) << 1);
 }
 
 extern int poll(struct pollfd *, nfds_t, long);
@@ -112,13 +112,13 @@ int WRAP(poll)(struct pollfd *fds, nfds_t nfds, long timeout)
   int ret;
 
   for (i = 0; i < nfds; i++)
-      fds->events = mips_change_portable_events(fds->events);
+      fds[i].events = mips_change_portable_events(fds[i].events);
 
   ret = REAL(poll)(fds, nfds, timeout);
 
   for (i = 0; i < nfds; i++) {
-      fds->events = change_mips_events(fds->events);
-      fds->revents = change_mips_events(fds->revents);
+      fds[i].events = change_mips_events(fds[i].events);
+      fds[i].revents = change_mips_events(fds[i].revents);
   }
 
   return ret;
@@ -217,6 +217,57 @@ __hidden char *map_mips_signum_to_name(int mips_signum)
 }
 
 
+/*
+ * Signals below SIGRTMIN that are numbered differently, as
+ * X(native, portable) pairs. There is no native SIGSTKFLT, it is
+ * mapped to SIGEMT and back. The real time signals keep their numbers.
+ * The signal number tables and the sigset translation are generated
+ * from this list.
+ */
+#define SIGNAL_MAP(X) \
+    X(SIGHUP,       SIGHUP_PORTABLE)        /* 1 */ \
+    X(SIGINT,       SIGINT_PORTABLE)        /* 2 */ \
+    X(SIGQUIT,      SIGQUIT_PORTABLE)       /* 3 */ \
+    X(SIGILL,       SIGILL_PORTABLE)        /* 4 */ \
+    X(SIGTRAP,      SIGTRAP_PORTABLE)       /* 5 */ \
+    X(SIGABRT,      SIGABRT_PORTABLE)       /* 6 */ \
+    X(SIGBUS,       SIGBUS_PORTABLE)        /* 7 --> 10 */ \
+    X(SIGFPE,       SIGFPE_PORTABLE)        /* 8 */ \
+    X(SIGKILL,      SIGKILL_PORTABLE)       /* 9 */ \
+    X(SIGUSR1,      SIGUSR1_PORTABLE)       /* 10 --> 16 */ \
+    X(SIGSEGV,      SIGSEGV_PORTABLE)       /* 11 */ \
+    X(SIGUSR2,      SIGUSR2_PORTABLE)       /* 12 --> 17 */ \
+    X(SIGPIPE,      SIGPIPE_PORTABLE)       /* 13 */ \
+    X(SIGALRM,      SIGALRM_PORTABLE)       /* 14 */ \
+    X(SIGTERM,      SIGTERM_PORTABLE)       /* 15 */ \
+    X(SIGEMT,       SIGSTKFLT_PORTABLE)     /* 16 --> 7 */ \
+    X(SIGCHLD,      SIGCHLD_PORTABLE)       /* 17 --> 18 */ \
+    X(SIGCONT,      SIGCONT_PORTABLE)       /* 18 --> 25 */ \
+    X(SIGSTOP,      SIGSTOP_PORTABLE)       /* 19 --> 23 */ \
+    X(SIGTSTP,      SIGTSTP_PORTABLE)       /* 20 --> 24 */ \
+    X(SIGTTIN,      SIGTTIN_PORTABLE)       /* 21 --> 26 */ \
+    X(SIGTTOU,      SIGTTOU_PORTABLE)       /* 22 --> 27 */ \
+    X(SIGURG,       SIGURG_PORTABLE)        /* 23 --> 21 */ \
+    X(SIGXCPU,      SIGXCPU_PORTABLE)       /* 24 --> 30 */ \
+    X(SIGXFSZ,      SIGXFSZ_PORTABLE)       /* 25 --> 31 */ \
+    X(SIGVTALRM,    SIGVTALRM_PORTABLE)     /* 26 --> 28 */ \
+    X(SIGPROF,      SIGPROF_PORTABLE)       /* 27 --> 29 */ \
+    X(SIGWINCH,     SIGWINCH_PORTABLE)      /* 28 --> 20 */ \
+    X(SIGIO,        SIGIO_PORTABLE)         /* 29 --> 22 */ \
+    X(SIGPWR,       SIGPWR_PORTABLE)        /* 30 --> 19 */ \
+    X(SIGSYS,       SIGSYS_PORTABLE)        /* 31 --> 12 */
+
+#define SIGNUM_PTON_ENTRY(native, portable) [portable] = native,
+static const unsigned char signum_pton_table[SIGRTMIN_PORTABLE] = {
+    SIGNAL_MAP(SIGNUM_PTON_ENTRY)
+};
+
+#define SIGNUM_NTOP_ENTRY(native, portable) [native] = portable,
+static const unsigned char signum_ntop_table[SIGRTMIN] = {
+    SIGNAL_MAP(SIGNUM_NTOP_ENTRY)
+};
+
+
 /*
  * Maps a signal number from portable to native.
  */
@@ -224,134 +275,32 @@ __hidden int signum_pton(int portable_signum)
 {
     int mips_signum = -1;
 
-    switch(portable_signum) {
-
-    case 0:                             /* 0 */
-        return 0;
-
-    case SIGHUP_PORTABLE:               /* 1 */
-        return SIGHUP;
-
-    case SIGINT_PORTABLE:               /* 2 */
-        return SIGINT;
-
-    case SIGQUIT_PORTABLE:              /* 3 */
-        return SIGQUIT;
-
-    case SIGILL_PORTABLE:               /* 4 */
-        return SIGILL;
-
-    case SIGTRAP_PORTABLE:              /* 5 */
-        return SIGTRAP;
-
-    case SIGABRT_PORTABLE:              /* 6 */
-        return SIGABRT;
-
-    case SIGBUS_PORTABLE:               /* 7 --> 10 */
-        return SIGBUS;
-
-    case SIGFPE_PORTABLE:               /* 8 */
-        return SIGFPE;
-
-    case SIGKILL_PORTABLE:              /* 9 */
-        return SIGKILL;
-
-    case SIGUSR1_PORTABLE:              /* 10 --> 16 */
-        return SIGUSR1;
-
-    case SIGSEGV_PORTABLE:              /* 11 */
-        return SIGSEGV;
-
-    case SIGUSR2_PORTABLE:              /* 12 --> 17 */
-        return SIGUSR2;
-
-    case SIGPIPE_PORTABLE:              /* 13 */
-        return SIGPIPE;
-
-    case SIGALRM_PORTABLE:              /* 14 */
-        return SIGALRM;
-
-    case SIGTERM_PORTABLE:              /* 15 */
-        return SIGTERM;
-
-    case SIGSTKFLT_PORTABLE:            /* 16 --> 7 */
-        return SIGEMT;                  /* No native SIGSTKFLT exist  ...
-                                           ... mapping it to SIGEMT. */
-
-    case SIGCHLD_PORTABLE:              /* 17 --> 18 */
-        return SIGCHLD;
-
-    case SIGCONT_PORTABLE:              /* 18 --> 25 */
-        return SIGCONT;
-
-    case SIGSTOP_PORTABLE:              /* 19 --> 23 */
-        return SIGSTOP;
-
-    case SIGTSTP_PORTABLE:              /* 20 --> 24 */
-        return SIGTSTP;
-
-    case SIGTTIN_PORTABLE:              /* 21 --> 26 */
-        return SIGTTIN;
-
-    case SIGTTOU_PORTABLE:              /* 22 --> 27 */
-        return SIGTTOU;
-
-    case SIGURG_PORTABLE:               /* 23 --> 21 */
-        return SIGURG;
-
-    case SIGXCPU_PORTABLE:              /* 24 --> 30 */
-        return SIGXCPU;
-
-    case SIGXFSZ_PORTABLE:              /* 25 --> 31 */
-        return SIGXFSZ;
-
-    case SIGVTALRM_PORTABLE:            /* 26 --> 28 */
-        return SIGVTALRM;
+    if ((unsigned int)portable_signum < SIGRTMIN_PORTABLE)
+        return signum_pton_table[portable_signum];
 
-    case SIGPROF_PORTABLE:              /* 27 --> 29 */
-        return SIGPROF;
-
-    case SIGWINCH_PORTABLE:             /* 28 --> 20 */
-        return SIGWINCH;
-
-    case SIGIO_PORTABLE:                /* 29 --> 22 */
-        return SIGIO;
-
-    case SIGPWR_PORTABLE:               /* 30 --> 19 */
-        return SIGPWR;
-
-    case SIGSYS_PORTABLE:               /* 31 --> 12 */
-        return SIGSYS;
     /*
      * Mapping lower 32 Real Time signals to identical Native signal numbers.
      * NOTE: SIGRTMAX_PORTABLE == 64 but SIGRTMAX == 128.
      */
-    case SIGRTMIN_PORTABLE...SIGRTMAX_PORTABLE:         /* 32 ... 64 */
+    if (portable_signum >= SIGRTMIN_PORTABLE && portable_signum <= SIGRTMAX_PORTABLE) {
         ASSERT(SIGRTMIN_PORTABLE == SIGRTMIN);
         ASSERT(SIGRTMAX_PORTABLE <= SIGRTMAX);
         return portable_signum;
+    }
 
-    default:
-        ALOGE("%s: switch default: NOTE portable_signum:%d Not supported. Just a Test?",
-              __func__,                 portable_signum);
-        /*
-         * User could be LTP testing with bogus signal numbers,
-         * if so we mimic the test.
-         *
-         * If the signal is just outside the PORTABLE range
-         * we use a signal just outside the Native/MIPS range.
-         */
-        if (portable_signum < 0) {
-            mips_signum = portable_signum;
-        } else if (portable_signum > NSIG_PORTABLE) {
-            mips_signum = (portable_signum - NSIG_PORTABLE) +  NSIG;
-        } else {
-            ALOGE("%s: 0 < portable_signum:%d <= NSIG_PORTABLE:%d; Not supported, return(0);",
-                 __func__, portable_signum,      NSIG_PORTABLE);
-
-            mips_signum = 0;
-        }
-        break;
+    ALOGE("%s: NOTE portable_signum:%d Not supported. Just a Test?",
+          __func__,   portable_signum);
+    /*
+     * User could be LTP testing with bogus signal numbers,
+     * if so we mimic the test.
+     *
+     * If the signal is just outside the PORTABLE range
+     * we use a signal just outside the Native/MIPS range.
+     */
+    if (portable_signum < 0) {
+        mips_signum = portable_signum;
+    } else {
+        mips_signum = (portable_signum - NSIG_PORTABLE) +  NSIG;
     }
     ALOGV("%s(portable_signum:%d): return(mips_signum:%d);", __func__,
               portable_signum,            mips_signum);
@@ -365,121 +314,24 @@ __hidden int signum_pton(int portable_signum)
  */
 __hidden int signum_ntop(int mips_signum)
 {
-    int portable_ssignum = -1;
-
-    switch(mips_signum) {
-    case 0:                             /* 0 */
-        return 0;
-
-    case SIGHUP:                        /* 1 */
-        return SIGHUP_PORTABLE;
-
-    case SIGINT:                        /* 2 */
-        return SIGINT_PORTABLE;
-
-    case SIGQUIT:                       /* 3 */
-        return SIGQUIT_PORTABLE;
-
-    case SIGILL:                        /* 4 */
-        return SIGILL_PORTABLE;
-
-    case SIGTRAP:                       /* 5 */
-        return SIGTRAP_PORTABLE;
-
-    case SIGABRT:                       /* 6 */
-        return SIGABRT_PORTABLE;
-
-    case SIGBUS:                        /* 7 <-- 10 */
-        return SIGBUS_PORTABLE;
-
-    case SIGFPE:                        /* 8 */
-        return SIGFPE_PORTABLE;
-
-    case SIGKILL:                       /* 9 */
-        return SIGKILL_PORTABLE;
-
-    case SIGUSR1:                       /* 10 <-- 16 */
-        return SIGUSR1_PORTABLE;
-
-    case SIGSEGV:                       /* 11 */
-        return SIGSEGV_PORTABLE;
-
-    case SIGUSR2:                       /* 12 <-- 17 */
-        return SIGUSR2_PORTABLE;
-
-    case SIGPIPE:                       /* 13 */
-        return SIGPIPE_PORTABLE;
-
-    case SIGALRM:                       /* 14 */
-        return SIGALRM_PORTABLE;
-
-    case SIGTERM:                       /* 15 */
-        return SIGTERM_PORTABLE;
-
-    case SIGEMT:                        /* 16 <--- 7 */
-        return SIGSTKFLT_PORTABLE;      /* No native SIGSTKFLT exist ...
-                                           ... reverse mapping SIGEMT ...
-                                           ...  back to SIGSTKFLT. */
-
-    case SIGCHLD:                       /* 17 <-- 18 */
-        return SIGCHLD_PORTABLE;
-
-    case SIGCONT:                       /* 18 <-- 15 */
-        return SIGCONT_PORTABLE;
-
-    case SIGSTOP:                       /* 19 <-- 23 */
-        return SIGSTOP_PORTABLE;
-
-    case SIGTSTP:                       /* 20 <-- 24 */
-        return SIGTSTP_PORTABLE;
-
-    case SIGTTIN:                       /* 21 <-- 26 */
-        return SIGTTIN_PORTABLE;
-
-    case SIGTTOU:                       /* 22 <-- 27 */
-        return SIGTTOU_PORTABLE;
-
-    case SIGURG:                        /* 23 <-- 21 */
-        return SIGURG_PORTABLE;
-
-    case SIGXCPU:                       /* 24 <-- 30 */
-        return SIGXCPU_PORTABLE;
-
-    case SIGXFSZ:                       /* 25 <-- 31 */
-        return SIGXFSZ_PORTABLE;
-
-    case SIGVTALRM:                     /* 26 <-- 28 */
-        return SIGVTALRM_PORTABLE;
-
-    case SIGPROF:                       /* 27 <-- 29 */
-        return SIGPROF_PORTABLE;
-
-    case SIGWINCH:                      /* 28 <-- 20 */
-        return SIGWINCH_PORTABLE;
-
-    case SIGIO:                         /* 29 <-- 22 */
-        return SIGIO_PORTABLE;
-
-    case SIGPWR:                        /* 30 <-- 19 */
-        return SIGPWR_PORTABLE;
-
-    case SIGSYS:                        /* 31 <-- 12 */
-        return SIGSYS_PORTABLE;
+    if ((unsigned int)mips_signum < SIGRTMIN)
+        return signum_ntop_table[mips_signum];
 
     /*
      * Mapping lower 32 Real Time signals to identical Portable signal numbers.
      * NOTE: SIGRTMAX_PORTABLE == 64 but SIGRTMAX == 128.
      */
-    case SIGRTMIN...SIGRTMAX_PORTABLE:              /* 32 ... 64 */
+    if (mips_signum >= SIGRTMIN && mips_signum <= SIGRTMAX_PORTABLE) {
         ASSERT(SIGRTMIN == SIGRTMIN_PORTABLE);
         ASSERT(SIGRTMAX >= SIGRTMAX_PORTABLE);
         return mips_signum;
+    }
 
    /*
     * Mapping upper 63 Native Real Time signals to the last Portable signal number.
     * Shouldn't even be possible to be using these signals.
     */
-    case (SIGRTMAX_PORTABLE+1)...SIGRTMAX:          /* 65 ... 128 */
+    if (mips_signum > SIGRTMAX_PORTABLE && mips_signum <= SIGRTMAX) {
         ASSERT(SIGRTMIN == SIGRTMIN_PORTABLE);
         ASSERT(SIGRTMAX >= SIGRTMAX_PORTABLE);
 
@@ -490,17 +342,14 @@ __hidden int signum_ntop(int mips_signum)
                 __func__);
 
         return SIGRTMAX_PORTABLE;
+    }
 
-
-    default:
-        ALOGE("%s: switch default: mips_signum:%d Not supported! return(0);", __func__,
-                                   mips_signum);
+    ALOGE("%s: mips_signum:%d Not supported! return(0);", __func__,
+               mips_signum);
 #if 0
-        LOG_FATAL("%s: mips_signum:%d is not portable;", __func__, mips_signum);
+    LOG_FATAL("%s: mips_signum:%d is not portable;", __func__, mips_signum);
 #endif
-        return 0;
-    }
-    return portable_ssignum;
+    return 0;
 }
 
 
@@ -929,9 +778,38 @@ int WRAP(raise)(int portable_signum)
 }
 
 
+/*
+ * Sets are translated a word at a time. In the first word each signal of
+ * SIGNAL_MAP is moved to its bit on the other side with a shift and a
+ * mask, the bits of the real time signals are copied as they are. The
+ * following words only hold real time signals and are copied.
+ */
+#define SIGSET_BIT(signum)              (1UL << ((signum) - 1))
+#define SIGSET_RT_MASK                  (~(SIGSET_BIT(SIGRTMIN_PORTABLE) - 1))
+#define SIGSET_PORTABLE_WORDS           (sizeof(sigset_portable_t) / sizeof(unsigned long))
+
+#define SIGSET_PTON_BIT(native, portable) \
+    | (((portable_word >> ((portable) - 1)) & 1UL) << ((native) - 1))
+
+#define SIGSET_NTOP_BIT(native, portable) \
+    | (((mips_word >> ((native) - 1)) & 1UL) << ((portable) - 1))
+
+static inline unsigned long sigset_word_pton(unsigned long portable_word)
+{
+    return (portable_word & SIGSET_RT_MASK) SIGNAL_MAP(SIGSET_PTON_BIT);
+}
+
+static inline unsigned long sigset_word_ntop(unsigned long mips_word)
+{
+    return (mips_word & SIGSET_RT_MASK) SIGNAL_MAP(SIGSET_NTOP_BIT);
+}
+
+
 void sigset_pton(sigset_portable_t *portable_sigset, sigset_t *mips_sigset)
 {
-    int portable_signum;
+    unsigned long *portable_words = (unsigned long *)portable_sigset;
+    unsigned long *mips_words = (unsigned long *)mips_sigset;
+    unsigned int i;
 
     ASSERT(mips_sigset != NULL);
 
@@ -945,28 +823,9 @@ void sigset_pton(sigset_portable_t *portable_sigset, sigset_t *mips_sigset)
         goto done;
     }
 
-    for(portable_signum = 1; portable_signum <= NSIG_PORTABLE; portable_signum++) {
-
-        if (WRAP(sigismember)(portable_sigset, portable_signum)) {
-            char *portable_signame = map_portable_signum_to_name(portable_signum);
-            int mips_signum = signum_pton(portable_signum);
-            char *mips_signame;
-
-            if (mips_signum != 0) {
-                int err;
-
-                mips_signame = map_mips_signum_to_name(mips_signum);
-                ALOGV("%s: sigaddset(mips_sigset:%p, mips_signum:%d:'%s');", __func__,
-                                     mips_sigset,    mips_signum,
-                                                     mips_signame);
-
-                err = sigaddset(mips_sigset, mips_signum);
-                if (err == -1) {
-                    PERROR("sigaddset");
-                }
-            }
-        }
-    }
+    mips_words[0] = sigset_word_pton(portable_words[0]);
+    for (i = 1; i < SIGSET_PORTABLE_WORDS; i++)
+        mips_words[i] = portable_words[i];
 
 done:
     ALOGV("%s: return; }", __func__);
@@ -974,32 +833,30 @@ done:
 }
 
 
+/*
+ * Native signals that are beyond the portable set are dropped.
+ */
 void
 sigset_ntop(const sigset_t *const_mips_sigset, sigset_portable_t *portable_sigset)
 {
-    int mips_signum;
-    sigset_t *mips_sigset = (sigset_t *) const_mips_sigset;
+    unsigned long *portable_words = (unsigned long *)portable_sigset;
+    const unsigned long *mips_words = (const unsigned long *)const_mips_sigset;
+    unsigned int i;
 
     ALOGV("%s(const_mips_sigset:%p, portable_sigset:%p) {", __func__,
               const_mips_sigset,    portable_sigset);
 
-    ASSERT(mips_sigset != NULL);
+    ASSERT(const_mips_sigset != NULL);
 
     if (invalid_pointer((void *)portable_sigset)) {
         ALOGE("%s: portable_sigset:%p is not Valid; can't return sigset", __func__,
                    portable_sigset);
         goto done;
     }
-    WRAP(sigemptyset)(portable_sigset);
-
-    for(mips_signum = 1; mips_signum <= NSIG; mips_signum++) {
-        if (sigismember(mips_sigset, mips_signum)) {
-            int portable_signum = signum_ntop(mips_signum);
 
-            if (portable_signum != 0)
-                WRAP(sigaddset)(portable_sigset, portable_signum);
-        }
-    }
+    portable_words[0] = sigset_word_ntop(mips_words[0]);
+    for (i = 1; i < SIGSET_PORTABLE_WORDS; i++)
+        portable_words[i] = mips_words[i];
 
 done:
     ALOGV("%s: return; }", __func__);
@@ -1007,37 +864,30 @@ done:
 }
 
 
+/*
+ * sigaction flags, as X(native, portable) pairs. SA_THIRTYTWO is
+ * handled separately.
+ */
+#define SA_FLAGS_MAP(X) \
+    X(SA_NOCLDSTOP,     SA_NOCLDSTOP_PORTABLE) \
+    X(SA_NOCLDWAIT,     SA_NOCLDWAIT_PORTABLE) \
+    X(SA_SIGINFO,       SA_SIGINFO_PORTABLE) \
+    X(SA_RESTORER,      SA_RESTORER_PORTABLE) \
+    X(SA_ONSTACK,       SA_ONSTACK_PORTABLE) \
+    X(SA_RESTART,       SA_RESTART_PORTABLE) \
+    X(SA_NODEFER,       SA_NODEFER_PORTABLE) \
+    X(SA_RESETHAND,     SA_RESETHAND_PORTABLE)
+
+#define SA_FLAG_PTON(native, portable)  | FLAG_MAP(portable_flags, portable, native)
+#define SA_FLAG_NTOP(native, portable)  | FLAG_MAP(mips_flags, native, portable)
+
 static int sigaction_flags_pton(int portable_flags)
 {
-    int mips_flags = 0;
+    int mips_flags = 0 SA_FLAGS_MAP(SA_FLAG_PTON);
 
-    if (portable_flags & SA_NOCLDSTOP_PORTABLE) {
-        mips_flags |= SA_NOCLDSTOP;
-    }
-    if (portable_flags & SA_NOCLDWAIT_PORTABLE) {
-        mips_flags |= SA_NOCLDWAIT;
-    }
-    if (portable_flags & SA_SIGINFO_PORTABLE) {
-        mips_flags |= SA_SIGINFO;
-    }
     if (portable_flags & SA_THIRTYTWO_PORTABLE) {
         ALOGV("%s: SA_THIRTYTWO_PORTABLE isn't SUPPORTED.", __func__);
     }
-    if (portable_flags & SA_RESTORER_PORTABLE) {
-        mips_flags |= SA_RESTORER;
-    }
-    if (portable_flags & SA_ONSTACK_PORTABLE) {
-        mips_flags |= SA_ONSTACK;
-    }
-    if (portable_flags & SA_RESTART_PORTABLE) {
-        mips_flags |= SA_RESTART;
-    }
-    if (portable_flags & SA_NODEFER_PORTABLE) {
-        mips_flags |= SA_NODEFER;
-    }
-    if (portable_flags & SA_RESETHAND_PORTABLE) {
-        mips_flags |= SA_RESETHAND;
-    }
 
     ALOGV("%s(portable_flags:0x%x) return(mips_flags:0x%x);", __func__,
               portable_flags,             mips_flags);
@@ -1048,19 +898,11 @@ static int sigaction_flags_pton(int portable_flags)
 
 int sigaction_flags_ntop(int mips_flags)
 {
-    int portable_flags = 0;
+    int portable_flags = 0 SA_FLAGS_MAP(SA_FLAG_NTOP);
 
-    if (mips_flags & SA_NOCLDSTOP)      portable_flags |= SA_NOCLDSTOP_PORTABLE;
-    if (mips_flags & SA_NOCLDWAIT)      portable_flags |= SA_NOCLDWAIT_PORTABLE;
-    if (mips_flags & SA_SIGINFO)        portable_flags |= SA_SIGINFO_PORTABLE;
 #ifdef SA_THIRTYTWO
     if (mips_flags & SA_THIRTYTWO)      portable_flags |= SA_THIRTYTWO_PORTABLE;
 #endif
-    if (mips_flags & SA_RESTORER)       portable_flags |= SA_RESTORER_PORTABLE;
-    if (mips_flags & SA_ONSTACK)        portable_flags |= SA_ONSTACK_PORTABLE;
-    if (mips_flags & SA_RESTART)        portable_flags |= SA_RESTART_PORTABLE;
-    if (mips_flags & SA_NODEFER)        portable_flags |= SA_NODEFER_PORTABLE;
-    if (mips_flags & SA_RESETHAND)      portable_flags |= SA_RESETHAND_PORTABLE;
 
     ALOGV("%s(mips_flags:0x%x) return(portable_flags:0x%x);", __func__,
               mips_flags,             portable_flags);
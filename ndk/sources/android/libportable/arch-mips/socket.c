@@ -50,6 +50,30 @@
 #endif
 
 
+/*
+ * Socket types, as X(native, portable) pairs. The translation tables
+ * are indexed by the type, once SOCK_NONBLOCK and SOCK_CLOEXEC are
+ * removed.
+ */
+#define SOCKTYPE_MAP(X) \
+    X(SOCK_STREAM,      SOCK_STREAM_PORTABLE) \
+    X(SOCK_DGRAM,       SOCK_DGRAM_PORTABLE) \
+    X(SOCK_RAW,         SOCK_RAW_PORTABLE) \
+    X(SOCK_RDM,         SOCK_RDM_PORTABLE) \
+    X(SOCK_SEQPACKET,   SOCK_SEQPACKET_PORTABLE) \
+    X(SOCK_PACKET,      SOCK_PACKET_PORTABLE)
+
+#define SOCKTYPE_PTON_ENTRY(native, portable) [portable] = native,
+static const unsigned char socktype_pton_table[SOCK_PACKET_PORTABLE + 1] = {
+    SOCKTYPE_MAP(SOCKTYPE_PTON_ENTRY)
+};
+
+#define SOCKTYPE_NTOP_ENTRY(native, portable) [native] = portable,
+static const unsigned char socktype_ntop_table[SOCK_PACKET + 1] = {
+    SOCKTYPE_MAP(SOCKTYPE_NTOP_ENTRY)
+};
+
+
 /*
  * Portable to Native socktype mapper.
  */
@@ -71,19 +95,14 @@ static inline int socktype_pton(int portable_type)
     }
 #endif
 
-    switch (portable_type) {
-    case SOCK_STREAM_PORTABLE: native_type |= SOCK_STREAM; break;
-    case SOCK_DGRAM_PORTABLE: native_type |= SOCK_DGRAM; break;
-    case SOCK_RAW_PORTABLE: native_type |= SOCK_RAW; break;
-    case SOCK_RDM_PORTABLE: native_type |= SOCK_RDM; break;
-    case SOCK_SEQPACKET_PORTABLE: native_type |= SOCK_SEQPACKET; break;
-    case SOCK_PACKET_PORTABLE: native_type |= SOCK_PACKET; break;
-    default:
-        ALOGE("%s: case default: native_type:0x%x |= portable_type:0x%x:[UNKNOWN!];", __func__,
-                                 native_type,        portable_type);
+    if ((unsigned int)portable_type < ARRAY_SIZE(socktype_pton_table) &&
+        socktype_pton_table[portable_type] != 0) {
+        native_type |= socktype_pton_table[portable_type];
+    } else {
+        ALOGE("%s: native_type:0x%x |= portable_type:0x%x:[UNKNOWN!];", __func__,
+                   native_type,        portable_type);
 
         native_type |= portable_type;
-        break;
     }
     ALOGV("%s: return(native_type:%d); }", __func__, native_type);
     return native_type;
@@ -111,17 +130,13 @@ static inline int socktype_ntop(int native_type)
     }
 #endif
 
-    switch (native_type) {
-    case SOCK_STREAM: portable_type |= SOCK_STREAM_PORTABLE; break;
-    case SOCK_DGRAM: portable_type |= SOCK_DGRAM_PORTABLE; break;
-    case SOCK_RAW: portable_type |= SOCK_RAW_PORTABLE; break;
-    case SOCK_RDM: portable_type |= SOCK_RDM_PORTABLE; break;
-    case SOCK_SEQPACKET: portable_type |= SOCK_SEQPACKET_PORTABLE; break;
-    case SOCK_PACKET: portable_type |= SOCK_PACKET_PORTABLE; break;
-    default:
+    if ((unsigned int)native_type < ARRAY_SIZE(socktype_ntop_table) &&
+        socktype_ntop_table[native_type] != 0) {
+        portable_type |= socktype_ntop_table[native_type];
+    } else {
         portable_type |= native_type;
-        ALOGE("%s: case default: portable_type:0x%x |= native_type:0x%x:[UNKNOWN!];", __func__,
-                                 portable_type,        native_type);
+        ALOGE("%s: portable_type:0x%x |= native_type:0x%x:[UNKNOWN!];", __func__,
+                   portable_type,        native_type);
     }
     ALOGV("%s: return(portable_type:%d); }", __func__, portable_type);
     return portable_type;
@@ -15,9 +15,20 @@
  */
 
 #include <portability.h>
+#include <string.h>
 #include <sys/epoll.h>
 #include <epoll_portable.h>
 
+/*
+ * The x86 struct epoll_event is packed into 12 bytes, while the portable
+ * one is padded to 16 bytes. Since the native array is never larger than
+ * the portable one, epoll_wait() can return its events directly into the
+ * caller's array, and they are then expanded in place. Walking the array
+ * backwards guarantees that no native event is overwritten before it has
+ * been converted. The native events are copied out with memcpy() as the
+ * two arrays alias each other.
+ */
+
 int WRAP(epoll_ctl)(int epfd, int op, int fd, struct epoll_event_portable *event)
 {
     struct epoll_event x86_epoll_event;
@@ -30,12 +41,17 @@ int WRAP(epoll_ctl)(int epfd, int op, int fd, struct epoll_event_portable *event
 
 int WRAP(epoll_wait)(int epfd, struct epoll_event_portable *events, int max, int timeout)
 {
-    struct epoll_event x86_epoll_event;
-    int ret = REAL(epoll_wait)(epfd, &x86_epoll_event, max, timeout);
+    struct epoll_event *x86_epoll_events = (struct epoll_event *)events;
+    int ret = REAL(epoll_wait)(epfd, x86_epoll_events, max, timeout);
+    int i;
+
+    for (i = ret - 1; i >= 0; i--) {
+        struct epoll_event x86_epoll_event;
 
-    events->events = x86_epoll_event.events;
-    events->data = x86_epoll_event.data;
+        memcpy(&x86_epoll_event, &x86_epoll_events[i], sizeof(x86_epoll_event));
+        events[i].events = x86_epoll_event.events;
+        events[i].data = x86_epoll_event.data;
+    }
 
     return ret;
 }
-
@@ -77,6 +77,32 @@
 #define O_CLOEXEC_PORTABLE 02000000
 #endif
 
+/*
+ * Open flags translated by the open(), fcntl() and __sflags() wrappers,
+ * as X(native, portable) pairs. The access mode bits are the same on
+ * all architectures and are passed through.
+ *
+ * O_FLAG_PTON() and O_FLAG_NTOP() translate the bits of a local 'flags'.
+ */
+#define O_FLAGS_MAP(X) \
+    X(O_CREAT,          O_CREAT_PORTABLE) \
+    X(O_EXCL,           O_EXCL_PORTABLE) \
+    X(O_NOCTTY,         O_NOCTTY_PORTABLE) \
+    X(O_TRUNC,          O_TRUNC_PORTABLE) \
+    X(O_APPEND,         O_APPEND_PORTABLE) \
+    X(O_NONBLOCK,       O_NONBLOCK_PORTABLE) \
+    X(O_SYNC,           O_SYNC_PORTABLE) \
+    X(FASYNC,           FASYNC_PORTABLE) \
+    X(O_DIRECT,         O_DIRECT_PORTABLE) \
+    X(O_LARGEFILE,      O_LARGEFILE_PORTABLE) \
+    X(O_DIRECTORY,      O_DIRECTORY_PORTABLE) \
+    X(O_NOFOLLOW,       O_NOFOLLOW_PORTABLE) \
+    X(O_NOATIME,        O_NOATIME_PORTABLE) \
+    X(O_NDELAY,         O_NDELAY_PORTABLE)
+
+#define O_FLAG_PTON(native, portable)   | FLAG_MAP(flags, portable, native)
+#define O_FLAG_NTOP(native, portable)   | FLAG_MAP(flags, native, portable)
+
 #ifndef __ARCH_FLOCK64_PAD
 #define __ARCH_FLOCK64_PAD
 #endif
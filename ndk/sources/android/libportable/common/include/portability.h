@@ -40,6 +40,17 @@ inline static int invalid_pointer(void *p)
         ;
 }
 
+/*
+ * Helpers for the tables and flag lists used to translate values
+ * between portable and native.
+ *
+ * FLAG_MAP() returns 'to' if any bit of 'from' is set in 'value'. With
+ * constant single-bit flags it compiles to shifts and masks, so the
+ * translation of a whole flag word doesn't branch.
+ */
+#define ARRAY_SIZE(a)               (sizeof(a) / sizeof((a)[0]))
+#define FLAG_MAP(value, from, to)   (((value) & (from)) ? (to) : 0)
+
 /*
  * Hidden functions are exposed while linking the libportable shared object
  * but are not exposed thereafter.
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2012, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test and benchmark of the epoll_wait() and poll() translations, with
+ * many ready descriptors.
+ *
+ * NUM_FDS eventfds are made readable, then:
+ *   - epoll_wait() must return all of them in a single call, with their
+ *     64-bit data intact, and must honour 'max';
+ *   - poll() must translate and report every descriptor, not just the
+ *     first one.
+ *
+ * Each call is then repeated for BENCH_SECS seconds, and the number of
+ * events returned per system call is reported.
+ */
+
+#include <portability.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <epoll_portable.h>
+#include <poll_portable.h>
+
+#define NUM_FDS     1024
+#define BENCH_SECS  1.0
+
+extern int WRAP(epoll_ctl)(int epfd, int op, int fd, struct epoll_event_portable *event);
+extern int WRAP(epoll_wait)(int epfd, struct epoll_event_portable *events, int max, int timeout);
+
+#ifdef __mips__
+extern int WRAP(poll)(struct pollfd *fds, nfds_t nfds, long timeout);
+#define test_poll WRAP(poll)
+#else
+/* The poll flags of the other architectures match the portable ones */
+#define test_poll poll
+#endif
+
+#define DATA_TAG    0xabcd0000ULL
+
+static int fds[NUM_FDS];
+static struct epoll_event_portable events[NUM_FDS];
+static struct pollfd pollfds[NUM_FDS];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int setup(void)
+{
+    struct rlimit rl;
+    uint64_t one = 1;
+    int i;
+
+    /* Make room for NUM_FDS eventfds, an epoll fd and stdio */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < NUM_FDS + 16) {
+        rl.rlim_cur = NUM_FDS + 16;
+        if (rl.rlim_max < rl.rlim_cur)
+            rl.rlim_max = rl.rlim_cur;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    for (i = 0; i < NUM_FDS; i++) {
+        fds[i] = eventfd(0, 0);
+        if (fds[i] < 0) {
+            fprintf(stderr, "eventfd #%d: %s\n", i, strerror(errno));
+            return -1;
+        }
+        if (write(fds[i], &one, sizeof(one)) != sizeof(one)) {
+            fprintf(stderr, "write #%d: %s\n", i, strerror(errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int test_epoll(void)
+{
+    struct epoll_event_portable event;
+    char *seen;
+    int epfd, i, ret, errors = 0;
+    long calls = 0, total = 0;
+    double start, elapsed = 0;
+
+    epfd = epoll_create(NUM_FDS);
+    if (epfd < 0) {
+        fprintf(stderr, "epoll_create: %s\n", strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < NUM_FDS; i++) {
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = (DATA_TAG << 32) | i;
+        if (WRAP(epoll_ctl)(epfd, EPOLL_CTL_ADD, fds[i], &event) < 0) {
+            fprintf(stderr, "epoll_ctl #%d: %s\n", i, strerror(errno));
+            close(epfd);
+            return -1;
+        }
+    }
+
+    /* All the descriptors must be returned by a single call */
+    memset(events, 0xff, sizeof(events));
+    ret = WRAP(epoll_wait)(epfd, events, NUM_FDS, 0);
+    if (ret != NUM_FDS) {
+        fprintf(stderr, "FAIL: epoll_wait returned %d events instead of %d\n",
+                ret, NUM_FDS);
+        errors++;
+    }
+
+    seen = calloc(NUM_FDS, 1);
+    for (i = 0; i < ret && seen != NULL; i++) {
+        uint64_t data = events[i].data.u64;
+        unsigned int index = (unsigned int)(data & 0xffffffff);
+
+        if (events[i].events != EPOLLIN || (data >> 32) != DATA_TAG ||
+            index >= NUM_FDS || seen[index]) {
+            fprintf(stderr, "FAIL: bad event #%d: events:0x%x data:0x%llx\n",
+                    i, events[i].events, (unsigned long long)data);
+            errors++;
+            break;
+        }
+        seen[index] = 1;
+    }
+    free(seen);
+
+    /* 'max' must be honoured */
+    ret = WRAP(epoll_wait)(epfd, events, 7, 0);
+    if (ret != 7) {
+        fprintf(stderr, "FAIL: epoll_wait(max:7) returned %d events\n", ret);
+        errors++;
+    }
+
+    start = now();
+    do {
+        ret = WRAP(epoll_wait)(epfd, events, NUM_FDS, 0);
+        if (ret < 0)
+            break;
+        total += ret;
+        calls++;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_SECS);
+
+    printf("epoll_wait: %d fds, %.1f events/call, %.0f calls/s, %.0f events/s\n",
+           NUM_FDS, (double)total / calls, calls / elapsed, total / elapsed);
+
+    close(epfd);
+    return errors ? -1 : 0;
+}
+
+static int test_poll_fds(void)
+{
+    int i, ret, errors = 0;
+    long calls = 0, total = 0;
+    double start, elapsed = 0;
+
+    for (i = 0; i < NUM_FDS; i++) {
+        pollfds[i].fd = fds[i];
+        pollfds[i].events = POLLIN_PORTABLE | POLLOUT_PORTABLE | POLLWRNORM_PORTABLE;
+        pollfds[i].revents = 0;
+    }
+
+    /* Every descriptor is readable and writable */
+    ret = test_poll(pollfds, NUM_FDS, 0);
+    if (ret != NUM_FDS) {
+        fprintf(stderr, "FAIL: poll returned %d instead of %d\n", ret, NUM_FDS);
+        errors++;
+    }
+    for (i = 0; i < NUM_FDS; i++) {
+        short revents = pollfds[i].revents;
+
+        /* all the events must have been translated back the same way */
+        if ((revents & POLLIN_PORTABLE) == 0 || (revents & POLLOUT_PORTABLE) == 0 ||
+            (pollfds[i].events & POLLIN_PORTABLE) == 0 ||
+            pollfds[i].events != pollfds[0].events) {
+            fprintf(stderr, "FAIL: bad pollfd #%d: events:0x%x revents:0x%x\n",
+                    i, pollfds[i].events, revents);
+            errors++;
+            break;
+        }
+    }
+
+    start = now();
+    do {
+        ret = test_poll(pollfds, NUM_FDS, 0);
+        if (ret < 0)
+            break;
+        total += ret;
+        calls++;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_SECS);
+
+    printf("poll: %d fds, %.1f events/call, %.0f calls/s, %.0f events/s\n",
+           NUM_FDS, (double)total / calls, calls / elapsed, total / elapsed);
+
+    return errors ? -1 : 0;
+}
+
+int main(void)
+{
+    int status = 0;
+
+    if (setup() < 0)
+        return 1;
+
+    if (test_epoll() < 0)
+        status = 1;
+    if (test_poll_fds() < 0)
+        status = 1;
+
+    printf("%s\n", status ? "FAILED" : "PASSED");
+    return status;
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2012, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test and benchmark of the table driven errno, signal and flag
+ * translations of the MIPS libportable.
+ *
+ * errno.c and signal.c are included, to reach their specs and static
+ * functions. For each translation a reference is built from the same
+ * spec the way the code used to be written: a switch for the numbers,
+ * a loop over the signals for the sets and a test per flag. Both must
+ * agree for every input, then both are timed and their cost per call
+ * is reported.
+ */
+
+#include "../arch-mips/errno.c"
+#include "../arch-mips/signal.c"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_INPUTS  1024
+#define BENCH_SECS  0.5
+
+/* Spreads the bits of a small input over a whole word */
+#define SPREAD(input)   ((unsigned int)(input) * 0x9e3779b1u)
+
+static int inputs[NUM_INPUTS];
+static volatile int sink;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Returns the cost of fn() in ns per call, over the inputs */
+static double bench(int (*fn)(int))
+{
+    long calls = 0;
+    double start = now(), elapsed;
+    int i;
+
+    do {
+        for (i = 0; i < NUM_INPUTS; i++)
+            sink = fn(inputs[i]);
+        calls += NUM_INPUTS;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_SECS);
+
+    return elapsed * 1e9 / calls;
+}
+
+/* Fills the inputs with values cycling through [first, last] */
+static void fill_inputs(int first, int last)
+{
+    unsigned int seed = 1;
+    int i;
+
+    for (i = 0; i < NUM_INPUTS; i++) {
+        seed = seed * 1103515245 + 12345;
+        inputs[i] = first + (int)((seed >> 8) % (unsigned int)(last - first + 1));
+    }
+}
+
+static int compare(const char *name, int (*fn)(int), int (*ref)(int), int first, int last)
+{
+    int i;
+
+    for (i = first; i <= last; i++) {
+        if (fn(i) != ref(i)) {
+            printf("FAIL: %s(%d) returned %d instead of %d\n", name, i, fn(i), ref(i));
+            return -1;
+        }
+    }
+    fill_inputs(first, last);
+    printf("%-22s %6.1f ns/call, switch: %6.1f ns/call\n", name, bench(fn), bench(ref));
+    return 0;
+}
+
+
+#define ERRNO_NTOP_CASE(native, portable)   case native: return portable;
+#define ERRNO_PTON_CASE(native, portable)   case portable: return native;
+
+static int switch_errno_ntop(int native_errno)
+{
+    switch (native_errno) {
+    ERRNO_MAP(ERRNO_NTOP_CASE)
+    default: return native_errno;
+    }
+}
+
+static int switch_errno_pton(int portable_errno)
+{
+    switch (portable_errno) {
+    ERRNO_MAP(ERRNO_PTON_CASE)
+    default: return portable_errno;
+    }
+}
+
+
+#define SIGNUM_NTOP_CASE(native, portable)  case native: return portable;
+#define SIGNUM_PTON_CASE(native, portable)  case portable: return native;
+
+static int switch_signum_ntop(int mips_signum)
+{
+    switch (mips_signum) {
+    case 0: return 0;
+    SIGNAL_MAP(SIGNUM_NTOP_CASE)
+    case SIGRTMIN...SIGRTMAX_PORTABLE: return mips_signum;
+    default: return 0;
+    }
+}
+
+static int switch_signum_pton(int portable_signum)
+{
+    switch (portable_signum) {
+    case 0: return 0;
+    SIGNAL_MAP(SIGNUM_PTON_CASE)
+    case SIGRTMIN_PORTABLE...SIGRTMAX_PORTABLE: return portable_signum;
+    default: return 0;
+    }
+}
+
+
+/*
+ * The sets are built from the input, spread over the first word, and
+ * only the first word is compared.
+ */
+static int table_sigset_pton(int bits)
+{
+    sigset_portable_t portable_sigset = SPREAD(bits);
+    sigset_t mips_sigset;
+
+    sigset_pton(&portable_sigset, &mips_sigset);
+    return (int)((unsigned long *)&mips_sigset)[0];
+}
+
+static int loop_sigset_pton(int bits)
+{
+    sigset_portable_t portable_sigset = SPREAD(bits);
+    sigset_t mips_sigset;
+    int portable_signum;
+
+    sigemptyset(&mips_sigset);
+    for (portable_signum = 1; portable_signum <= SIGRTMIN_PORTABLE; portable_signum++) {
+        if (WRAP(sigismember)(&portable_sigset, portable_signum))
+            sigaddset(&mips_sigset, switch_signum_pton(portable_signum));
+    }
+    return (int)((unsigned long *)&mips_sigset)[0];
+}
+
+static int table_sigset_ntop(int bits)
+{
+    sigset_portable_t portable_sigset;
+    sigset_t mips_sigset;
+
+    sigemptyset(&mips_sigset);
+    ((unsigned long *)&mips_sigset)[0] = SPREAD(bits);
+    sigset_ntop(&mips_sigset, &portable_sigset);
+    return (int)portable_sigset;
+}
+
+static int loop_sigset_ntop(int bits)
+{
+    sigset_portable_t portable_sigset;
+    sigset_t mips_sigset;
+    int mips_signum;
+
+    sigemptyset(&mips_sigset);
+    ((unsigned long *)&mips_sigset)[0] = SPREAD(bits);
+    WRAP(sigemptyset)(&portable_sigset);
+    for (mips_signum = 1; mips_signum <= SIGRTMIN; mips_signum++) {
+        if (sigismember(&mips_sigset, mips_signum))
+            WRAP(sigaddset)(&portable_sigset, switch_signum_ntop(mips_signum));
+    }
+    return (int)portable_sigset;
+}
+
+
+static int table_sigaction_flags_ntop(int input)
+{
+    return sigaction_flags_ntop(SPREAD(input));
+}
+
+#define SA_FLAG_NTOP_TEST(native, portable) \
+    if (mips_flags & native) portable_flags |= portable;
+
+static int if_sigaction_flags_ntop(int input)
+{
+    int mips_flags = SPREAD(input);
+    int portable_flags = 0;
+
+    SA_FLAGS_MAP(SA_FLAG_NTOP_TEST)
+    return portable_flags;
+}
+
+
+static int table_o_flags_pton(int flags)
+{
+    return (flags & O_ACCMODE_PORTABLE) O_FLAGS_MAP(O_FLAG_PTON);
+}
+
+#define O_FLAG_PTON_TEST(native, portable)  if (flags & portable) mipsflags |= native;
+
+static int if_o_flags_pton(int flags)
+{
+    int mipsflags = flags & O_ACCMODE_PORTABLE;
+
+    O_FLAGS_MAP(O_FLAG_PTON_TEST)
+    return mipsflags;
+}
+
+
+int main(void)
+{
+    int status = 0;
+
+    status |= compare("errno_ntop", errno_ntop, switch_errno_ntop, -1, 1200);
+    status |= compare("errno_pton", errno_pton, switch_errno_pton, -1, 1200);
+    status |= compare("signum_ntop", signum_ntop, switch_signum_ntop, 0, SIGRTMAX_PORTABLE);
+    status |= compare("signum_pton", signum_pton, switch_signum_pton, 0, SIGRTMAX_PORTABLE);
+    status |= compare("sigset_ntop", table_sigset_ntop, loop_sigset_ntop, 0, 0xffff);
+    status |= compare("sigset_pton", table_sigset_pton, loop_sigset_pton, 0, 0xffff);
+    status |= compare("sigaction_flags_ntop", table_sigaction_flags_ntop,
+                      if_sigaction_flags_ntop, 0, 0xffff);
+    status |= compare("open_flags_pton", table_o_flags_pton, if_o_flags_pton, 0, 0xfffff);
+
+    printf("%s\n", status ? "FAILED" : "PASSED");
+    return status;
+}
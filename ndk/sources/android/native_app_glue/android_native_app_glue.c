@@ -18,8 +18,10 @@
 #include <jni.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
 #include <sys/resource.h>
 
 #include "android_native_app_glue.h"
@@ -45,19 +47,71 @@ static void free_saved_state(struct android_app* android_app) {
     pthread_mutex_unlock(&android_app->mutex);
 }
 
+#define CMD_RING_MASK (ANDROID_APP_CMD_RING_SIZE - 1)
+
+// Commands that don't need to be queued again while one is pending,
+// as the app thread only looks at the current state when it gets them.
+#define CMD_COALESCED ((1u << APP_CMD_WINDOW_RESIZED) | \
+        (1u << APP_CMD_WINDOW_REDRAW_NEEDED) | \
+        (1u << APP_CMD_CONTENT_RECT_CHANGED) | \
+        (1u << APP_CMD_CONFIG_CHANGED) | \
+        (1u << APP_CMD_LOW_MEMORY))
+
+static void signal_cmd(struct android_app* android_app) {
+    uint64_t one = 1;
+    size_t len = (android_app->msgwrite == android_app->msgread) ? sizeof(one) : 1;
+    if (write(android_app->msgwrite, &one, len) != (ssize_t)len) {
+        LOGE("Failure signaling android_app cmd: %s\n", strerror(errno));
+    }
+}
+
+static void clear_cmd_signal(struct android_app* android_app) {
+    uint64_t buf[8];
+    while (read(android_app->msgread, buf, sizeof(buf)) == sizeof(buf)) {
+    }
+}
+
 int8_t android_app_read_cmd(struct android_app* android_app) {
+    uint32_t head = android_app->cmdHead;
     int8_t cmd;
-    if (read(android_app->msgread, &cmd, sizeof(cmd)) == sizeof(cmd)) {
-        switch (cmd) {
-            case APP_CMD_SAVE_STATE:
-                free_saved_state(android_app);
-                break;
+
+    if (head == android_app->cmdTail) {
+        // Signaled without a command, e.g. after the signal was set again
+        // below.
+        clear_cmd_signal(android_app);
+        __sync_synchronize();
+        if (head == android_app->cmdTail) {
+            LOGV("No android_app cmd queued");
+            return -1;
         }
-        return cmd;
-    } else {
-        LOGE("No data on command pipe!");
     }
-    return -1;
+
+    __sync_synchronize();
+    cmd = android_app->cmdRing[head & CMD_RING_MASK];
+    if ((1u << cmd) & CMD_COALESCED) {
+        __sync_fetch_and_and(&android_app->cmdQueued, ~(1u << cmd));
+    }
+    __sync_synchronize();
+    android_app->cmdHead = ++head;
+    __sync_synchronize();
+
+    // The main thread only signals when it queues into an empty ring: once
+    // it is empty, clear the signal, and set it again if a command was
+    // queued meanwhile.
+    if (head == android_app->cmdTail) {
+        clear_cmd_signal(android_app);
+        __sync_synchronize();
+        if (head != android_app->cmdTail) {
+            signal_cmd(android_app);
+        }
+    }
+
+    switch (cmd) {
+        case APP_CMD_SAVE_STATE:
+            free_saved_state(android_app);
+            break;
+    }
+    return cmd;
 }
 
 static void print_cur_config(struct android_app* android_app) {
@@ -204,6 +258,7 @@ static void process_input(struct android_app* app, struct android_poll_source* s
 
 static void process_cmd(struct android_app* app, struct android_poll_source* source) {
     int8_t cmd = android_app_read_cmd(app);
+    if (cmd < 0) return;
     android_app_pre_exec_cmd(app, cmd);
     if (app->onAppCmd != NULL) app->onAppCmd(app, cmd);
     android_app_post_exec_cmd(app, cmd);
@@ -259,13 +314,19 @@ static struct android_app* android_app_create(ANativeActivity* activity,
         memcpy(android_app->savedState, savedState, savedStateSize);
     }
 
-    int msgpipe[2];
-    if (pipe(msgpipe)) {
-        LOGE("could not create pipe: %s", strerror(errno));
-        return NULL;
+    android_app->msgread = eventfd(0, 0);
+    if (android_app->msgread >= 0) {
+        android_app->msgwrite = android_app->msgread;
+    } else {
+        int msgpipe[2];
+        if (pipe(msgpipe)) {
+            LOGE("could not create pipe: %s", strerror(errno));
+            return NULL;
+        }
+        android_app->msgread = msgpipe[0];
+        android_app->msgwrite = msgpipe[1];
     }
-    android_app->msgread = msgpipe[0];
-    android_app->msgwrite = msgpipe[1];
+    fcntl(android_app->msgread, F_SETFL, O_NONBLOCK);
 
     pthread_attr_t attr; 
     pthread_attr_init(&attr);
@@ -283,8 +344,28 @@ static struct android_app* android_app_create(ANativeActivity* activity,
 }
 
 static void android_app_write_cmd(struct android_app* android_app, int8_t cmd) {
-    if (write(android_app->msgwrite, &cmd, sizeof(cmd)) != sizeof(cmd)) {
-        LOGE("Failure writing android_app cmd: %s\n", strerror(errno));
+    uint32_t tail = android_app->cmdTail;
+
+    if ((1u << cmd) & CMD_COALESCED) {
+        if (__sync_fetch_and_or(&android_app->cmdQueued, 1u << cmd) & (1u << cmd)) {
+            LOGV("Coalescing android_app cmd %d\n", cmd);
+            return;
+        }
+    }
+
+    // Commands can't be dropped: wait for the app thread to make room.
+    while (tail - android_app->cmdHead >= ANDROID_APP_CMD_RING_SIZE) {
+        sched_yield();
+    }
+
+    android_app->cmdRing[tail & CMD_RING_MASK] = cmd;
+    __sync_synchronize();
+    android_app->cmdTail = tail + 1;
+    __sync_synchronize();
+
+    // Only signal if the app thread had read everything before this command.
+    if (android_app->cmdHead == tail) {
+        signal_cmd(android_app);
     }
 }
 
@@ -316,7 +397,7 @@ static void android_app_set_window(struct android_app* android_app, ANativeWindo
 static void android_app_set_activity_state(struct android_app* android_app, int8_t cmd) {
     pthread_mutex_lock(&android_app->mutex);
     android_app_write_cmd(android_app, cmd);
-    while (android_app->activityState != cmd) {
+    while (!android_app->nonBlockingLifecycle && android_app->activityState != cmd) {
         pthread_cond_wait(&android_app->cond, &android_app->mutex);
     }
     pthread_mutex_unlock(&android_app->mutex);
@@ -331,7 +412,9 @@ static void android_app_free(struct android_app* android_app) {
     pthread_mutex_unlock(&android_app->mutex);
 
     close(android_app->msgread);
-    close(android_app->msgwrite);
+    if (android_app->msgwrite != android_app->msgread) {
+        close(android_app->msgwrite);
+    }
     pthread_cond_destroy(&android_app->cond);
     pthread_mutex_destroy(&android_app->mutex);
     free(android_app);
@@ -83,6 +83,12 @@ extern "C" {
 
 struct android_app;
 
+/**
+ * Number of commands that can be queued for the app thread.  Must be a
+ * power of two.
+ */
+#define ANDROID_APP_CMD_RING_SIZE 256
+
 /**
  * Data associated with an ALooper fd that will be returned as the "outData"
  * when that source has data ready.
@@ -161,15 +167,34 @@ struct android_app {
     // destroyed and waiting for the app thread to complete.
     int destroyRequested;
 
+    // Set this to non-zero, from android_main(), to let the activity's
+    // start, resume, pause and stop callbacks return as soon as their
+    // command is queued instead of waiting for the app thread to process
+    // it.  Window, input queue, save state and destroy commands are always
+    // waited for.
+    int nonBlockingLifecycle;
+
     // -------------------------------------------------
     // Below are "private" implementation of the glue code.
 
     pthread_mutex_t mutex;
     pthread_cond_t cond;
 
+    // Commands from the main thread are queued in cmdRing, the main thread
+    // being the only producer and the app thread the only consumer.
+    // msgread is signaled while the ring isn't empty; it is an eventfd,
+    // with msgwrite == msgread, or the read end of a pipe.
     int msgread;
     int msgwrite;
 
+    int8_t cmdRing[ANDROID_APP_CMD_RING_SIZE];
+    volatile uint32_t cmdHead;
+    volatile uint32_t cmdTail;
+
+    // Bit mask of the coalesced commands that are queued but not yet
+    // read by the app thread.
+    volatile uint32_t cmdQueued;
+
     pthread_t thread;
 
     struct android_poll_source cmdPollSource;
@@ -313,7 +338,12 @@ enum {
 
 /**
  * Call when ALooper_pollAll() returns LOOPER_ID_MAIN, reading the next
- * app command message.
+ * app command message.  Returns -1 if there is no command to read.
+ *
+ * Repeated APP_CMD_CONFIG_CHANGED, APP_CMD_LOW_MEMORY,
+ * APP_CMD_WINDOW_RESIZED, APP_CMD_WINDOW_REDRAW_NEEDED and
+ * APP_CMD_CONTENT_RECT_CHANGED commands are coalesced: a command that is
+ * still queued is not queued again.
  */
 int8_t android_app_read_cmd(struct android_app* android_app);
 
@@ -0,0 +1,11 @@
+# Command delivery latency of the native_app_glue library
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := test_native_app_glue_latency
+LOCAL_SRC_FILES := main.c
+LOCAL_LDLIBS := -landroid -llog
+LOCAL_STATIC_LIBRARIES := android_native_app_glue
+include $(BUILD_EXECUTABLE)
+
+$(call import-module,android/native_app_glue)
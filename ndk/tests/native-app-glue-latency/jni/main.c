@@ -0,0 +1,199 @@
+/*
+ * Command delivery latency of the native_app_glue library.
+ *
+ * There is no Java activity here: this program plays the activity's main
+ * thread by calling the callbacks that ANativeActivity_onCreate() installs,
+ * and android_main() runs the usual event loop in the app thread. It
+ * measures:
+ *
+ *  - the delay between the main thread queuing a command and the app
+ *    thread receiving it in onAppCmd,
+ *  - the time spent in the lifecycle callbacks, waiting for the app
+ *    thread, and with android_app::nonBlockingLifecycle set,
+ *  - that repeated APP_CMD_CONFIG_CHANGED commands are coalesced while
+ *    the app thread is busy.
+ */
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <android_native_app_glue.h>
+
+#define ITERATIONS     10000
+#define CONFIG_CHANGES 1000
+
+static volatile int     received;
+static volatile double  received_time;
+static volatile int     config_changes;
+static sem_t            busy_sem;
+static double           latencies[ITERATIONS];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* There is no asset manager outside of a real activity */
+void AConfiguration_fromAssetManager(AConfiguration* out, AAssetManager* am)
+{
+}
+
+static void on_app_cmd(struct android_app* app, int32_t cmd)
+{
+    switch (cmd) {
+    case APP_CMD_CONFIG_CHANGED:
+        config_changes++;
+        break;
+    case APP_CMD_LOW_MEMORY:
+        /* Keeps the app thread busy until the main thread is done */
+        sem_wait(&busy_sem);
+        break;
+    }
+    received_time = now();
+    __sync_synchronize();
+    received++;
+}
+
+void android_main(struct android_app* app)
+{
+    app->onAppCmd = on_app_cmd;
+
+    while (!app->destroyRequested) {
+        struct android_poll_source* source;
+        int events;
+
+        if (ALooper_pollAll(-1, NULL, &events, (void**)&source) >= 0 && source != NULL)
+            source->process(app, source);
+    }
+}
+
+/* Waits until the app thread has received 'count' commands */
+static void wait_received(int count)
+{
+    while (received < count)
+        sched_yield();
+    __sync_synchronize();
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static void report(const char* name, double* values, int count)
+{
+    double total = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+        total += values[i];
+    qsort(values, count, sizeof(*values), compare_doubles);
+    printf("%-28s avg %7.1f us  p50 %7.1f us  p99 %7.1f us  max %7.1f us\n", name,
+           total / count * 1e6, values[count / 2] * 1e6, values[count * 99 / 100] * 1e6,
+           values[count - 1] * 1e6);
+}
+
+/* Delay from queuing a focus change to its delivery to the app thread */
+static void test_delivery(ANativeActivity* activity)
+{
+    int i;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        int count = received;
+        double start = now();
+
+        activity->callbacks->onWindowFocusChanged(activity, i & 1);
+        wait_received(count + 1);
+        latencies[i] = received_time - start;
+    }
+    report("focus change delivery", latencies, ITERATIONS);
+}
+
+/* Time spent in the pause and resume callbacks */
+static void test_lifecycle(ANativeActivity* activity, const char* name)
+{
+    int i;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        int count = received;
+        double start = now();
+
+        if (i & 1)
+            activity->callbacks->onResume(activity);
+        else
+            activity->callbacks->onPause(activity);
+        latencies[i] = now() - start;
+        wait_received(count + 1);
+    }
+    report(name, latencies, ITERATIONS);
+}
+
+/* Config changes queued while the app thread is busy must be coalesced */
+static int test_coalescing(ANativeActivity* activity)
+{
+    int count = received;
+    int i;
+
+    config_changes = 0;
+    activity->callbacks->onLowMemory(activity);
+    for (i = 0; i < CONFIG_CHANGES; i++)
+        activity->callbacks->onConfigurationChanged(activity);
+    sem_post(&busy_sem);
+
+    /* The focus change is queued after the config change */
+    activity->callbacks->onWindowFocusChanged(activity, 1);
+    wait_received(count + 3);
+
+    printf("%d config changes delivered as %d commands\n", CONFIG_CHANGES, config_changes);
+    if (config_changes != 1) {
+        fprintf(stderr, "FAIL: expected a single APP_CMD_CONFIG_CHANGED\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    ANativeActivityCallbacks callbacks;
+    ANativeActivity activity;
+    struct android_app* app;
+    int status = 0;
+
+    sem_init(&busy_sem, 0, 0);
+
+    memset(&callbacks, 0, sizeof(callbacks));
+    memset(&activity, 0, sizeof(activity));
+    activity.callbacks = &callbacks;
+    activity.sdkVersion = 9;
+
+    ANativeActivity_onCreate(&activity, NULL, 0);
+    app = (struct android_app*)activity.instance;
+    if (app == NULL) {
+        fprintf(stderr, "Could not create the android_app\n");
+        return 1;
+    }
+
+    activity.callbacks->onStart(&activity);
+    activity.callbacks->onResume(&activity);
+    wait_received(2);
+
+    test_delivery(&activity);
+    test_lifecycle(&activity, "blocking pause/resume");
+    app->nonBlockingLifecycle = 1;
+    test_lifecycle(&activity, "non-blocking pause/resume");
+    app->nonBlockingLifecycle = 0;
+    if (test_coalescing(&activity) < 0)
+        status = 1;
+
+    activity.callbacks->onDestroy(&activity);
+
+    printf("%s\n", status ? "FAILED" : "PASSED");
+    return status;
+}
@@ -7,6 +7,11 @@
 # Also define BUILD_EMULATOR_OPENGL_DRIVER to 'true' to build the gralloc
 # stuff as well.
 #
+# Define BUILD_EMULATOR_OPENGL_HOST to 'true' to also build the encoders,
+# the EGL layer and the GLES libraries for a Linux host, together with the
+# emugl_encoder_bench benchmark which runs them against an in-process fake
+# renderer (see tests/encoder_bench).
+#
 ifeq (true,$(BUILD_EMULATOR_OPENGL))
 
 # Top-level for all modules
@@ -24,6 +29,14 @@ EMUGL_COMMON_INCLUDES := $(EMUGL_PATH)/host/include/libOpenglRender
 #
 EMUGL_COMMON_CFLAGS := -DWITH_GLES2
 
+# Set to 'true' when the guest libraries must also be built for the host.
+# The modules check it to declare their host counterpart.
+#
+EMUGL_BUILD_HOST_LIBS :=
+ifeq (true-linux,$(BUILD_EMULATOR_OPENGL_HOST)-$(HOST_OS))
+    EMUGL_BUILD_HOST_LIBS := true
+endif
+
 # Uncomment the following line if you want to enable debug traces
 # in the GLES emulation libraries.
 # EMUGL_COMMON_CFLAGS += -DEMUGL_DEBUG=1
@@ -63,4 +76,9 @@ include $(EMUGL_PATH)/system/GLESv2/Android.mk
 include $(EMUGL_PATH)/system/gralloc/Android.mk
 include $(EMUGL_PATH)/system/egl/Android.mk
 
+# Host benchmark of the guest libraries
+ifeq (true,$(EMUGL_BUILD_HOST_LIBS))
+include $(EMUGL_PATH)/tests/encoder_bench/Android.mk
+endif
+
 endif # BUILD_EMULATOR_OPENGL == true
@@ -23,6 +23,17 @@
 emugl-begin-static-library = $(call emugl-begin-module,$1,STATIC_LIBRARY)
 emugl-begin-shared-library = $(call emugl-begin-module,$1,SHARED_LIBRARY)
 
+# The following macros are used to start a new module built for the
+# development host instead of the Android target. They are only used to
+# build the guest libraries on a Linux host, for benchmarking, see
+# EMUGL_BUILD_HOST_LIBS in Android.mk. Host and target modules live in
+# separate namespaces, so a host module can have the same name as its
+# target counterpart, and emugl-import picks the right one.
+#
+emugl-begin-host-static-library = $(call emugl-begin-module,$1,HOST_STATIC_LIBRARY,HOST)
+emugl-begin-host-shared-library = $(call emugl-begin-module,$1,HOST_SHARED_LIBRARY,HOST)
+emugl-begin-host-executable = $(call emugl-begin-module,$1,HOST_EXECUTABLE,HOST)
+
 # Internal list of all declared modules (used for sanity checking)
 _emugl_modules :=
 _emugl_HOST_modules :=
@@ -6,6 +6,9 @@ LOCAL_PATH := $(call my-dir)
 commonSources := \
         GLClientState.cpp \
         GLSharedGroup.cpp \
+        IndexRangeCache.cpp \
+        ScratchArena.cpp \
+        ProgramCache.cpp \
         glUtils.cpp \
         SocketStream.cpp \
         TcpStream.cpp \
@@ -21,3 +24,20 @@ LOCAL_CFLAGS += -DLOG_TAG=\"eglCodecCommon\"
 $(call emugl-export,SHARED_LIBRARIES,libcutils libutils)
 $(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
 $(call emugl-end-module)
+
+### CodecCommon  host ###############################################
+ifeq (true,$(EMUGL_BUILD_HOST_LIBS))
+$(call emugl-begin-host-static-library,libOpenglCodecCommon)
+
+LOCAL_SRC_FILES := $(commonSources)
+
+LOCAL_CFLAGS += -DLOG_TAG=\"eglCodecCommon\"
+
+# The guest libraries expect the Android flavour of the EGL and GLES
+# headers (e.g. ANativeWindow as the native window type).
+$(call emugl-export,CFLAGS,-DANDROID)
+$(call emugl-export,STATIC_LIBRARIES,libutils libcutils liblog)
+$(call emugl-export,LDLIBS,-lpthread -ldl -lrt)
+$(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
+$(call emugl-end-module)
+endif
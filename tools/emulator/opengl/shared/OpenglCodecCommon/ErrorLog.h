@@ -26,6 +26,7 @@
 #    endif
 #else
 #     include <stdio.h>
+#    include <cutils/log.h>  /* ALOGE() in the encoders built for the host */
 #    define ERR(...)    fprintf(stderr, __VA_ARGS__)
 #    ifdef EMUGL_DEBUG
 #        define DBG(...)    fprintf(stderr, __VA_ARGS__)
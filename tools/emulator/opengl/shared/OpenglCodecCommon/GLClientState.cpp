@@ -25,6 +25,11 @@
 #define MAX(a, b) ((a) < (b) ? (b) : (a))
 #endif
 
+// The padding of an upload is stripped when it makes up at least 1/8 of the
+// data, and at least 256 bytes.
+#define MIN_PADDING_RATIO   8
+#define MIN_PADDING_SIZE    256
+
 GLClientState::GLClientState(int nLocations)
 {
     if (nLocations < LAST_LOCATION) {
@@ -68,7 +73,7 @@ GLClientState::GLClientState(int nLocations)
 
 GLClientState::~GLClientState()
 {
-    delete m_states;
+    delete [] m_states;
 }
 
 void GLClientState::enable(int location, int state)
@@ -240,6 +245,20 @@ size_t GLClientState::pixelDataSize(GLsizei width, GLsizei height, GLenum format
     return aligned_linesize * height;
 }
 
+size_t GLClientState::strippedPixelDataSize(GLsizei width, GLsizei height, GLenum format, GLenum type) const
+{
+    if (width <= 0 || height <= 0 || m_pixelStore.unpack_alignment <= 1) {
+        return 0;
+    }
+
+    size_t size = (glUtilsPixelBitSize(format, type) >> 3) * width * height;
+    size_t padding = pixelDataSize(width, height, format, type, 0) - size;
+    if (padding < MIN_PADDING_SIZE || padding < (size + padding) / MIN_PADDING_RATIO) {
+        return 0;
+    }
+    return size;
+}
+
 GLenum GLClientState::setActiveTextureUnit(GLenum texture)
 {
     GLuint unit = texture - GL_TEXTURE0;
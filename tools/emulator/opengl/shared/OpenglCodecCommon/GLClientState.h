@@ -123,6 +123,10 @@ public:
       return ret;
     }
     size_t pixelDataSize(GLsizei width, GLsizei height, GLenum format, GLenum type, int pack) const;
+    // Size of an unpacked image once its rows are stripped of the padding
+    // of the unpack alignment, or 0 if there is too little padding to be
+    // worth the copy and the alignment changes.
+    size_t strippedPixelDataSize(GLsizei width, GLsizei height, GLenum format, GLenum type) const;
 
     void setCurrentProgram(GLint program) { m_currentProgram = program; }
     GLint currentProgram() const { return m_currentProgram; }
@@ -15,6 +15,7 @@
 */
 
 #include "GLSharedGroup.h"
+#include "ProgramCache.h"
 
 /**** BufferData ****/
 
@@ -29,7 +30,8 @@ BufferData::BufferData(GLsizeiptr size, void * data) : m_size(size)
 /**** ProgramData ****/
 ProgramData::ProgramData() : m_numIndexes(0),
                              m_initialized(false),
-                             m_locShiftWAR(false)
+                             m_locShiftWAR(false),
+                             m_attribBindingsHash(0)
 {
     m_Indexes = NULL;
 }
@@ -105,6 +107,12 @@ GLenum ProgramData::getTypeForLocation(GLint location)
     return 0;
 }
 
+void ProgramData::bindAttribLocation(GLuint index, const char* name)
+{
+    m_attribBindingsHash = ProgramCache::hash(&index, sizeof(index), m_attribBindingsHash);
+    m_attribBindingsHash = ProgramCache::hash(name, strlen(name) + 1, m_attribBindingsHash);
+}
+
 void ProgramData::setupLocationShiftWAR()
 {
     m_locShiftWAR = false;
@@ -254,9 +262,21 @@ GLenum GLSharedGroup::subUpdateBufferData(GLuint bufferId, GLintptr offset, GLsi
 
     //it's safe to update now
     memcpy((char*)buf->m_fixedBuffer.ptr() + offset, data, size);
+    buf->m_indexRanges.invalidate(buf->m_fixedBuffer.ptr(), offset, size);
     return GL_NO_ERROR; 
 }
 
+bool GLSharedGroup::getBufferIndexRange(GLuint bufferId, GLintptr offset, GLsizei count,
+                                        GLenum type, int* minIndex, int* maxIndex)
+{
+    android::AutoMutex _lock(m_lock);
+    BufferData * buf = m_buffers.valueFor(bufferId);
+    if (!buf || !buf->m_fixedBuffer.ptr() || offset < 0 || count < 0) return false;
+
+    return buf->m_indexRanges.getRange(buf->m_fixedBuffer.ptr(), buf->m_size, type,
+                                       offset, count, minIndex, maxIndex);
+}
+
 void GLSharedGroup::deleteBufferData(GLuint bufferId)
 {
     android::AutoMutex _lock(m_lock);
@@ -358,6 +378,31 @@ void GLSharedGroup::setProgramIndexInfo(GLuint program, GLuint index, GLint base
     }
 }
 
+void GLSharedGroup::bindAttribLocation(GLuint program, GLuint index, const char* name)
+{
+    android::AutoMutex _lock(m_lock);
+    ProgramData* pData = m_programs.valueFor(program);
+    if (pData) pData->bindAttribLocation(index, name);
+}
+
+bool GLSharedGroup::getProgramContentHash(GLuint program, uint64_t* hash)
+{
+    android::AutoMutex _lock(m_lock);
+    ProgramData* pData = m_programs.valueFor(program);
+    if (!pData || pData->getNumShaders() == 0) return false;
+
+    uint64_t h = ProgramCache::hash(NULL, 0);
+    size_t n = pData->getNumShaders();
+    for (size_t i = 0; i < n; i++) {
+        ShaderData* shader = m_shaders.valueFor(pData->getShader(i));
+        if (!shader || !shader->compiledHash) return false;
+        h = ProgramCache::hash(&shader->compiledHash, sizeof(shader->compiledHash), h);
+    }
+    uint64_t attribs = pData->getAttribBindingsHash();
+    *hash = ProgramCache::hash(&attribs, sizeof(attribs), h);
+    return true;
+}
+
 GLenum GLSharedGroup::getProgramUniformType(GLuint program, GLint location)
 {
     android::AutoMutex _lock(m_lock);
@@ -430,8 +475,11 @@ bool GLSharedGroup::addShaderData(GLuint shader)
         if (m_shaders.add(shader, data) < 0) {
             delete data;
             data = NULL;
+        } else {
+            data->sourceHash = 0;
+            data->compiledHash = 0;
+            data->refcount = 1;
         }
-        data->refcount = 1;
     }
     return data != NULL;
 }
@@ -451,6 +499,13 @@ void GLSharedGroup::unrefShaderData(GLuint shader)
     }
 }
 
+void GLSharedGroup::compileShader(GLuint shader)
+{
+    android::AutoMutex _lock(m_lock);
+    ShaderData* data = m_shaders.valueFor(shader);
+    if (data) data->compiledHash = data->sourceHash;
+}
+
 void GLSharedGroup::refShaderDataLocked(ssize_t shaderIdx)
 {
     assert(shaderIdx >= 0 && shaderIdx <= m_shaders.size());
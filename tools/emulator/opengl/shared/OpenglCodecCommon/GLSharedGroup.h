@@ -35,6 +35,7 @@
 #include <utils/String8.h>
 #include <utils/threads.h>
 #include "FixedBuffer.h"
+#include "IndexRangeCache.h"
 #include "SmartPtr.h"
 
 struct BufferData {
@@ -42,6 +43,7 @@ struct BufferData {
     BufferData(GLsizeiptr size, void * data);
     GLsizeiptr  m_size;
     FixedBuffer m_fixedBuffer;    
+    IndexRangeCache m_indexRanges;
 };
 
 class ProgramData {
@@ -62,6 +64,7 @@ private:
     bool m_locShiftWAR;
 
     android::Vector<GLuint> m_shaders;
+    uint64_t m_attribBindingsHash;
 
 public:
     enum {
@@ -89,11 +92,16 @@ public:
     bool detachShader(GLuint shader);
     size_t getNumShaders() const { return m_shaders.size(); }
     GLuint getShader(size_t i) const { return m_shaders[i]; }
+
+    void bindAttribLocation(GLuint index, const char* name);
+    uint64_t getAttribBindingsHash() const { return m_attribBindingsHash; }
 };
 
 struct ShaderData {
     typedef android::List<android::String8> StringList;
     StringList samplerExternalNames;
+    uint64_t sourceHash;    // of the source sent to the host, 0 if none
+    uint64_t compiledHash;  // of the source last compiled, 0 if none
     int refcount;
 };
 
@@ -115,6 +123,10 @@ public:
     void    updateBufferData(GLuint bufferId, GLsizeiptr size, void * data);
     GLenum  subUpdateBufferData(GLuint bufferId, GLintptr offset, GLsizeiptr size, void * data);
     void    deleteBufferData(GLuint);
+    // Smallest and largest of the 'count' indices of 'type' at 'offset' in
+    // the buffer, for glDrawElements(). Returns false if they are not in it.
+    bool    getBufferIndexRange(GLuint bufferId, GLintptr offset, GLsizei count,
+                                GLenum type, int* minIndex, int* maxIndex);
 
     bool    isProgram(GLuint program);
     bool    isProgramInitialized(GLuint program);
@@ -125,6 +137,11 @@ public:
     void    deleteProgramData(GLuint program);
     void    setProgramIndexInfo(GLuint program, GLuint index, GLint base, GLint size, GLenum type, const char* name);
     GLenum  getProgramUniformType(GLuint program, GLint location);
+    void    bindAttribLocation(GLuint program, GLuint index, const char* name);
+    // Hash of what determines the result of linking the program: the
+    // sources of its shaders, as compiled, and its attribute bindings.
+    // Returns false if a shader was not compiled.
+    bool    getProgramContentHash(GLuint program, uint64_t* hash);
     void    setupLocationShiftWAR(GLuint program);
     GLint   locationWARHostToApp(GLuint program, GLint hostLoc, GLint arrIndex);
     GLint   locationWARAppToHost(GLuint program, GLint appLoc);
@@ -136,6 +153,7 @@ public:
     // caller must hold a reference to the shader as long as it holds the pointer
     ShaderData* getShaderData(GLuint shader);
     void    unrefShaderData(GLuint shader);
+    void    compileShader(GLuint shader);
 };
 
 typedef SmartPtr<GLSharedGroup> GLSharedGroupPtr; 
@@ -0,0 +1,211 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "IndexRangeCache.h"
+#include <string.h>
+
+IndexRangeCache::IndexRangeCache() :
+    m_numRanges(0),
+    m_nextRange(0),
+    m_size(0)
+{
+    memset(m_summaries, 0, sizeof(m_summaries));
+}
+
+IndexRangeCache::~IndexRangeCache()
+{
+    for (int i = 0; i < NUM_SUMMARIES; i++) {
+        delete [] m_summaries[i].mins;
+        delete [] m_summaries[i].maxs;
+    }
+}
+
+// GL_BYTE and GL_SHORT indices are read as unsigned, as glDrawElements()
+// does
+static size_t indexSize(GLenum type)
+{
+    switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+template <class T>
+void IndexRangeCache::buildBlocks(Summary *summary, const T *indices,
+                                  size_t first, size_t end, size_t count)
+{
+    for (size_t b = first; b < end; b++) {
+        size_t i = b * BLOCK_SIZE;
+        size_t last = (i + BLOCK_SIZE < count ? i + BLOCK_SIZE : count);
+        T lo = indices[i], hi = indices[i];
+        for (i++; i < last; i++) {
+            if (indices[i] < lo) lo = indices[i];
+            if (indices[i] > hi) hi = indices[i];
+        }
+        summary->mins[b] = lo;
+        summary->maxs[b] = hi;
+    }
+}
+
+template <class T>
+static void scanIndices(const T *indices, size_t first, size_t end, int *lo, int *hi)
+{
+    for (size_t i = first; i < end; i++) {
+        if (*lo == -1 || indices[i] < *lo) *lo = indices[i];
+        if (*hi == -1 || indices[i] > *hi) *hi = indices[i];
+    }
+}
+
+template <class T>
+void IndexRangeCache::computeRange(Summary *summary, const T *indices,
+                                   size_t first, size_t count, int *min, int *max)
+{
+    size_t end = first + count;
+    // the whole blocks of the range, which the summary covers
+    size_t firstBlock = (first + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    size_t endBlock = end / BLOCK_SIZE;
+
+    *min = -1;
+    *max = -1;
+    if (firstBlock >= endBlock) {
+        scanIndices(indices, first, end, min, max);
+        return;
+    }
+    scanIndices(indices, first, firstBlock * BLOCK_SIZE, min, max);
+    for (size_t b = firstBlock; b < endBlock; b++) {
+        if (*min == -1 || summary->mins[b] < *min) *min = summary->mins[b];
+        if (*max == -1 || summary->maxs[b] > *max) *max = summary->maxs[b];
+    }
+    scanIndices(indices, endBlock * BLOCK_SIZE, end, min, max);
+}
+
+bool IndexRangeCache::getRange(const void *data, size_t size, GLenum type,
+                               size_t offset, size_t count, int *min, int *max)
+{
+    size_t elemSize = indexSize(type);
+    if (elemSize == 0 || offset % elemSize != 0 || offset > size ||
+        count > (size - offset) / elemSize) {
+        return false;
+    }
+    if (elemSize == 1) {
+        type = GL_UNSIGNED_BYTE;
+    } else {
+        type = GL_UNSIGNED_SHORT;
+    }
+
+    for (size_t i = 0; i < m_numRanges; i++) {
+        const Range &range = m_ranges[i];
+        if (range.offset == offset && range.count == count && range.type == type) {
+            *min = range.min;
+            *max = range.max;
+            return true;
+        }
+    }
+
+    if (m_size != size) {
+        // the data were reallocated: the summaries are for the old ones
+        for (int i = 0; i < NUM_SUMMARIES; i++) {
+            delete [] m_summaries[i].mins;
+            delete [] m_summaries[i].maxs;
+        }
+        memset(m_summaries, 0, sizeof(m_summaries));
+        m_numRanges = 0;
+        m_size = size;
+    }
+
+    size_t numIndices = size / elemSize;
+    Summary *summary = &m_summaries[elemSize == 1 ? SUMMARY_BYTE : SUMMARY_SHORT];
+    if (!summary->mins) {
+        summary->numBlocks = (numIndices + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        summary->mins = new unsigned short[summary->numBlocks];
+        summary->maxs = new unsigned short[summary->numBlocks];
+        if (elemSize == 1) {
+            buildBlocks(summary, (const unsigned char *)data, 0, summary->numBlocks, numIndices);
+        } else {
+            buildBlocks(summary, (const unsigned short *)data, 0, summary->numBlocks, numIndices);
+        }
+    }
+
+    if (elemSize == 1) {
+        computeRange(summary, (const unsigned char *)data, offset, count, min, max);
+    } else {
+        computeRange(summary, (const unsigned short *)data, offset / 2, count, min, max);
+    }
+
+    Range *range;
+    if (m_numRanges < MAX_RANGES) {
+        range = &m_ranges[m_numRanges++];
+    } else {
+        range = &m_ranges[m_nextRange];
+        m_nextRange = (m_nextRange + 1) % MAX_RANGES;
+    }
+    range->offset = offset;
+    range->count = count;
+    range->type = type;
+    range->min = *min;
+    range->max = *max;
+    return true;
+}
+
+void IndexRangeCache::invalidate(const void *data, size_t offset, size_t len)
+{
+    if (len == 0 || offset >= m_size) {
+        return;
+    }
+    if (len > m_size - offset) {
+        len = m_size - offset;
+    }
+
+    for (size_t i = 0; i < m_numRanges; ) {
+        const Range &range = m_ranges[i];
+        size_t end = range.offset + range.count * indexSize(range.type);
+        if (range.offset < offset + len && offset < end) {
+            m_ranges[i] = m_ranges[--m_numRanges];
+        } else {
+            i++;
+        }
+    }
+    m_nextRange = 0;
+
+    for (int i = 0; i < NUM_SUMMARIES; i++) {
+        Summary *summary = &m_summaries[i];
+        if (!summary->mins) {
+            continue;
+        }
+        size_t elemSize = (i == SUMMARY_BYTE ? 1 : 2);
+        size_t numIndices = m_size / elemSize;
+        size_t first = offset / elemSize;
+        size_t end = (offset + len + elemSize - 1) / elemSize;
+        if (end > numIndices) {
+            end = numIndices;
+        }
+        if (first >= end) {
+            continue;
+        }
+        size_t firstBlock = first / BLOCK_SIZE;
+        size_t endBlock = (end + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (elemSize == 1) {
+            buildBlocks(summary, (const unsigned char *)data, firstBlock, endBlock, numIndices);
+        } else {
+            buildBlocks(summary, (const unsigned short *)data, firstBlock, endBlock, numIndices);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef _INDEX_RANGE_CACHE_H_
+#define _INDEX_RANGE_CACHE_H_
+
+#include <GLES/gl.h>
+#include <sys/types.h>
+
+//
+// The smallest and largest indices of ranges of an index buffer, which
+// glDrawElements() needs to send the vertices a draw uses when they come
+// from client arrays.
+//
+// The ranges drawn recently are remembered as is, since a buffer is usually
+// drawn many times with the same offset and count. The others are computed
+// from a summary of the buffer, which holds the smallest and largest index
+// of each block of BLOCK_SIZE indices: only the indices at both ends of the
+// range, outside whole blocks, are scanned.
+//
+// The cache belongs to the data of a buffer, and must be told when they are
+// modified. It is not thread safe.
+//
+class IndexRangeCache {
+public:
+    enum { BLOCK_SIZE = 64, MAX_RANGES = 8 };
+
+    IndexRangeCache();
+    ~IndexRangeCache();
+
+    // Gets the smallest and largest of the 'count' indices of 'type'
+    // (GL_UNSIGNED_BYTE or GL_UNSIGNED_SHORT) starting 'offset' bytes into
+    // 'data', the 'size' bytes of the buffer. Returns false if the range is
+    // not in the buffer or not aligned for 'type'.
+    bool getRange(const void *data, size_t size, GLenum type,
+                  size_t offset, size_t count, int *min, int *max);
+
+    // Forgets the ranges which overlap the 'len' bytes at 'offset' of
+    // 'data', which have been modified, and updates their summaries
+    void invalidate(const void *data, size_t offset, size_t len);
+
+private:
+    struct Range {
+        size_t offset;
+        size_t count;
+        GLenum type;
+        int min;
+        int max;
+    };
+
+    // The smallest and largest index of each block, for one type
+    struct Summary {
+        unsigned short *mins;
+        unsigned short *maxs;
+        size_t numBlocks;
+    };
+
+    enum { SUMMARY_BYTE, SUMMARY_SHORT, NUM_SUMMARIES };
+
+    template <class T> void buildBlocks(Summary *summary, const T *indices,
+                                        size_t first, size_t end, size_t count);
+    template <class T> void computeRange(Summary *summary, const T *indices,
+                                         size_t first, size_t count, int *min, int *max);
+
+    Range m_ranges[MAX_RANGES];
+    size_t m_numRanges;
+    size_t m_nextRange;         // replaced next, once they are all used
+    Summary m_summaries[NUM_SUMMARIES];
+    size_t m_size;              // of the data summarized
+};
+
+#endif
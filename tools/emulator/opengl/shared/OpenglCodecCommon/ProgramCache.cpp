@@ -0,0 +1,265 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "ProgramCache.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ErrorLog.h"
+
+// Cache file: a header, then the entries from the least to the most
+// recently used, each one as its key, its size and its data.
+#define CACHE_FILE_MAGIC    0x43504745  // "EGPC"
+#define CACHE_FILE_VERSION  1
+
+struct CacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t salt;
+    uint32_t count;
+};
+
+struct CacheFileEntry {
+    uint64_t key;
+    uint32_t size;
+};
+
+ProgramCache::ProgramCache(uint64_t salt, size_t maxSize) :
+    m_salt(salt),
+    m_maxSize(maxSize),
+    m_first(NULL),
+    m_last(NULL),
+    m_size(0),
+    m_dirty(false)
+{
+}
+
+ProgramCache::~ProgramCache()
+{
+    clearLocked();
+}
+
+uint64_t ProgramCache::hash(const void *data, size_t len, uint64_t h)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+ssize_t ProgramCache::get(uint64_t key, FixedBuffer *value)
+{
+    android::AutoMutex _lock(m_lock);
+    ssize_t idx = m_entries.indexOfKey(key);
+    if (idx < 0) {
+        return -1;
+    }
+
+    Entry *entry = m_entries.valueAt(idx);
+    void *ptr = value->alloc(entry->size);
+    if (!ptr && entry->size > 0) {
+        return -1;
+    }
+    memcpy(ptr, entry->data(), entry->size);
+
+    unlinkLocked(entry);
+    linkFirstLocked(entry);
+    return entry->size;
+}
+
+void ProgramCache::put(uint64_t key, const void *value, size_t size)
+{
+    android::AutoMutex _lock(m_lock);
+    putLocked(key, value, size);
+    m_dirty = true;
+}
+
+void ProgramCache::putLocked(uint64_t key, const void *value, size_t size)
+{
+    ssize_t idx = m_entries.indexOfKey(key);
+    if (idx >= 0) {
+        removeLocked(m_entries.valueAt(idx));
+    }
+    if (size > m_maxSize) {
+        return;
+    }
+
+    while (m_last && m_size + size > m_maxSize) {
+        removeLocked(m_last);
+    }
+
+    Entry *entry = (Entry *)malloc(sizeof(Entry) + size);
+    if (!entry) {
+        return;
+    }
+    entry->key = key;
+    entry->size = size;
+    memcpy(entry->data(), value, size);
+    m_entries.add(key, entry);
+    linkFirstLocked(entry);
+    m_size += size;
+}
+
+void ProgramCache::removeLocked(Entry *entry)
+{
+    unlinkLocked(entry);
+    m_entries.removeItem(entry->key);
+    m_size -= entry->size;
+    free(entry);
+}
+
+void ProgramCache::linkFirstLocked(Entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = m_first;
+    if (m_first) {
+        m_first->prev = entry;
+    } else {
+        m_last = entry;
+    }
+    m_first = entry;
+}
+
+void ProgramCache::unlinkLocked(Entry *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        m_first = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        m_last = entry->prev;
+    }
+}
+
+void ProgramCache::clearLocked()
+{
+    while (m_first) {
+        Entry *next = m_first->next;
+        free(m_first);
+        m_first = next;
+    }
+    m_last = NULL;
+    m_entries.clear();
+    m_size = 0;
+}
+
+bool ProgramCache::load(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    android::AutoMutex _lock(m_lock);
+    clearLocked();
+
+    CacheFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == CACHE_FILE_MAGIC &&
+              header.version == CACHE_FILE_VERSION &&
+              header.salt == m_salt;
+
+    FixedBuffer value;
+    for (uint32_t i = 0; ok && i < header.count; i++) {
+        CacheFileEntry fileEntry;
+        if (fread(&fileEntry, sizeof(fileEntry), 1, file) != 1 ||
+            fileEntry.size > m_maxSize) {
+            ok = false;
+            break;
+        }
+        void *ptr = value.alloc(fileEntry.size);
+        if (fileEntry.size > 0 &&
+            (!ptr || fread(ptr, fileEntry.size, 1, file) != 1)) {
+            ok = false;
+            break;
+        }
+        putLocked(fileEntry.key, ptr, fileEntry.size);
+    }
+    fclose(file);
+
+    if (!ok) {
+        // a truncated or stale file is rewritten at the next save
+        clearLocked();
+        m_dirty = true;
+        return false;
+    }
+    m_dirty = false;
+    return true;
+}
+
+bool ProgramCache::save(const char *path)
+{
+    android::AutoMutex _lock(m_lock);
+    if (!m_dirty) {
+        return true;
+    }
+
+    char tmpPath[PATH_MAX];
+    if (snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path) >= (int)sizeof(tmpPath)) {
+        return false;
+    }
+    FILE *file = fopen(tmpPath, "wb");
+    if (!file) {
+        ERR("ProgramCache: could not create %s\n", tmpPath);
+        return false;
+    }
+
+    CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CACHE_FILE_MAGIC;
+    header.version = CACHE_FILE_VERSION;
+    header.salt = m_salt;
+    header.count = m_entries.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (Entry *entry = m_last; ok && entry; entry = entry->prev) {
+        CacheFileEntry fileEntry;
+        memset(&fileEntry, 0, sizeof(fileEntry));
+        fileEntry.key = entry->key;
+        fileEntry.size = entry->size;
+        ok = fwrite(&fileEntry, sizeof(fileEntry), 1, file) == 1 &&
+             (entry->size == 0 || fwrite(entry->data(), entry->size, 1, file) == 1);
+    }
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+
+    if (!ok || rename(tmpPath, path) != 0) {
+        ERR("ProgramCache: could not write %s\n", path);
+        unlink(tmpPath);
+        return false;
+    }
+    m_dirty = false;
+    return true;
+}
+
+size_t ProgramCache::count() const
+{
+    android::AutoMutex _lock(m_lock);
+    return m_entries.size();
+}
+
+size_t ProgramCache::size() const
+{
+    android::AutoMutex _lock(m_lock);
+    return m_size;
+}
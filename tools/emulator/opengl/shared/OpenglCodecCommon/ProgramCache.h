@@ -0,0 +1,96 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef _PROGRAM_CACHE_H_
+#define _PROGRAM_CACHE_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include "FixedBuffer.h"
+
+//
+// A cache of the information the guest gets back from the host when it
+// links a program, keyed by a hash of the program's content (the sources
+// of its shaders, its attribute bindings). Linking the same shaders again,
+// in another context or, when the cache is saved to a file, in another run
+// of the process, then needs no round-trip to the host.
+//
+// The cache is bounded in size: the least recently used entries are
+// evicted first. It is safe to use from several threads.
+//
+class ProgramCache {
+public:
+    enum { DEFAULT_MAX_SIZE = 256 * 1024 };
+
+    // 'salt' identifies the host renderer the values come from: a file
+    // saved with another salt is not loaded.
+    ProgramCache(uint64_t salt, size_t maxSize = DEFAULT_MAX_SIZE);
+    ~ProgramCache();
+
+    // 64-bit FNV-1a hash of 'len' bytes, to be chained through 'h'
+    static uint64_t hash(const void *data, size_t len, uint64_t h = HASH_SEED);
+
+    uint64_t salt() const { return m_salt; }
+
+    // Copies the value cached for 'key' into 'value' and returns its size,
+    // or -1 if there is none. The entry becomes the most recently used.
+    ssize_t get(uint64_t key, FixedBuffer *value);
+
+    // Caches 'size' bytes for 'key', replacing its previous value, and
+    // evicts the least recently used entries beyond the maximum size.
+    void put(uint64_t key, const void *value, size_t size);
+
+    // Replaces the content of the cache with the one saved in 'path', if it
+    // was saved with the same salt.
+    bool load(const char *path);
+
+    // Writes the cache to 'path', atomically, if it changed since it was
+    // loaded or last saved.
+    bool save(const char *path);
+    bool isDirty() const { return m_dirty; }
+
+    size_t count() const;
+    size_t size() const;
+
+private:
+    static const uint64_t HASH_SEED = 0xcbf29ce484222325ULL;
+
+    struct Entry {
+        uint64_t key;
+        size_t size;
+        Entry *prev;        // more recently used
+        Entry *next;        // less recently used
+        unsigned char *data() { return (unsigned char *)(this + 1); }
+    };
+
+    void clearLocked();
+    void putLocked(uint64_t key, const void *value, size_t size);
+    void removeLocked(Entry *entry);
+    void linkFirstLocked(Entry *entry);
+    void unlinkLocked(Entry *entry);
+
+    const uint64_t m_salt;
+    const size_t m_maxSize;
+    android::KeyedVector<uint64_t, Entry *> m_entries;
+    Entry *m_first;         // most recently used
+    Entry *m_last;          // least recently used
+    size_t m_size;
+    volatile bool m_dirty;
+    mutable android::Mutex m_lock;
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "ScratchArena.h"
+#include <stdlib.h>
+#include <string.h>
+#include "ErrorLog.h"
+
+// The header of a block, before its memory
+#define BLOCK_HEADER_SIZE \
+    ((sizeof(Block) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1))
+
+// The power of two, at least MIN_BLOCK_SIZE, which holds 'size' bytes
+static size_t sizeClass(size_t size)
+{
+    size_t blockSize = ScratchArena::MIN_BLOCK_SIZE;
+    while (blockSize < size) {
+        blockSize *= 2;
+    }
+    return blockSize;
+}
+
+ScratchArena::ScratchArena() :
+    m_blocks(NULL),
+    m_offset(0),
+    m_used(0),
+    m_nextSize(MIN_BLOCK_SIZE),
+    m_recentPeak(0),
+    m_smallResets(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+ScratchArena::~ScratchArena()
+{
+    freeBlocks();
+}
+
+void *ScratchArena::alloc(size_t size)
+{
+    if (size > ((size_t)-1) / 4) {
+        return NULL;
+    }
+    if (m_used >= MAX_FRAME_SIZE) {
+        reset();
+    }
+
+    size = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    if (!m_blocks || m_blocks->size - m_offset < size) {
+        if (!addBlock(size)) {
+            return NULL;
+        }
+    }
+
+    unsigned char *ptr = (unsigned char *)m_blocks + BLOCK_HEADER_SIZE + m_offset;
+    m_offset += size;
+    m_used += size;
+    if (m_used > m_stats.peakSize) {
+        m_stats.peakSize = m_used;
+    }
+    m_stats.allocs++;
+    return ptr;
+}
+
+bool ScratchArena::addBlock(size_t minSize)
+{
+    size_t size = sizeClass(minSize);
+    size_t grown = (m_blocks ? m_blocks->size * 2 : m_nextSize);
+    if (size < grown) {
+        size = grown;
+    }
+
+    Block *block = (Block *)malloc(BLOCK_HEADER_SIZE + size);
+    if (!block) {
+        ERR("ScratchArena: malloc (%u) failed\n", (unsigned int)size);
+        return false;
+    }
+    block->next = m_blocks;
+    block->size = size;
+    m_blocks = block;
+    m_offset = 0;
+    m_stats.heldSize += size;
+    m_stats.blockAllocs++;
+    return true;
+}
+
+void ScratchArena::reset()
+{
+    m_stats.resets++;
+    if (m_blocks && m_blocks->next) {
+        // the frame did not fit in a block: the next one gets a single one
+        m_nextSize = sizeClass(m_used);
+        freeBlocks();
+        m_smallResets = 0;
+        m_recentPeak = 0;
+    } else if (m_blocks && m_used <= m_blocks->size / 4) {
+        if (m_used > m_recentPeak) {
+            m_recentPeak = m_used;
+        }
+        if (++m_smallResets >= TRIM_RESETS) {
+            m_nextSize = sizeClass(m_recentPeak);
+            freeBlocks();
+            m_smallResets = 0;
+            m_recentPeak = 0;
+        }
+    } else {
+        m_smallResets = 0;
+        m_recentPeak = 0;
+    }
+    m_offset = 0;
+    m_used = 0;
+}
+
+void ScratchArena::freeBlocks()
+{
+    while (m_blocks) {
+        Block *next = m_blocks->next;
+        free(m_blocks);
+        m_blocks = next;
+    }
+    m_offset = 0;
+    m_stats.heldSize = 0;
+}
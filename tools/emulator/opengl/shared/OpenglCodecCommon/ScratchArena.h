@@ -0,0 +1,84 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef _SCRATCH_ARENA_H_
+#define _SCRATCH_ARENA_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+//
+// The temporaries of the calls of a thread: rebased indices, unpadded
+// pixels, partial color buffer updates, ...
+//
+// They are carved one after the other from blocks of the heap, and all
+// released at once by reset(), at the end of a frame and on glFlush() and
+// glFinish(). The blocks are kept: when a frame needed more than one, they
+// are replaced by a single block for the whole frame at the next one. The
+// blocks are sized in powers of two, each one at least twice the size of
+// the previous one, so a growing frame takes few allocations and the heap
+// sees few different sizes. A block much larger than the last TRIM_RESETS
+// frames needed is given back.
+//
+// A temporary must not outlive the call which allocated it: a frame which
+// neither flushes nor swaps would grow the arena forever, so alloc() resets
+// it first once it holds MAX_FRAME_SIZE bytes. The arena is not thread safe.
+//
+class ScratchArena {
+public:
+    enum {
+        MIN_BLOCK_SIZE = 4 * 1024,
+        MAX_FRAME_SIZE = 16 * 1024 * 1024,
+        TRIM_RESETS = 64,
+        ALIGNMENT = 16
+    };
+
+    struct Stats {
+        size_t peakSize;        // allocated between two resets, at most
+        size_t heldSize;        // of the blocks held
+        uint64_t allocs;
+        uint64_t blockAllocs;   // from the heap
+        uint64_t resets;
+    };
+
+    ScratchArena();
+    ~ScratchArena();
+
+    // Returns 'size' bytes valid until the next reset(), or NULL if the
+    // heap is exhausted
+    void *alloc(size_t size);
+    void reset();
+
+    const Stats &stats() const { return m_stats; }
+
+private:
+    struct Block {
+        Block *next;            // the previous block
+        size_t size;
+    };
+
+    bool addBlock(size_t minSize);
+    void freeBlocks();
+
+    Block *m_blocks;            // the current one, then the previous ones
+    size_t m_offset;            // in the current block
+    size_t m_used;              // since the last reset
+    size_t m_nextSize;          // of the block of the next frame
+    size_t m_recentPeak;        // since the last trim
+    unsigned int m_smallResets; // in a row, much smaller than the block
+    Stats m_stats;
+};
+
+#endif
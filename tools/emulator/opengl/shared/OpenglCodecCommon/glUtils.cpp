@@ -469,3 +469,16 @@ int glUtilsCalcShaderSourceLen( char **strings,  GLint *length, GLsizei count)
     return len;
 
 }
+
+// copy the rows of an image, each one starting at a multiple of
+// 'alignment' in 'src', next to each other in 'dst'
+void glUtilsPackPixelRows(unsigned char *dst, const unsigned char *src,
+                          size_t rowSize, GLsizei height, int alignment)
+{
+    size_t stride = (rowSize + alignment - 1) / alignment * alignment;
+    for (GLsizei i = 0; i < height; i++) {
+        memcpy(dst, src, rowSize);
+        dst += rowSize;
+        src += stride;
+    }
+}
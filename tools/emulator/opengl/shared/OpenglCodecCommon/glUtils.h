@@ -57,6 +57,8 @@ extern "C" {
     int glUtilsPixelBitSize(GLenum format, GLenum type);
     void   glUtilsPackStrings(char *ptr, char **strings, GLint *length, GLsizei count);
     int glUtilsCalcShaderSourceLen(char **strings, GLint *length, GLsizei count);
+    void glUtilsPackPixelRows(unsigned char *dst, const unsigned char *src,
+                              size_t rowSize, GLsizei height, int alignment);
 #ifdef __cplusplus
 };
 #endif
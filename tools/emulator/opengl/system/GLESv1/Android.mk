@@ -10,3 +10,15 @@ LOCAL_SRC_FILES := gl.cpp
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/egl
 
 $(call emugl-end-module)
+
+### GLESv1 implementation, host #####################################
+ifeq (true,$(EMUGL_BUILD_HOST_LIBS))
+$(call emugl-begin-host-shared-library,libGLESv1_CM_emulation)
+$(call emugl-import,libOpenglSystemCommon libGLESv1_enc lib_renderControl_enc)
+
+LOCAL_CFLAGS += -DLOG_TAG=\"GLES_emulation\" -DGL_GLEXT_PROTOTYPES
+
+LOCAL_SRC_FILES := gl.cpp
+
+$(call emugl-end-module)
+endif
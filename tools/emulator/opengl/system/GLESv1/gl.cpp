@@ -22,13 +22,26 @@
 #include "ErrorLog.h"
 #include "gralloc_cb.h"
 #include "ThreadInfo.h"
+#include "CommandList.h"
 
+// The calls of a thread recording a command list go to the list, see
+// eglBeginCommandListEMU()
+static inline gl_encoder_context_t *getEntryContext()
+{
+    EGLThreadInfo *tInfo = getEGLThreadInfo();
+    if (tInfo->commandList) {
+        return tInfo->commandList->glEncoder();
+    }
+    return tInfo->hostConn->glEncoder();
+}
+
+#define GET_CONTEXT gl_encoder_context_t * ctx = getEntryContext();
+#include "gl_entry.cpp"
+#undef GET_CONTEXT
 
 //XXX: fix this macro to get the context from fast tls path
 #define GET_CONTEXT GLEncoder * ctx = getEGLThreadInfo()->hostConn->glEncoder();
 
-#include "gl_entry.cpp"
-
 //The functions table
 #include "gl_ftable.h"
 
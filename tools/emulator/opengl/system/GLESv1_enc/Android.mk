@@ -1,19 +1,39 @@
 LOCAL_PATH := $(call my-dir)
 
-### GLESv1_enc Encoder ###########################################
-$(call emugl-begin-shared-library,libGLESv1_enc)
-
-LOCAL_CFLAGS += -DLOG_TAG=\"emuglGLESv1_enc\"
-
-LOCAL_SRC_FILES := \
+glesv1EncSources := \
         GLEncoder.cpp \
         GLEncoderUtils.cpp \
         gl_client_context.cpp \
         gl_enc.cpp \
         gl_entry.cpp
 
+### GLESv1_enc Encoder ###########################################
+$(call emugl-begin-shared-library,libGLESv1_enc)
+
+LOCAL_CFLAGS += -DLOG_TAG=\"emuglGLESv1_enc\"
+
+LOCAL_SRC_FILES := $(glesv1EncSources)
+
 $(call emugl-import,libOpenglCodecCommon)
 $(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
 $(call emugl-export,C_INCLUDES,$(intermediates))
 
 $(call emugl-end-module)
+
+### GLESv1_enc Encoder, host #####################################
+ifeq (true,$(EMUGL_BUILD_HOST_LIBS))
+$(call emugl-begin-host-shared-library,libGLESv1_enc)
+
+LOCAL_CFLAGS += -DLOG_TAG=\"emuglGLESv1_enc\"
+
+LOCAL_SRC_FILES := $(glesv1EncSources)
+
+# Both encoders define the same glXxx_enc functions: bind each library to its
+# own definitions, which is what the Android dynamic linker does.
+LOCAL_LDFLAGS += -Wl,-Bsymbolic
+
+$(call emugl-import,libOpenglCodecCommon)
+$(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
+
+$(call emugl-end-module)
+endif
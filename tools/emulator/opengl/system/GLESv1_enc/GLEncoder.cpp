@@ -15,7 +15,6 @@
 */
 #include "GLEncoder.h"
 #include "glUtils.h"
-#include "FixedBuffer.h"
 #include <cutils/log.h>
 #include <assert.h>
 
@@ -231,6 +230,7 @@ void GLEncoder::s_glFlush(void *self)
     GLEncoder *ctx = (GLEncoder *)self;
     ctx->m_glFlush_enc(self);
     ctx->m_stream->flush();
+    ctx->m_scratch->reset();
 }
 
 const GLubyte *GLEncoder::s_glGetString(void *self, GLenum name)
@@ -541,6 +541,8 @@ void GLEncoder::s_glDrawElements(void *self, GLenum mode, GLsizei count, GLenum
     }
 
     bool adjustIndices = true;
+    bool haveIndexRange = false;
+    int minIndex = 0, maxIndex = 0;
     if (ctx->m_state->currentIndexVbo() != 0) {
         if (!has_immediate_arrays) {
             ctx->sendVertexData(0, count);
@@ -550,19 +552,23 @@ void GLEncoder::s_glDrawElements(void *self, GLenum mode, GLsizei count, GLenum
         } else {
             BufferData * buf = ctx->m_shared->getBufferData(ctx->m_state->currentIndexVbo());
             ctx->m_glBindBuffer_enc(self, GL_ELEMENT_ARRAY_BUFFER, 0);
+            // the same indices are usually drawn again: their range is cached
+            haveIndexRange = ctx->m_shared->getBufferIndexRange(ctx->m_state->currentIndexVbo(),
+                    (GLintptr)indices, count, type, &minIndex, &maxIndex);
             indices = (void*)((GLintptr)buf->m_fixedBuffer.ptr() + (GLintptr)indices);
         }
     } 
     if (adjustIndices) {
         void *adjustedIndices = (void*)indices;
-        int minIndex = 0, maxIndex = 0;
 
         switch(type) {
         case GL_BYTE:
         case GL_UNSIGNED_BYTE:
-            GLUtils::minmax<unsigned char>((unsigned char *)indices, count, &minIndex, &maxIndex);
+            if (!haveIndexRange) {
+                GLUtils::minmax<unsigned char>((unsigned char *)indices, count, &minIndex, &maxIndex);
+            }
             if (minIndex != 0) {
-                adjustedIndices =  ctx->m_fixedBuffer.alloc(glSizeof(type) * count);
+                adjustedIndices =  ctx->m_scratch->alloc(glSizeof(type) * count);
                 GLUtils::shiftIndices<unsigned char>((unsigned char *)indices,
                                                  (unsigned char *)adjustedIndices,
                                                  count, -minIndex);
@@ -570,9 +576,11 @@ void GLEncoder::s_glDrawElements(void *self, GLenum mode, GLsizei count, GLenum
             break;
         case GL_SHORT:
         case GL_UNSIGNED_SHORT:
-            GLUtils::minmax<unsigned short>((unsigned short *)indices, count, &minIndex, &maxIndex);
+            if (!haveIndexRange) {
+                GLUtils::minmax<unsigned short>((unsigned short *)indices, count, &minIndex, &maxIndex);
+            }
             if (minIndex != 0) {
-                adjustedIndices = ctx->m_fixedBuffer.alloc(glSizeof(type) * count);
+                adjustedIndices = ctx->m_scratch->alloc(glSizeof(type) * count);
                 GLUtils::shiftIndices<unsigned short>((unsigned short *)indices,
                                                  (unsigned short *)adjustedIndices,
                                                  count, -minIndex);
@@ -900,6 +908,63 @@ void GLEncoder::s_glTexParameterxv(void* self,
     }
 }
 
+// Sends the rows of padded images back to back, as GL2Encoder does
+const GLvoid* GLEncoder::stripUnpackPadding(GLsizei width, GLsizei height,
+        GLenum format, GLenum type, const GLvoid* pixels)
+{
+    assert(m_state != NULL);
+    size_t size = pixels ? m_state->strippedPixelDataSize(width, height, format, type) : 0;
+    if (size == 0) {
+        return NULL;
+    }
+
+    unsigned char *packed = (unsigned char *)m_scratch->alloc(size);
+    if (!packed) {
+        return NULL;
+    }
+    glUtilsPackPixelRows(packed, (const unsigned char *)pixels, size / height, height,
+            m_state->pixelStoreState()->unpack_alignment);
+    return packed;
+}
+
+void GLEncoder::s_glTexImage2D(void* self, GLenum target, GLint level,
+        GLint internalformat, GLsizei width, GLsizei height, GLint border,
+        GLenum format, GLenum type, const GLvoid* pixels)
+{
+    GLEncoder* ctx = (GLEncoder*)self;
+    const GLvoid* packed = ctx->stripUnpackPadding(width, height, format, type, pixels);
+
+    if (packed) {
+        GLint alignment = ctx->m_state->pixelStoreState()->unpack_alignment;
+        s_glPixelStorei(ctx, GL_UNPACK_ALIGNMENT, 1);
+        ctx->m_glTexImage2D_enc(ctx, target, level, internalformat, width, height,
+                border, format, type, packed);
+        s_glPixelStorei(ctx, GL_UNPACK_ALIGNMENT, alignment);
+    } else {
+        ctx->m_glTexImage2D_enc(ctx, target, level, internalformat, width, height,
+                border, format, type, pixels);
+    }
+}
+
+void GLEncoder::s_glTexSubImage2D(void* self, GLenum target, GLint level,
+        GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+        GLenum format, GLenum type, const GLvoid* pixels)
+{
+    GLEncoder* ctx = (GLEncoder*)self;
+    const GLvoid* packed = ctx->stripUnpackPadding(width, height, format, type, pixels);
+
+    if (packed) {
+        GLint alignment = ctx->m_state->pixelStoreState()->unpack_alignment;
+        s_glPixelStorei(ctx, GL_UNPACK_ALIGNMENT, 1);
+        ctx->m_glTexSubImage2D_enc(ctx, target, level, xoffset, yoffset, width, height,
+                format, type, packed);
+        s_glPixelStorei(ctx, GL_UNPACK_ALIGNMENT, alignment);
+    } else {
+        ctx->m_glTexSubImage2D_enc(ctx, target, level, xoffset, yoffset, width, height,
+                format, type, pixels);
+    }
+}
+
 void GLEncoder::override2DTextureTarget(GLenum target)
 {
     if ((target == GL_TEXTURE_2D || target == GL_TEXTURE_EXTERNAL_OES) &&
@@ -923,6 +988,7 @@ GLEncoder::GLEncoder(IOStream *stream) : gl_encoder_context_t(stream)
     m_error = GL_NO_ERROR;
     m_num_compressedTextureFormats = 0;
     m_compressedTextureFormats = NULL;
+    m_scratch = &m_ownScratch;
     // overrides;
     m_glFlush_enc = set_glFlush(s_glFlush);
     m_glPixelStorei_enc = set_glPixelStorei(s_glPixelStorei);
@@ -969,6 +1035,8 @@ GLEncoder::GLEncoder(IOStream *stream) : gl_encoder_context_t(stream)
     m_glTexParameterx_enc = set_glTexParameterx(s_glTexParameterx);
     m_glTexParameteriv_enc = set_glTexParameteriv(s_glTexParameteriv);
     m_glTexParameterxv_enc = set_glTexParameterxv(s_glTexParameterxv);
+    m_glTexImage2D_enc = set_glTexImage2D(s_glTexImage2D);
+    m_glTexSubImage2D_enc = set_glTexSubImage2D(s_glTexSubImage2D);
 }
 
 GLEncoder::~GLEncoder()
@@ -986,4 +1054,5 @@ void GLEncoder::s_glFinish(void *self)
 {
     GLEncoder *ctx = (GLEncoder *)self;
     ctx->glFinishRoundTrip(self);
+    ctx->m_scratch->reset();
 }
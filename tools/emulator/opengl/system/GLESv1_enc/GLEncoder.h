@@ -19,7 +19,7 @@
 #include "gl_enc.h"
 #include "GLClientState.h"
 #include "GLSharedGroup.h"
-#include "FixedBuffer.h"
+#include "ScratchArena.h"
 
 class GLEncoder : public gl_encoder_context_t {
 
@@ -30,6 +30,9 @@ public:
         m_state = state;
     }
     void setSharedGroup(GLSharedGroupPtr shared) { m_shared = shared; }
+    // The temporaries of the calls go to 'arena', e.g. the one of the
+    // connection, instead of the own one of the encoder
+    void setScratchArena(ScratchArena *arena) { m_scratch = arena; }
     void flush() { m_stream->flush(); }
     size_t pixelDataSize(GLsizei width, GLsizei height, GLenum format, GLenum type, int pack);
 
@@ -41,6 +44,10 @@ public:
 
     void override2DTextureTarget(GLenum target);
     void restore2DTextureTarget();
+    // Returns a copy of the rows of 'pixels' without the padding of the
+    // unpack alignment, or NULL if they are to be sent as they are.
+    const GLvoid* stripUnpackPadding(GLsizei width, GLsizei height,
+            GLenum format, GLenum type, const GLvoid* pixels);
 
 private:
 
@@ -48,7 +55,8 @@ private:
     GLClientState *m_state;
     GLSharedGroupPtr m_shared;
     GLenum  m_error;
-    FixedBuffer m_fixedBuffer;
+    ScratchArena m_ownScratch;
+    ScratchArena *m_scratch;
     GLint *m_compressedTextureFormats;
     GLint m_num_compressedTextureFormats;
 
@@ -97,6 +105,8 @@ private:
     glTexParameterx_client_proc_t m_glTexParameterx_enc;
     glTexParameteriv_client_proc_t m_glTexParameteriv_enc;
     glTexParameterxv_client_proc_t m_glTexParameterxv_enc;
+    glTexImage2D_client_proc_t m_glTexImage2D_enc;
+    glTexSubImage2D_client_proc_t m_glTexSubImage2D_enc;
 
     // statics
     static GLenum s_glGetError(void * self);
@@ -145,5 +155,11 @@ private:
     static void s_glTexParameterx(void* self, GLenum target, GLenum pname, GLfixed param);
     static void s_glTexParameteriv(void* self, GLenum target, GLenum pname, const GLint* params);
     static void s_glTexParameterxv(void* self, GLenum target, GLenum pname, const GLfixed* params);
+    static void s_glTexImage2D(void* self, GLenum target, GLint level, GLint internalformat,
+            GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type,
+            const GLvoid* pixels);
+    static void s_glTexSubImage2D(void* self, GLenum target, GLint level, GLint xoffset,
+            GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type,
+            const GLvoid* pixels);
 };
 #endif
@@ -10,3 +10,15 @@ LOCAL_SRC_FILES := gl2.cpp
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/egl
 
 $(call emugl-end-module)
+
+### GLESv2 implementation, host #####################################
+ifeq (true,$(EMUGL_BUILD_HOST_LIBS))
+$(call emugl-begin-host-shared-library,libGLESv2_emulation)
+$(call emugl-import,libOpenglSystemCommon libGLESv2_enc lib_renderControl_enc)
+
+LOCAL_CFLAGS += -DLOG_TAG=\"GLESv2_emulation\" -DGL_GLEXT_PROTOTYPES
+
+LOCAL_SRC_FILES := gl2.cpp
+
+$(call emugl-end-module)
+endif
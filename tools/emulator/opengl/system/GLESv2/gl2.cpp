@@ -22,11 +22,25 @@
 #include "ErrorLog.h"
 #include "gralloc_cb.h"
 #include "ThreadInfo.h"
+#include "CommandList.h"
 
-//XXX: fix this macro to get the context from fast tls path
-#define GET_CONTEXT GL2Encoder * ctx = getEGLThreadInfo()->hostConn->gl2Encoder();
+// The calls of a thread recording a command list go to the list, see
+// eglBeginCommandListEMU()
+static inline gl2_encoder_context_t *getEntryContext()
+{
+    EGLThreadInfo *tInfo = getEGLThreadInfo();
+    if (tInfo->commandList) {
+        return tInfo->commandList->gl2Encoder();
+    }
+    return tInfo->hostConn->gl2Encoder();
+}
 
+#define GET_CONTEXT gl2_encoder_context_t * ctx = getEntryContext();
 #include "gl2_entry.cpp"
+#undef GET_CONTEXT
+
+//XXX: fix this macro to get the context from fast tls path
+#define GET_CONTEXT GL2Encoder * ctx = getEGLThreadInfo()->hostConn->gl2Encoder();
 
 //The functions table
 #include "gl2_ftable.h"
@@ -1,15 +1,17 @@
 LOCAL_PATH := $(call my-dir)
 
-### GLESv2_enc Encoder ###########################################
-$(call emugl-begin-shared-library,libGLESv2_enc)
-
-LOCAL_SRC_FILES := \
+glesv2EncSources := \
     GL2EncoderUtils.cpp \
     GL2Encoder.cpp \
     gl2_client_context.cpp \
     gl2_enc.cpp \
     gl2_entry.cpp
 
+### GLESv2_enc Encoder ###########################################
+$(call emugl-begin-shared-library,libGLESv2_enc)
+
+LOCAL_SRC_FILES := $(glesv2EncSources)
+
 LOCAL_CFLAGS += -DLOG_TAG=\"emuglGLESv2_enc\"
 
 $(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
@@ -17,4 +19,20 @@ $(call emugl-import,libOpenglCodecCommon)
 
 $(call emugl-end-module)
 
+### GLESv2_enc Encoder, host #####################################
+ifeq (true,$(EMUGL_BUILD_HOST_LIBS))
+$(call emugl-begin-host-shared-library,libGLESv2_enc)
+
+LOCAL_SRC_FILES := $(glesv2EncSources)
 
+# Both encoders define the same glXxx_enc functions: bind each library to its
+# own definitions, which is what the Android dynamic linker does.
+LOCAL_LDFLAGS += -Wl,-Bsymbolic
+
+LOCAL_CFLAGS += -DLOG_TAG=\"emuglGLESv2_enc\"
+
+$(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
+$(call emugl-import,libOpenglCodecCommon)
+
+$(call emugl-end-module)
+endif
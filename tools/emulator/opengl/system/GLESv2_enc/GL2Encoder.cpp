@@ -15,6 +15,7 @@
 */
 
 #include "GL2Encoder.h"
+#include "ProgramCache.h"
 #include <assert.h>
 #include <ctype.h>
 
@@ -45,9 +46,11 @@ GL2Encoder::GL2Encoder(IOStream *stream) : gl2_encoder_context_t(stream)
 {
     m_initialized = false;
     m_state = NULL;
+    m_programCache = NULL;
     m_error = GL_NO_ERROR;
     m_num_compressedTextureFormats = 0;
     m_compressedTextureFormats = NULL;
+    m_scratch = &m_ownScratch;
     //overrides
     m_glFlush_enc = set_glFlush(s_glFlush);
     m_glPixelStorei_enc = set_glPixelStorei(s_glPixelStorei);
@@ -68,6 +71,8 @@ GL2Encoder::GL2Encoder(IOStream *stream) : gl2_encoder_context_t(stream)
     m_glGetVertexAttribfv_enc = set_glGetVertexAttribfv(s_glGetVertexAttribfv);
     m_glGetVertexAttribPointerv = set_glGetVertexAttribPointerv(s_glGetVertexAttribPointerv);
     set_glShaderSource(s_glShaderSource);
+    m_glCompileShader_enc = set_glCompileShader(s_glCompileShader);
+    m_glBindAttribLocation_enc = set_glBindAttribLocation(s_glBindAttribLocation);
     set_glFinish(s_glFinish);
     m_glGetError_enc = set_glGetError(s_glGetError);
     m_glLinkProgram_enc = set_glLinkProgram(s_glLinkProgram);
@@ -111,6 +116,8 @@ GL2Encoder::GL2Encoder(IOStream *stream) : gl2_encoder_context_t(stream)
     m_glTexParameterfv_enc = set_glTexParameterfv(s_glTexParameterfv);
     m_glTexParameteri_enc = set_glTexParameteri(s_glTexParameteri);
     m_glTexParameteriv_enc = set_glTexParameteriv(s_glTexParameteriv);
+    m_glTexImage2D_enc = set_glTexImage2D(s_glTexImage2D);
+    m_glTexSubImage2D_enc = set_glTexSubImage2D(s_glTexSubImage2D);
 }
 
 GL2Encoder::~GL2Encoder()
@@ -136,6 +143,7 @@ void GL2Encoder::s_glFlush(void *self)
     GL2Encoder *ctx = (GL2Encoder *) self;
     ctx->m_glFlush_enc(self);
     ctx->m_stream->flush();
+    ctx->m_scratch->reset();
 }
 
 const GLubyte *GL2Encoder::s_glGetString(void *self, GLenum name)
@@ -475,6 +483,8 @@ void GL2Encoder::s_glDrawElements(void *self, GLenum mode, GLsizei count, GLenum
     }
 
     bool adjustIndices = true;
+    bool haveIndexRange = false;
+    int minIndex = 0, maxIndex = 0;
     if (ctx->m_state->currentIndexVbo() != 0) {
         if (!has_immediate_arrays) {
             ctx->sendVertexAttributes(0, count);
@@ -484,19 +494,23 @@ void GL2Encoder::s_glDrawElements(void *self, GLenum mode, GLsizei count, GLenum
         } else {
             BufferData * buf = ctx->m_shared->getBufferData(ctx->m_state->currentIndexVbo());
             ctx->m_glBindBuffer_enc(self, GL_ELEMENT_ARRAY_BUFFER, 0);
+            // the same indices are usually drawn again: their range is cached
+            haveIndexRange = ctx->m_shared->getBufferIndexRange(ctx->m_state->currentIndexVbo(),
+                    (GLintptr)indices, count, type, &minIndex, &maxIndex);
             indices = (void*)((GLintptr)buf->m_fixedBuffer.ptr() + (GLintptr)indices);
         }
     } 
     if (adjustIndices) {
         void *adjustedIndices = (void*)indices;
-        int minIndex = 0, maxIndex = 0;
 
         switch(type) {
         case GL_BYTE:
         case GL_UNSIGNED_BYTE:
-            GLUtils::minmax<unsigned char>((unsigned char *)indices, count, &minIndex, &maxIndex);
+            if (!haveIndexRange) {
+                GLUtils::minmax<unsigned char>((unsigned char *)indices, count, &minIndex, &maxIndex);
+            }
             if (minIndex != 0) {
-                adjustedIndices =  ctx->m_fixedBuffer.alloc(glSizeof(type) * count);
+                adjustedIndices =  ctx->m_scratch->alloc(glSizeof(type) * count);
                 GLUtils::shiftIndices<unsigned char>((unsigned char *)indices,
                                                  (unsigned char *)adjustedIndices,
                                                  count, -minIndex);
@@ -504,9 +518,11 @@ void GL2Encoder::s_glDrawElements(void *self, GLenum mode, GLsizei count, GLenum
             break;
         case GL_SHORT:
         case GL_UNSIGNED_SHORT:
-            GLUtils::minmax<unsigned short>((unsigned short *)indices, count, &minIndex, &maxIndex);
+            if (!haveIndexRange) {
+                GLUtils::minmax<unsigned short>((unsigned short *)indices, count, &minIndex, &maxIndex);
+            }
             if (minIndex != 0) {
-                adjustedIndices = ctx->m_fixedBuffer.alloc(glSizeof(type) * count);
+                adjustedIndices = ctx->m_scratch->alloc(glSizeof(type) * count);
                 GLUtils::shiftIndices<unsigned short>((unsigned short *)indices,
                                                   (unsigned short *)adjustedIndices,
                                                   count, -minIndex);
@@ -646,27 +662,67 @@ void GL2Encoder::s_glShaderSource(void *self, GLuint shader, GLsizei count, cons
     // TODO: pre-process str before calling replaceSamplerExternalWith2D().
     // Perhaps we can borrow Mesa's pre-processor?
 
+    shaderData->samplerExternalNames.clear();
     if (!replaceSamplerExternalWith2D(str, shaderData)) {
-        delete str;
+        delete [] str;
         ctx->setError(GL_OUT_OF_MEMORY);
         return;
     }
+    shaderData->sourceHash = ProgramCache::hash(str, len);
 
     ctx->glShaderString(ctx, shader, str, len + 1);
-    delete str;
+    delete [] str;
+}
+
+void GL2Encoder::s_glCompileShader(void *self, GLuint shader)
+{
+    GL2Encoder *ctx = (GL2Encoder *)self;
+    ctx->m_glCompileShader_enc(self, shader);
+    ctx->m_shared->compileShader(shader);
+}
+
+void GL2Encoder::s_glBindAttribLocation(void *self, GLuint program, GLuint index, const GLchar *name)
+{
+    GL2Encoder *ctx = (GL2Encoder *)self;
+    ctx->m_glBindAttribLocation_enc(self, program, index, name);
+    if (name) ctx->m_shared->bindAttribLocation(program, index, name);
 }
 
 void GL2Encoder::s_glFinish(void *self)
 {
     GL2Encoder *ctx = (GL2Encoder *)self;
     ctx->glFinishRoundTrip(self);
+    ctx->m_scratch->reset();
 }
 
+// The uniforms of a linked program are cached as their count, then for each
+// one its host location, size, type, and the length and characters of its
+// name.
+struct CachedUniform {
+    GLint base;
+    GLint size;
+    GLenum type;
+    GLuint nameLength;
+};
+
 void GL2Encoder::s_glLinkProgram(void * self, GLuint program)
 {
     GL2Encoder *ctx = (GL2Encoder *)self;
     ctx->m_glLinkProgram_enc(self, program);
 
+    // The same shaders were linked before, by the same host renderer: the
+    // program links and its uniforms are known.
+    uint64_t key = 0;
+    bool cacheable = ctx->m_programCache &&
+                     ctx->m_shared->getProgramContentHash(program, &key);
+    if (cacheable) {
+        ssize_t size = ctx->m_programCache->get(key, &ctx->m_fixedBuffer);
+        if (size >= 0 && ctx->loadProgramUniforms(program,
+                (const unsigned char *)ctx->m_fixedBuffer.ptr(), size)) {
+            return;
+        }
+    }
+
     GLint linkStatus = 0;
     ctx->glGetProgramiv(self,program,GL_LINK_STATUS,&linkStatus);
     if (!linkStatus)
@@ -685,18 +741,72 @@ void GL2Encoder::s_glLinkProgram(void * self, GLuint program)
     GLenum type;
     GLchar *name = new GLchar[maxLength+1];
     GLint location;
+
+    FixedBuffer cached;
+    unsigned char *ptr = NULL;
+    if (cacheable && numUniforms >= 0) {
+        ptr = (unsigned char *)cached.alloc(sizeof(GLuint) +
+                numUniforms * (sizeof(CachedUniform) + maxLength + 1));
+        if (ptr) {
+            memcpy(ptr, &numUniforms, sizeof(GLuint));
+            ptr += sizeof(GLuint);
+        }
+    }
+
     //for each active uniform, get its size and starting location.
     for (GLint i=0 ; i<numUniforms ; ++i) 
     {
+        name[0] = '\0';
         ctx->glGetActiveUniform(self, program, i, maxLength, NULL, &size, &type, name);
+        name[maxLength] = '\0';
         location = ctx->m_glGetUniformLocation_enc(self, program, name);
         ctx->m_shared->setProgramIndexInfo(program, i, location, size, type, name);
+
+        if (ptr) {
+            CachedUniform uniform = { location, size, type, (GLuint)strlen(name) };
+            memcpy(ptr, &uniform, sizeof(uniform));
+            memcpy(ptr + sizeof(uniform), name, uniform.nameLength);
+            ptr += sizeof(uniform) + uniform.nameLength;
+        }
     }
     ctx->m_shared->setupLocationShiftWAR(program);
 
+    if (ptr) {
+        ctx->m_programCache->put(key, cached.ptr(), ptr - (unsigned char *)cached.ptr());
+    }
     delete[] name;
 }
 
+bool GL2Encoder::loadProgramUniforms(GLuint program, const unsigned char *data, size_t size)
+{
+    const unsigned char *end = data + size;
+    GLuint numUniforms;
+    if (size < sizeof(numUniforms)) {
+        return false;
+    }
+    memcpy(&numUniforms, data, sizeof(numUniforms));
+    data += sizeof(numUniforms);
+
+    m_shared->initProgramData(program, numUniforms);
+    for (GLuint i = 0; i < numUniforms; i++) {
+        CachedUniform uniform;
+        if ((size_t)(end - data) < sizeof(uniform)) {
+            return false;
+        }
+        memcpy(&uniform, data, sizeof(uniform));
+        data += sizeof(uniform);
+        if ((size_t)(end - data) < uniform.nameLength) {
+            return false;
+        }
+        android::String8 name((const char *)data, uniform.nameLength);
+        data += uniform.nameLength;
+        m_shared->setProgramIndexInfo(program, i, uniform.base, uniform.size, uniform.type,
+                                      name.string());
+    }
+    m_shared->setupLocationShiftWAR(program);
+    return true;
+}
+
 void GL2Encoder::s_glDeleteProgram(void *self, GLuint program)
 {
     GL2Encoder *ctx = (GL2Encoder*)self;
@@ -1180,6 +1290,65 @@ void GL2Encoder::s_glTexParameteriv(void* self,
     }
 }
 
+// The rows of an uploaded image are padded to the unpack alignment, 4 by
+// default: for an RGB or odd sized image, the padding is stripped before the
+// pixels are sent, and the host unpacks them with an alignment of 1.
+const GLvoid* GL2Encoder::stripUnpackPadding(GLsizei width, GLsizei height,
+        GLenum format, GLenum type, const GLvoid* pixels)
+{
+    assert(m_state != NULL);
+    size_t size = pixels ? m_state->strippedPixelDataSize(width, height, format, type) : 0;
+    if (size == 0) {
+        return NULL;
+    }
+
+    unsigned char *packed = (unsigned char *)m_scratch->alloc(size);
+    if (!packed) {
+        return NULL;
+    }
+    glUtilsPackPixelRows(packed, (const unsigned char *)pixels, size / height, height,
+            m_state->pixelStoreState()->unpack_alignment);
+    return packed;
+}
+
+void GL2Encoder::s_glTexImage2D(void* self, GLenum target, GLint level,
+        GLint internalformat, GLsizei width, GLsizei height, GLint border,
+        GLenum format, GLenum type, const GLvoid* pixels)
+{
+    GL2Encoder* ctx = (GL2Encoder*)self;
+    const GLvoid* packed = ctx->stripUnpackPadding(width, height, format, type, pixels);
+
+    if (packed) {
+        GLint alignment = ctx->m_state->pixelStoreState()->unpack_alignment;
+        s_glPixelStorei(ctx, GL_UNPACK_ALIGNMENT, 1);
+        ctx->m_glTexImage2D_enc(ctx, target, level, internalformat, width, height,
+                border, format, type, packed);
+        s_glPixelStorei(ctx, GL_UNPACK_ALIGNMENT, alignment);
+    } else {
+        ctx->m_glTexImage2D_enc(ctx, target, level, internalformat, width, height,
+                border, format, type, pixels);
+    }
+}
+
+void GL2Encoder::s_glTexSubImage2D(void* self, GLenum target, GLint level,
+        GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+        GLenum format, GLenum type, const GLvoid* pixels)
+{
+    GL2Encoder* ctx = (GL2Encoder*)self;
+    const GLvoid* packed = ctx->stripUnpackPadding(width, height, format, type, pixels);
+
+    if (packed) {
+        GLint alignment = ctx->m_state->pixelStoreState()->unpack_alignment;
+        s_glPixelStorei(ctx, GL_UNPACK_ALIGNMENT, 1);
+        ctx->m_glTexSubImage2D_enc(ctx, target, level, xoffset, yoffset, width, height,
+                format, type, packed);
+        s_glPixelStorei(ctx, GL_UNPACK_ALIGNMENT, alignment);
+    } else {
+        ctx->m_glTexSubImage2D_enc(ctx, target, level, xoffset, yoffset, width, height,
+                format, type, pixels);
+    }
+}
+
 void GL2Encoder::override2DTextureTarget(GLenum target)
 {
     if ((target == GL_TEXTURE_2D || target == GL_TEXTURE_EXTERNAL_OES) &&
@@ -20,7 +20,9 @@
 #include "GLClientState.h"
 #include "GLSharedGroup.h"
 #include "FixedBuffer.h"
+#include "ScratchArena.h"
 
+class ProgramCache;
 
 class GL2Encoder : public gl2_encoder_context_t {
 public:
@@ -30,6 +32,12 @@ public:
         m_state = state;
     }
     void setSharedGroup(GLSharedGroupPtr shared){ m_shared = shared; }
+    // Programs linked from shaders found in 'cache' get their uniforms
+    // from it instead of querying the host.
+    void setProgramCache(ProgramCache *cache) { m_programCache = cache; }
+    // The temporaries of the calls go to 'arena', e.g. the one of the
+    // connection, instead of the own one of the encoder
+    void setScratchArena(ScratchArena *arena) { m_scratch = arena; }
     const GLClientState *state() { return m_state; }
     const GLSharedGroupPtr shared() { return m_shared; }
     void flush() { m_stream->flush(); }
@@ -42,12 +50,17 @@ public:
 
     void override2DTextureTarget(GLenum target);
     void restore2DTextureTarget();
+    // Returns a copy of the rows of 'pixels' without the padding of the
+    // unpack alignment, or NULL if they are to be sent as they are.
+    const GLvoid* stripUnpackPadding(GLsizei width, GLsizei height,
+            GLenum format, GLenum type, const GLvoid* pixels);
 
 private:
 
     bool    m_initialized;
     GLClientState *m_state;
     GLSharedGroupPtr m_shared;
+    ProgramCache *m_programCache;
     GLenum  m_error;
 
     GLint *m_compressedTextureFormats;
@@ -55,6 +68,8 @@ private:
     GLint *getCompressedTextureFormats();
 
     FixedBuffer m_fixedBuffer;
+    ScratchArena m_ownScratch;
+    ScratchArena *m_scratch;
 
     void sendVertexAttributes(GLint first, GLsizei count);
     bool updateHostTexture2DBinding(GLenum texUnit, GLenum newTarget);
@@ -119,10 +134,17 @@ private:
 
     static void s_glShaderSource(void *self, GLuint shader, GLsizei count, const GLchar **string, const GLint *length);
 
+    glCompileShader_client_proc_t m_glCompileShader_enc;
+    static void s_glCompileShader(void *self, GLuint shader);
+
+    glBindAttribLocation_client_proc_t m_glBindAttribLocation_enc;
+    static void s_glBindAttribLocation(void *self, GLuint program, GLuint index, const GLchar *name);
+
     static void s_glFinish(void *self);
 
     glLinkProgram_client_proc_t m_glLinkProgram_enc;
     static void s_glLinkProgram(void *self, GLuint program);
+    bool loadProgramUniforms(GLuint program, const unsigned char *data, size_t size);
 
     glDeleteProgram_client_proc_t m_glDeleteProgram_enc;
     static void s_glDeleteProgram(void * self, GLuint program);
@@ -202,6 +224,8 @@ private:
     glTexParameterfv_client_proc_t m_glTexParameterfv_enc;
     glTexParameteri_client_proc_t m_glTexParameteri_enc;
     glTexParameteriv_client_proc_t m_glTexParameteriv_enc;
+    glTexImage2D_client_proc_t m_glTexImage2D_enc;
+    glTexSubImage2D_client_proc_t m_glTexSubImage2D_enc;
 
     static void s_glActiveTexture(void* self, GLenum texture);
     static void s_glBindTexture(void* self, GLenum target, GLuint texture);
@@ -212,5 +236,11 @@ private:
     static void s_glTexParameterfv(void* self, GLenum target, GLenum pname, const GLfloat* params);
     static void s_glTexParameteri(void* self, GLenum target, GLenum pname, GLint param);
     static void s_glTexParameteriv(void* self, GLenum target, GLenum pname, const GLint* params);
+    static void s_glTexImage2D(void* self, GLenum target, GLint level, GLint internalformat,
+            GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type,
+            const GLvoid* pixels);
+    static void s_glTexSubImage2D(void* self, GLenum target, GLint level, GLint xoffset,
+            GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type,
+            const GLvoid* pixels);
 };
 #endif
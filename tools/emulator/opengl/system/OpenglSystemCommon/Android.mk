@@ -4,10 +4,41 @@ $(call emugl-begin-shared-library,libOpenglSystemCommon)
 $(call emugl-import,libGLESv1_enc libGLESv2_enc lib_renderControl_enc)
 
 LOCAL_SRC_FILES := \
+    ColorBufferPrefetch.cpp \
+    CommandList.cpp \
     HostConnection.cpp \
+    OpcodeRangeGL.cpp \
+    OpcodeRangeGL2.cpp \
+    OpcodeRangeRenderControl.cpp \
+    ProfilingStream.cpp \
     QemuPipeStream.cpp \
+    ReadbackFence.cpp \
+    StagingStream.cpp \
     ThreadInfo.cpp
 
 $(call emugl-export,C_INCLUDES,$(LOCAL_PATH) bionic/libc/private)
 
 $(call emugl-end-module)
+
+# There is no QEMU pipe on the host: the connections use the stream
+# factory set with HostConnection::setStreamFactory(), or TCP.
+ifeq (true,$(EMUGL_BUILD_HOST_LIBS))
+$(call emugl-begin-host-shared-library,libOpenglSystemCommon)
+$(call emugl-import,libGLESv1_enc libGLESv2_enc lib_renderControl_enc)
+
+LOCAL_SRC_FILES := \
+    ColorBufferPrefetch.cpp \
+    CommandList.cpp \
+    HostConnection.cpp \
+    OpcodeRangeGL.cpp \
+    OpcodeRangeGL2.cpp \
+    OpcodeRangeRenderControl.cpp \
+    ProfilingStream.cpp \
+    ReadbackFence.cpp \
+    StagingStream.cpp \
+    ThreadInfo.cpp
+
+$(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
+
+$(call emugl-end-module)
+endif
@@ -0,0 +1,155 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "ColorBufferPrefetch.h"
+#include "HostConnection.h"
+#include "ReadbackFence.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <cutils/log.h>
+
+// Reads ahead in flight at a time, i.e. buffers posted and not locked yet
+#define MAX_PREFETCHES  8
+
+struct Prefetch {
+    enum { FREE, PENDING, WAITED } state;
+    uint32_t hostHandle;
+    ReadbackFence fence;
+};
+
+static pthread_mutex_t s_prefetchLock = PTHREAD_MUTEX_INITIALIZER;
+static Prefetch s_prefetches[MAX_PREFETCHES];
+
+static void *guestAddress(cb_handle_t *cb)
+{
+    if (!cb->ashmemBase || cb->ashmemBasePid != getpid()) {
+        return NULL;
+    }
+    if (cb->canBePosted()) {
+        return (void *)((intptr_t)cb->ashmemBase + sizeof(int));
+    }
+    return (void *)(intptr_t)cb->ashmemBase;
+}
+
+// Takes the read ahead of 'hostHandle' off the list, so that a single
+// caller waits for it. Returns NULL if there is none.
+static Prefetch *claimPrefetch(uint32_t hostHandle)
+{
+    Prefetch *prefetch = NULL;
+
+    pthread_mutex_lock(&s_prefetchLock);
+    for (int i = 0; i < MAX_PREFETCHES; i++) {
+        if (s_prefetches[i].state == Prefetch::PENDING &&
+            s_prefetches[i].hostHandle == hostHandle) {
+            prefetch = &s_prefetches[i];
+            prefetch->state = Prefetch::WAITED;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_prefetchLock);
+    return prefetch;
+}
+
+static bool waitPrefetch(Prefetch *prefetch)
+{
+    bool ok = prefetch->fence.wait();
+
+    pthread_mutex_lock(&s_prefetchLock);
+    prefetch->state = Prefetch::FREE;
+    pthread_mutex_unlock(&s_prefetchLock);
+    return ok;
+}
+
+void prefetchColorBuffer(cb_handle_t *cb)
+{
+    void *addr = guestAddress(cb);
+    if (!addr || !cb->hostHandle || !cb->glFormat) {
+        return;
+    }
+
+    HostConnection *hostCon = HostConnection::get();
+    if (!hostCon) {
+        return;
+    }
+
+    // A buffer posted again before it was locked has been rendered again:
+    // its previous read ahead is stale, and must be complete before the new
+    // one starts
+    cancelColorBufferPrefetch(cb);
+
+    // Without a free entry, e.g. when the consumer is another process and
+    // never claims them, one whose read ahead is complete is reused: a lock
+    // of its buffer then reads it again.
+    Prefetch *prefetch = NULL;
+    pthread_mutex_lock(&s_prefetchLock);
+    for (int i = 0; i < MAX_PREFETCHES && !prefetch; i++) {
+        if (s_prefetches[i].state == Prefetch::FREE) {
+            prefetch = &s_prefetches[i];
+        }
+    }
+    for (int i = 0; i < MAX_PREFETCHES && !prefetch; i++) {
+        if (s_prefetches[i].state == Prefetch::PENDING && s_prefetches[i].fence.isSignaled()) {
+            prefetch = &s_prefetches[i];
+        }
+    }
+    if (prefetch) {
+        prefetch->state = Prefetch::PENDING;
+        prefetch->hostHandle = cb->hostHandle;
+        prefetch->fence.reset();
+    }
+    pthread_mutex_unlock(&s_prefetchLock);
+
+    if (!prefetch) {
+        return;
+    }
+    if (!hostCon->readNextAsync(&prefetch->fence)) {
+        prefetch->fence.signal(false);
+        return;
+    }
+
+    renderControl_encoder_context_t *rcEnc = hostCon->rcEncoder();
+    rcEnc->rcReadColorBuffer(rcEnc, cb->hostHandle, 0, 0, cb->width, cb->height,
+                             cb->glFormat, cb->glType, addr);
+}
+
+void readColorBuffer(cb_handle_t *cb)
+{
+    void *addr = guestAddress(cb);
+    if (!addr || !cb->hostHandle || !cb->glFormat) {
+        return;
+    }
+
+    Prefetch *prefetch = claimPrefetch(cb->hostHandle);
+    if (prefetch && waitPrefetch(prefetch)) {
+        return;
+    }
+
+    HostConnection *hostCon = HostConnection::get();
+    if (!hostCon) {
+        return;
+    }
+    renderControl_encoder_context_t *rcEnc = hostCon->rcEncoder();
+    rcEnc->rcReadColorBuffer(rcEnc, cb->hostHandle, 0, 0, cb->width, cb->height,
+                             cb->glFormat, cb->glType, addr);
+}
+
+void cancelColorBufferPrefetch(cb_handle_t *cb)
+{
+    Prefetch *prefetch;
+
+    while ((prefetch = claimPrefetch(cb->hostHandle)) != NULL) {
+        waitPrefetch(prefetch);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __COLOR_BUFFER_PREFETCH_H
+#define __COLOR_BUFFER_PREFETCH_H
+
+#include "gralloc_cb.h"
+
+//
+// Reads of the host color buffers of gralloc buffers into their guest
+// memory, for the software readers of the buffers.
+//
+// A buffer rendered by the GPU and allocated for frequent software reads is
+// read ahead when it is posted, in the background: the lock of the buffer
+// for reading then waits for that read to complete rather than making one,
+// and any other lock waits for it before the CPU touches the memory. The
+// reads ahead are tracked per process.
+//
+
+// Starts reading the color buffer of 'cb', with the host connection of the
+// calling thread, if it is mapped in this process
+void prefetchColorBuffer(cb_handle_t *cb);
+
+// Brings the guest memory of 'cb' up to date with its color buffer, from the
+// read ahead if there is one
+void readColorBuffer(cb_handle_t *cb);
+
+// Waits for a read ahead of the color buffer of 'cb' and forgets it: before
+// the memory of the buffer is written or unmapped, and once the buffer is
+// dequeued to be rendered again, as the read ahead becomes stale
+void cancelColorBufferPrefetch(cb_handle_t *cb);
+
+#endif
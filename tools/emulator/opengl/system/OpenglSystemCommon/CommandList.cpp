@@ -0,0 +1,181 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "CommandList.h"
+#include "GLEncoder.h"
+#include "GL2Encoder.h"
+#include "GLClientState.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/log.h>
+
+CommandList::CommandList(size_t bufSize) :
+    IOStream(bufSize),
+    m_data(NULL),
+    m_size(0),
+    m_capacity(0),
+    m_rejectedSize((size_t)-1),
+    m_rejectedCalls(0),
+    m_failed(false),
+    m_state(NULL),
+    m_shared(new GLSharedGroup()),
+    m_glEnc(NULL),
+    m_gl2Enc(NULL)
+{
+}
+
+CommandList::~CommandList()
+{
+    delete m_glEnc;
+    delete m_gl2Enc;
+    delete m_state;
+    free(m_data);
+}
+
+GLEncoder *CommandList::glEncoder()
+{
+    if (!m_glEnc) {
+        if (!m_state) {
+            m_state = new GLClientState();
+        }
+        m_glEnc = new GLEncoder(this);
+        m_glEnc->setClientState(m_state);
+        m_glEnc->setSharedGroup(m_shared);
+    }
+    return m_glEnc;
+}
+
+GL2Encoder *CommandList::gl2Encoder()
+{
+    if (!m_gl2Enc) {
+        if (!m_state) {
+            m_state = new GLClientState();
+        }
+        m_gl2Enc = new GL2Encoder(this);
+        m_gl2Enc->setClientState(m_state);
+        m_gl2Enc->setSharedGroup(m_shared);
+    }
+    return m_gl2Enc;
+}
+
+void CommandList::setSharedGroup(GLSharedGroupPtr shared)
+{
+    m_shared = shared;
+    if (m_glEnc) {
+        m_glEnc->setSharedGroup(shared);
+    }
+    if (m_gl2Enc) {
+        m_gl2Enc->setSharedGroup(shared);
+    }
+}
+
+void CommandList::reset()
+{
+    flush();
+    m_size = 0;
+    m_rejectedSize = (size_t)-1;
+    m_rejectedCalls = 0;
+    m_failed = false;
+}
+
+bool CommandList::reserve(size_t len)
+{
+    if (m_capacity - m_size >= len) {
+        return true;
+    }
+
+    // grow geometrically: a list is usually recorded again at the same size
+    size_t capacity = (m_capacity ? m_capacity * 2 : len);
+    while (capacity - m_size < len) {
+        capacity *= 2;
+    }
+    unsigned char *p = (unsigned char *)realloc(m_data, capacity);
+    if (!p) {
+        ERR("CommandList: realloc (%u) failed\n", (unsigned int)capacity);
+        m_failed = true;
+        return false;
+    }
+    m_data = p;
+    m_capacity = capacity;
+    return true;
+}
+
+void *CommandList::allocBuffer(size_t minSize)
+{
+    if (!reserve(minSize)) {
+        return NULL;
+    }
+    return m_data + m_size;
+}
+
+int CommandList::commitBuffer(size_t size)
+{
+    m_size += size;
+    return 0;
+}
+
+int CommandList::writeFully(const void *buf, size_t len)
+{
+    if (!reserve(len)) {
+        return -1;
+    }
+    memcpy(m_data + m_size, buf, len);
+    m_size += len;
+    return 0;
+}
+
+const unsigned char *CommandList::readFully(void *buf, size_t len)
+{
+    rejectLastPacket();
+    memset(buf, 0, len);
+    return (const unsigned char *)buf;
+}
+
+const unsigned char *CommandList::read(void *buf, size_t *inout_len)
+{
+    rejectLastPacket();
+    memset(buf, 0, *inout_len);
+    return (const unsigned char *)buf;
+}
+
+void CommandList::rejectLastPacket()
+{
+    // the other readbacks of the same call
+    if (m_size == m_rejectedSize) {
+        return;
+    }
+
+    // the call which reads back has been flushed: it is the last packet
+    size_t offset = 0, last = 0;
+    while (offset + 8 <= m_size) {
+        uint32_t packetSize;
+        memcpy(&packetSize, m_data + offset + 4, 4);
+        if (packetSize < 8) {
+            break;
+        }
+        last = offset;
+        offset += packetSize;
+    }
+
+    uint32_t opcode = 0;
+    if (last + 4 <= m_size) {
+        memcpy(&opcode, m_data + last, 4);
+    }
+    ALOGE("CommandList: call %u reads back from the host, dropped\n", opcode);
+    m_size = last;
+    m_rejectedSize = m_size;
+    m_rejectedCalls++;
+}
@@ -0,0 +1,93 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __COMMAND_LIST_H
+#define __COMMAND_LIST_H
+
+#include "IOStream.h"
+#include "GLSharedGroup.h"
+
+class GLClientState;
+class GLEncoder;
+class GL2Encoder;
+
+//
+// Commands encoded in memory, e.g. by a worker thread, for the thread which
+// owns a context to send later with HostConnection::submit().
+//
+// The commands are recorded with the same encoders as the contexts, over a
+// client state of their own: the program, the arrays and the pixel store
+// settings the calls rely on are the ones set in the list, and the bindings
+// a list changes are not seen by the encoders of the owning thread. The
+// programs and their uniforms are the ones of the share group set with
+// setSharedGroup(), normally the one of the owning context. A call which
+// reads back from the host can not be deferred: it is dropped from the
+// list, and returns zeros.
+//
+// A list is recorded by one thread at a time. Applications record them
+// through the EGL_EMU_command_list extension, see EGLCommandList.h.
+//
+class CommandList : public IOStream {
+public:
+    enum { DEFAULT_BUFFER_SIZE = 64 * 1024 };
+
+    CommandList(size_t bufSize = DEFAULT_BUFFER_SIZE);
+    ~CommandList();
+
+    virtual void *allocBuffer(size_t minSize);
+    virtual int commitBuffer(size_t size);
+    virtual const unsigned char *readFully(void *buf, size_t len);
+    virtual const unsigned char *read(void *buf, size_t *inout_len);
+    virtual int writeFully(const void *buf, size_t len);
+
+    // The encoders recording into the list
+    GLEncoder *glEncoder();
+    GL2Encoder *gl2Encoder();
+    // The share group of the programs the calls use, a group of its own
+    // by default
+    void setSharedGroup(GLSharedGroupPtr shared);
+    GLSharedGroupPtr sharedGroup() const { return m_shared; }
+
+    // The commands recorded, once the list has been flushed
+    const void *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    // Calls dropped since the last reset() because they read back
+    unsigned int rejectedCalls() const { return m_rejectedCalls; }
+    // Whether memory ran out: the list misses commands
+    bool failed() const { return m_failed; }
+
+    // Discards the commands, to record new ones
+    void reset();
+
+private:
+    // Makes room for 'len' more bytes
+    bool reserve(size_t len);
+    // Drops the last packet recorded, which reads back
+    void rejectLastPacket();
+
+    unsigned char *m_data;
+    size_t m_size;
+    size_t m_capacity;
+    size_t m_rejectedSize;      // m_size when the last packet was dropped
+    unsigned int m_rejectedCalls;
+    bool m_failed;
+
+    GLClientState *m_state;
+    GLSharedGroupPtr m_shared;
+    GLEncoder *m_glEnc;
+    GL2Encoder *m_gl2Enc;
+};
+
+#endif
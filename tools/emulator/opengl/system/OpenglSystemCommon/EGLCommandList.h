@@ -0,0 +1,71 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef _SYSTEM_COMMON_EGL_COMMAND_LIST_H
+#define _SYSTEM_COMMON_EGL_COMMAND_LIST_H
+
+#include <EGL/egl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// EGL_EMU_command_list: GL calls recorded by any thread into a command
+// list, for the thread which owns a context to send later, in order with
+// its own calls. The entry points are returned by eglGetProcAddress().
+//
+// A list belongs to the share group of the context current when it is
+// created, and is submitted by a context of that group. Between
+// eglBeginCommandListEMU() and eglEndCommandListEMU(), the GLES and GLES2
+// calls of a thread go to the list instead of its current context, if any.
+// The list has a client state of its own (see CommandList.h), so:
+//  - the program, the array pointers and the pixel store settings the
+//    calls of a list rely on must be set in the list;
+//  - the bindings a list changes must be restored at its end;
+//  - a call which reads back from the host, e.g. glGet*(), glReadPixels()
+//    or glFinish(), or which creates an object, is dropped and returns
+//    zeros.
+//
+// A list is used by one thread at a time: it can not be recorded,
+// submitted, reset or destroyed while it is recorded or submitted. A
+// submitted list is kept, so it can be submitted again until it is reset.
+//
+#define EGL_EMU_command_list 1
+
+typedef void *EGLCommandListEMU;
+#define EGL_NO_COMMAND_LIST_EMU ((EGLCommandListEMU)0)
+
+typedef EGLCommandListEMU (EGLAPIENTRYP PFNEGLCREATECOMMANDLISTEMUPROC) (EGLDisplay dpy, const EGLint *attrib_list);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLDESTROYCOMMANDLISTEMUPROC) (EGLDisplay dpy, EGLCommandListEMU list);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLBEGINCOMMANDLISTEMUPROC) (EGLDisplay dpy, EGLCommandListEMU list);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLENDCOMMANDLISTEMUPROC) (EGLDisplay dpy);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLSUBMITCOMMANDLISTSEMUPROC) (EGLDisplay dpy, EGLint count, const EGLCommandListEMU *lists);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLRESETCOMMANDLISTEMUPROC) (EGLDisplay dpy, EGLCommandListEMU list);
+
+#ifdef EGL_EGLEXT_PROTOTYPES
+EGLAPI EGLCommandListEMU EGLAPIENTRY eglCreateCommandListEMU(EGLDisplay dpy, const EGLint *attrib_list);
+EGLAPI EGLBoolean EGLAPIENTRY eglDestroyCommandListEMU(EGLDisplay dpy, EGLCommandListEMU list);
+EGLAPI EGLBoolean EGLAPIENTRY eglBeginCommandListEMU(EGLDisplay dpy, EGLCommandListEMU list);
+EGLAPI EGLBoolean EGLAPIENTRY eglEndCommandListEMU(EGLDisplay dpy);
+EGLAPI EGLBoolean EGLAPIENTRY eglSubmitCommandListsEMU(EGLDisplay dpy, EGLint count, const EGLCommandListEMU *lists);
+EGLAPI EGLBoolean EGLAPIENTRY eglResetCommandListEMU(EGLDisplay dpy, EGLCommandListEMU list);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,21 +14,58 @@
 * limitations under the License.
 */
 #include "HostConnection.h"
+#include "CommandList.h"
+#include "ProfilingStream.h"
+#include "StagingStream.h"
 #include "TcpStream.h"
+#ifdef HAVE_ANDROID_OS
 #include "QemuPipeStream.h"
+#endif
 #include "ThreadInfo.h"
 #include <cutils/log.h>
 #include "GLEncoder.h"
 #include "GL2Encoder.h"
+#include "ProgramCache.h"
+#include <limits.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #define STREAM_BUFFER_SIZE  4*1024*1024
 #define STREAM_PORT_NUM     22468
 
+#ifdef HAVE_ANDROID_OS
 /* Set to 1 to use a QEMU pipe, or 0 for a TCP connection */
 #define  USE_QEMU_PIPE  1
+#define  STREAM_HOST_ADDR   "10.0.2.2"
+#else
+/* Off-Android, connect directly to the emulator's renderer */
+#define  USE_QEMU_PIPE  0
+#define  STREAM_HOST_ADDR   "127.0.0.1"
+#endif
+
+/* Set to 1 to send the large writes (texture uploads, ...) from a separate
+ * thread and allow asynchronous readbacks, see StagingStream.h */
+#define  USE_STAGING_STREAM  1
+
+/* Command lists sent by a single write, see HostConnection::submit() */
+#define MAX_GATHERED_LISTS  64
+
+/* Name of the program cache file in the cache directory of an application */
+#define PROGRAM_CACHE_FILE  "emugl_program_cache"
+
+HostConnection::StreamFactory HostConnection::s_streamFactory = NULL;
+bool HostConnection::s_stagingEnabled = USE_STAGING_STREAM;
+
+static pthread_mutex_t s_programCacheLock = PTHREAD_MUTEX_INITIALIZER;
+static ProgramCache *s_programCache = NULL;
+static char s_programCachePath[PATH_MAX];
 
 HostConnection::HostConnection() :
     m_stream(NULL),
+    m_stagingStream(NULL),
+    m_profiler(NULL),
     m_glEnc(NULL),
     m_gl2Enc(NULL),
     m_rcEnc(NULL)
@@ -43,6 +80,83 @@ HostConnection::~HostConnection()
     delete m_rcEnc;
 }
 
+void HostConnection::setStreamFactory(StreamFactory factory)
+{
+    s_streamFactory = factory;
+}
+
+void HostConnection::setStagingEnabled(bool enabled)
+{
+    s_stagingEnabled = enabled;
+}
+
+void HostConnection::endFrame()
+{
+    m_scratch.reset();
+    if (m_profiler) {
+        m_profiler->endFrame();
+    }
+}
+
+bool HostConnection::submit(CommandList *const *lists, int count)
+{
+    struct iovec iov[MAX_GATHERED_LISTS];
+    int n = 0;
+    bool ok = true;
+
+    // the commands encoded so far by the thread go first
+    if (m_stream->flush() < 0) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        CommandList *list = lists[i];
+        list->flush();
+        if (list->failed()) {
+            ALOGE("HostConnection::submit: command list %p misses commands, not sent\n", list);
+            ok = false;
+            continue;
+        }
+        if (list->size() == 0) {
+            continue;
+        }
+        iov[n].iov_base = (void *)list->data();
+        iov[n].iov_len = list->size();
+        if (++n == MAX_GATHERED_LISTS) {
+            if (!writeGathered(iov, n)) {
+                return false;
+            }
+            n = 0;
+        }
+    }
+    if (n > 0 && !writeGathered(iov, n)) {
+        return false;
+    }
+    return ok;
+}
+
+// The staging stream sends the buffers with a single write to the host
+bool HostConnection::writeGathered(const struct iovec *iov, int iovcnt)
+{
+    if (m_stream == m_stagingStream) {
+        return m_stagingStream->writeFullyv(iov, iovcnt) >= 0;
+    }
+    for (int i = 0; i < iovcnt; i++) {
+        if (m_stream->writeFully(iov[i].iov_base, iov[i].iov_len) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HostConnection::readNextAsync(ReadbackFence *fence)
+{
+    if (!m_stagingStream) {
+        return false;
+    }
+    m_stagingStream->readNextAsync(fence);
+    return true;
+}
+
 HostConnection *HostConnection::get()
 {
     /* TODO: Make this configurable with a system property */
@@ -60,7 +174,17 @@ HostConnection *HostConnection::get()
             return NULL;
         }
 
-        if (useQemuPipe) {
+        if (s_streamFactory) {
+            IOStream *stream = s_streamFactory(STREAM_BUFFER_SIZE);
+            if (!stream) {
+                ALOGE("Failed to create stream for host connection!!!\n");
+                delete con;
+                return NULL;
+            }
+            con->m_stream = stream;
+        }
+#if USE_QEMU_PIPE
+        else if (useQemuPipe) {
             QemuPipeStream *stream = new QemuPipeStream(STREAM_BUFFER_SIZE);
             if (!stream) {
                 ALOGE("Failed to create QemuPipeStream for host connection!!!\n");
@@ -75,6 +199,7 @@ HostConnection *HostConnection::get()
             }
             con->m_stream = stream;
         }
+#endif
         else /* !useQemuPipe */
         {
             TcpStream *stream = new TcpStream(STREAM_BUFFER_SIZE);
@@ -84,7 +209,7 @@ HostConnection *HostConnection::get()
                 return NULL;
             }
 
-            if (stream->connect("10.0.2.2", STREAM_PORT_NUM) < 0) {
+            if (stream->connect(STREAM_HOST_ADDR, STREAM_PORT_NUM) < 0) {
                 ALOGE("Failed to connect to host (TcpStream)!!!\n");
                 delete stream;
                 delete con;
@@ -93,12 +218,26 @@ HostConnection *HostConnection::get()
             con->m_stream = stream;
         }
 
+        if (s_stagingEnabled) {
+            con->m_stagingStream = new StagingStream(con->m_stream, STREAM_BUFFER_SIZE);
+            con->m_stream = con->m_stagingStream;
+        }
+
         // send zero 'clientFlags' to the host.
         unsigned int *pClientFlags =
                 (unsigned int *)con->m_stream->allocBuffer(sizeof(unsigned int));
         *pClientFlags = 0;
         con->m_stream->commitBuffer(sizeof(unsigned int));
 
+        // the profiler parses the packets of the encoders: it comes last
+        char profileOutput[PATH_MAX];
+        if (ProfilingStream::getOutput(profileOutput, sizeof(profileOutput))) {
+            con->m_profiler = new ProfilingStream(con->m_stream, STREAM_BUFFER_SIZE,
+                                                  profileOutput);
+            con->m_profiler->setScratchArena(&con->m_scratch);
+            con->m_stream = con->m_profiler;
+        }
+
         ALOGD("HostConnection::get() New Host Connection established %p, tid %d\n", con, gettid());
         tinfo->hostConn = con;
     }
@@ -112,6 +251,7 @@ GLEncoder *HostConnection::glEncoder()
         m_glEnc = new GLEncoder(m_stream);
         DBG("HostConnection::glEncoder new encoder %p, tid %d", m_glEnc, gettid());
         m_glEnc->setContextAccessor(s_getGLContext);
+        m_glEnc->setScratchArena(&m_scratch);
     }
     return m_glEnc;
 }
@@ -122,10 +262,94 @@ GL2Encoder *HostConnection::gl2Encoder()
         m_gl2Enc = new GL2Encoder(m_stream);
         DBG("HostConnection::gl2Encoder new encoder %p, tid %d", m_gl2Enc, gettid());
         m_gl2Enc->setContextAccessor(s_getGL2Context);
+        m_gl2Enc->setProgramCache(programCache());
+        m_gl2Enc->setScratchArena(&m_scratch);
     }
     return m_gl2Enc;
 }
 
+// Where the program cache of the process is saved: $EMUGL_PROGRAM_CACHE if
+// set, otherwise the cache directory of the application, which processes
+// forked from the zygote are named after. Other processes have no file.
+static bool getProgramCachePath(char *path, size_t size)
+{
+    const char *env = getenv("EMUGL_PROGRAM_CACHE");
+    if (env) {
+        return env[0] != '\0' && snprintf(path, size, "%s", env) < (int)size;
+    }
+#ifdef HAVE_ANDROID_OS
+    char name[128];
+    FILE *cmdline = fopen("/proc/self/cmdline", "r");
+    if (!cmdline) {
+        return false;
+    }
+    size_t n = fread(name, 1, sizeof(name) - 1, cmdline);
+    fclose(cmdline);
+    name[n] = '\0';
+    // the processes of an application ("package:service") share its directory
+    char *colon = strchr(name, ':');
+    if (colon) {
+        *colon = '\0';
+    }
+    if (name[0] == '\0' || strchr(name, '/')) {
+        return false;
+    }
+
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "/data/data/%s/cache", name);
+    if (access(dir, W_OK) != 0) {
+        return false;
+    }
+    return snprintf(path, size, "%s/%s", dir, PROGRAM_CACHE_FILE) < (int)size;
+#else
+    return false;
+#endif
+}
+
+// Link results and uniform locations are only valid for the renderer that
+// produced them: the cache is salted with the host GL strings.
+static uint64_t hostRendererHash(renderControl_encoder_context_t *rcEnc)
+{
+    static const EGLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    uint64_t h = ProgramCache::hash(NULL, 0);
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        int n = rcEnc->rcGetGLString(rcEnc, names[i], NULL, 0);
+        if (n < 0) {
+            char *str = new char[-n];
+            if (rcEnc->rcGetGLString(rcEnc, names[i], str, -n) > 0) {
+                h = ProgramCache::hash(str, -n, h);
+            }
+            delete [] str;
+        }
+    }
+    return h;
+}
+
+ProgramCache *HostConnection::programCache()
+{
+    pthread_mutex_lock(&s_programCacheLock);
+    if (!s_programCache) {
+        s_programCache = new ProgramCache(hostRendererHash(rcEncoder()));
+        if (getProgramCachePath(s_programCachePath, sizeof(s_programCachePath))) {
+            s_programCache->load(s_programCachePath);
+        } else {
+            s_programCachePath[0] = '\0';
+        }
+    }
+    pthread_mutex_unlock(&s_programCacheLock);
+    return s_programCache;
+}
+
+void HostConnection::saveProgramCache()
+{
+    pthread_mutex_lock(&s_programCacheLock);
+    if (s_programCache && s_programCachePath[0] && s_programCache->isDirty()) {
+        s_programCache->save(s_programCachePath);
+    }
+    pthread_mutex_unlock(&s_programCacheLock);
+}
+
 renderControl_encoder_context_t *HostConnection::rcEncoder()
 {
     if (!m_rcEnc) {
@@ -18,38 +18,88 @@
 
 #include "IOStream.h"
 #include "renderControl_enc.h"
+#include "ScratchArena.h"
 
+class CommandList;
 class GLEncoder;
 class gl_client_context_t;
 class GL2Encoder;
 class gl2_client_context_t;
+class ProfilingStream;
+class ProgramCache;
+class ReadbackFence;
+class StagingStream;
+struct iovec;
 
 class HostConnection
 {
 public:
+    // Creates the stream of a new connection, with the given buffer size.
+    typedef IOStream *(*StreamFactory)(size_t bufSize);
+
     static HostConnection *get();
     ~HostConnection();
 
+    // Makes the connections created afterwards use streams returned by
+    // 'factory' instead of the QEMU pipe or TCP socket to the emulator, e.g.
+    // to run against an in-process renderer. NULL restores the default.
+    static void setStreamFactory(StreamFactory factory);
+    // Makes the connections created afterwards send through a staging
+    // stream (see StagingStream.h), or not. They do by default.
+    static void setStagingEnabled(bool enabled);
+
     GLEncoder *glEncoder();
     GL2Encoder *gl2Encoder();
     renderControl_encoder_context_t *rcEncoder();
 
+    // The cache of linked programs shared by the GLES 2 encoders of the
+    // process, loaded from the cache file of the process when there is one.
+    ProgramCache *programCache();
+    // Writes the new programs to the cache file, if any
+    static void saveProgramCache();
+
+    // Makes the next readback of the connection, e.g. of rcReadColorBuffer(),
+    // complete in the background and signal 'fence'. Returns false if the
+    // connection can not: the readback then blocks as usual.
+    bool readNextAsync(ReadbackFence *fence);
+
     void flush() {
         if (m_stream) {
             m_stream->flush();
         }
     }
 
+    // Sends the commands recorded in 'lists', in order, after those encoded
+    // so far by the thread, for its current context (see CommandList.h).
+    // The lists can be reset once it returns. Returns false if a list could
+    // not be sent, as it misses commands, or if the stream failed.
+    bool submit(CommandList *const *lists, int count);
+
+    // The temporaries of the calls of the thread, e.g. of its encoders
+    ScratchArena *scratchArena() { return &m_scratch; }
+
+    // Marks the end of a frame of the thread: releases its temporaries, and
+    // tells the profiler of the commands if it is enabled (see
+    // ProfilingStream.h)
+    void endFrame();
+
 private:
     HostConnection();
     static gl_client_context_t  *s_getGLContext();
     static gl2_client_context_t *s_getGL2Context();
+    bool writeGathered(const struct iovec *iov, int iovcnt);
 
 private:
+    static StreamFactory s_streamFactory;
+    static bool s_stagingEnabled;
+
     IOStream *m_stream;
+    StagingStream *m_stagingStream;     // m_stream, or under it, when it is one
+    ProfilingStream *m_profiler;        // m_stream, when profiling
     GLEncoder   *m_glEnc;
     GL2Encoder  *m_gl2Enc;
     renderControl_encoder_context_t *m_rcEnc;
+    ScratchArena m_scratch;
 };
 
 #endif
@@ -0,0 +1,37 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __OPCODE_RANGE_H
+#define __OPCODE_RANGE_H
+
+#include <stdint.h>
+
+//
+// The opcodes of the encoders of an API, from 'first' to before 'end'.
+//
+// The opcode headers of the APIs define some of the same names with
+// different values, e.g. OP_glActiveTexture: each range is taken from its
+// header in a file of its own.
+//
+struct OpcodeRange {
+    uint32_t first;
+    uint32_t end;
+};
+
+OpcodeRange glOpcodeRange();
+OpcodeRange gl2OpcodeRange();
+OpcodeRange renderControlOpcodeRange();
+
+#endif
@@ -0,0 +1,361 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "ProfilingStream.h"
+#include "OpcodeRange.h"
+#include "gl_client_context.h"
+#include "gl2_client_context.h"
+#include "renderControl_client_context.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cutils/log.h>
+#ifdef HAVE_ANDROID_OS
+#include <cutils/properties.h>
+#endif
+
+// Rows of each table of the summary
+#define MAX_REPORTED_OPCODES  16
+
+// The opcodes of an API, and the index of the counter of the first one
+struct ProfiledRange {
+    OpcodeRange opcodes;
+    size_t index;
+};
+
+// The ranges, and the names of the opcodes by counter index. The generated
+// dispatch initializers look the entry points up in the order of their
+// opcodes.
+static pthread_once_t s_opcodesOnce = PTHREAD_ONCE_INIT;
+static ProfiledRange s_ranges[3];
+static size_t s_numOpcodes;     // the counter after the last is for unknown ones
+static const char **s_names;
+static size_t s_numNames;
+
+static pthread_mutex_t s_outputLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *s_addName(const char *name, void *userData)
+{
+    if (s_numNames < s_numOpcodes) {
+        s_names[s_numNames++] = name;
+    }
+    return NULL;
+}
+
+static void initOpcodes()
+{
+    s_ranges[0].opcodes = glOpcodeRange();
+    s_ranges[1].opcodes = gl2OpcodeRange();
+    s_ranges[2].opcodes = renderControlOpcodeRange();
+    for (size_t i = 0; i < sizeof(s_ranges) / sizeof(s_ranges[0]); i++) {
+        s_ranges[i].index = s_numOpcodes;
+        s_numOpcodes += s_ranges[i].opcodes.end - s_ranges[i].opcodes.first;
+    }
+    s_names = new const char *[s_numOpcodes + 1];
+
+    gl_client_context_t glContext;
+    gl2_client_context_t gl2Context;
+    renderControl_client_context_t rcContext;
+
+    glContext.initDispatchByName(s_addName, NULL);
+    gl2Context.initDispatchByName(s_addName, NULL);
+    rcContext.initDispatchByName(s_addName, NULL);
+    while (s_numNames < s_numOpcodes) {
+        s_names[s_numNames++] = "?";
+    }
+    s_names[s_numOpcodes] = "unknown";
+}
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Writes a line of the summary to 'file', or to the log if NULL
+static void emit(FILE *file, const char *format, ...)
+{
+    char line[256];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (file) {
+        fprintf(file, "%s\n", line);
+    } else {
+        ALOGI("%s", line);
+    }
+}
+
+bool ProfilingStream::getOutput(char *output, size_t size)
+{
+    const char *env = getenv("EMUGL_PROFILE");
+    if (env) {
+        return env[0] != '\0' && snprintf(output, size, "%s", env) < (int)size;
+    }
+#ifdef HAVE_ANDROID_OS
+    char prop[PROPERTY_VALUE_MAX];
+    if (property_get("debug.egl.profile", prop, "") > 0) {
+        return snprintf(output, size, "%s", prop) < (int)size;
+    }
+#endif
+    return false;
+}
+
+ProfilingStream::ProfilingStream(IOStream *stream, size_t bufSize, const char *output) :
+    IOStream(bufSize),
+    m_stream(stream),
+    m_buf(NULL),
+    m_output(strdup(output)),
+    m_scratch(NULL),
+    m_headerSize(0),
+    m_remaining(0),
+    m_current(NULL),
+    m_ops(NULL),
+    m_frameBytes(0),
+    m_frameNs(0)
+{
+    pthread_once(&s_opcodesOnce, initOpcodes);
+    m_ops = new OpStats[s_numOpcodes + 1];
+    reset();
+}
+
+ProfilingStream::~ProfilingStream()
+{
+    if (m_frames > 0 || m_frameBytes > 0) {
+        report();
+    }
+    delete [] m_ops;
+    free(m_output);
+    delete m_stream;
+}
+
+void *ProfilingStream::allocBuffer(size_t minSize)
+{
+    m_buf = (unsigned char *)m_stream->allocBuffer(minSize);
+    return m_buf;
+}
+
+int ProfilingStream::commitBuffer(size_t size)
+{
+    parse(m_buf, size);
+    return m_stream->commitBuffer(size);
+}
+
+int ProfilingStream::writeFully(const void *buf, size_t len)
+{
+    parse((const unsigned char *)buf, len);
+    return m_stream->writeFully(buf, len);
+}
+
+const unsigned char *ProfilingStream::readFully(void *buf, size_t len)
+{
+    uint64_t start = nowNs();
+    const unsigned char *ret = m_stream->readFully(buf, len);
+    countReadback(start);
+    return ret;
+}
+
+const unsigned char *ProfilingStream::read(void *buf, size_t *inout_len)
+{
+    uint64_t start = nowNs();
+    const unsigned char *ret = m_stream->read(buf, inout_len);
+    countReadback(start);
+    return ret;
+}
+
+void ProfilingStream::endFrame()
+{
+    if (m_frameBytes > m_maxFrameBytes) {
+        m_maxFrameBytes = m_frameBytes;
+    }
+    if (m_frameNs > m_maxFrameNs) {
+        m_maxFrameNs = m_frameNs;
+    }
+    m_frameBytes = 0;
+    m_frameNs = 0;
+
+    if (++m_frames == REPORT_FRAMES) {
+        report();
+        reset();
+    }
+}
+
+void ProfilingStream::parse(const unsigned char *buf, size_t len)
+{
+    m_frameBytes += len;
+
+    while (len > 0) {
+        // the rest of the packet, e.g. the data of glBufferData(), may come
+        // in separate writes
+        if (m_remaining > 0) {
+            size_t n = (len < m_remaining ? len : m_remaining);
+            m_remaining -= n;
+            buf += n;
+            len -= n;
+            continue;
+        }
+
+        size_t n = sizeof(m_header) - m_headerSize;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(m_header + m_headerSize, buf, n);
+        m_headerSize += n;
+        buf += n;
+        len -= n;
+        if (m_headerSize < sizeof(m_header)) {
+            break;
+        }
+
+        uint32_t opcode, packetSize;
+        memcpy(&opcode, m_header, 4);
+        memcpy(&packetSize, m_header + 4, 4);
+        m_current = opStats(opcode);
+        m_current->calls++;
+        m_current->bytes += packetSize;
+        m_remaining = (packetSize > sizeof(m_header) ? packetSize - sizeof(m_header) : 0);
+        m_headerSize = 0;
+    }
+}
+
+ProfilingStream::OpStats *ProfilingStream::opStats(uint32_t opcode)
+{
+    for (size_t i = 0; i < sizeof(s_ranges) / sizeof(s_ranges[0]); i++) {
+        const OpcodeRange &opcodes = s_ranges[i].opcodes;
+        if (opcode >= opcodes.first && opcode < opcodes.end) {
+            return &m_ops[s_ranges[i].index + opcode - opcodes.first];
+        }
+    }
+    return &m_ops[s_numOpcodes];
+}
+
+void ProfilingStream::countReadback(uint64_t startNs)
+{
+    uint64_t ns = nowNs() - startNs;
+    OpStats *op = (m_current ? m_current : &m_ops[s_numOpcodes]);
+
+    op->readbacks++;
+    op->readbackNs += ns;
+    m_frameNs += ns;
+}
+
+struct SortEntry {
+    size_t index;
+    uint64_t key;
+};
+
+// Sorts the opcodes by decreasing bytes, or time waiting
+static int compareEntries(const void *a, const void *b)
+{
+    uint64_t ka = ((const SortEntry *)a)->key;
+    uint64_t kb = ((const SortEntry *)b)->key;
+    return ka < kb ? 1 : (ka > kb ? -1 : 0);
+}
+
+void ProfilingStream::report()
+{
+    SortEntry *bytes = new SortEntry[s_numOpcodes + 1];
+    SortEntry *waits = new SortEntry[s_numOpcodes + 1];
+    size_t numBytes = 0, numWaits = 0;
+    uint64_t calls = 0, total = 0, readbacks = 0, readbackNs = 0;
+
+    for (size_t i = 0; i <= s_numOpcodes; i++) {
+        const OpStats &op = m_ops[i];
+        calls += op.calls;
+        total += op.bytes;
+        readbacks += op.readbacks;
+        readbackNs += op.readbackNs;
+        if (op.bytes > 0) {
+            bytes[numBytes].index = i;
+            bytes[numBytes++].key = op.bytes;
+        }
+        if (op.readbackNs > 0) {
+            waits[numWaits].index = i;
+            waits[numWaits++].key = op.readbackNs;
+        }
+    }
+    qsort(bytes, numBytes, sizeof(bytes[0]), compareEntries);
+    qsort(waits, numWaits, sizeof(waits[0]), compareEntries);
+
+    // the averages are per frame, or totals for a thread which does not post
+    double frames = (m_frames > 0 ? m_frames : 1);
+
+    pthread_mutex_lock(&s_outputLock);
+    FILE *file = NULL;
+    if (strcmp(m_output, "log") != 0) {
+        file = fopen(m_output, "a");
+        if (!file) {
+            ALOGE("ProfilingStream: could not open %s\n", m_output);
+            pthread_mutex_unlock(&s_outputLock);
+            delete [] bytes;
+            delete [] waits;
+            return;
+        }
+    }
+
+    if (m_frames > 0) {
+        emit(file, "tid %d: %u frames, per frame: %.0f calls, %.1f KB (max %.1f KB), "
+             "%.1f readbacks waiting %.3f ms (max %.3f ms)",
+             gettid(), m_frames, calls / frames, total / frames / 1024,
+             m_maxFrameBytes / 1024.0, readbacks / frames, readbackNs / frames / 1e6,
+             m_maxFrameNs / 1e6);
+    } else {
+        emit(file, "tid %d: no frames, %llu calls, %.1f KB, %llu readbacks waiting %.3f ms",
+             gettid(), (unsigned long long)calls, total / 1024.0,
+             (unsigned long long)readbacks, readbackNs / 1e6);
+    }
+    if (m_scratch && m_scratch->stats().allocs > 0) {
+        const ScratchArena::Stats &scratch = m_scratch->stats();
+        emit(file, "  scratch memory since the start: %llu allocations, %llu from the heap, "
+             "peak %.1f KB, %.1f KB held",
+             (unsigned long long)scratch.allocs, (unsigned long long)scratch.blockAllocs,
+             scratch.peakSize / 1024.0, scratch.heldSize / 1024.0);
+    }
+    emit(file, "  %-32s %10s %12s", "by bytes", "calls", "KB");
+    for (size_t i = 0; i < numBytes && i < MAX_REPORTED_OPCODES; i++) {
+        const OpStats &op = m_ops[bytes[i].index];
+        emit(file, "  %-32s %10.1f %12.2f", s_names[bytes[i].index],
+             op.calls / frames, op.bytes / frames / 1024);
+    }
+    if (numWaits > 0) {
+        emit(file, "  %-32s %10s %12s", "by readback wait", "readbacks", "ms");
+    }
+    for (size_t i = 0; i < numWaits && i < MAX_REPORTED_OPCODES; i++) {
+        const OpStats &op = m_ops[waits[i].index];
+        emit(file, "  %-32s %10.1f %12.3f", s_names[waits[i].index],
+             op.readbacks / frames, op.readbackNs / frames / 1e6);
+    }
+
+    if (file) {
+        fclose(file);
+    }
+    pthread_mutex_unlock(&s_outputLock);
+    delete [] bytes;
+    delete [] waits;
+}
+
+void ProfilingStream::reset()
+{
+    memset(m_ops, 0, (s_numOpcodes + 1) * sizeof(m_ops[0]));
+    m_frames = 0;
+    m_maxFrameBytes = 0;
+    m_maxFrameNs = 0;
+}
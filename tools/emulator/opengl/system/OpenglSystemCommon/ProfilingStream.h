@@ -0,0 +1,92 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __PROFILING_STREAM_H
+#define __PROFILING_STREAM_H
+
+#include <stdint.h>
+#include "IOStream.h"
+#include "ScratchArena.h"
+
+//
+// A stream which counts, for each opcode of the GLES 1, GLES 2 and
+// renderControl encoders, the calls, the bytes sent to the host and the
+// time spent waiting for readbacks.
+//
+// It sits between the encoders of a connection and its stream, and parses
+// the headers of the packets going through, so a connection which is not
+// profiled pays nothing. The counters belong to the thread of the
+// connection: every REPORT_FRAMES frames, as delimited by endFrame(), and
+// when the connection is closed, a summary is appended to a dump file or
+// written to the log.
+//
+class ProfilingStream : public IOStream {
+public:
+    enum { REPORT_FRAMES = 100 };
+
+    // 'output' is the path of the dump file, or "log" for the log
+    ProfilingStream(IOStream *stream, size_t bufSize, const char *output);
+    ~ProfilingStream();
+
+    virtual void *allocBuffer(size_t minSize);
+    virtual int commitBuffer(size_t size);
+    virtual const unsigned char *readFully(void *buf, size_t len);
+    virtual const unsigned char *read(void *buf, size_t *inout_len);
+    virtual int writeFully(const void *buf, size_t len);
+
+    // Called by eglSwapBuffers() once the frame has been sent
+    void endFrame();
+    // The summaries include the statistics of 'arena'
+    void setScratchArena(const ScratchArena *arena) { m_scratch = arena; }
+
+    // Where a new connection should send its summaries: $EMUGL_PROFILE if
+    // set, otherwise the debug.egl.profile property, i.e. "log" or the path
+    // of a dump file. Returns false if it is not profiled.
+    static bool getOutput(char *output, size_t size);
+
+private:
+    struct OpStats {
+        uint64_t calls;
+        uint64_t bytes;
+        uint64_t readbacks;
+        uint64_t readbackNs;    // time waiting for the replies
+    };
+
+    // Counts the packets which 'len' bytes sent to the host start
+    void parse(const unsigned char *buf, size_t len);
+    OpStats *opStats(uint32_t opcode);
+    void countReadback(uint64_t startNs);
+    void report();
+    void reset();
+
+    IOStream *m_stream;
+    unsigned char *m_buf;       // returned by the last allocBuffer()
+    char *m_output;
+    const ScratchArena *m_scratch;
+
+    unsigned char m_header[8];  // of the packet being parsed
+    size_t m_headerSize;
+    size_t m_remaining;         // bytes of the packet still to come
+    OpStats *m_current;         // of the last packet
+
+    OpStats *m_ops;             // by opcode, the last one for unknown ones
+    unsigned int m_frames;
+    uint64_t m_frameBytes;      // of the current frame
+    uint64_t m_frameNs;
+    uint64_t m_maxFrameBytes;   // of the frames reported
+    uint64_t m_maxFrameNs;
+};
+
+#endif
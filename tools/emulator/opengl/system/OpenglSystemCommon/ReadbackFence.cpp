@@ -0,0 +1,66 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "ReadbackFence.h"
+
+ReadbackFence::ReadbackFence() :
+    m_signaled(true),
+    m_ok(false)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_cond, NULL);
+}
+
+ReadbackFence::~ReadbackFence()
+{
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void ReadbackFence::reset()
+{
+    pthread_mutex_lock(&m_lock);
+    m_signaled = false;
+    m_ok = false;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void ReadbackFence::signal(bool ok)
+{
+    pthread_mutex_lock(&m_lock);
+    m_signaled = true;
+    m_ok = ok;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool ReadbackFence::isSignaled()
+{
+    pthread_mutex_lock(&m_lock);
+    bool signaled = m_signaled;
+    pthread_mutex_unlock(&m_lock);
+    return signaled;
+}
+
+bool ReadbackFence::wait()
+{
+    pthread_mutex_lock(&m_lock);
+    while (!m_signaled) {
+        pthread_cond_wait(&m_cond, &m_lock);
+    }
+    bool ok = m_ok;
+    pthread_mutex_unlock(&m_lock);
+    return ok;
+}
@@ -0,0 +1,48 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __READBACK_FENCE_H
+#define __READBACK_FENCE_H
+
+#include <pthread.h>
+
+//
+// Signaled when a readback which completes in the background, see
+// StagingStream::readNextAsync(), has written its data to the buffer of the
+// caller.
+//
+class ReadbackFence {
+public:
+    ReadbackFence();
+    ~ReadbackFence();
+
+    // Makes the fence wait for a new readback
+    void reset();
+    // Called once the readback is complete, 'ok' being false if it failed
+    void signal(bool ok);
+
+    bool isSignaled();
+    // Waits until the fence is signaled, and returns whether the readback
+    // succeeded
+    bool wait();
+
+private:
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_cond;
+    bool m_signaled;
+    bool m_ok;
+};
+
+#endif
@@ -0,0 +1,377 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "StagingStream.h"
+#include <stdlib.h>
+#include <string.h>
+
+StagingStream::StagingStream(IOStream *stream, size_t bufSize, size_t stagingSize) :
+    IOStream(bufSize),
+    m_stream(stream),
+    m_buf(NULL),
+    m_bufsize(bufSize),
+    m_ring(NULL),
+    m_ringSize(stagingSize),
+    m_head(0),
+    m_first(0),
+    m_count(0),
+    m_queuedChunks(0),
+    m_sentChunks(0),
+    m_nextFence(NULL),
+    m_firstReadback(0),
+    m_readbackCount(0),
+    m_error(false),
+    m_exit(false),
+    m_threadStarted(false),
+    m_receiverStarted(false)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_queueCond, NULL);
+    pthread_cond_init(&m_sentCond, NULL);
+    pthread_cond_init(&m_readbackCond, NULL);
+}
+
+StagingStream::~StagingStream()
+{
+    pthread_mutex_lock(&m_lock);
+    drainLocked();
+    waitReadbacksLocked();
+    m_exit = true;
+    pthread_cond_signal(&m_queueCond);
+    pthread_cond_broadcast(&m_readbackCond);
+    pthread_mutex_unlock(&m_lock);
+
+    if (m_threadStarted) {
+        pthread_join(m_thread, NULL);
+    }
+    if (m_receiverStarted) {
+        pthread_join(m_receiver, NULL);
+    }
+    pthread_cond_destroy(&m_readbackCond);
+    pthread_cond_destroy(&m_sentCond);
+    pthread_cond_destroy(&m_queueCond);
+    pthread_mutex_destroy(&m_lock);
+
+    free(m_ring);
+    free(m_buf);
+    delete m_stream;
+}
+
+void *StagingStream::allocBuffer(size_t minSize)
+{
+    size_t allocSize = (m_bufsize < minSize ? minSize : m_bufsize);
+    if (!m_buf) {
+        m_buf = (unsigned char *)malloc(allocSize);
+    }
+    else if (m_bufsize < allocSize) {
+        unsigned char *p = (unsigned char *)realloc(m_buf, allocSize);
+        if (p != NULL) {
+            m_buf = p;
+            m_bufsize = allocSize;
+        } else {
+            ERR("realloc (%d) failed\n", allocSize);
+            free(m_buf);
+            m_buf = NULL;
+            m_bufsize = 0;
+        }
+    }
+
+    return m_buf;
+}
+
+int StagingStream::commitBuffer(size_t size)
+{
+    return writeFully(m_buf, size);
+}
+
+int StagingStream::writeFully(const void *buf, size_t len)
+{
+    struct iovec iov = { (void *)buf, len };
+    return write(&iov, 1, len >= STAGING_THRESHOLD);
+}
+
+int StagingStream::writeFullyv(const struct iovec *iov, int iovcnt)
+{
+    return write(iov, iovcnt, true);
+}
+
+int StagingStream::write(const struct iovec *iov, int iovcnt, bool stage)
+{
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    if (m_error) {
+        pthread_mutex_unlock(&m_lock);
+        return -1;
+    }
+
+    // Large writes are staged, and the others too while staged data is
+    // pending, to keep them in order
+    size_t offset;
+    if ((stage || m_count > 0) && reserveLocked(len, &offset)) {
+        // only this thread writes to the reserved space: copy it unlocked
+        pthread_mutex_unlock(&m_lock);
+        for (int i = 0; i < iovcnt; i++) {
+            memcpy(m_ring + offset, iov[i].iov_base, iov[i].iov_len);
+            offset += iov[i].iov_len;
+        }
+        pthread_mutex_lock(&m_lock);
+
+        Chunk *chunk = &m_chunks[(m_first + m_count) % MAX_CHUNKS];
+        chunk->offset = offset - len;
+        chunk->size = len;
+        m_count++;
+        m_queuedChunks++;
+        m_stats.stagedWrites++;
+        m_stats.stagedBytes += len;
+        pthread_cond_signal(&m_queueCond);
+        pthread_mutex_unlock(&m_lock);
+        return 0;
+    }
+
+    // Too large for the ring, or no staging: send it after the pending data
+    drainLocked();
+    bool error = m_error;
+    m_stats.directWrites++;
+    pthread_mutex_unlock(&m_lock);
+
+    for (int i = 0; i < iovcnt && !error; i++) {
+        error = m_stream->writeFully(iov[i].iov_base, iov[i].iov_len) < 0;
+    }
+    return error ? -1 : 0;
+}
+
+const unsigned char *StagingStream::readFully(void *buf, size_t len)
+{
+    ReadbackFence *fence = m_nextFence;
+    m_nextFence = NULL;
+
+    pthread_mutex_lock(&m_lock);
+    if (fence) {
+        bool queued = queueReadbackLocked(buf, len, fence);
+        pthread_mutex_unlock(&m_lock);
+        if (!queued) {
+            fence->signal(false);
+            return NULL;
+        }
+        return (const unsigned char *)buf;
+    }
+
+    drainLocked();
+    waitReadbacksLocked();
+    bool error = m_error;
+    pthread_mutex_unlock(&m_lock);
+
+    return error ? NULL : m_stream->readFully(buf, len);
+}
+
+const unsigned char *StagingStream::read(void *buf, size_t *inout_len)
+{
+    pthread_mutex_lock(&m_lock);
+    drainLocked();
+    waitReadbacksLocked();
+    bool error = m_error;
+    pthread_mutex_unlock(&m_lock);
+
+    return error ? NULL : m_stream->read(buf, inout_len);
+}
+
+bool StagingStream::reserveLocked(size_t len, size_t *offset)
+{
+    if (len > m_ringSize) {
+        return false;
+    }
+    if (!m_ring) {
+        m_ring = (unsigned char *)malloc(m_ringSize);
+        if (!m_ring) {
+            ERR("StagingStream: could not allocate %d bytes\n", m_ringSize);
+            m_ringSize = 0;
+            return false;
+        }
+    }
+    if (!m_threadStarted) {
+        if (pthread_create(&m_thread, NULL, s_sendLoop, this) != 0) {
+            ERR("StagingStream: could not start the sender thread\n");
+            free(m_ring);
+            m_ring = NULL;
+            m_ringSize = 0;
+            return false;
+        }
+        m_threadStarted = true;
+    }
+
+    // Wait until the sender has made room
+    while (!m_error) {
+        if (m_count == 0) {
+            *offset = 0;
+            m_head = len;
+            return true;
+        }
+        if (m_count < MAX_CHUNKS) {
+            // the pending chunks span [tail, m_head), wrapping at the end
+            size_t tail = m_chunks[m_first].offset;
+            if (m_head > tail) {
+                if (m_ringSize - m_head >= len) {
+                    *offset = m_head;
+                    m_head += len;
+                    return true;
+                }
+                if (tail >= len) {
+                    *offset = 0;
+                    m_head = len;
+                    return true;
+                }
+            } else if (tail - m_head >= len) {
+                *offset = m_head;
+                m_head += len;
+                return true;
+            }
+        }
+        m_stats.waits++;
+        pthread_cond_wait(&m_sentCond, &m_lock);
+    }
+    return false;
+}
+
+void StagingStream::drainLocked()
+{
+    while (m_count > 0) {
+        m_stats.waits++;
+        pthread_cond_wait(&m_sentCond, &m_lock);
+    }
+}
+
+bool StagingStream::queueReadbackLocked(void *buf, size_t len, ReadbackFence *fence)
+{
+    if (!m_receiverStarted) {
+        if (pthread_create(&m_receiver, NULL, s_receiveLoop, this) != 0) {
+            ERR("StagingStream: could not start the receiver thread\n");
+            return false;
+        }
+        m_receiverStarted = true;
+    }
+
+    while (m_readbackCount == MAX_READBACKS && !m_error) {
+        m_stats.waits++;
+        pthread_cond_wait(&m_readbackCond, &m_lock);
+    }
+    if (m_error) {
+        return false;
+    }
+
+    Readback *readback = &m_readbacks[(m_firstReadback + m_readbackCount) % MAX_READBACKS];
+    readback->buf = buf;
+    readback->len = len;
+    readback->fence = fence;
+    readback->chunks = m_queuedChunks;
+    m_readbackCount++;
+    m_stats.asyncReadbacks++;
+    pthread_cond_broadcast(&m_readbackCond);
+    return true;
+}
+
+void StagingStream::waitReadbacksLocked()
+{
+    while (m_readbackCount > 0) {
+        m_stats.waits++;
+        pthread_cond_wait(&m_readbackCond, &m_lock);
+    }
+}
+
+void *StagingStream::s_sendLoop(void *self)
+{
+    ((StagingStream *)self)->sendLoop();
+    return NULL;
+}
+
+void StagingStream::sendLoop()
+{
+    pthread_mutex_lock(&m_lock);
+    for (;;) {
+        while (m_count == 0 && !m_exit) {
+            pthread_cond_wait(&m_queueCond, &m_lock);
+        }
+        if (m_count == 0) {
+            break;
+        }
+
+        // The chunk stays queued, and its space reserved, until it is sent
+        Chunk chunk = m_chunks[m_first];
+        bool error = m_error;
+        pthread_mutex_unlock(&m_lock);
+        int stat = error ? -1 : m_stream->writeFully(m_ring + chunk.offset, chunk.size);
+        pthread_mutex_lock(&m_lock);
+
+        if (stat < 0 && !m_error) {
+            ERR("StagingStream: failed to send %d bytes\n", chunk.size);
+            m_error = true;
+        }
+        m_first = (m_first + 1) % MAX_CHUNKS;
+        m_count--;
+        m_sentChunks++;
+        pthread_cond_broadcast(&m_sentCond);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void *StagingStream::s_receiveLoop(void *self)
+{
+    ((StagingStream *)self)->receiveLoop();
+    return NULL;
+}
+
+void StagingStream::receiveLoop()
+{
+    pthread_mutex_lock(&m_lock);
+    for (;;) {
+        while (m_readbackCount == 0 && !m_exit) {
+            pthread_cond_wait(&m_readbackCond, &m_lock);
+        }
+        if (m_readbackCount == 0) {
+            break;
+        }
+
+        // The host replies once it has received the request
+        Readback readback = m_readbacks[m_firstReadback];
+        while (m_sentChunks < readback.chunks && !m_error) {
+            pthread_cond_wait(&m_sentCond, &m_lock);
+        }
+        bool error = m_error;
+        pthread_mutex_unlock(&m_lock);
+        bool ok = !error && m_stream->readFully(readback.buf, readback.len) != NULL;
+        pthread_mutex_lock(&m_lock);
+
+        if (!ok && !m_error) {
+            ERR("StagingStream: failed to read %d bytes\n", readback.len);
+            m_error = true;
+            pthread_cond_broadcast(&m_sentCond);
+        }
+        m_firstReadback = (m_firstReadback + 1) % MAX_READBACKS;
+        m_readbackCount--;
+        pthread_cond_broadcast(&m_readbackCond);
+
+        pthread_mutex_unlock(&m_lock);
+        readback.fence->signal(ok);
+        pthread_mutex_lock(&m_lock);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
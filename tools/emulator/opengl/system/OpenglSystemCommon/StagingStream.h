@@ -0,0 +1,138 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __STAGING_STREAM_H
+#define __STAGING_STREAM_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "IOStream.h"
+#include "ReadbackFence.h"
+
+//
+// A stream which sends the large writes to the host in the background.
+//
+// The data of a write of at least STAGING_THRESHOLD bytes, e.g. the pixels
+// of glTexImage2D(), is copied to a staging ring and the call returns: a
+// sender thread writes it to the underlying stream. Whatever is written
+// while staged data is pending is queued behind it, so that the host
+// receives everything in order, and a readback waits until the queue has
+// been sent.
+//
+// When nothing is pending, writes go straight to the underlying stream,
+// which the staging stream owns.
+//
+// A readback can complete in the background as well: a receiver thread
+// reads the data into the buffer of the caller, and signals a fence.
+//
+class StagingStream : public IOStream {
+public:
+    enum {
+        STAGING_THRESHOLD = 64 * 1024,
+        DEFAULT_STAGING_SIZE = 16 * 1024 * 1024,
+    };
+
+    StagingStream(IOStream *stream, size_t bufSize,
+                  size_t stagingSize = DEFAULT_STAGING_SIZE);
+    ~StagingStream();
+
+    virtual void *allocBuffer(size_t minSize);
+    virtual int commitBuffer(size_t size);
+    virtual const unsigned char *readFully(void *buf, size_t len);
+    virtual const unsigned char *read(void *buf, size_t *inout_len);
+    virtual int writeFully(const void *buf, size_t len);
+    // Sends 'iovcnt' buffers as a single staged write, whatever their size
+    int writeFullyv(const struct iovec *iov, int iovcnt);
+
+    // Makes the next readback, e.g. the one of rcReadColorBuffer(), return
+    // at once: its data is read into the buffer of the caller, which must
+    // remain valid until 'fence' is signaled. The readbacks made meanwhile
+    // wait for it, the writes do not.
+    void readNextAsync(ReadbackFence *fence) { m_nextFence = fence; }
+
+    struct Stats {
+        uint64_t stagedWrites;  // writes copied to the staging ring
+        uint64_t stagedBytes;
+        uint64_t directWrites;  // writes sent from the caller's thread
+        uint64_t waits;         // times the caller waited for the sender
+        uint64_t asyncReadbacks;
+    };
+    const Stats &stats() const { return m_stats; }
+
+private:
+    enum { MAX_CHUNKS = 64, MAX_READBACKS = 16 };
+
+    struct Chunk {
+        size_t offset;
+        size_t size;
+    };
+
+    struct Readback {
+        void *buf;
+        size_t len;
+        ReadbackFence *fence;
+        uint64_t chunks;        // chunks to send before the reply can come
+    };
+
+    // Writes the buffers, staging them if 'stage' or if data are pending
+    int write(const struct iovec *iov, int iovcnt, bool stage);
+    // Reserves 'len' contiguous bytes of the ring, waiting for the sender
+    // to free them. Fails if the ring is too small or the sender failed.
+    bool reserveLocked(size_t len, size_t *offset);
+    // Waits until the sender has written every queued chunk
+    void drainLocked();
+    // Queues a readback for the receiver, starting it if needed
+    bool queueReadbackLocked(void *buf, size_t len, ReadbackFence *fence);
+    // Waits until the receiver has read every pending readback
+    void waitReadbacksLocked();
+    void sendLoop();
+    static void *s_sendLoop(void *self);
+    void receiveLoop();
+    static void *s_receiveLoop(void *self);
+
+    IOStream *m_stream;
+    unsigned char *m_buf;
+    size_t m_bufsize;
+
+    unsigned char *m_ring;      // allocated at the first staged write
+    size_t m_ringSize;
+    size_t m_head;              // where the next chunk goes
+    Chunk m_chunks[MAX_CHUNKS]; // chunks not sent yet, the first one being sent
+    size_t m_first;
+    size_t m_count;
+    uint64_t m_queuedChunks;
+    uint64_t m_sentChunks;
+
+    ReadbackFence *m_nextFence;
+    Readback m_readbacks[MAX_READBACKS];    // the first one being read
+    size_t m_firstReadback;
+    size_t m_readbackCount;
+
+    bool m_error;               // the stream failed
+    bool m_exit;
+    Stats m_stats;
+
+    pthread_t m_thread;
+    bool m_threadStarted;
+    pthread_t m_receiver;
+    bool m_receiverStarted;
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_queueCond;     // signaled when a chunk is queued
+    pthread_cond_t m_sentCond;      // signaled when a chunk has been sent
+    pthread_cond_t m_readbackCond;  // signaled when a readback is queued or read
+};
+
+#endif
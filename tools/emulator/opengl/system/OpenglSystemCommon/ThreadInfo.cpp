@@ -18,10 +18,17 @@
 
 thread_store_t s_tls = THREAD_STORE_INITIALIZER;
 
+#ifndef HAVE_ANDROID_OS
+__thread EGLThreadInfo *s_threadInfo = NULL;
+#endif
+
 static void tlsDestruct(void *ptr)
 {
     if (ptr) {
         EGLThreadInfo *ti = (EGLThreadInfo *)ptr;
+#ifndef HAVE_ANDROID_OS
+        s_threadInfo = NULL;
+#endif
         delete ti->hostConn;
         delete ti;
     }
@@ -30,10 +37,13 @@ static void tlsDestruct(void *ptr)
 EGLThreadInfo *slow_getEGLThreadInfo()
 {
     EGLThreadInfo *ti = (EGLThreadInfo *)thread_store_get(&s_tls);
-    if (ti) return ti;
-
-    ti = new EGLThreadInfo();
-    thread_store_set(&s_tls, ti, tlsDestruct);
+    if (!ti) {
+        ti = new EGLThreadInfo();
+        thread_store_set(&s_tls, ti, tlsDestruct);
+    }
 
+#ifndef HAVE_ANDROID_OS
+    s_threadInfo = ti;
+#endif
     return ti;
 }
@@ -23,14 +23,33 @@
 #endif
 
 struct EGLContext_t;
+class CommandList;
 
 struct EGLThreadInfo
 {
-    EGLThreadInfo() : currentContext(NULL), hostConn(NULL), eglError(EGL_SUCCESS) {}
+    EGLThreadInfo() : currentContext(NULL), hostConn(NULL), eglError(EGL_SUCCESS),
+                      hostContext(0), hostDrawSurface(0), hostReadSurface(0),
+                      makeCurrentCalls(0), makeCurrentElided(0),
+                      commandList(NULL) {}
 
     EGLContext_t *currentContext;
     HostConnection *hostConn;
     int           eglError;
+
+    // The binding of the thread's host connection, as last sent with
+    // rcMakeCurrent(): eglMakeCurrent() skips the round-trip when it is
+    // unchanged.
+    uint32_t      hostContext;
+    uint32_t      hostDrawSurface;
+    uint32_t      hostReadSurface;
+
+    // eglMakeCurrent() calls, and those which did not need the host
+    unsigned int  makeCurrentCalls;
+    unsigned int  makeCurrentElided;
+
+    // The list recording the GL calls of the thread, see
+    // eglBeginCommandListEMU()
+    CommandList  *commandList;
 };
 
 
@@ -48,8 +67,17 @@ EGLThreadInfo *slow_getEGLThreadInfo();
         return tInfo;
     }
 #else
+    // Off-Android, the thread store is only kept to destroy the info when
+    // the thread exits: every GL call goes through here, so the info is
+    // cached in a compiler-managed TLS variable.
+    extern __thread EGLThreadInfo *s_threadInfo;
+
     inline EGLThreadInfo* getEGLThreadInfo() {
-        return slow_getEGLThreadInfo();
+        EGLThreadInfo *tInfo = s_threadInfo;
+        if (!tInfo) {
+            tInfo = slow_getEGLThreadInfo();
+        }
+        return tInfo;
     }
 #endif
 
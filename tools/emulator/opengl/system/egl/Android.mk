@@ -39,3 +39,22 @@ include $(BUILD_PREBUILT)
 endif # TARGET_PRODUCT in 'full full_x86 full_mips sdk sdk_x86 sdk_mips google_sdk google_sdk_x86 google_sdk_mips')
 
 endif # BUILD_EMULATOR_OPENGL_DRIVER != false
+
+#### libEGL_emulation, host ####
+ifeq (true,$(EMUGL_BUILD_HOST_LIBS))
+LOCAL_PATH := $(call my-dir)
+
+$(call emugl-begin-host-shared-library,libEGL_emulation)
+$(call emugl-import,libOpenglSystemCommon)
+
+LOCAL_CFLAGS += -DLOG_TAG=\"EGL_emulation\" -DEGL_EGLEXT_PROTOTYPES -DWITH_GLES2
+
+LOCAL_SRC_FILES := \
+    eglDisplay.cpp \
+    egl.cpp \
+    ClientAPIExts.cpp
+
+$(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
+
+$(call emugl-end-module)
+endif # EMUGL_BUILD_HOST_LIBS == true
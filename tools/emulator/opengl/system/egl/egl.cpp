@@ -17,9 +17,12 @@
 #include "HostConnection.h"
 #include "ThreadInfo.h"
 #include "eglDisplay.h"
+#include "EGLCommandList.h"
 #include "egl_ftable.h"
 #include <cutils/log.h>
 #include "gralloc_cb.h"
+#include "ColorBufferPrefetch.h"
+#include "CommandList.h"
 #include "GLClientState.h"
 #include "GLSharedGroup.h"
 #include "eglContext.h"
@@ -86,7 +89,7 @@ const char *  eglStrError(EGLint err)
 #endif //LOG_EGL_ERRORS
 
 #define VALIDATE_CONFIG(cfg,ret) \
-    if(((int)cfg<0)||((int)cfg>s_display.getNumConfigs())) { \
+    if(((int)cfg<0)||((int)cfg>=s_display.getNumConfigs())) { \
         RETURN_ERROR(ret,EGL_BAD_CONFIG); \
     }
 
@@ -315,14 +318,27 @@ EGLBoolean egl_window_surface_t::swapBuffers()
 
     rcEnc->rcFlushWindowColorBuffer(rcEnc, rcSurface);
 
+    // a buffer for frequent software reads will be locked by its consumer
+    // soon: start reading it back while the application goes on
+    cb_handle_t *cb = (cb_handle_t *)buffer->handle;
+    if (cb->usage & GRALLOC_USAGE_SW_READ_OFTEN) {
+        prefetchColorBuffer(cb);
+    }
+
     nativeWindow->queueBuffer_DEPRECATED(nativeWindow, buffer);
     if (nativeWindow->dequeueBuffer_DEPRECATED(nativeWindow, &buffer)) {
         buffer = NULL;
         setErrorReturn(EGL_BAD_ALLOC, EGL_FALSE);
     }
 
-    rcEnc->rcSetWindowColorBuffer(rcEnc, rcSurface,
-            ((cb_handle_t *)(buffer->handle))->hostHandle);
+    // the buffer will be rendered again: a read ahead of its previous frame
+    // is stale
+    cb_handle_t *next = (cb_handle_t *)buffer->handle;
+    if (next->usage & GRALLOC_USAGE_SW_READ_OFTEN) {
+        cancelColorBufferPrefetch(next);
+    }
+
+    rcEnc->rcSetWindowColorBuffer(rcEnc, rcSurface, next->hostHandle);
 
     return EGL_TRUE;
 }
@@ -575,18 +591,15 @@ EGLBoolean eglChooseConfig(EGLDisplay dpy, const EGLint *attrib_list, EGLConfig
 {
     VALIDATE_DISPLAY_INIT(dpy, EGL_FALSE);
 
-    int attribs_size = 0;
-    if (attrib_list) {
-        const EGLint * attrib_p = attrib_list;
-        while (attrib_p[0] != EGL_NONE) {
-            attribs_size += 2;
-            attrib_p += 2;
-        }
-        attribs_size++; //for the terminating EGL_NONE
+    if (!num_config) {
+        RETURN_ERROR(EGL_FALSE, EGL_BAD_PARAMETER);
     }
 
-    DEFINE_AND_VALIDATE_HOST_CONNECTION(EGL_FALSE);
-    *num_config = rcEnc->rcChooseConfig(rcEnc, (EGLint*)attrib_list, attribs_size * sizeof(EGLint), (uint32_t*)configs, config_size);
+    // The configs are matched and sorted from the table downloaded by
+    // eglInitialize(), without asking the host.
+    if (!s_display.chooseConfig(attrib_list, configs, config_size, num_config)) {
+        RETURN_ERROR(EGL_FALSE, EGL_BAD_ATTRIBUTE);
+    }
 
     return EGL_TRUE;
 }
@@ -650,7 +663,7 @@ EGLSurface eglCreatePbufferSurface(EGLDisplay dpy, EGLConfig config, const EGLin
     int32_t h = 0;
     EGLint texFormat = EGL_NO_TEXTURE;
     EGLint texTarget = EGL_NO_TEXTURE;
-    while (attrib_list[0]) {
+    while (attrib_list && attrib_list[0] != EGL_NONE) {
         switch (attrib_list[0]) {
             case EGL_WIDTH:
                 w = attrib_list[1];
@@ -858,7 +871,7 @@ EGLContext eglCreateContext(EGLDisplay dpy, EGLConfig config, EGLContext share_c
     VALIDATE_CONFIG(config, EGL_NO_CONTEXT);
 
     EGLint version = 1; //default
-    while (attrib_list && attrib_list[0]) {
+    while (attrib_list && attrib_list[0] != EGL_NONE) {
         if (attrib_list[0] == EGL_CONTEXT_CLIENT_VERSION) version = attrib_list[1];
         attrib_list+=2;
     }
@@ -931,12 +944,17 @@ EGLBoolean eglMakeCurrent(EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLC
     uint32_t readHandle = (readSurf) ? readSurf->getRcSurface() : 0;
 
     //
-    // Nothing to do if no binding change has made
+    // Nothing to do if no binding change has made: the host binding of
+    // the thread is compared, since surfaces and contexts may be destroyed
+    // and new ones created at the same address.
     //
     EGLThreadInfo *tInfo = getEGLThreadInfo();
+    tInfo->makeCurrentCalls++;
     if (tInfo->currentContext == context &&
-        (context == NULL ||
-        (context && context->draw == draw && context->read == read))) {
+        tInfo->hostContext == ctxHandle &&
+        tInfo->hostDrawSurface == drawHandle &&
+        tInfo->hostReadSurface == readHandle) {
+        tInfo->makeCurrentElided++;
         return EGL_TRUE;
     }
 
@@ -950,11 +968,22 @@ EGLBoolean eglMakeCurrent(EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLC
         ALOGE("rcMakeCurrent returned EGL_FALSE");
         setErrorReturn(EGL_BAD_CONTEXT, EGL_FALSE);
     }
+    tInfo->hostContext = ctxHandle;
+    tInfo->hostDrawSurface = drawHandle;
+    tInfo->hostReadSurface = readHandle;
 
-    //Now make the local bind
     if (context) {
         context->draw = draw;
         context->read = read;
+    }
+
+    //Only the surfaces changed: the encoder state stays bound
+    if (tInfo->currentContext == context) {
+        return EGL_TRUE;
+    }
+
+    //Now make the local bind
+    if (context) {
         context->flags |= EGLContext_t::IS_CURRENT;
         //set the client state
         if (context->version == 2) {
@@ -1107,6 +1136,10 @@ EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface eglSurface)
     d->swapBuffers();
 
     hostCon->flush();
+    hostCon->endFrame();
+
+    // programs are linked while loading: save them once the frames start
+    HostConnection::saveProgramCache();
     return EGL_TRUE;
 }
 
@@ -1252,3 +1285,178 @@ EGLBoolean eglGetSyncAttribKHR(EGLDisplay dpy, EGLSyncKHR sync,
         setErrorReturn(EGL_BAD_ATTRIBUTE, EGL_FALSE);
     }
 }
+
+// A command list of EGL_EMU_command_list, see EGLCommandList.h
+struct EGLCommandList_t : public CommandList {
+    EGLCommandList_t() : user(NULL) {}
+    // the thread recording, submitting, resetting or destroying the list
+    EGLThreadInfo *user;
+};
+
+// Command lists sent by a single HostConnection::submit()
+#define SUBMIT_BATCH_SIZE 64
+
+// Guards the users of the command lists
+static pthread_mutex_t s_commandListLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Makes the thread the user of the list, returns false if it is in use
+static bool acquireCommandList(EGLCommandList_t *list, EGLThreadInfo *tInfo)
+{
+    pthread_mutex_lock(&s_commandListLock);
+    bool idle = (list->user == NULL);
+    if (idle) {
+        list->user = tInfo;
+    }
+    pthread_mutex_unlock(&s_commandListLock);
+    return idle;
+}
+
+static void releaseCommandList(EGLCommandList_t *list)
+{
+    pthread_mutex_lock(&s_commandListLock);
+    list->user = NULL;
+    pthread_mutex_unlock(&s_commandListLock);
+}
+
+EGLCommandListEMU eglCreateCommandListEMU(EGLDisplay dpy, const EGLint *attrib_list)
+{
+    VALIDATE_DISPLAY_INIT(dpy, EGL_NO_COMMAND_LIST_EMU);
+
+    if (attrib_list != NULL && attrib_list[0] != EGL_NONE) {
+        setErrorReturn(EGL_BAD_ATTRIBUTE, EGL_NO_COMMAND_LIST_EMU);
+    }
+    EGLThreadInfo *tInfo = getEGLThreadInfo();
+    if (!tInfo || !tInfo->currentContext) {
+        setErrorReturn(EGL_BAD_MATCH, EGL_NO_COMMAND_LIST_EMU);
+    }
+
+    // the list uses the programs of the share group of the context
+    EGLCommandList_t *cl = new EGLCommandList_t();
+    cl->setSharedGroup(tInfo->currentContext->getSharedGroup());
+    return (EGLCommandListEMU)cl;
+}
+
+EGLBoolean eglDestroyCommandListEMU(EGLDisplay dpy, EGLCommandListEMU list)
+{
+    VALIDATE_DISPLAY_INIT(dpy, EGL_FALSE);
+
+    EGLCommandList_t *cl = (EGLCommandList_t *)list;
+    if (!cl) {
+        setErrorReturn(EGL_BAD_PARAMETER, EGL_FALSE);
+    }
+    if (!acquireCommandList(cl, getEGLThreadInfo())) {
+        setErrorReturn(EGL_BAD_ACCESS, EGL_FALSE);
+    }
+    delete cl;
+    return EGL_TRUE;
+}
+
+EGLBoolean eglBeginCommandListEMU(EGLDisplay dpy, EGLCommandListEMU list)
+{
+    VALIDATE_DISPLAY_INIT(dpy, EGL_FALSE);
+
+    EGLCommandList_t *cl = (EGLCommandList_t *)list;
+    if (!cl) {
+        setErrorReturn(EGL_BAD_PARAMETER, EGL_FALSE);
+    }
+    EGLThreadInfo *tInfo = getEGLThreadInfo();
+    if (tInfo->commandList || !acquireCommandList(cl, tInfo)) {
+        setErrorReturn(EGL_BAD_ACCESS, EGL_FALSE);
+    }
+
+    // the GL calls of the thread now go to the list
+    tInfo->commandList = cl;
+    return EGL_TRUE;
+}
+
+EGLBoolean eglEndCommandListEMU(EGLDisplay dpy)
+{
+    VALIDATE_DISPLAY_INIT(dpy, EGL_FALSE);
+
+    EGLThreadInfo *tInfo = getEGLThreadInfo();
+    EGLCommandList_t *cl = static_cast<EGLCommandList_t *>(tInfo->commandList);
+    if (!cl) {
+        setErrorReturn(EGL_BAD_ACCESS, EGL_FALSE);
+    }
+
+    cl->flush();
+    tInfo->commandList = NULL;
+    releaseCommandList(cl);
+    return EGL_TRUE;
+}
+
+EGLBoolean eglSubmitCommandListsEMU(EGLDisplay dpy, EGLint count, const EGLCommandListEMU *lists)
+{
+    VALIDATE_DISPLAY_INIT(dpy, EGL_FALSE);
+
+    if (count < 0 || (count > 0 && !lists)) {
+        setErrorReturn(EGL_BAD_PARAMETER, EGL_FALSE);
+    }
+    EGLThreadInfo *tInfo = getEGLThreadInfo();
+    if (!tInfo || !tInfo->currentContext) {
+        setErrorReturn(EGL_BAD_MATCH, EGL_FALSE);
+    }
+    HostConnection *hostCon = HostConnection::get();
+    if (!hostCon) {
+        setErrorReturn(EGL_BAD_ALLOC, EGL_FALSE);
+    }
+
+    // all or nothing: check the lists before sending any of them, and keep
+    // the other threads from changing them until they are sent
+    GLSharedGroup *shared = tInfo->currentContext->getSharedGroup().Ptr();
+    EGLint error = EGL_SUCCESS;
+    pthread_mutex_lock(&s_commandListLock);
+    for (EGLint i = 0; i < count && error == EGL_SUCCESS; i++) {
+        EGLCommandList_t *cl = (EGLCommandList_t *)lists[i];
+        if (!cl) {
+            error = EGL_BAD_PARAMETER;
+        } else if (cl->user) {
+            error = EGL_BAD_ACCESS;
+        } else if (cl->sharedGroup().Ptr() != shared) {
+            error = EGL_BAD_MATCH;
+        }
+    }
+    if (error == EGL_SUCCESS) {
+        for (EGLint i = 0; i < count; i++) {
+            ((EGLCommandList_t *)lists[i])->user = tInfo;
+        }
+    }
+    pthread_mutex_unlock(&s_commandListLock);
+    if (error != EGL_SUCCESS) {
+        setErrorReturn(error, EGL_FALSE);
+    }
+
+    CommandList *batch[SUBMIT_BATCH_SIZE];
+    bool ok = true;
+    for (EGLint i = 0; i < count; ) {
+        int n = 0;
+        while (i < count && n < SUBMIT_BATCH_SIZE) {
+            batch[n++] = (EGLCommandList_t *)lists[i++];
+        }
+        ok = hostCon->submit(batch, n) && ok;
+    }
+    for (EGLint i = 0; i < count; i++) {
+        releaseCommandList((EGLCommandList_t *)lists[i]);
+    }
+    if (!ok) {
+        // a list missed commands, or the host connection failed
+        setErrorReturn(EGL_BAD_ALLOC, EGL_FALSE);
+    }
+    return EGL_TRUE;
+}
+
+EGLBoolean eglResetCommandListEMU(EGLDisplay dpy, EGLCommandListEMU list)
+{
+    VALIDATE_DISPLAY_INIT(dpy, EGL_FALSE);
+
+    EGLCommandList_t *cl = (EGLCommandList_t *)list;
+    if (!cl) {
+        setErrorReturn(EGL_BAD_PARAMETER, EGL_FALSE);
+    }
+    if (!acquireCommandList(cl, getEGLThreadInfo())) {
+        setErrorReturn(EGL_BAD_ACCESS, EGL_FALSE);
+    }
+    cl->reset();
+    releaseCommandList(cl);
+    return EGL_TRUE;
+}
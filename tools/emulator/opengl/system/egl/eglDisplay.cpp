@@ -25,7 +25,8 @@ static const char systemEGLVendor[] = "Google Android emulator";
 //  NOTE that each extension name should be suffixed with space
 static const char systemStaticEGLExtensions[] =
             "EGL_ANDROID_image_native_buffer "
-            "EGL_KHR_fence_sync ";
+            "EGL_KHR_fence_sync "
+            "EGL_EMU_command_list ";
 
 // list of extensions supported by this EGL implementation only if supported
 // on the host implementation.
@@ -35,6 +36,16 @@ static const char systemDynamicEGLExtensions[] =
             "EGL_KHR_gl_texture_2d_image ";
 
 
+// The GLES client libraries loaded by eglInitialize(). On the host, they
+// are looked up in the library search path.
+#ifdef HAVE_ANDROID_OS
+static const char s_gles_lib_name[] = "/system/lib/egl/libGLESv1_CM_emulation.so";
+static const char s_gles2_lib_name[] = "/system/lib/egl/libGLESv2_emulation.so";
+#else
+static const char s_gles_lib_name[] = "libGLESv1_CM_emulation.so";
+static const char s_gles2_lib_name[] = "libGLESv2_emulation.so";
+#endif
+
 static void *s_gles_lib = NULL;
 static void *s_gles2_lib = NULL;
 
@@ -60,8 +71,8 @@ eglDisplay::eglDisplay() :
     m_hostRendererVersion(0),
     m_numConfigs(0),
     m_numConfigAttribs(0),
-    m_attribs(DefaultKeyedVector<EGLint, EGLint>(ATTRIBUTE_NONE)),
     m_configs(NULL),
+    m_chooseConfigCacheNext(0),
     m_gles_iface(NULL),
     m_gles2_iface(NULL),
     m_versionString(NULL),
@@ -69,10 +80,15 @@ eglDisplay::eglDisplay() :
     m_extensionString(NULL)
 {
     pthread_mutex_init(&m_lock, NULL);
+    for (int i=0; i<CONFIG_ATTRIB_LAST-CONFIG_ATTRIB_FIRST+1; i++) {
+        m_attribIndex[i] = ATTRIBUTE_NONE;
+    }
+    memset(m_chooseConfigCache, 0, sizeof(m_chooseConfigCache));
 }
 
 eglDisplay::~eglDisplay()
 {
+    clearChooseConfigCache();
     pthread_mutex_destroy(&m_lock);
 }
 
@@ -84,7 +100,7 @@ bool eglDisplay::initialize(EGLClient_eglInterface *eglIface)
         //
         // load GLES client API
         //
-        m_gles_iface = loadGLESClientAPI("/system/lib/egl/libGLESv1_CM_emulation.so",
+        m_gles_iface = loadGLESClientAPI(s_gles_lib_name,
                                          eglIface,
                                          &s_gles_lib);
         if (!m_gles_iface) {
@@ -94,7 +110,7 @@ bool eglDisplay::initialize(EGLClient_eglInterface *eglIface)
         }
 
 #ifdef WITH_GLES2
-        m_gles2_iface = loadGLESClientAPI("/system/lib/egl/libGLESv2_emulation.so",
+        m_gles2_iface = loadGLESClientAPI(s_gles2_lib_name,
                                           eglIface,
                                           &s_gles2_lib);
         // Note that if loading gles2 failed, we can still run with no
@@ -169,21 +185,28 @@ bool eglDisplay::initialize(EGLClient_eglInterface *eglIface)
             return false;
         }
 
-        //Fill the attributes vector.
+        //Fill the attributes index.
         //The first m_numConfigAttribs values of tmp_buf are the actual attributes enums.
+        for (int i=0; i<CONFIG_ATTRIB_LAST-CONFIG_ATTRIB_FIRST+1; i++) {
+            m_attribIndex[i] = ATTRIBUTE_NONE;
+        }
         for (int i=0; i<m_numConfigAttribs; i++) {
-            m_attribs.add(tmp_buf[i], i);
+            if (tmp_buf[i] >= CONFIG_ATTRIB_FIRST && tmp_buf[i] <= CONFIG_ATTRIB_LAST) {
+                m_attribIndex[tmp_buf[i] - CONFIG_ATTRIB_FIRST] = i;
+            }
         }
 
         //Copy the actual configs data to m_configs
         memcpy(m_configs, tmp_buf + m_numConfigAttribs, m_numConfigs*m_numConfigAttribs*sizeof(EGLint));
 
+        //The table must not change once the display is initialized, since
+        //it is read without the lock.
+        processConfigs();
+
         m_initialized = true;
     }
     pthread_mutex_unlock(&m_lock);
 
-    processConfigs();
-
     return true;
 }
 
@@ -194,7 +217,7 @@ void eglDisplay::processConfigs()
         //Setup the EGL_NATIVE_VISUAL_ID attribute
         PixelFormat format;
         if (getConfigNativePixelFormat(config, &format)) {
-            setConfigAttrib(config, EGL_NATIVE_VISUAL_ID, format);
+            setAttribValue(config, attribIndex(EGL_NATIVE_VISUAL_ID), format);
         }
     }
 }
@@ -206,6 +229,7 @@ void eglDisplay::terminate()
         m_initialized = false;
         delete [] m_configs;
         m_configs = NULL;
+        clearChooseConfigCache();
 
         if (m_versionString) {
             free(m_versionString);
@@ -405,13 +429,31 @@ EGLBoolean eglDisplay::getAttribValue(EGLConfig config, EGLint attribIdx, EGLint
     return EGL_TRUE;
 }
 
+EGLint eglDisplay::attribIndex(EGLint attrib) const
+{
+    if (attrib < CONFIG_ATTRIB_FIRST || attrib > CONFIG_ATTRIB_LAST) {
+        return ATTRIBUTE_NONE;
+    }
+    return m_attribIndex[attrib - CONFIG_ATTRIB_FIRST];
+}
+
+/* Like getAttribValue(), without complaining about the attributes the host
+ * does not report */
+bool eglDisplay::lookupConfigAttrib(int config, EGLint attrib, EGLint *value) const
+{
+    EGLint attribIdx = attribIndex(attrib);
+    if (attribIdx == ATTRIBUTE_NONE) {
+        return false;
+    }
+    *value = m_configs[config*m_numConfigAttribs + attribIdx];
+    return true;
+}
+
 EGLBoolean eglDisplay::getConfigAttrib(EGLConfig config, EGLint attrib, EGLint * value)
 {
-    //Though it seems that valueFor() is thread-safe, we don't take chanses
-    pthread_mutex_lock(&m_lock);
-    EGLBoolean ret = getAttribValue(config, m_attribs.valueFor(attrib), value);
-    pthread_mutex_unlock(&m_lock);
-    return ret;
+    //The configs table and the attributes index do not change after
+    //initialize(): no need to lock.
+    return getAttribValue(config, attribIndex(attrib), value);
 }
 
 void eglDisplay::dumpConfig(EGLConfig config)
@@ -438,24 +480,14 @@ EGLBoolean eglDisplay::setAttribValue(EGLConfig config, EGLint attribIdx, EGLint
     return EGL_TRUE;
 }
 
-EGLBoolean eglDisplay::setConfigAttrib(EGLConfig config, EGLint attrib, EGLint value)
-{
-    //Though it seems that valueFor() is thread-safe, we don't take chanses
-    pthread_mutex_lock(&m_lock);
-    EGLBoolean ret = setAttribValue(config, m_attribs.valueFor(attrib), value);
-    pthread_mutex_unlock(&m_lock);
-    return ret;
-}
-
-
 EGLBoolean eglDisplay::getConfigNativePixelFormat(EGLConfig config, PixelFormat * format)
 {
     EGLint redSize, blueSize, greenSize, alphaSize;
 
-    if ( !(getAttribValue(config, m_attribs.valueFor(EGL_RED_SIZE), &redSize) &&
-        getAttribValue(config, m_attribs.valueFor(EGL_BLUE_SIZE), &blueSize) &&
-        getAttribValue(config, m_attribs.valueFor(EGL_GREEN_SIZE), &greenSize) &&
-        getAttribValue(config, m_attribs.valueFor(EGL_ALPHA_SIZE), &alphaSize)) )
+    if ( !(getAttribValue(config, attribIndex(EGL_RED_SIZE), &redSize) &&
+        getAttribValue(config, attribIndex(EGL_BLUE_SIZE), &blueSize) &&
+        getAttribValue(config, attribIndex(EGL_GREEN_SIZE), &greenSize) &&
+        getAttribValue(config, attribIndex(EGL_ALPHA_SIZE), &alphaSize)) )
     {
         ALOGE("Couldn't find value for one of the pixel format attributes");
         return EGL_FALSE;
@@ -476,10 +508,10 @@ EGLBoolean eglDisplay::getConfigGLPixelFormat(EGLConfig config, GLenum * format)
 {
     EGLint redSize, blueSize, greenSize, alphaSize;
 
-    if ( !(getAttribValue(config, m_attribs.valueFor(EGL_RED_SIZE), &redSize) &&
-        getAttribValue(config, m_attribs.valueFor(EGL_BLUE_SIZE), &blueSize) &&
-        getAttribValue(config, m_attribs.valueFor(EGL_GREEN_SIZE), &greenSize) &&
-        getAttribValue(config, m_attribs.valueFor(EGL_ALPHA_SIZE), &alphaSize)) )
+    if ( !(getAttribValue(config, attribIndex(EGL_RED_SIZE), &redSize) &&
+        getAttribValue(config, attribIndex(EGL_BLUE_SIZE), &blueSize) &&
+        getAttribValue(config, attribIndex(EGL_GREEN_SIZE), &greenSize) &&
+        getAttribValue(config, attribIndex(EGL_ALPHA_SIZE), &alphaSize)) )
     {
         ALOGE("Couldn't find value for one of the pixel format attributes");
         return EGL_FALSE;
@@ -495,3 +527,276 @@ EGLBoolean eglDisplay::getConfigGLPixelFormat(EGLConfig config, GLenum * format)
 
     return EGL_TRUE;
 }
+
+/* How eglChooseConfig() matches each attribute, see the EGL 1.4 spec, table 3.4 */
+enum {
+    MATCH_IGNORE,
+    MATCH_EXACT,
+    MATCH_AT_LEAST,
+    MATCH_MASK
+};
+
+static const struct {
+    EGLint attrib;
+    EGLint defaultValue;
+    int    match;
+} s_chooseConfigRules[] = {
+    { EGL_BUFFER_SIZE,              0,                  MATCH_AT_LEAST },
+    { EGL_RED_SIZE,                 0,                  MATCH_AT_LEAST },
+    { EGL_GREEN_SIZE,               0,                  MATCH_AT_LEAST },
+    { EGL_BLUE_SIZE,                0,                  MATCH_AT_LEAST },
+    { EGL_LUMINANCE_SIZE,           0,                  MATCH_AT_LEAST },
+    { EGL_ALPHA_SIZE,               0,                  MATCH_AT_LEAST },
+    { EGL_ALPHA_MASK_SIZE,          0,                  MATCH_AT_LEAST },
+    { EGL_BIND_TO_TEXTURE_RGB,      EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_BIND_TO_TEXTURE_RGBA,     EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_COLOR_BUFFER_TYPE,        EGL_RGB_BUFFER,     MATCH_EXACT },
+    { EGL_CONFIG_CAVEAT,            EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_CONFIG_ID,                EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_CONFORMANT,               0,                  MATCH_MASK },
+    { EGL_DEPTH_SIZE,               0,                  MATCH_AT_LEAST },
+    { EGL_LEVEL,                    0,                  MATCH_EXACT },
+    { EGL_MAX_PBUFFER_WIDTH,        0,                  MATCH_IGNORE },
+    { EGL_MAX_PBUFFER_HEIGHT,       0,                  MATCH_IGNORE },
+    { EGL_MAX_PBUFFER_PIXELS,       0,                  MATCH_IGNORE },
+    { EGL_MAX_SWAP_INTERVAL,        EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_MIN_SWAP_INTERVAL,        EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_NATIVE_RENDERABLE,        EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_NATIVE_VISUAL_ID,         0,                  MATCH_IGNORE },
+    { EGL_NATIVE_VISUAL_TYPE,       EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_RENDERABLE_TYPE,          EGL_OPENGL_ES_BIT,  MATCH_MASK },
+    { EGL_SAMPLE_BUFFERS,           0,                  MATCH_AT_LEAST },
+    { EGL_SAMPLES,                  0,                  MATCH_AT_LEAST },
+    { EGL_STENCIL_SIZE,             0,                  MATCH_AT_LEAST },
+    { EGL_SURFACE_TYPE,             EGL_WINDOW_BIT,     MATCH_MASK },
+    { EGL_TRANSPARENT_TYPE,         EGL_NONE,           MATCH_EXACT },
+    { EGL_TRANSPARENT_RED_VALUE,    EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_TRANSPARENT_GREEN_VALUE,  EGL_DONT_CARE,      MATCH_EXACT },
+    { EGL_TRANSPARENT_BLUE_VALUE,   EGL_DONT_CARE,      MATCH_EXACT },
+#ifdef EGL_MATCH_NATIVE_PIXMAP
+    { EGL_MATCH_NATIVE_PIXMAP,      EGL_NONE,           MATCH_IGNORE },
+#endif
+#ifdef EGL_RECORDABLE_ANDROID
+    // All our configs can be used for recording
+    { EGL_RECORDABLE_ANDROID,       EGL_DONT_CARE,      MATCH_IGNORE },
+#endif
+};
+
+#define NUM_CHOOSE_CONFIG_RULES (int)(sizeof(s_chooseConfigRules)/sizeof(s_chooseConfigRules[0]))
+
+/* The sort keys of a matching config, in order of precedence, see the
+ * EGL 1.4 spec, section 3.4.1.2 */
+enum {
+    SORT_CAVEAT,
+    SORT_COLOR_BUFFER_TYPE,
+    SORT_COLOR_BITS,        /* larger first: stored negated */
+    SORT_BUFFER_SIZE,
+    SORT_SAMPLE_BUFFERS,
+    SORT_SAMPLES,
+    SORT_DEPTH_SIZE,
+    SORT_STENCIL_SIZE,
+    SORT_ALPHA_MASK_SIZE,
+    SORT_CONFIG_ID,
+    NUM_SORT_KEYS
+};
+
+struct ConfigSortKey {
+    EGLint keys[NUM_SORT_KEYS];
+    EGLint config;
+};
+
+static int compareConfigSortKeys(const void *a, const void *b)
+{
+    const ConfigSortKey *ka = (const ConfigSortKey *)a;
+    const ConfigSortKey *kb = (const ConfigSortKey *)b;
+
+    for (int i=0; i<NUM_SORT_KEYS; i++) {
+        if (ka->keys[i] != kb->keys[i]) {
+            return ka->keys[i] < kb->keys[i] ? -1 : 1;
+        }
+    }
+    return ka->config - kb->config;
+}
+
+static int findChooseConfigRule(EGLint attrib)
+{
+    for (int i=0; i<NUM_CHOOSE_CONFIG_RULES; i++) {
+        if (s_chooseConfigRules[i].attrib == attrib) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Fills 'configs' with the configs matching attrib_list, sorted, and
+ * returns their number, or -1 if attrib_list holds an unknown attribute.
+ * 'configs' must have room for all the configs. */
+int eglDisplay::matchConfigs(const EGLint *attrib_list, EGLint *configs)
+{
+    EGLint wanted[NUM_CHOOSE_CONFIG_RULES];
+
+    for (int i=0; i<NUM_CHOOSE_CONFIG_RULES; i++) {
+        wanted[i] = s_chooseConfigRules[i].defaultValue;
+    }
+    for (const EGLint *p = attrib_list; p && p[0] != EGL_NONE; p += 2) {
+        int rule = findChooseConfigRule(p[0]);
+        if (rule < 0) {
+            ALOGE("[%s] Unknown attribute 0x%x\n", __FUNCTION__, p[0]);
+            return -1;
+        }
+        wanted[rule] = p[1];
+    }
+
+    // When a config ID is given, all the other attributes are ignored
+    int configIdRule = findChooseConfigRule(EGL_CONFIG_ID);
+    bool byConfigId = wanted[configIdRule] != EGL_DONT_CARE;
+
+    ConfigSortKey *sortKeys = new ConfigSortKey[m_numConfigs];
+    int numMatching = 0;
+
+    for (int c=0; c<m_numConfigs; c++) {
+        bool match = true;
+
+        for (int i=0; i<NUM_CHOOSE_CONFIG_RULES && match; i++) {
+            EGLint value = wanted[i];
+            int matchRule = s_chooseConfigRules[i].match;
+            EGLint configValue;
+
+            if (byConfigId && i != configIdRule) {
+                continue;
+            }
+            if (matchRule == MATCH_IGNORE || value == EGL_DONT_CARE ||
+                (matchRule != MATCH_EXACT && value == 0)) {
+                continue;
+            }
+            if (!lookupConfigAttrib(c, s_chooseConfigRules[i].attrib, &configValue)) {
+                match = false;
+                break;
+            }
+            switch (matchRule) {
+            case MATCH_EXACT:
+                match = (configValue == value);
+                break;
+            case MATCH_AT_LEAST:
+                match = (configValue >= value);
+                break;
+            case MATCH_MASK:
+                match = ((configValue & value) == value);
+                break;
+            }
+        }
+        if (!match) {
+            continue;
+        }
+
+        ConfigSortKey *key = &sortKeys[numMatching++];
+        EGLint caveat = EGL_NONE, bufferType = EGL_RGB_BUFFER;
+        lookupConfigAttrib(c, EGL_CONFIG_CAVEAT, &caveat);
+        lookupConfigAttrib(c, EGL_COLOR_BUFFER_TYPE, &bufferType);
+        key->keys[SORT_CAVEAT] = caveat == EGL_NONE ? 0 : caveat == EGL_SLOW_CONFIG ? 1 : 2;
+        key->keys[SORT_COLOR_BUFFER_TYPE] = bufferType == EGL_RGB_BUFFER ? 0 : 1;
+
+        // Only the color components that were asked for count
+        static const EGLint colorAttribs[] = {
+            EGL_RED_SIZE, EGL_GREEN_SIZE, EGL_BLUE_SIZE, EGL_ALPHA_SIZE, EGL_LUMINANCE_SIZE
+        };
+        EGLint colorBits = 0;
+        for (int i=0; i<(int)(sizeof(colorAttribs)/sizeof(colorAttribs[0])); i++) {
+            EGLint value = wanted[findChooseConfigRule(colorAttribs[i])];
+            EGLint size = 0;
+            if (value != 0 && value != EGL_DONT_CARE &&
+                lookupConfigAttrib(c, colorAttribs[i], &size)) {
+                colorBits += size;
+            }
+        }
+        key->keys[SORT_COLOR_BITS] = -colorBits;
+
+        static const struct { int key; EGLint attrib; } smallerFirst[] = {
+            { SORT_BUFFER_SIZE,     EGL_BUFFER_SIZE },
+            { SORT_SAMPLE_BUFFERS,  EGL_SAMPLE_BUFFERS },
+            { SORT_SAMPLES,         EGL_SAMPLES },
+            { SORT_DEPTH_SIZE,      EGL_DEPTH_SIZE },
+            { SORT_STENCIL_SIZE,    EGL_STENCIL_SIZE },
+            { SORT_ALPHA_MASK_SIZE, EGL_ALPHA_MASK_SIZE },
+            { SORT_CONFIG_ID,       EGL_CONFIG_ID }
+        };
+        for (int i=0; i<(int)(sizeof(smallerFirst)/sizeof(smallerFirst[0])); i++) {
+            EGLint value = 0;
+            lookupConfigAttrib(c, smallerFirst[i].attrib, &value);
+            key->keys[smallerFirst[i].key] = value;
+        }
+        key->config = c;
+    }
+
+    qsort(sortKeys, numMatching, sizeof(ConfigSortKey), compareConfigSortKeys);
+    for (int i=0; i<numMatching; i++) {
+        configs[i] = sortKeys[i].config;
+    }
+    delete [] sortKeys;
+    return numMatching;
+}
+
+EGLBoolean eglDisplay::chooseConfig(const EGLint *attrib_list, EGLConfig *configs,
+                                    EGLint config_size, EGLint *num_config)
+{
+    int numAttribs = 0;
+    while (attrib_list && attrib_list[numAttribs] != EGL_NONE) {
+        numAttribs += 2;
+    }
+
+    pthread_mutex_lock(&m_lock);
+
+    ChooseConfigResult *result = NULL;
+    for (int i=0; i<CHOOSE_CONFIG_CACHE_SIZE; i++) {
+        ChooseConfigResult *r = &m_chooseConfigCache[i];
+        if (r->configs && r->numAttribs == numAttribs &&
+            !memcmp(r->attribs, attrib_list, numAttribs*sizeof(EGLint))) {
+            result = r;
+            break;
+        }
+    }
+
+    if (!result) {
+        EGLint *matching = new EGLint[m_numConfigs];
+        int numMatching = matchConfigs(attrib_list, matching);
+        if (numMatching < 0) {
+            pthread_mutex_unlock(&m_lock);
+            delete [] matching;
+            return EGL_FALSE;
+        }
+
+        result = &m_chooseConfigCache[m_chooseConfigCacheNext];
+        m_chooseConfigCacheNext = (m_chooseConfigCacheNext + 1) % CHOOSE_CONFIG_CACHE_SIZE;
+        delete [] result->attribs;
+        delete [] result->configs;
+        result->attribs = new EGLint[numAttribs + 1];
+        memcpy(result->attribs, attrib_list, numAttribs*sizeof(EGLint));
+        result->numAttribs = numAttribs;
+        result->configs = matching;
+        result->numConfigs = numMatching;
+    }
+
+    int n = result->numConfigs;
+    if (configs) {
+        if (n > config_size) {
+            n = config_size;
+        }
+        for (int i=0; i<n; i++) {
+            configs[i] = (EGLConfig)result->configs[i];
+        }
+    }
+    *num_config = n;
+
+    pthread_mutex_unlock(&m_lock);
+    return EGL_TRUE;
+}
+
+void eglDisplay::clearChooseConfigCache()
+{
+    for (int i=0; i<CHOOSE_CONFIG_CACHE_SIZE; i++) {
+        delete [] m_chooseConfigCache[i].attribs;
+        delete [] m_chooseConfigCache[i].configs;
+    }
+    memset(m_chooseConfigCache, 0, sizeof(m_chooseConfigCache));
+    m_chooseConfigCacheNext = 0;
+}
@@ -21,11 +21,14 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include "EGLClientIface.h"
-#include <utils/KeyedVector.h>
 
 #include <ui/PixelFormat.h>
 
 #define ATTRIBUTE_NONE -1
+
+/* The config attributes of EGL 1.4 are in [EGL_BUFFER_SIZE, EGL_CONFORMANT] */
+#define CONFIG_ATTRIB_FIRST EGL_BUFFER_SIZE
+#define CONFIG_ATTRIB_LAST  EGL_CONFORMANT
 //FIXME: are we in this namespace?
 using namespace android;
 
@@ -49,10 +52,14 @@ public:
 
     int     getNumConfigs(){ return m_numConfigs; }
     EGLBoolean  getConfigAttrib(EGLConfig config, EGLint attrib, EGLint * value);
-    EGLBoolean  setConfigAttrib(EGLConfig config, EGLint attrib, EGLint value);
     EGLBoolean getConfigGLPixelFormat(EGLConfig config, GLenum * format);
     EGLBoolean getConfigNativePixelFormat(EGLConfig config, PixelFormat * format);
 
+    /* eglChooseConfig(), from the configs table. Returns EGL_FALSE when
+     * attrib_list holds an unknown attribute. */
+    EGLBoolean chooseConfig(const EGLint *attrib_list, EGLConfig *configs,
+                            EGLint config_size, EGLint *num_config);
+
     void     dumpConfig(EGLConfig config);
 private:
     EGLClient_glesInterface *loadGLESClientAPI(const char *libName,
@@ -61,6 +68,10 @@ private:
     EGLBoolean getAttribValue(EGLConfig config, EGLint attribIdxi, EGLint * value);
     EGLBoolean setAttribValue(EGLConfig config, EGLint attribIdxi, EGLint value);
     void     processConfigs();
+    EGLint   attribIndex(EGLint attrib) const;
+    bool     lookupConfigAttrib(int config, EGLint attrib, EGLint *value) const;
+    int      matchConfigs(const EGLint *attrib_list, EGLint *configs);
+    void     clearChooseConfigCache();
 
 private:
     pthread_mutex_t m_lock;
@@ -71,14 +82,28 @@ private:
     int  m_numConfigs;
     int  m_numConfigAttribs;
 
-    /* This is the mapping between an attribute name to it's index in any given config */
-    DefaultKeyedVector<EGLint, EGLint>    m_attribs;
+    /* This is the mapping between an attribute name to it's index in any given config:
+     * m_attribIndex[attrib - CONFIG_ATTRIB_FIRST], or ATTRIBUTE_NONE. It is filled
+     * once by initialize(), and read without m_lock. */
+    EGLint m_attribIndex[CONFIG_ATTRIB_LAST - CONFIG_ATTRIB_FIRST + 1];
     /* This is an array of all config's attributes values stored in the following sequencial fasion (read: v[c,a] = the value of attribute <a> of config <c>)
      * v[0,0],..,v[0,m_numConfigAttribs-1],
      *...
      * v[m_numConfigs-1,0],..,v[m_numConfigs-1,m_numConfigAttribs-1]
      */
     EGLint *m_configs;
+
+    /* The results of the last chooseConfig() calls, per attribute list:
+     * apps choose the same configs for every surface they create. */
+    enum { CHOOSE_CONFIG_CACHE_SIZE = 8 };
+    struct ChooseConfigResult {
+        EGLint *attribs;        /* attribute list, without EGL_NONE */
+        int     numAttribs;
+        EGLint *configs;        /* all the matching configs, sorted */
+        int     numConfigs;
+    };
+    ChooseConfigResult m_chooseConfigCache[CHOOSE_CONFIG_CACHE_SIZE];
+    int m_chooseConfigCacheNext;
     EGLClient_glesInterface *m_gles_iface;
     EGLClient_glesInterface *m_gles2_iface;
     char *m_versionString;
@@ -58,7 +58,13 @@ static const struct _egl_funcs_by_name {
     {"eglCreateSyncKHR", (void *)eglCreateSyncKHR},
     {"eglDestroySyncKHR", (void *)eglDestroySyncKHR},
     {"eglClientWaitSyncKHR", (void *)eglClientWaitSyncKHR},
-    {"eglGetSyncAttribKHR", (void *)eglGetSyncAttribKHR}
+    {"eglGetSyncAttribKHR", (void *)eglGetSyncAttribKHR},
+    {"eglCreateCommandListEMU", (void *)eglCreateCommandListEMU},
+    {"eglDestroyCommandListEMU", (void *)eglDestroyCommandListEMU},
+    {"eglBeginCommandListEMU", (void *)eglBeginCommandListEMU},
+    {"eglEndCommandListEMU", (void *)eglEndCommandListEMU},
+    {"eglSubmitCommandListsEMU", (void *)eglSubmitCommandListsEMU},
+    {"eglResetCommandListEMU", (void *)eglResetCommandListEMU}
 };
 
 static const int egl_num_funcs = sizeof(egl_funcs_by_name) / sizeof(struct _egl_funcs_by_name);
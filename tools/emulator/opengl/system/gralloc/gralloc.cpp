@@ -26,6 +26,7 @@
 #include <dlfcn.h>
 #include <sys/mman.h>
 #include "gralloc_cb.h"
+#include "ColorBufferPrefetch.h"
 #include "HostConnection.h"
 #include "glUtils.h"
 #include <cutils/log.h>
@@ -364,6 +365,9 @@ static int gralloc_free(alloc_device_t* dev,
     }
 
     if (cb->hostHandle != 0) {
+        // a read ahead may still be writing to the memory of the buffer
+        cancelColorBufferPrefetch((cb_handle_t *)cb);
+
         DEFINE_AND_VALIDATE_HOST_CONNECTION;
         D("Closing host ColorBuffer 0x%x\n", cb->hostHandle);
         rcEnc->rcCloseColorBuffer(rcEnc, cb->hostHandle);
@@ -564,6 +568,9 @@ static int gralloc_unregister_buffer(gralloc_module_t const* module,
     }
 
     if (cb->hostHandle != 0) {
+        // a read ahead may still be writing to the memory of the buffer
+        cancelColorBufferPrefetch((cb_handle_t *)cb);
+
         DEFINE_AND_VALIDATE_HOST_CONNECTION;
         D("Closing host ColorBuffer 0x%x\n", cb->hostHandle);
         rcEnc->rcCloseColorBuffer(rcEnc, cb->hostHandle);
@@ -670,6 +677,18 @@ static int gralloc_lock(gralloc_module_t const* module,
             return -EBUSY;
         }
 
+        //
+        // the pixels of a buffer rendered by the GPU are on the host: read
+        // them back, or wait for the read ahead made when it was posted.
+        // Any other lock waits for the read ahead, which would otherwise
+        // overwrite what the CPU writes.
+        //
+        if (sw_read && (cb->usage & GRALLOC_USAGE_HW_RENDER)) {
+            readColorBuffer(cb);
+        } else {
+            cancelColorBufferPrefetch(cb);
+        }
+
     }
 
     //
@@ -727,25 +746,30 @@ static int gralloc_unlock(gralloc_module_t const* module,
 
         if (cb->lockedWidth < cb->width || cb->lockedHeight < cb->height) {
             int bpp = glUtilsPixelBitSize(cb->glFormat, cb->glType) >> 3;
-            char *tmpBuf = new char[cb->lockedWidth * cb->lockedHeight * bpp];
-
-            int dst_line_len = cb->lockedWidth * bpp;
-            int src_line_len = cb->width * bpp;
-            char *src = (char *)cpu_addr + cb->lockedTop*src_line_len + cb->lockedLeft*bpp;
-            char *dst = tmpBuf;
-            for (int y=0; y<cb->lockedHeight; y++) {
-                memcpy(dst, src, dst_line_len);
-                src += src_line_len;
-                dst += dst_line_len;
+            ScratchArena *scratch = hostCon->scratchArena();
+            char *tmpBuf = (char *)scratch->alloc(cb->lockedWidth * cb->lockedHeight * bpp);
+            if (!tmpBuf) {
+                ALOGE("gralloc_unlock: no memory to update the color buffer\n");
+            } else {
+                int dst_line_len = cb->lockedWidth * bpp;
+                int src_line_len = cb->width * bpp;
+                char *src = (char *)cpu_addr + cb->lockedTop*src_line_len + cb->lockedLeft*bpp;
+                char *dst = tmpBuf;
+                for (int y=0; y<cb->lockedHeight; y++) {
+                    memcpy(dst, src, dst_line_len);
+                    src += src_line_len;
+                    dst += dst_line_len;
+                }
+
+                rcEnc->rcUpdateColorBuffer(rcEnc, cb->hostHandle,
+                                           cb->lockedLeft, cb->lockedTop,
+                                           cb->lockedWidth, cb->lockedHeight,
+                                           cb->glFormat, cb->glType,
+                                           tmpBuf);
+
+                // the thread may not draw with GL, and never end a frame
+                scratch->reset();
             }
-
-            rcEnc->rcUpdateColorBuffer(rcEnc, cb->hostHandle,
-                                       cb->lockedLeft, cb->lockedTop,
-                                       cb->lockedWidth, cb->lockedHeight,
-                                       cb->glFormat, cb->glType,
-                                       tmpBuf);
-
-            delete [] tmpBuf;
         }
         else {
             rcEnc->rcUpdateColorBuffer(rcEnc, cb->hostHandle, 0, 0,
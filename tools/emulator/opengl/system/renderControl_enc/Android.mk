@@ -1,12 +1,24 @@
 LOCAL_PATH := $(call my-dir)
 
-$(call emugl-begin-shared-library,lib_renderControl_enc)
-
-LOCAL_SRC_FILES := \
+renderControlEncSources := \
     renderControl_client_context.cpp \
     renderControl_enc.cpp \
     renderControl_entry.cpp
 
+$(call emugl-begin-shared-library,lib_renderControl_enc)
+
+LOCAL_SRC_FILES := $(renderControlEncSources)
+
+$(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
+$(call emugl-import,libOpenglCodecCommon)
+$(call emugl-end-module)
+
+ifeq (true,$(EMUGL_BUILD_HOST_LIBS))
+$(call emugl-begin-host-shared-library,lib_renderControl_enc)
+
+LOCAL_SRC_FILES := $(renderControlEncSources)
+
 $(call emugl-export,C_INCLUDES,$(LOCAL_PATH))
 $(call emugl-import,libOpenglCodecCommon)
 $(call emugl-end-module)
+endif
@@ -0,0 +1,25 @@
+LOCAL_PATH := $(call my-dir)
+
+# Benchmark of the guest encoders, EGL and GLES libraries built for the
+# host, against an in-process fake renderer. The GLES libraries are loaded
+# at runtime, like the EGL layer does, and must be in the library path.
+#
+$(call emugl-begin-host-executable,emugl_encoder_bench)
+$(call emugl-import,libEGL_emulation libOpenglSystemCommon lib_renderControl_enc libGLESv1_enc libGLESv2_enc libOpenglCodecCommon)
+
+LOCAL_CFLAGS += -DLOG_TAG=\"emugl_encoder_bench\"
+
+LOCAL_SRC_FILES := \
+    encoder_bench.cpp \
+    command_lists.cpp \
+    FakeRenderStream.cpp \
+    FakeGLReplies.cpp \
+    FakeGL2Replies.cpp \
+    FakeNativeWindow.cpp \
+    gles1_workload.cpp \
+    gles2_workload.cpp \
+    indexed_workload.cpp \
+    program_links.cpp \
+    texture_uploads.cpp
+
+$(call emugl-end-module)
@@ -0,0 +1,123 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "FakeRenderStream.h"
+#include <string.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include "gl2_opcodes.h"
+
+// The uniforms of every program, at locations 0 to NUM_UNIFORMS-1
+static const struct {
+    const char *name;
+    GLenum type;
+} s_uniforms[] = {
+    { "u_mvp", GL_FLOAT_MAT4 },
+    { "u_tint", GL_FLOAT_VEC4 },
+    { "u_light", GL_FLOAT_VEC3 },
+    { "u_texture", GL_SAMPLER_2D },
+};
+
+#define NUM_UNIFORMS    (int)(sizeof(s_uniforms) / sizeof(s_uniforms[0]))
+#define MAX_UNIFORM_NAME_LENGTH 16
+
+bool fakeGL2Reply(FakeRenderStream *stream, const FakeRenderStream::Call &call,
+                  void *buf, size_t len)
+{
+    if (call.opcode < OP_glActiveTexture || call.opcode >= OP_last) {
+        return false;
+    }
+
+    const GLuint *args = (const GLuint *)call.args;
+    GLuint *reply = (GLuint *)buf;
+
+    switch (call.opcode) {
+    case OP_glGenBuffers:
+    case OP_glGenTextures:
+    case OP_glGenFramebuffers:
+    case OP_glGenRenderbuffers:
+    case OP_glGenVertexArraysOES:
+        for (size_t i = 0; i < len / sizeof(GLuint); i++) {
+            reply[i] = stream->newName();
+        }
+        break;
+
+    case OP_glCreateShader:
+    case OP_glCreateProgram:
+        reply[0] = stream->newName();
+        break;
+
+    case OP_glCheckFramebufferStatus:
+        reply[0] = GL_FRAMEBUFFER_COMPLETE;
+        break;
+
+    case OP_glGetShaderiv:
+    case OP_glGetProgramiv:
+        // [object][pname][size of params]: shaders compile and programs link
+        if (call.argsSize >= 2 * sizeof(GLuint)) {
+            switch (args[1]) {
+            case GL_COMPILE_STATUS:
+            case GL_LINK_STATUS:
+            case GL_VALIDATE_STATUS:
+                reply[0] = GL_TRUE;
+                break;
+            case GL_ACTIVE_UNIFORMS:
+                reply[0] = NUM_UNIFORMS;
+                break;
+            case GL_ACTIVE_UNIFORM_MAX_LENGTH:
+                reply[0] = MAX_UNIFORM_NAME_LENGTH;
+                break;
+            }
+        }
+        break;
+
+    case OP_glGetActiveUniform:
+        // [program][index][bufsize]...: the length if asked for, the size,
+        // the type and the name. The encoder never asks for the length.
+        if (call.argsSize >= 3 * sizeof(GLuint) && (int)args[1] < NUM_UNIFORMS) {
+            switch (call.readback) {
+            case 0:
+                reply[0] = 1;
+                break;
+            case 1:
+                reply[0] = s_uniforms[args[1]].type;
+                break;
+            case 2:
+                strncpy((char *)buf, s_uniforms[args[1]].name, len);
+                break;
+            }
+        }
+        break;
+
+    case OP_glGetUniformLocation:
+        // [program][size of name][name]
+        reply[0] = (GLuint)-1;
+        if (call.argsSize > 2 * sizeof(GLuint)) {
+            const char *name = (const char *)&args[2];
+            size_t nameSize = call.argsSize - 2 * sizeof(GLuint);
+            for (int i = 0; i < NUM_UNIFORMS; i++) {
+                if (strnlen(name, nameSize) < nameSize && !strcmp(name, s_uniforms[i].name)) {
+                    reply[0] = i;
+                }
+            }
+        }
+        break;
+
+    default:
+        // glGetError() and the other queries return zeroes
+        break;
+    }
+    return true;
+}
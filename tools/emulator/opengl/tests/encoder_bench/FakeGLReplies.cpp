@@ -0,0 +1,53 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "FakeRenderStream.h"
+#include <GLES/gl.h>
+#include <GLES/glext.h>
+#include "gl_opcodes.h"
+
+// The GLES 1 and GLES 2 opcodes are defined in separate files since both
+// headers define OP_last.
+
+bool fakeGLReply(FakeRenderStream *stream, const FakeRenderStream::Call &call,
+                 void *buf, size_t len)
+{
+    if (call.opcode < OP_glAlphaFunc || call.opcode >= OP_last) {
+        return false;
+    }
+
+    GLuint *reply = (GLuint *)buf;
+
+    switch (call.opcode) {
+    case OP_glGenBuffers:
+    case OP_glGenTextures:
+    case OP_glGenFramebuffersOES:
+    case OP_glGenRenderbuffersOES:
+    case OP_glGenVertexArraysOES:
+        for (size_t i = 0; i < len / sizeof(GLuint); i++) {
+            reply[i] = stream->newName();
+        }
+        break;
+
+    case OP_glCheckFramebufferStatusOES:
+        reply[0] = GL_FRAMEBUFFER_COMPLETE_OES;
+        break;
+
+    default:
+        // glGetError() and the queries return zeroes
+        break;
+    }
+    return true;
+}
@@ -0,0 +1,147 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "FakeNativeWindow.h"
+#include "ColorBufferPrefetch.h"
+#include "HostConnection.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <GLES/gl.h>
+
+FakeNativeWindow::FakeNativeWindow(int width, int height, int usage) :
+    m_width(width),
+    m_height(height),
+    m_next(0),
+    m_queued(NULL)
+{
+    common.incRef = incRef;
+    common.decRef = decRef;
+    ANativeWindow::setSwapInterval = setSwapInterval;
+    dequeueBuffer_DEPRECATED = dequeueBuffer;
+    lockBuffer_DEPRECATED = lockBuffer;
+    queueBuffer_DEPRECATED = queueBuffer;
+    ANativeWindow::query = query;
+    ANativeWindow::perform = perform;
+    cancelBuffer_DEPRECATED = cancelBuffer;
+
+    renderControl_encoder_context_t *rcEnc = HostConnection::get()->rcEncoder();
+    usage |= GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
+    int ashmemSize = (usage & GRALLOC_USAGE_SW_READ_MASK) ? width * height * 4 : 0;
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        m_handles[i] = new cb_handle_t(-1, ashmemSize, usage, width, height,
+                                       HAL_PIXEL_FORMAT_RGBA_8888,
+                                       GL_RGBA, GL_UNSIGNED_BYTE);
+        m_handles[i]->hostHandle = rcEnc->rcCreateColorBuffer(rcEnc, width, height, GL_RGBA);
+        if (ashmemSize) {
+            void *addr = mmap(NULL, ashmemSize, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+            if (addr == MAP_FAILED) {
+                perror("mmap");
+                abort();
+            }
+            m_handles[i]->ashmemBase = (intptr_t)addr;
+            m_handles[i]->ashmemBasePid = getpid();
+        }
+
+        ANativeWindowBuffer &buffer = m_buffers[i];
+        buffer.common.incRef = incRef;
+        buffer.common.decRef = decRef;
+        buffer.width = width;
+        buffer.height = height;
+        buffer.stride = width;
+        buffer.format = HAL_PIXEL_FORMAT_RGBA_8888;
+        buffer.usage = usage;
+        buffer.handle = m_handles[i];
+    }
+}
+
+FakeNativeWindow::~FakeNativeWindow()
+{
+    HostConnection *hostCon = HostConnection::get();
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        if (hostCon) {
+            renderControl_encoder_context_t *rcEnc = hostCon->rcEncoder();
+            cancelColorBufferPrefetch(m_handles[i]);
+            rcEnc->rcCloseColorBuffer(rcEnc, m_handles[i]->hostHandle);
+        }
+        if (m_handles[i]->ashmemBase) {
+            munmap((void *)(intptr_t)m_handles[i]->ashmemBase, m_handles[i]->ashmemSize);
+        }
+        delete m_handles[i];
+    }
+}
+
+// The benchmark owns its windows and buffers: the references taken by the
+// surfaces are not counted.
+void FakeNativeWindow::incRef(android_native_base_t *base)
+{
+}
+
+void FakeNativeWindow::decRef(android_native_base_t *base)
+{
+}
+
+int FakeNativeWindow::setSwapInterval(ANativeWindow *window, int interval)
+{
+    return NO_ERROR;
+}
+
+int FakeNativeWindow::dequeueBuffer(ANativeWindow *window, ANativeWindowBuffer **buffer)
+{
+    FakeNativeWindow *w = self(window);
+    *buffer = &w->m_buffers[w->m_next];
+    w->m_next = (w->m_next + 1) % NUM_BUFFERS;
+    return NO_ERROR;
+}
+
+int FakeNativeWindow::lockBuffer(ANativeWindow *window, ANativeWindowBuffer *buffer)
+{
+    return NO_ERROR;
+}
+
+int FakeNativeWindow::queueBuffer(ANativeWindow *window, ANativeWindowBuffer *buffer)
+{
+    self(window)->m_queued = (cb_handle_t *)buffer->handle;
+    return NO_ERROR;
+}
+
+int FakeNativeWindow::query(const ANativeWindow *window, int what, int *value)
+{
+    switch (what) {
+    case NATIVE_WINDOW_WIDTH:
+        *value = self(window)->m_width;
+        return NO_ERROR;
+    case NATIVE_WINDOW_HEIGHT:
+        *value = self(window)->m_height;
+        return NO_ERROR;
+    case NATIVE_WINDOW_FORMAT:
+        *value = HAL_PIXEL_FORMAT_RGBA_8888;
+        return NO_ERROR;
+    default:
+        return -1;
+    }
+}
+
+int FakeNativeWindow::perform(ANativeWindow *window, int operation, ...)
+{
+    return NO_ERROR;
+}
+
+int FakeNativeWindow::cancelBuffer(ANativeWindow *window, ANativeWindowBuffer *buffer)
+{
+    return NO_ERROR;
+}
@@ -0,0 +1,63 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __FAKE_NATIVE_WINDOW_H
+#define __FAKE_NATIVE_WINDOW_H
+
+#include <system/window.h>
+#include "gralloc_cb.h"
+
+//
+// A window with a few color buffers, for the surfaces of the benchmark:
+// it hands out cb_handle_t buffers whose host color buffers are created on
+// the current host connection, as gralloc does in the emulator.
+//
+// With software read 'usage' bits, the buffers have guest memory too, mapped
+// in the low 2GB: the handles hold their address in an int.
+//
+class FakeNativeWindow : public ANativeWindow {
+public:
+    enum { NUM_BUFFERS = 3 };
+
+    FakeNativeWindow(int width, int height, int usage = 0);
+    ~FakeNativeWindow();
+
+    // The buffer queued by the last eglSwapBuffers()
+    cb_handle_t *queuedBuffer() const { return m_queued; }
+
+private:
+    static FakeNativeWindow *self(const ANativeWindow *window) {
+        return (FakeNativeWindow *)window;
+    }
+
+    static void incRef(android_native_base_t *base);
+    static void decRef(android_native_base_t *base);
+    static int setSwapInterval(ANativeWindow *window, int interval);
+    static int dequeueBuffer(ANativeWindow *window, ANativeWindowBuffer **buffer);
+    static int lockBuffer(ANativeWindow *window, ANativeWindowBuffer *buffer);
+    static int queueBuffer(ANativeWindow *window, ANativeWindowBuffer *buffer);
+    static int query(const ANativeWindow *window, int what, int *value);
+    static int perform(ANativeWindow *window, int operation, ...);
+    static int cancelBuffer(ANativeWindow *window, ANativeWindowBuffer *buffer);
+
+    int m_width;
+    int m_height;
+    int m_next;
+    cb_handle_t *m_queued;
+    ANativeWindowBuffer m_buffers[NUM_BUFFERS];
+    cb_handle_t *m_handles[NUM_BUFFERS];
+};
+
+#endif
@@ -0,0 +1,542 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "FakeRenderStream.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <EGL/egl.h>
+#include "renderControl_opcodes.h"
+
+//
+// The configs of the fake renderer: every combination of the color formats,
+// depth and stencil sizes below, with the attributes of the emulator's
+// renderer (see host/libs/libOpenglRender/FBConfig.cpp).
+//
+static const EGLint s_configAttribs[] = {
+    EGL_DEPTH_SIZE,
+    EGL_STENCIL_SIZE,
+    EGL_RENDERABLE_TYPE,
+    EGL_SURFACE_TYPE,
+    EGL_CONFIG_ID,
+    EGL_BUFFER_SIZE,
+    EGL_ALPHA_SIZE,
+    EGL_BLUE_SIZE,
+    EGL_GREEN_SIZE,
+    EGL_RED_SIZE,
+    EGL_CONFIG_CAVEAT,
+    EGL_LEVEL,
+    EGL_MAX_PBUFFER_HEIGHT,
+    EGL_MAX_PBUFFER_PIXELS,
+    EGL_MAX_PBUFFER_WIDTH,
+    EGL_NATIVE_RENDERABLE,
+    EGL_NATIVE_VISUAL_ID,
+    EGL_NATIVE_VISUAL_TYPE,
+    EGL_SAMPLES,
+    EGL_SAMPLE_BUFFERS,
+    EGL_TRANSPARENT_TYPE,
+    EGL_TRANSPARENT_BLUE_VALUE,
+    EGL_TRANSPARENT_GREEN_VALUE,
+    EGL_TRANSPARENT_RED_VALUE,
+    EGL_BIND_TO_TEXTURE_RGB,
+    EGL_BIND_TO_TEXTURE_RGBA,
+    EGL_MIN_SWAP_INTERVAL,
+    EGL_MAX_SWAP_INTERVAL,
+    EGL_LUMINANCE_SIZE,
+    EGL_ALPHA_MASK_SIZE,
+    EGL_COLOR_BUFFER_TYPE,
+    EGL_CONFORMANT
+};
+
+#define NUM_CONFIG_ATTRIBS  (int)(sizeof(s_configAttribs) / sizeof(s_configAttribs[0]))
+
+static const struct {
+    EGLint red, green, blue, alpha;
+} s_colorFormats[] = {
+    { 5, 6, 5, 0 },
+    { 8, 8, 8, 0 },
+    { 8, 8, 8, 8 }
+};
+
+static const EGLint s_depthSizes[] = { 0, 16, 24 };
+static const EGLint s_stencilSizes[] = { 0, 8 };
+
+#define NUM_COLOR_FORMATS   (int)(sizeof(s_colorFormats) / sizeof(s_colorFormats[0]))
+#define NUM_DEPTH_SIZES     (int)(sizeof(s_depthSizes) / sizeof(s_depthSizes[0]))
+#define NUM_STENCIL_SIZES   (int)(sizeof(s_stencilSizes) / sizeof(s_stencilSizes[0]))
+
+int FakeRenderStream::numConfigs()
+{
+    return NUM_COLOR_FORMATS * NUM_DEPTH_SIZES * NUM_STENCIL_SIZES;
+}
+
+static EGLint getConfigAttrib(int config, EGLint attrib)
+{
+    int color = config / (NUM_DEPTH_SIZES * NUM_STENCIL_SIZES);
+    int depth = (config / NUM_STENCIL_SIZES) % NUM_DEPTH_SIZES;
+    int stencil = config % NUM_STENCIL_SIZES;
+
+    switch (attrib) {
+    case EGL_DEPTH_SIZE:            return s_depthSizes[depth];
+    case EGL_STENCIL_SIZE:          return s_stencilSizes[stencil];
+    case EGL_RENDERABLE_TYPE:       return EGL_OPENGL_ES_BIT | EGL_OPENGL_ES2_BIT;
+    case EGL_SURFACE_TYPE:          return EGL_WINDOW_BIT | EGL_PBUFFER_BIT;
+    case EGL_CONFIG_ID:             return config + 1;
+    case EGL_BUFFER_SIZE:           return s_colorFormats[color].red + s_colorFormats[color].green +
+                                           s_colorFormats[color].blue + s_colorFormats[color].alpha;
+    case EGL_ALPHA_SIZE:            return s_colorFormats[color].alpha;
+    case EGL_BLUE_SIZE:             return s_colorFormats[color].blue;
+    case EGL_GREEN_SIZE:            return s_colorFormats[color].green;
+    case EGL_RED_SIZE:              return s_colorFormats[color].red;
+    case EGL_CONFIG_CAVEAT:         return EGL_NONE;
+    case EGL_MAX_PBUFFER_HEIGHT:
+    case EGL_MAX_PBUFFER_WIDTH:     return 4096;
+    case EGL_MAX_PBUFFER_PIXELS:    return 4096 * 4096;
+    case EGL_TRANSPARENT_TYPE:      return EGL_NONE;
+    case EGL_MAX_SWAP_INTERVAL:     return 1;
+    case EGL_COLOR_BUFFER_TYPE:     return EGL_RGB_BUFFER;
+    case EGL_CONFORMANT:            return EGL_OPENGL_ES_BIT | EGL_OPENGL_ES2_BIT;
+    default:                        return 0;
+    }
+}
+
+// Whether 'config' matches the attribute list, the way the renderer does it
+// for the attributes an application usually asks for.
+static bool matchConfig(int config, const EGLint *attribs, size_t count)
+{
+    for (size_t i = 0; i + 1 < count && attribs[i] != EGL_NONE; i += 2) {
+        EGLint attrib = attribs[i];
+        EGLint value = attribs[i + 1];
+
+        if (value == EGL_DONT_CARE) {
+            continue;
+        }
+        switch (attrib) {
+        case EGL_BUFFER_SIZE:
+        case EGL_RED_SIZE:
+        case EGL_GREEN_SIZE:
+        case EGL_BLUE_SIZE:
+        case EGL_ALPHA_SIZE:
+        case EGL_DEPTH_SIZE:
+        case EGL_STENCIL_SIZE:
+        case EGL_SAMPLES:
+        case EGL_SAMPLE_BUFFERS:
+            if (getConfigAttrib(config, attrib) < value) {
+                return false;
+            }
+            break;
+        case EGL_SURFACE_TYPE:
+        case EGL_RENDERABLE_TYPE:
+        case EGL_CONFORMANT:
+            if ((getConfigAttrib(config, attrib) & value) != value) {
+                return false;
+            }
+            break;
+        default:
+            if (getConfigAttrib(config, attrib) != value) {
+                return false;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+static const char s_eglVendor[] = "Android";
+static const char s_eglVersion[] = "1.4 Android META-EGL";
+static const char s_eglExtensions[] = "EGL_KHR_image_base EGL_KHR_gl_texture_2D_image";
+static const char s_glVendor[] = "Android";
+static const char s_glRenderer[] = "Android Emulator OpenGL ES Translator (fake renderer)";
+static const char s_glVersion[] = "OpenGL ES 2.0";
+static const char s_glExtensions[] =
+    "GL_OES_EGL_image GL_OES_framebuffer_object GL_OES_packed_depth_stencil "
+    "GL_OES_texture_npot GL_OES_rgb8_rgba8 GL_OES_depth24";
+
+static const char *lookupString(EGLint name)
+{
+    switch (name) {
+    case EGL_VENDOR:        return s_eglVendor;
+    case EGL_VERSION:       return s_eglVersion;
+    case EGL_EXTENSIONS:    return s_eglExtensions;
+    case 0x1F00:            return s_glVendor;      // GL_VENDOR
+    case 0x1F01:            return s_glRenderer;    // GL_RENDERER
+    case 0x1F02:            return s_glVersion;     // GL_VERSION
+    case 0x1F03:            return s_glExtensions;  // GL_EXTENSIONS
+    default:                return "";
+    }
+}
+
+FakeRenderStream::FakeRenderStream(size_t bufSize) :
+    IOStream(bufSize),
+    m_buf(NULL),
+    m_bufsize(0),
+    m_recordFile(NULL),
+    m_bandwidth(0),
+    m_busyUntil(0),
+    m_readBusyUntil(0),
+    m_flagsLeft(sizeof(unsigned int)),
+    m_headerSize(0),
+    m_packetLeft(0),
+    m_lastName(0),
+    m_firstPixelRead(0),
+    m_pixelReadCount(0),
+    m_numColorBuffers(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    memset(&m_call, 0, sizeof(m_call));
+    m_call.args = m_args;
+    pthread_mutex_init(&m_pixelReadLock, NULL);
+}
+
+FakeRenderStream::~FakeRenderStream()
+{
+    flush();
+    free(m_buf);
+    pthread_mutex_destroy(&m_pixelReadLock);
+}
+
+void *FakeRenderStream::allocBuffer(size_t minSize)
+{
+    if (minSize > m_bufsize) {
+        unsigned char *p = (unsigned char *)realloc(m_buf, minSize);
+        if (!p) {
+            ERR("FakeRenderStream::allocBuffer failed to allocate %d bytes\n", (int)minSize);
+            return NULL;
+        }
+        m_buf = p;
+        m_bufsize = minSize;
+    }
+    return m_buf;
+}
+
+int FakeRenderStream::commitBuffer(size_t size)
+{
+    return writeFully(m_buf, size);
+}
+
+int FakeRenderStream::writeFully(const void *buf, size_t len)
+{
+    if (m_recordFile) {
+        fwrite(buf, 1, len, m_recordFile);
+    }
+    receive((const unsigned char *)buf, len);
+    if (m_bandwidth > 0) {
+        waitTransfer(&m_busyUntil, len);
+    }
+    return 0;
+}
+
+// Each direction of the stream has the bandwidth: 'busyUntil' is when the
+// data sent so far in one of them is through
+void FakeRenderStream::waitTransfer(double *busyUntil, size_t len)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    double now = ts.tv_sec + ts.tv_nsec / 1e9;
+    if (*busyUntil < now) {
+        *busyUntil = now;
+    }
+    *busyUntil += len / m_bandwidth;
+
+    // small transfers add up until there is enough to wait for
+    if (*busyUntil - now >= 100e-6) {
+        ts.tv_sec = (time_t)*busyUntil;
+        ts.tv_nsec = (long)((*busyUntil - ts.tv_sec) * 1e9);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+}
+
+void FakeRenderStream::receive(const unsigned char *data, size_t len)
+{
+    if (m_flagsLeft) {
+        size_t n = len < m_flagsLeft ? len : m_flagsLeft;
+        m_flagsLeft -= n;
+        data += n;
+        len -= n;
+    }
+
+    while (len > 0) {
+        if (m_headerSize < sizeof(m_header)) {
+            size_t n = sizeof(m_header) - m_headerSize;
+            if (n > len) n = len;
+            memcpy(m_header + m_headerSize, data, n);
+            m_headerSize += n;
+            data += n;
+            len -= n;
+            if (m_headerSize < sizeof(m_header)) {
+                break;
+            }
+
+            uint32_t packetSize;
+            memcpy(&m_call.opcode, m_header, 4);
+            memcpy(&packetSize, m_header + 4, 4);
+            m_call.argsSize = 0;
+            m_packetLeft = packetSize - sizeof(m_header);
+            m_stats.calls++;
+            m_stats.bytes += packetSize;
+            if (m_packetLeft == 0) {
+                endPacket();
+            }
+            continue;
+        }
+
+        size_t n = len < m_packetLeft ? len : m_packetLeft;
+        if (m_call.argsSize < MAX_ARGS_SIZE) {
+            size_t keep = MAX_ARGS_SIZE - m_call.argsSize;
+            if (keep > n) keep = n;
+            memcpy(m_args + m_call.argsSize, data, keep);
+            m_call.argsSize += keep;
+        }
+        m_packetLeft -= n;
+        data += n;
+        len -= n;
+        if (m_packetLeft == 0) {
+            endPacket();
+        }
+    }
+}
+
+void FakeRenderStream::endPacket()
+{
+    m_headerSize = 0;
+    m_call.readback = 0;
+
+    uint32_t args[2] = { 0, 0 };
+    memcpy(args, m_call.args, m_call.argsSize < sizeof(args) ? m_call.argsSize : sizeof(args));
+
+    if (m_call.opcode == OP_rcReadColorBuffer && m_call.argsSize >= sizeof(uint32_t)) {
+        uint32_t pixel = colorBufferPixel(args[0]);
+        pthread_mutex_lock(&m_pixelReadLock);
+        if (m_pixelReadCount < MAX_PIXEL_READS) {
+            m_pixelReads[(m_firstPixelRead + m_pixelReadCount) % MAX_PIXEL_READS] = pixel;
+            m_pixelReadCount++;
+        } else {
+            ERR("FakeRenderStream: too many pending color buffer reads\n");
+        }
+        pthread_mutex_unlock(&m_pixelReadLock);
+    } else if (m_call.opcode == OP_rcSetWindowColorBuffer && m_call.argsSize >= sizeof(args)) {
+        pthread_mutex_lock(&m_pixelReadLock);
+        for (size_t i = 0; i < m_numColorBuffers; i++) {
+            if (m_colorBuffers[i].windowSurface == args[0]) {
+                m_colorBuffers[i].windowSurface = 0;
+            }
+        }
+        ColorBuffer *cb = colorBuffer(args[1]);
+        if (cb) {
+            cb->windowSurface = args[0];
+        }
+        pthread_mutex_unlock(&m_pixelReadLock);
+    } else if (m_call.opcode == OP_rcFlushWindowColorBuffer &&
+               m_call.argsSize >= sizeof(uint32_t)) {
+        pthread_mutex_lock(&m_pixelReadLock);
+        for (size_t i = 0; i < m_numColorBuffers; i++) {
+            if (m_colorBuffers[i].windowSurface == args[0]) {
+                m_colorBuffers[i].posts++;
+            }
+        }
+        pthread_mutex_unlock(&m_pixelReadLock);
+    } else if (m_call.opcode == OP_rcCloseColorBuffer && m_call.argsSize >= sizeof(uint32_t)) {
+        pthread_mutex_lock(&m_pixelReadLock);
+        for (size_t i = 0; i < m_numColorBuffers; i++) {
+            if (m_colorBuffers[i].handle == args[0]) {
+                m_colorBuffers[i] = m_colorBuffers[--m_numColorBuffers];
+                break;
+            }
+        }
+        pthread_mutex_unlock(&m_pixelReadLock);
+    }
+}
+
+// Called with m_pixelReadLock held
+FakeRenderStream::ColorBuffer *FakeRenderStream::colorBuffer(uint32_t handle)
+{
+    for (size_t i = 0; i < m_numColorBuffers; i++) {
+        if (m_colorBuffers[i].handle == handle) {
+            return &m_colorBuffers[i];
+        }
+    }
+    if (m_numColorBuffers == MAX_COLOR_BUFFERS) {
+        ERR("FakeRenderStream: too many color buffers\n");
+        return NULL;
+    }
+    ColorBuffer *cb = &m_colorBuffers[m_numColorBuffers++];
+    cb->handle = handle;
+    cb->windowSurface = 0;
+    cb->posts = 0;
+    return cb;
+}
+
+uint32_t FakeRenderStream::colorBufferPixel(uint32_t colorBuffer)
+{
+    pthread_mutex_lock(&m_pixelReadLock);
+    ColorBuffer *cb = this->colorBuffer(colorBuffer);
+    uint32_t posts = (cb ? cb->posts : 0);
+    pthread_mutex_unlock(&m_pixelReadLock);
+    return colorBuffer + (posts << 20);
+}
+
+bool FakeRenderStream::nextPixelRead(uint32_t *pixel)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&m_pixelReadLock);
+    if (m_pixelReadCount > 0) {
+        *pixel = m_pixelReads[m_firstPixelRead];
+        m_firstPixelRead = (m_firstPixelRead + 1) % MAX_PIXEL_READS;
+        m_pixelReadCount--;
+        found = true;
+    }
+    pthread_mutex_unlock(&m_pixelReadLock);
+    return found;
+}
+
+const unsigned char *FakeRenderStream::readFully(void *buf, size_t len)
+{
+    // The pixels of rcReadColorBuffer() are read in the order of the calls,
+    // possibly by another thread while the next calls are written: every
+    // pixel is set as colorBufferPixel() was when the call was received.
+    uint32_t pixel;
+    if (buf && nextPixelRead(&pixel)) {
+        uint32_t *pixels = (uint32_t *)buf;
+        for (size_t i = 0; i < len / sizeof(uint32_t); i++) {
+            pixels[i] = pixel;
+        }
+        m_stats.readbacks++;
+        m_stats.readbackBytes += len;
+        if (m_bandwidth > 0) {
+            waitTransfer(&m_readBusyUntil, len);
+        }
+        return (const unsigned char *)buf;
+    }
+
+    // The encoders read back empty output buffers too (e.g. when querying
+    // the size of a string): they still count as a readback of the call.
+    if (buf) {
+        memset(buf, 0, len);
+        m_stats.readbacks++;
+        m_stats.readbackBytes += len;
+
+        if (m_call.opcode >= OP_rcGetRendererVersion && m_call.opcode < OP_last) {
+            replyRenderControl(m_call, buf, len);
+        } else if (!fakeGLReply(this, m_call, buf, len)) {
+            fakeGL2Reply(this, m_call, buf, len);
+        }
+    }
+    m_call.readback++;
+    return (const unsigned char *)buf;
+}
+
+const unsigned char *FakeRenderStream::read(void *buf, size_t *inout_len)
+{
+    return readFully(buf, *inout_len);
+}
+
+void FakeRenderStream::replyRenderControl(const Call &call, void *buf, size_t len)
+{
+    const EGLint *args = (const EGLint *)call.args;
+    EGLint *reply = (EGLint *)buf;
+    int nargs = call.argsSize / sizeof(EGLint);
+
+    switch (call.opcode) {
+    case OP_rcGetRendererVersion:
+        reply[0] = 1;
+        break;
+
+    case OP_rcGetEGLVersion:
+        // major, minor, then the result
+        reply[0] = call.readback == 0 ? 1 : call.readback == 1 ? 4 : EGL_TRUE;
+        break;
+
+    case OP_rcQueryEGLString:
+    case OP_rcGetGLString:
+        // [name][size of buffer][bufferSize]: the buffer, then the size of
+        // the string, negated when it did not fit.
+        if (nargs >= 3) {
+            const char *str = lookupString(args[0]);
+            EGLint size = strlen(str) + 1;
+            if (call.readback == 0 && (size_t)size <= len) {
+                memcpy(buf, str, size);
+            } else if (call.readback == 1) {
+                reply[0] = args[2] < size ? -size : size;
+            }
+        }
+        break;
+
+    case OP_rcGetNumConfigs:
+        // the number of attributes, then the number of configs
+        reply[0] = call.readback == 0 ? NUM_CONFIG_ATTRIBS : numConfigs();
+        break;
+
+    case OP_rcGetConfigs:
+        // the attributes, then the configs, one attribute row each
+        if (call.readback == 0) {
+            size_t n = len / sizeof(EGLint);
+            for (size_t i = 0; i < n; i++) {
+                int row = i / NUM_CONFIG_ATTRIBS;
+                int col = i % NUM_CONFIG_ATTRIBS;
+                reply[i] = row == 0 ? s_configAttribs[col]
+                                    : getConfigAttrib(row - 1, s_configAttribs[col]);
+            }
+        } else {
+            reply[0] = numConfigs();
+        }
+        break;
+
+    case OP_rcChooseConfig: {
+        // [size][attribs][attribs_size][size][configs_size]: the configs when
+        // there is room for them, then their number.
+        size_t attribsSize = nargs > 0 ? args[0] : 0;
+        size_t count = attribsSize / sizeof(EGLint);
+        if ((size_t)nargs < count + 4) {
+            break;
+        }
+        const EGLint *attribs = args + 1;
+        bool hasConfigs = args[count + 2] > 0;
+        size_t room = hasConfigs ? args[count + 3] : 0;
+        size_t matched = 0;
+        for (int c = 0; c < numConfigs(); c++) {
+            if (matchConfig(c, attribs, count)) {
+                if (hasConfigs && call.readback == 0 && matched < room) {
+                    reply[matched] = c;
+                }
+                matched++;
+            }
+        }
+        if (call.readback == (hasConfigs ? 1 : 0)) {
+            reply[0] = hasConfigs && matched > room ? room : matched;
+        }
+        break;
+    }
+
+    case OP_rcCreateContext:
+    case OP_rcCreateWindowSurface:
+    case OP_rcCreateColorBuffer:
+        reply[0] = newName();
+        break;
+
+    case OP_rcGetFBParam:
+        reply[0] = 0;
+        break;
+
+    case OP_rcMakeCurrent:
+    case OP_rcColorBufferCacheFlush:
+        reply[0] = EGL_TRUE;
+        break;
+
+    default:
+        break;
+    }
+}
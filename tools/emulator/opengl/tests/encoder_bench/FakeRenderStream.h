@@ -0,0 +1,130 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __FAKE_RENDER_STREAM_H
+#define __FAKE_RENDER_STREAM_H
+
+/* This file implements an IOStream which plays the emulator's renderer in
+ * the same process: the packets written by the encoders are parsed and
+ * counted, then dropped, and readbacks get plausible replies (new object
+ * names, a table of EGL configs, complete framebuffers, ...) so that the
+ * guest libraries run as they would against a real renderer.
+ *
+ * The stream can also record everything it receives to a file, and take
+ * the time a transfer to the host would take, at a given bandwidth.
+ *
+ * The replies to rcReadColorBuffer() may be read from a thread of their
+ * own, while the next calls are written.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "IOStream.h"
+
+class FakeRenderStream : public IOStream {
+public:
+    explicit FakeRenderStream(size_t bufSize = 10000);
+    ~FakeRenderStream();
+
+    virtual void *allocBuffer(size_t minSize);
+    virtual int commitBuffer(size_t size);
+    virtual const unsigned char *readFully(void *buf, size_t len);
+    virtual const unsigned char *read(void *buf, size_t *inout_len);
+    virtual int writeFully(const void *buf, size_t len);
+
+    // Writes everything received, from the client flags on, to 'file'
+    void setRecordFile(FILE *file) { m_recordFile = file; }
+
+    // Makes writeFully() return once the data would have been sent at
+    // 'bytesPerSecond', 0 for no limit
+    void setBandwidth(double bytesPerSecond) { m_bandwidth = bytesPerSecond; }
+
+    struct Stats {
+        uint64_t calls;         // encoded packets
+        uint64_t bytes;         // bytes written by the encoders
+        uint64_t readbacks;     // readFully() calls, i.e. round-trips
+        uint64_t readbackBytes;
+    };
+    const Stats &stats() const { return m_stats; }
+
+    // The last complete packet, which the readbacks answer
+    struct Call {
+        uint32_t opcode;
+        const unsigned char *args;  // the first argsSize bytes of arguments
+        size_t argsSize;
+        int readback;               // index of the readback in the call
+    };
+
+    // Returns a new object name (context, surface, texture, shader...)
+    uint32_t newName() { return ++m_lastName; }
+
+    // The value of every pixel of a color buffer read back now: its handle,
+    // plus the frames posted from it so far in the high bits, so that the
+    // pixels of a previous frame differ
+    uint32_t colorBufferPixel(uint32_t colorBuffer);
+
+    // Number of EGL configs of the fake renderer
+    static int numConfigs();
+
+private:
+    void receive(const unsigned char *data, size_t len);
+    void waitTransfer(double *busyUntil, size_t len);
+    bool nextPixelRead(uint32_t *pixel);
+    void endPacket();
+    void replyRenderControl(const Call &call, void *buf, size_t len);
+
+    enum { MAX_ARGS_SIZE = 4096, MAX_PIXEL_READS = 64, MAX_COLOR_BUFFERS = 64 };
+
+    unsigned char *m_buf;
+    size_t m_bufsize;
+    FILE *m_recordFile;
+    double m_bandwidth;
+    double m_busyUntil;         // when the data written so far is sent
+    double m_readBusyUntil;
+    Stats m_stats;
+
+    size_t m_flagsLeft;         // bytes of client flags still to receive
+    unsigned char m_header[8];  // opcode and size of the current packet
+    size_t m_headerSize;
+    size_t m_packetLeft;        // bytes of the current packet still to receive
+    unsigned char m_args[MAX_ARGS_SIZE];
+    Call m_call;
+    uint32_t m_lastName;
+
+    // the pixels of the rcReadColorBuffer() calls not read back yet, and the
+    // color buffers which were set on window surfaces or posted
+    pthread_mutex_t m_pixelReadLock;
+    uint32_t m_pixelReads[MAX_PIXEL_READS];
+    size_t m_firstPixelRead;
+    size_t m_pixelReadCount;
+    struct ColorBuffer {
+        uint32_t handle;
+        uint32_t windowSurface;     // it is set on, or 0
+        uint32_t posts;
+    };
+    ColorBuffer m_colorBuffers[MAX_COLOR_BUFFERS];
+    size_t m_numColorBuffers;
+    ColorBuffer *colorBuffer(uint32_t handle);
+};
+
+// Replies to the readbacks of the GLES 1 and GLES 2 calls. They return false
+// when the opcode does not belong to their API.
+bool fakeGLReply(FakeRenderStream *stream, const FakeRenderStream::Call &call,
+                 void *buf, size_t len);
+bool fakeGL2Reply(FakeRenderStream *stream, const FakeRenderStream::Call &call,
+                  void *buf, size_t len);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef __WORKLOAD_H
+#define __WORKLOAD_H
+
+//
+// A workload draws frames with one of the GLES APIs. The GL functions are
+// looked up in the library of the API, as an application linked with it
+// would call them, so that the benchmark goes through the same entry
+// points.
+//
+struct Workload {
+    const char *name;
+    int glVersion;          // 1 or 2, for the context and the library
+    const char *libName;    // library with the GL entry points
+
+    // Looks up the GL functions in 'lib' and creates the objects of the
+    // workload, in the current context. Returns false on failure.
+    bool (*init)(void *lib, int width, int height);
+
+    // Draws frame 'frame', without swapping
+    void (*drawFrame)(int frame);
+};
+
+extern const Workload gles1Workload;
+extern const Workload gles2Workload;
+extern const Workload indexedWorkload;
+
+// Creates, links and deletes 'count' programs with the GLES 2 functions of
+// 'lib', in the current context. Returns false on failure.
+bool linkPrograms(void *lib, int count);
+
+// Uploads 'frames' RGBA frames of 'width' x 'height' pixels to a texture with
+// the GLES 2 functions of 'lib', in the current context, then waits for the
+// renderer. Returns false on failure.
+bool streamTexture(void *lib, int width, int height, int frames);
+
+// Draws 'frames' frames, each recorded in command lists by 'threads' worker
+// threads then submitted by the calling thread, in its current GLES 2
+// context, and waits for the renderer. The objects drawn are created with
+// the functions of 'lib'. Sets the calls per frame and returns the seconds
+// spent, or a negative value on failure.
+double recordCommandLists(void *lib, int threads, int frames, int *callsPerFrame);
+
+// Looks up 'name' in 'lib' into 'fn', reporting a failure
+bool lookupGLFunction(void *lib, const char *name, void **fn);
+
+#endif
@@ -0,0 +1,424 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+//
+// Draws recorded in command lists by worker threads, as an engine which
+// builds its draw lists in parallel does, then submitted in order by the
+// thread of the context, through the EGL_EMU_command_list extension.
+//
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include "CommandList.h"
+#include "EGLCommandList.h"
+#include "GLEncoder.h"
+#include "GL2Encoder.h"
+#include "gl2_opcodes.h"
+#include "Workload.h"
+
+#define COMMAND_LIST_FUNCTIONS(X) \
+    X(GLuint, glCreateShader, (GLenum type)) \
+    X(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar **string, const GLint *length)) \
+    X(void, glCompileShader, (GLuint shader)) \
+    X(GLuint, glCreateProgram, (void)) \
+    X(void, glAttachShader, (GLuint program, GLuint shader)) \
+    X(void, glBindAttribLocation, (GLuint program, GLuint index, const GLchar *name)) \
+    X(void, glLinkProgram, (GLuint program)) \
+    X(void, glUseProgram, (GLuint program)) \
+    X(GLint, glGetUniformLocation, (GLuint program, const GLchar *name)) \
+    X(void, glGenBuffers, (GLsizei n, GLuint *buffers)) \
+    X(void, glBindBuffer, (GLenum target, GLuint buffer)) \
+    X(void, glBufferData, (GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage)) \
+    X(void, glVertexAttribPointer, (GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *ptr)) \
+    X(void, glEnableVertexAttribArray, (GLuint index)) \
+    X(void, glDisableVertexAttribArray, (GLuint index)) \
+    X(void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)) \
+    X(void, glUniform4f, (GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)) \
+    X(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count)) \
+    X(void, glGenTextures, (GLsizei n, GLuint *textures)) \
+    X(void, glBindTexture, (GLenum target, GLuint texture)) \
+    X(void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels)) \
+    X(void, glReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid *pixels)) \
+    X(void, glFinish, (void))
+
+#define DECLARE_FUNCTION(ret, name, args) static ret (*p_##name) args;
+COMMAND_LIST_FUNCTIONS(DECLARE_FUNCTION)
+
+static PFNEGLCREATECOMMANDLISTEMUPROC p_eglCreateCommandListEMU;
+static PFNEGLDESTROYCOMMANDLISTEMUPROC p_eglDestroyCommandListEMU;
+static PFNEGLBEGINCOMMANDLISTEMUPROC p_eglBeginCommandListEMU;
+static PFNEGLENDCOMMANDLISTEMUPROC p_eglEndCommandListEMU;
+static PFNEGLSUBMITCOMMANDLISTSEMUPROC p_eglSubmitCommandListsEMU;
+static PFNEGLRESETCOMMANDLISTEMUPROC p_eglResetCommandListEMU;
+
+#define MAX_RECORDERS   8
+#define NUM_DRAWS       4096    // per frame, shared by the recorders
+#define NUM_TRIANGLES   64      // of the mesh, each draw draws 8 of them
+
+static const char s_vertexShader[] =
+    "uniform mat4 u_mvp;\n"
+    "attribute vec4 a_position;\n"
+    "void main() {\n"
+    "    gl_Position = u_mvp * a_position;\n"
+    "}\n";
+
+static const char s_fragmentShader[] =
+    "precision mediump float;\n"
+    "uniform vec4 u_color;\n"
+    "void main() {\n"
+    "    gl_FragColor = u_color;\n"
+    "}\n";
+
+static GLuint s_program;
+static GLint s_mvpLocation;
+static GLint s_colorLocation;
+static GLuint s_vertexBuffer;
+
+static EGLDisplay s_dpy;
+
+struct Recorder {
+    pthread_t thread;
+    EGLCommandListEMU list;
+    int firstDraw;
+    int numDraws;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_frameCond = PTHREAD_COND_INITIALIZER;  // a frame starts
+static pthread_cond_t s_doneCond = PTHREAD_COND_INITIALIZER;   // a list is recorded
+static int s_frame;             // to record, -1 to exit
+static int s_recording;         // recorders not done with the frame
+
+static GLuint loadShader(GLenum type, const char *source)
+{
+    GLuint shader = p_glCreateShader(type);
+
+    p_glShaderSource(shader, 1, &source, NULL);
+    p_glCompileShader(shader);
+    return shader;
+}
+
+static bool init(void *lib)
+{
+#define LOOKUP_FUNCTION(ret, name, args) \
+    if (!lookupGLFunction(lib, #name, (void **)&p_##name)) return false;
+    COMMAND_LIST_FUNCTIONS(LOOKUP_FUNCTION)
+
+    s_dpy = eglGetCurrentDisplay();
+    const char *extensions = eglQueryString(s_dpy, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_EMU_command_list ")) {
+        fprintf(stderr, "EGL_EMU_command_list is not supported\n");
+        return false;
+    }
+#define LOOKUP_EGL_FUNCTION(type, name) \
+    p_##name = (type)eglGetProcAddress(#name); \
+    if (!p_##name) { \
+        fprintf(stderr, "Could not find %s\n", #name); \
+        return false; \
+    }
+    LOOKUP_EGL_FUNCTION(PFNEGLCREATECOMMANDLISTEMUPROC, eglCreateCommandListEMU)
+    LOOKUP_EGL_FUNCTION(PFNEGLDESTROYCOMMANDLISTEMUPROC, eglDestroyCommandListEMU)
+    LOOKUP_EGL_FUNCTION(PFNEGLBEGINCOMMANDLISTEMUPROC, eglBeginCommandListEMU)
+    LOOKUP_EGL_FUNCTION(PFNEGLENDCOMMANDLISTEMUPROC, eglEndCommandListEMU)
+    LOOKUP_EGL_FUNCTION(PFNEGLSUBMITCOMMANDLISTSEMUPROC, eglSubmitCommandListsEMU)
+    LOOKUP_EGL_FUNCTION(PFNEGLRESETCOMMANDLISTEMUPROC, eglResetCommandListEMU)
+
+    s_program = p_glCreateProgram();
+    p_glAttachShader(s_program, loadShader(GL_VERTEX_SHADER, s_vertexShader));
+    p_glAttachShader(s_program, loadShader(GL_FRAGMENT_SHADER, s_fragmentShader));
+    p_glBindAttribLocation(s_program, 0, "a_position");
+    p_glLinkProgram(s_program);
+    p_glUseProgram(s_program);
+    s_mvpLocation = p_glGetUniformLocation(s_program, "u_mvp");
+    s_colorLocation = p_glGetUniformLocation(s_program, "u_color");
+
+    GLfloat vertices[NUM_TRIANGLES * 3][2];
+    for (int i = 0; i < NUM_TRIANGLES * 3; i++) {
+        vertices[i][0] = (i % 3 == 1 ? 0.1f : 0) + (i / 3) * 0.01f;
+        vertices[i][1] = (i % 3 == 2 ? 0.1f : 0);
+    }
+    p_glGenBuffers(1, &s_vertexBuffer);
+    p_glBindBuffer(GL_ARRAY_BUFFER, s_vertexBuffer);
+    p_glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    p_glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+// The commands of a list: the program the uniforms go to is set in the list,
+// and the bindings it changes are restored at the end
+static void recordDraws(Recorder *recorder, int frame)
+{
+    GLfloat mvp[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+
+    p_eglResetCommandListEMU(s_dpy, recorder->list);
+    p_eglBeginCommandListEMU(s_dpy, recorder->list);
+    p_glUseProgram(s_program);
+    p_glBindBuffer(GL_ARRAY_BUFFER, s_vertexBuffer);
+    p_glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    p_glEnableVertexAttribArray(0);
+    for (int i = recorder->firstDraw; i < recorder->firstDraw + recorder->numDraws; i++) {
+        mvp[12] = (i % 64) * 0.03f - 1;
+        mvp[13] = (i / 64) * 0.03f - 1 + frame * 0.001f;
+        p_glUniformMatrix4fv(s_mvpLocation, 1, GL_FALSE, mvp);
+        p_glUniform4f(s_colorLocation, (i % 7) / 7.0f, (i % 5) / 5.0f, 1, 1);
+        p_glDrawArrays(GL_TRIANGLES, (i % 8) * 24, 24);
+    }
+    p_glDisableVertexAttribArray(0);
+    p_glBindBuffer(GL_ARRAY_BUFFER, 0);
+    p_eglEndCommandListEMU(s_dpy);
+}
+
+static void *recordLoop(void *arg)
+{
+    Recorder *recorder = (Recorder *)arg;
+    int recorded = 0;
+
+    pthread_mutex_lock(&s_lock);
+    for (;;) {
+        while (s_frame == recorded) {
+            pthread_cond_wait(&s_frameCond, &s_lock);
+        }
+        if (s_frame < 0) {
+            break;
+        }
+        recorded = s_frame;
+        pthread_mutex_unlock(&s_lock);
+
+        recordDraws(recorder, recorded);
+
+        pthread_mutex_lock(&s_lock);
+        if (--s_recording == 0) {
+            pthread_cond_signal(&s_doneCond);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return NULL;
+}
+
+// Returns the arguments of the first packet of 'opcode' in 'list', or NULL
+static const unsigned char *findPacket(const CommandList &list, uint32_t opcode)
+{
+    const unsigned char *data = (const unsigned char *)list.data();
+    size_t offset = 0;
+
+    while (offset + 8 <= list.size()) {
+        uint32_t packet[2];
+        memcpy(packet, data + offset, sizeof(packet));
+        if (packet[1] < 8 || offset + packet[1] > list.size()) {
+            break;
+        }
+        if (packet[0] == opcode) {
+            return data + offset + 8;
+        }
+        offset += packet[1];
+    }
+    return NULL;
+}
+
+// A list can not hold a call which reads back: check that it is dropped
+static bool checkReadbackRejected()
+{
+    CommandList list;
+    gl2_encoder_context_t *enc = list.gl2Encoder();
+
+    enc->glUseProgram(enc, 1);
+    list.flush();
+    size_t size = list.size();
+    GLint value = -1;
+    enc->glGetIntegerv(enc, GL_CURRENT_PROGRAM, &value);
+    enc->glFlush(enc);
+    list.flush();
+    if (list.rejectedCalls() != 1 || value != 0 || list.size() <= size) {
+        fprintf(stderr, "The call reading back was not dropped from the list\n");
+        return false;
+    }
+    return true;
+}
+
+// The calls which use the client state or the programs of the context are
+// recorded with the same encoders as the contexts, over the state of the list:
+// the pixels are sent with their size, glReadPixels() is dropped, and the
+// uniform locations are translated when the host shifts them
+static bool checkListEncoders()
+{
+    enum { PROGRAM = 7, HOST_LOCATION = 2 << 16 };
+    GLSharedGroupPtr shared(new GLSharedGroup());
+    shared->addProgramData(PROGRAM);
+    shared->initProgramData(PROGRAM, 2);
+    shared->setProgramIndexInfo(PROGRAM, 0, 1 << 16, 1, GL_FLOAT_VEC4, "u_a");
+    shared->setProgramIndexInfo(PROGRAM, 1, HOST_LOCATION, 1, GL_FLOAT_VEC4, "u_b");
+    shared->setupLocationShiftWAR(PROGRAM);
+    GLint location = shared->locationWARHostToApp(PROGRAM, HOST_LOCATION, 0);
+
+    static const GLubyte pixels[4 * 4 * 4] = { 0 };
+    GLubyte readback[4 * 4 * 4];
+    bool ok = shared->needUniformLocationWAR(PROGRAM) && location != HOST_LOCATION;
+
+    CommandList list2;
+    list2.setSharedGroup(shared);
+    gl2_encoder_context_t *enc2 = list2.gl2Encoder();
+    enc2->glUseProgram(enc2, PROGRAM);
+    enc2->glUniform4f(enc2, location, 1, 2, 3, 4);
+    enc2->glTexImage2D(enc2, GL_TEXTURE_2D, 0, GL_RGBA, 4, 4, 0, GL_RGBA,
+                       GL_UNSIGNED_BYTE, pixels);
+    memset(readback, 0xff, sizeof(readback));
+    enc2->glReadPixels(enc2, 0, 0, 4, 4, GL_RGBA, GL_UNSIGNED_BYTE, readback);
+    list2.flush();
+
+    const unsigned char *args = findPacket(list2, OP_glUniform4f);
+    GLint sentLocation = 0;
+    if (args) {
+        memcpy(&sentLocation, args, sizeof(sentLocation));
+    }
+    ok = ok && sentLocation == HOST_LOCATION;
+    ok = ok && findPacket(list2, OP_glTexImage2D) != NULL;
+    ok = ok && list2.rejectedCalls() == 1 && readback[0] == 0 && !list2.failed();
+
+    CommandList list1;
+    gl_encoder_context_t *enc1 = list1.glEncoder();
+    enc1->glTexImage2D(enc1, GL_TEXTURE_2D, 0, GL_RGBA, 4, 4, 0, GL_RGBA,
+                       GL_UNSIGNED_BYTE, pixels);
+    list1.flush();
+    size_t size = list1.size();
+    memset(readback, 0xff, sizeof(readback));
+    enc1->glReadPixels(enc1, 0, 0, 4, 4, GL_RGBA, GL_UNSIGNED_BYTE, readback);
+    list1.flush();
+    ok = ok && size > sizeof(pixels) && list1.size() == size;
+    ok = ok && list1.rejectedCalls() == 1 && readback[0] == 0 && !list1.failed();
+
+    if (!ok) {
+        fprintf(stderr, "The list encoders did not record the calls as the contexts do\n");
+    }
+    return ok;
+}
+
+// The same calls, through the entry points and the extension
+static bool checkListCalls()
+{
+    static const GLubyte pixels[4 * 4 * 4] = { 0 };
+    GLubyte readback[4 * 4 * 4];
+    GLuint texture;
+
+    p_glGenTextures(1, &texture);
+    EGLCommandListEMU list = p_eglCreateCommandListEMU(s_dpy, NULL);
+    bool ok = (list != EGL_NO_COMMAND_LIST_EMU);
+    ok = ok && p_eglBeginCommandListEMU(s_dpy, list);
+    if (ok) {
+        p_glUseProgram(s_program);
+        p_glUniform4f(s_colorLocation, 1, 0, 0, 1);
+        p_glBindTexture(GL_TEXTURE_2D, texture);
+        p_glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 4, 4, 0, GL_RGBA,
+                       GL_UNSIGNED_BYTE, pixels);
+        memset(readback, 0xff, sizeof(readback));
+        p_glReadPixels(0, 0, 4, 4, GL_RGBA, GL_UNSIGNED_BYTE, readback);
+        p_glBindTexture(GL_TEXTURE_2D, 0);
+        ok = p_eglEndCommandListEMU(s_dpy) && readback[0] == 0;
+    }
+    ok = ok && p_eglSubmitCommandListsEMU(s_dpy, 1, &list);
+    ok = ok && p_eglDestroyCommandListEMU(s_dpy, list);
+    if (!ok) {
+        fprintf(stderr, "Could not record texture calls in a command list\n");
+    }
+    return ok;
+}
+
+// A list is recorded by one thread at a time, and can not be sent or reset
+// while it is
+static bool checkRecordingErrors()
+{
+    EGLCommandListEMU list = p_eglCreateCommandListEMU(s_dpy, NULL);
+    bool ok = (list != EGL_NO_COMMAND_LIST_EMU);
+
+    ok = ok && !p_eglEndCommandListEMU(s_dpy) && eglGetError() == EGL_BAD_ACCESS;
+    ok = ok && p_eglBeginCommandListEMU(s_dpy, list);
+    ok = ok && !p_eglBeginCommandListEMU(s_dpy, list) && eglGetError() == EGL_BAD_ACCESS;
+    ok = ok && !p_eglSubmitCommandListsEMU(s_dpy, 1, &list) && eglGetError() == EGL_BAD_ACCESS;
+    ok = ok && !p_eglResetCommandListEMU(s_dpy, list) && eglGetError() == EGL_BAD_ACCESS;
+    ok = ok && !p_eglDestroyCommandListEMU(s_dpy, list) && eglGetError() == EGL_BAD_ACCESS;
+    ok = ok && p_eglEndCommandListEMU(s_dpy);
+    ok = ok && p_eglSubmitCommandListsEMU(s_dpy, 1, &list);
+    ok = ok && p_eglDestroyCommandListEMU(s_dpy, list);
+    if (!ok) {
+        fprintf(stderr, "The command list calls did not fail as expected\n");
+    }
+    return ok;
+}
+
+double recordCommandLists(void *lib, int threads, int frames, int *callsPerFrame)
+{
+    static bool initialized;
+    if (!initialized) {
+        if (!init(lib) || !checkReadbackRejected() || !checkListEncoders() ||
+            !checkListCalls() || !checkRecordingErrors()) {
+            return -1;
+        }
+        initialized = true;
+    }
+    if (threads > MAX_RECORDERS) {
+        return -1;
+    }
+
+    Recorder recorders[MAX_RECORDERS];
+    EGLCommandListEMU lists[MAX_RECORDERS];
+    s_frame = 0;
+    for (int i = 0; i < threads; i++) {
+        recorders[i].firstDraw = NUM_DRAWS * i / threads;
+        recorders[i].numDraws = NUM_DRAWS * (i + 1) / threads - recorders[i].firstDraw;
+        recorders[i].list = p_eglCreateCommandListEMU(s_dpy, NULL);
+        lists[i] = recorders[i].list;
+        if (pthread_create(&recorders[i].thread, NULL, recordLoop, &recorders[i]) != 0) {
+            fprintf(stderr, "Could not start the recording threads\n");
+            return -1;
+        }
+    }
+
+    struct timespec start, end;
+    bool ok = true;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int frame = 1; frame <= frames && ok; frame++) {
+        pthread_mutex_lock(&s_lock);
+        s_frame = frame;
+        s_recording = threads;
+        pthread_cond_broadcast(&s_frameCond);
+        while (s_recording > 0) {
+            pthread_cond_wait(&s_doneCond, &s_lock);
+        }
+        pthread_mutex_unlock(&s_lock);
+
+        ok = p_eglSubmitCommandListsEMU(s_dpy, threads, lists);
+    }
+    p_glFinish();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pthread_mutex_lock(&s_lock);
+    s_frame = -1;
+    pthread_cond_broadcast(&s_frameCond);
+    pthread_mutex_unlock(&s_lock);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(recorders[i].thread, NULL);
+        p_eglDestroyCommandListEMU(s_dpy, recorders[i].list);
+    }
+    if (!ok) {
+        fprintf(stderr, "Could not submit the command lists\n");
+        return -1;
+    }
+
+    *callsPerFrame = NUM_DRAWS * 3 + threads * 6;
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
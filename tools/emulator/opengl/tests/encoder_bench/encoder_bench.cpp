@@ -0,0 +1,606 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+//
+// Encoder benchmark: runs the guest EGL and GLES libraries on the host,
+// against a fake renderer in the same process, and reports the cost of
+// encoding GLES 1 and GLES 2 frames: encoded calls per second, bytes and
+// readbacks (round-trips to the renderer) per frame.
+//
+// usage: emugl_encoder_bench [-n frames] [-o recordfile] [-c programcache]
+//                            [-b bandwidth]
+//
+// The program cache file, a temporary one by default, is where the linked
+// programs are saved and loaded from.
+//
+// The texture streaming and readback runs transfer 1080p frames to and from
+// a renderer at 'bandwidth' MB/s, 2000 by default: synchronously, then with
+// the asynchronous transfers of the staging streams.
+//
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <EGL/egl.h>
+#include "ColorBufferPrefetch.h"
+#include "HostConnection.h"
+#include "ProgramCache.h"
+#include "ThreadInfo.h"
+#include "FakeRenderStream.h"
+#include "FakeNativeWindow.h"
+#include "Workload.h"
+
+#define WINDOW_WIDTH    480
+#define WINDOW_HEIGHT   800
+#define WARMUP_FRAMES   10
+#define NUM_PROGRAMS    100
+#define VIDEO_WIDTH     1920
+#define VIDEO_HEIGHT    1080
+
+static FakeRenderStream *s_stream;
+static FILE *s_recordFile;
+
+// Set for the connections of the texture streaming and readback runs
+static double s_bandwidth;
+
+static IOStream *createFakeStream(size_t bufSize)
+{
+    s_stream = new FakeRenderStream(bufSize);
+    if (s_bandwidth > 0) {
+        s_stream->setBandwidth(s_bandwidth);
+    } else {
+        s_stream->setRecordFile(s_recordFile);
+    }
+    return s_stream;
+}
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool lookupGLFunction(void *lib, const char *name, void **fn)
+{
+    *fn = dlsym(lib, name);
+    if (!*fn) {
+        fprintf(stderr, "Could not find %s: %s\n", name, dlerror());
+        return false;
+    }
+    return true;
+}
+
+static bool runWorkload(const Workload &workload, EGLDisplay dpy, EGLConfig config,
+                        EGLSurface surface, int frames)
+{
+    void *lib = dlopen(workload.libName, RTLD_NOW);
+    if (!lib) {
+        fprintf(stderr, "Could not load %s: %s\n", workload.libName, dlerror());
+        return false;
+    }
+
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, workload.glVersion, EGL_NONE };
+    EGLContext context = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(dpy, surface, surface, context)) {
+        fprintf(stderr, "%s: could not create the context: 0x%x\n", workload.name, eglGetError());
+        return false;
+    }
+    if (!workload.init(lib, WINDOW_WIDTH, WINDOW_HEIGHT)) {
+        fprintf(stderr, "%s: could not initialize the workload\n", workload.name);
+        return false;
+    }
+
+    for (int i = 0; i < WARMUP_FRAMES; i++) {
+        workload.drawFrame(i);
+        eglSwapBuffers(dpy, surface);
+    }
+
+    FakeRenderStream::Stats start = s_stream->stats();
+    const ScratchArena *scratch = HostConnection::get()->scratchArena();
+    ScratchArena::Stats scratchStart = scratch->stats();
+    double startTime = now();
+    for (int i = 0; i < frames; i++) {
+        workload.drawFrame(WARMUP_FRAMES + i);
+        eglSwapBuffers(dpy, surface);
+    }
+    double elapsed = now() - startTime;
+    const FakeRenderStream::Stats &end = s_stream->stats();
+    const ScratchArena::Stats &scratchEnd = scratch->stats();
+
+    double calls = end.calls - start.calls;
+    printf("%-6s %6d frames  %8.0f frames/s  %10.0f calls/s  %7.0f ns/call  "
+           "%6.0f calls/frame  %8.0f bytes/frame  %5.1f readbacks/frame\n",
+           workload.name, frames, frames / elapsed, calls / elapsed, elapsed * 1e9 / calls,
+           calls / frames, (double)(end.bytes - start.bytes) / frames,
+           (double)(end.readbacks - start.readbacks) / frames);
+    if (scratchEnd.allocs > scratchStart.allocs) {
+        // the temporaries of the encoder, once warmed up, come from the blocks held
+        printf("%-6s scratch  %5.1f allocations/frame  %llu from the heap  "
+               "peak %.1f KB  %.1f KB held\n", workload.name,
+               (double)(scratchEnd.allocs - scratchStart.allocs) / frames,
+               (unsigned long long)(scratchEnd.blockAllocs - scratchStart.blockAllocs),
+               scratchEnd.peakSize / 1024.0, scratchEnd.heldSize / 1024.0);
+    }
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(dpy, context);
+    return true;
+}
+
+// eglChooseConfig() and eglGetConfigAttrib(), as called for every surface
+static bool runConfigQueries(EGLDisplay dpy, const EGLint *configAttribs, int iterations)
+{
+    EGLConfig configs[64];
+    EGLint numConfigs = 0;
+
+    FakeRenderStream::Stats start = s_stream->stats();
+    double startTime = now();
+    for (int i = 0; i < iterations; i++) {
+        if (!eglChooseConfig(dpy, configAttribs, configs, 64, &numConfigs) || numConfigs < 1) {
+            fprintf(stderr, "eglChooseConfig failed: 0x%x\n", eglGetError());
+            return false;
+        }
+    }
+    double chooseTime = now() - startTime;
+    uint64_t chooseReadbacks = s_stream->stats().readbacks - start.readbacks;
+
+    EGLint value;
+    startTime = now();
+    for (int i = 0; i < iterations; i++) {
+        eglGetConfigAttrib(dpy, configs[i % numConfigs], EGL_DEPTH_SIZE, &value);
+    }
+    double attribTime = now() - startTime;
+
+    printf("config %6d calls   eglChooseConfig %7.0f ns/call %4.1f readbacks/call  "
+           "eglGetConfigAttrib %5.0f ns/call\n",
+           iterations, chooseTime * 1e9 / iterations, (double)chooseReadbacks / iterations,
+           attribTime * 1e9 / iterations);
+    return true;
+}
+
+// eglMakeCurrent() with an unchanged binding, as toolkits do many times per
+// frame, then switching between a window and a pbuffer surface
+static bool runMakeCurrent(EGLDisplay dpy, EGLConfig config, EGLSurface surface, int iterations)
+{
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    const EGLint pbufferAttribs[] = { EGL_WIDTH, 64, EGL_HEIGHT, 64, EGL_NONE };
+    EGLContext context = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+    EGLSurface pbuffer = eglCreatePbufferSurface(dpy, config, pbufferAttribs);
+    if (context == EGL_NO_CONTEXT || pbuffer == EGL_NO_SURFACE) {
+        fprintf(stderr, "Could not create the context and pbuffer: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        EGLThreadInfo *tInfo = getEGLThreadInfo();
+        unsigned int elided = tInfo->makeCurrentElided;
+        FakeRenderStream::Stats start = s_stream->stats();
+        double startTime = now();
+        for (int i = 0; i < iterations; i++) {
+            EGLSurface draw = (pass == 1 && (i & 1)) ? pbuffer : surface;
+            if (!eglMakeCurrent(dpy, draw, draw, context)) {
+                fprintf(stderr, "eglMakeCurrent failed: 0x%x\n", eglGetError());
+                return false;
+            }
+        }
+        double elapsed = now() - startTime;
+
+        printf("%-14s %6d calls   %7.0f ns/call  %4.2f readbacks/call  %d elided\n",
+               pass ? "makecur switch" : "makecur same", iterations, elapsed * 1e9 / iterations,
+               (double)(s_stream->stats().readbacks - start.readbacks) / iterations,
+               tInfo->makeCurrentElided - elided);
+    }
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(dpy, pbuffer);
+    eglDestroyContext(dpy, context);
+    return true;
+}
+
+// Links the same programs in two unrelated contexts: the second time, they
+// come from the program cache. Then checks that they were saved to the
+// cache file by eglSwapBuffers().
+static bool runProgramLinks(EGLDisplay dpy, EGLConfig config, EGLSurface surface,
+                            const char *cachePath)
+{
+    void *lib = dlopen(gles2Workload.libName, RTLD_NOW);
+    if (!lib) {
+        fprintf(stderr, "Could not load %s: %s\n", gles2Workload.libName, dlerror());
+        return false;
+    }
+
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    for (int pass = 0; pass < 2; pass++) {
+        EGLContext context = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(dpy, surface, surface, context)) {
+            fprintf(stderr, "Could not create the context: 0x%x\n", eglGetError());
+            return false;
+        }
+
+        FakeRenderStream::Stats start = s_stream->stats();
+        double startTime = now();
+        if (!linkPrograms(lib, NUM_PROGRAMS)) {
+            return false;
+        }
+        double elapsed = now() - startTime;
+
+        printf("%-14s %6d links   %7.0f ns/link  %5.1f readbacks/link\n",
+               pass ? "link cached" : "link", NUM_PROGRAMS, elapsed * 1e9 / NUM_PROGRAMS,
+               (double)(s_stream->stats().readbacks - start.readbacks) / NUM_PROGRAMS);
+
+        eglSwapBuffers(dpy, surface);
+        eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(dpy, context);
+    }
+
+    ProgramCache *cache = HostConnection::get()->programCache();
+    ProgramCache saved(cache->salt());
+    if (!saved.load(cachePath) || saved.count() != cache->count()) {
+        fprintf(stderr, "%s: %d programs saved instead of %d\n", cachePath,
+                (int)saved.count(), (int)cache->count());
+        return false;
+    }
+    printf("program cache  %6d programs  %7d bytes\n", (int)saved.count(), (int)saved.size());
+    return true;
+}
+
+// The same draws recorded in command lists by more and more threads, then
+// submitted by this one
+static bool runCommandLists(EGLDisplay dpy, EGLConfig config, EGLSurface surface, int frames)
+{
+    void *lib = dlopen(gles2Workload.libName, RTLD_NOW);
+    if (!lib) {
+        fprintf(stderr, "Could not load %s: %s\n", gles2Workload.libName, dlerror());
+        return false;
+    }
+
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    EGLContext context = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(dpy, surface, surface, context)) {
+        fprintf(stderr, "Could not create the context: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    static const int threadCounts[] = { 1, 2, 4, 8 };
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        int threads = threadCounts[i];
+        int callsPerFrame = 0;
+        FakeRenderStream::Stats start = s_stream->stats();
+        double elapsed = recordCommandLists(lib, threads, frames, &callsPerFrame);
+        if (elapsed < 0) {
+            return false;
+        }
+
+        // every call recorded must have reached the renderer
+        uint64_t calls = s_stream->stats().calls - start.calls;
+        if (calls < (uint64_t)callsPerFrame * frames) {
+            fprintf(stderr, "%d threads: %llu calls received instead of %d\n", threads,
+                    (unsigned long long)calls, callsPerFrame * frames);
+            return false;
+        }
+        printf("lists %d thread%s %6d frames  %8.1f frames/s  %10.0f calls/s  %7.0f ns/call\n",
+               threads, threads > 1 ? "s" : " ", frames, frames / elapsed,
+               callsPerFrame * frames / elapsed, elapsed * 1e9 / (callsPerFrame * frames));
+    }
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(dpy, context);
+    return true;
+}
+
+struct Run {
+    EGLDisplay dpy;
+    EGLConfig config;
+    EGLSurface surface;
+    int frames;
+    bool (*fn)(const Run &run, bool async);
+    bool async;
+    bool ok;
+};
+
+static void *runThread(void *arg)
+{
+    Run *run = (Run *)arg;
+    run->ok = run->fn(*run, run->async);
+    return NULL;
+}
+
+// Runs 'fn' in a thread of its own, with a connection of its own to a
+// renderer of the given bandwidth: once without, and once with the
+// asynchronous transfers of the staging streams.
+static bool runOnNewConnections(const Run &run, double bandwidth)
+{
+    FakeRenderStream *mainStream = s_stream;
+    Run threadRun = run;
+
+    s_bandwidth = bandwidth;
+    for (int pass = 0; pass < 2; pass++) {
+        pthread_t thread;
+        HostConnection::setStagingEnabled(pass == 1);
+        threadRun.async = (pass == 1);
+        threadRun.ok = false;
+        if (pthread_create(&thread, NULL, runThread, &threadRun) != 0) {
+            fprintf(stderr, "Could not start the benchmark thread\n");
+            break;
+        }
+        pthread_join(thread, NULL);
+        if (!threadRun.ok) {
+            break;
+        }
+    }
+    HostConnection::setStagingEnabled(true);
+    s_bandwidth = 0;
+    s_stream = mainStream;
+    return threadRun.ok;
+}
+
+// 1080p video frames uploaded to a texture
+static bool streamVideo(const Run &run, bool async)
+{
+    void *lib = dlopen(gles2Workload.libName, RTLD_NOW);
+    if (!lib) {
+        fprintf(stderr, "Could not load %s: %s\n", gles2Workload.libName, dlerror());
+        return false;
+    }
+
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    EGLContext context = eglCreateContext(run.dpy, run.config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(run.dpy, run.surface, run.surface, context)) {
+        fprintf(stderr, "Could not create the context: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    FakeRenderStream::Stats start = s_stream->stats();
+    double startTime = now();
+    if (!streamTexture(lib, VIDEO_WIDTH, VIDEO_HEIGHT, run.frames)) {
+        fprintf(stderr, "Could not stream the texture\n");
+        return false;
+    }
+    double elapsed = now() - startTime;
+
+    printf("%-14s %6d frames  %8.1f frames/s  %6.0f MB/s  %9.0f bytes/frame\n",
+           async ? "video staged" : "video", run.frames, run.frames / elapsed,
+           (s_stream->stats().bytes - start.bytes) / elapsed / 1e6,
+           (double)(s_stream->stats().bytes - start.bytes) / run.frames);
+
+    eglMakeCurrent(run.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(run.dpy, context);
+    return true;
+}
+
+// Goes through the pixels of a frame read back, as a screen recorder would
+// encode it. 'pixel' is the value of its pixels on the host when it was
+// locked.
+static bool processFrame(const cb_handle_t *cb, uint32_t pixel)
+{
+    const uint32_t *pixels = (const uint32_t *)(intptr_t)cb->ashmemBase;
+    uint32_t sum = 0;
+    for (int i = 0; i < cb->width * cb->height; i++) {
+        sum += pixels[i];
+    }
+    if (sum != pixel * (uint32_t)(cb->width * cb->height)) {
+        fprintf(stderr, "Color buffer %u was not read back, or from an older frame\n",
+                cb->hostHandle);
+        return false;
+    }
+    return true;
+}
+
+// Frames dropped by the consumer, so that the buffer it locks was posted
+// before, and a frame written by the CPU while it may be read ahead
+static bool checkStaleFrames(const Run &run, EGLSurface surface, FakeNativeWindow *window)
+{
+    for (int i = 0; i <= FakeNativeWindow::NUM_BUFFERS; i++) {
+        gles2Workload.drawFrame(i);
+        eglSwapBuffers(run.dpy, surface);
+    }
+    cb_handle_t *cb = window->queuedBuffer();
+    readColorBuffer(cb);
+    if (!processFrame(cb, s_stream->colorBufferPixel(cb->hostHandle))) {
+        return false;
+    }
+
+    // a lock for writing waits for the read ahead, as gralloc_lock() does
+    gles2Workload.drawFrame(0);
+    eglSwapBuffers(run.dpy, surface);
+    cb = window->queuedBuffer();
+    cancelColorBufferPrefetch(cb);
+    memset((void *)(intptr_t)cb->ashmemBase, 0, cb->width * cb->height * 4);
+    HostConnection::get()->rcEncoder()->rcGetRendererVersion(HostConnection::get()->rcEncoder());
+    if (!processFrame(cb, 0)) {
+        fprintf(stderr, "The pixels written were overwritten by a read ahead\n");
+        return false;
+    }
+    return true;
+}
+
+// 1080p GLES 2 frames read back by a software consumer: with frequent reads,
+// the frames are read ahead when they are posted.
+static bool readFrames(const Run &run, bool async)
+{
+    void *lib = dlopen(gles2Workload.libName, RTLD_NOW);
+    if (!lib) {
+        fprintf(stderr, "Could not load %s: %s\n", gles2Workload.libName, dlerror());
+        return false;
+    }
+
+    FakeNativeWindow window(VIDEO_WIDTH, VIDEO_HEIGHT,
+            async ? GRALLOC_USAGE_SW_READ_OFTEN : GRALLOC_USAGE_SW_READ_RARELY);
+    EGLSurface surface = eglCreateWindowSurface(run.dpy, run.config, &window, NULL);
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    EGLContext context = eglCreateContext(run.dpy, run.config, EGL_NO_CONTEXT, contextAttribs);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(run.dpy, surface, surface, context)) {
+        fprintf(stderr, "Could not create the surface and context: 0x%x\n", eglGetError());
+        return false;
+    }
+    if (!gles2Workload.init(lib, VIDEO_WIDTH, VIDEO_HEIGHT)) {
+        fprintf(stderr, "Could not initialize the workload\n");
+        return false;
+    }
+
+    // Every frame is locked for reading as gralloc does, once the previous
+    // one has been processed
+    FakeRenderStream::Stats start = s_stream->stats();
+    double startTime = now();
+    cb_handle_t *previous = NULL;
+    uint32_t pixel = 0;
+    for (int i = 0; i < run.frames; i++) {
+        gles2Workload.drawFrame(i);
+        eglSwapBuffers(run.dpy, surface);
+        if (previous && !processFrame(previous, pixel)) {
+            return false;
+        }
+        previous = window.queuedBuffer();
+        readColorBuffer(previous);
+        pixel = s_stream->colorBufferPixel(previous->hostHandle);
+    }
+    if (!processFrame(previous, pixel)) {
+        return false;
+    }
+    double elapsed = now() - startTime;
+    if (!checkStaleFrames(run, surface, &window)) {
+        return false;
+    }
+
+    printf("%-14s %6d frames  %8.1f frames/s  %6.0f MB/s read back\n",
+           async ? "readback ahead" : "readback", run.frames, run.frames / elapsed,
+           (s_stream->stats().readbackBytes - start.readbackBytes) / elapsed / 1e6);
+
+    eglMakeCurrent(run.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(run.dpy, context);
+    eglDestroySurface(run.dpy, surface);
+    return true;
+}
+
+static void usage(const char *progName)
+{
+    fprintf(stderr, "usage: %s [-n frames] [-o recordfile] [-c programcache] [-b bandwidth]\n",
+            progName);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 1000;
+    char cachePath[] = "/tmp/emugl_program_cache.XXXXXX";
+    bool tempCache = true;
+    double bandwidth = 2000;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:o:c:b:")) != -1) {
+        switch (c) {
+        case 'n':
+            frames = atoi(optarg);
+            if (frames <= 0) usage(argv[0]);
+            break;
+        case 'o':
+            s_recordFile = fopen(optarg, "wb");
+            if (!s_recordFile) {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        case 'c':
+            setenv("EMUGL_PROGRAM_CACHE", optarg, 1);
+            tempCache = false;
+            break;
+        case 'b':
+            bandwidth = atof(optarg);
+            if (bandwidth <= 0) usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (tempCache) {
+        int fd = mkstemp(cachePath);
+        if (fd < 0) {
+            perror(cachePath);
+            return 1;
+        }
+        close(fd);
+        setenv("EMUGL_PROGRAM_CACHE", cachePath, 1);
+    }
+
+    HostConnection::setStreamFactory(createFakeStream);
+
+    EGLDisplay dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (!eglInitialize(dpy, &major, &minor)) {
+        fprintf(stderr, "eglInitialize failed: 0x%x\n", eglGetError());
+        return 1;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 16,
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES_BIT | EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(dpy, configAttribs, &config, 1, &numConfigs) || numConfigs < 1) {
+        fprintf(stderr, "eglChooseConfig failed: 0x%x\n", eglGetError());
+        return 1;
+    }
+
+    FakeNativeWindow window(WINDOW_WIDTH, WINDOW_HEIGHT);
+    EGLSurface surface = eglCreateWindowSurface(dpy, config, &window, NULL);
+    if (surface == EGL_NO_SURFACE) {
+        fprintf(stderr, "eglCreateWindowSurface failed: 0x%x\n", eglGetError());
+        return 1;
+    }
+
+    printf("EGL %d.%d, %d configs, %dx%d window\n", major, minor,
+           FakeRenderStream::numConfigs(), WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    const Run streamingRun = { dpy, config, surface, frames / 10, streamVideo };
+    const Run readbackRun = { dpy, config, EGL_NO_SURFACE, frames / 10, readFrames };
+    int status = 0;
+    if (!runConfigQueries(dpy, configAttribs, frames * 10) ||
+        !runMakeCurrent(dpy, config, surface, frames * 10) ||
+        !runWorkload(gles1Workload, dpy, config, surface, frames) ||
+        !runWorkload(gles2Workload, dpy, config, surface, frames) ||
+        !runWorkload(indexedWorkload, dpy, config, surface, frames) ||
+        !runProgramLinks(dpy, config, surface, getenv("EMUGL_PROGRAM_CACHE")) ||
+        !runCommandLists(dpy, config, surface, frames / 10) ||
+        !runOnNewConnections(streamingRun, bandwidth * 1e6) ||
+        !runOnNewConnections(readbackRun, bandwidth * 1e6)) {
+        status = 1;
+    }
+
+    eglDestroySurface(dpy, surface);
+    eglTerminate(dpy);
+    if (tempCache) {
+        unlink(cachePath);
+    }
+    if (s_recordFile) {
+        s_stream->flush();
+        fclose(s_recordFile);
+    }
+    return status;
+}
@@ -0,0 +1,148 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "Workload.h"
+#include <math.h>
+#include <GLES/gl.h>
+
+//
+// A fixed function scene in the style of the san-angeles demo: lit and
+// colored objects drawn from client arrays, each with its own transform.
+//
+#define GLES1_FUNCTIONS(X) \
+    X(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height)) \
+    X(void, glClearColor, (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)) \
+    X(void, glClear, (GLbitfield mask)) \
+    X(void, glEnable, (GLenum cap)) \
+    X(void, glShadeModel, (GLenum mode)) \
+    X(void, glMatrixMode, (GLenum mode)) \
+    X(void, glLoadIdentity, (void)) \
+    X(void, glFrustumf, (GLfloat left, GLfloat right, GLfloat bottom, GLfloat top, GLfloat zNear, GLfloat zFar)) \
+    X(void, glPushMatrix, (void)) \
+    X(void, glPopMatrix, (void)) \
+    X(void, glTranslatef, (GLfloat x, GLfloat y, GLfloat z)) \
+    X(void, glRotatef, (GLfloat angle, GLfloat x, GLfloat y, GLfloat z)) \
+    X(void, glLightfv, (GLenum light, GLenum pname, const GLfloat *params)) \
+    X(void, glMaterialfv, (GLenum face, GLenum pname, const GLfloat *params)) \
+    X(void, glEnableClientState, (GLenum array)) \
+    X(void, glVertexPointer, (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)) \
+    X(void, glNormalPointer, (GLenum type, GLsizei stride, const GLvoid *pointer)) \
+    X(void, glColorPointer, (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)) \
+    X(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count))
+
+#define DECLARE_FUNCTION(ret, name, args) static ret (*p_##name) args;
+GLES1_FUNCTIONS(DECLARE_FUNCTION)
+
+#define NUM_OBJECTS     64
+#define NUM_SLICES      32      // triangles of each object
+
+struct Vertex {
+    GLfloat position[3];
+    GLfloat normal[3];
+    GLubyte color[4];
+};
+
+static Vertex s_vertices[NUM_SLICES * 3];
+
+// A cone-like object: NUM_SLICES triangles around the Z axis
+static void buildObject()
+{
+    for (int i = 0; i < NUM_SLICES; i++) {
+        float a0 = 2 * M_PI * i / NUM_SLICES;
+        float a1 = 2 * M_PI * (i + 1) / NUM_SLICES;
+        Vertex *v = &s_vertices[i * 3];
+        float corners[3][3] = {
+            { 0, 0, 1 },
+            { cosf(a0), sinf(a0), 0 },
+            { cosf(a1), sinf(a1), 0 }
+        };
+        for (int k = 0; k < 3; k++) {
+            for (int c = 0; c < 3; c++) {
+                v[k].position[c] = corners[k][c];
+                v[k].normal[c] = corners[k][c];
+            }
+            v[k].color[0] = 128 + 127 * cosf(a0);
+            v[k].color[1] = 128 + 127 * sinf(a0);
+            v[k].color[2] = 255 * k / 2;
+            v[k].color[3] = 255;
+        }
+    }
+}
+
+static bool init(void *lib, int width, int height)
+{
+#define LOOKUP_FUNCTION(ret, name, args) \
+    if (!lookupGLFunction(lib, #name, (void **)&p_##name)) return false;
+    GLES1_FUNCTIONS(LOOKUP_FUNCTION)
+
+    static const GLfloat lightPosition[] = { -4, 1, 1, 0 };
+    static const GLfloat lightDiffuse[] = { 1, 0.4f, 0, 1 };
+
+    buildObject();
+
+    p_glViewport(0, 0, width, height);
+    p_glClearColor(0.1f, 0.2f, 0.3f, 1);
+    p_glEnable(GL_DEPTH_TEST);
+    p_glEnable(GL_CULL_FACE);
+    p_glShadeModel(GL_FLAT);
+    p_glEnable(GL_LIGHTING);
+    p_glEnable(GL_LIGHT0);
+    p_glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
+    p_glLightfv(GL_LIGHT0, GL_DIFFUSE, lightDiffuse);
+    p_glEnable(GL_COLOR_MATERIAL);
+
+    p_glMatrixMode(GL_PROJECTION);
+    p_glLoadIdentity();
+    p_glFrustumf(-1, 1, -(float)height / width, (float)height / width, 1, 100);
+    p_glMatrixMode(GL_MODELVIEW);
+    return true;
+}
+
+static void drawFrame(int frame)
+{
+    static const GLfloat specular[] = { 0.5f, 0.5f, 0.5f, 1 };
+
+    p_glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    p_glLoadIdentity();
+    p_glTranslatef(0, 0, -20);
+    p_glRotatef(frame * 0.5f, 0, 1, 0);
+
+    p_glEnableClientState(GL_VERTEX_ARRAY);
+    p_glEnableClientState(GL_NORMAL_ARRAY);
+    p_glEnableClientState(GL_COLOR_ARRAY);
+
+    for (int i = 0; i < NUM_OBJECTS; i++) {
+        p_glPushMatrix();
+        p_glTranslatef((i % 8) * 2.0f - 7, (i / 8) * 2.0f - 7, 0);
+        p_glRotatef(frame + i * 10.0f, 1, 1, 0);
+        p_glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, specular);
+
+        // The arrays are client memory: the encoder sends the vertices
+        // with each draw.
+        p_glVertexPointer(3, GL_FLOAT, sizeof(Vertex), s_vertices[0].position);
+        p_glNormalPointer(GL_FLOAT, sizeof(Vertex), s_vertices[0].normal);
+        p_glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), s_vertices[0].color);
+        p_glDrawArrays(GL_TRIANGLES, 0, NUM_SLICES * 3);
+        p_glPopMatrix();
+    }
+}
+
+const Workload gles1Workload = {
+    "gles1",
+    1,
+    "libGLESv1_CM_emulation.so",
+    init,
+    drawFrame
+};
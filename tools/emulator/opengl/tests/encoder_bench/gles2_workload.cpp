@@ -0,0 +1,237 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "Workload.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <GLES2/gl2.h>
+
+//
+// A shader based scene in the style of the hello-gl2 sample: a static mesh
+// in buffer objects drawn many times with per object uniforms, plus a
+// streamed mesh drawn from client memory.
+//
+#define GLES2_FUNCTIONS(X) \
+    X(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height)) \
+    X(void, glClearColor, (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)) \
+    X(void, glClear, (GLbitfield mask)) \
+    X(void, glEnable, (GLenum cap)) \
+    X(GLuint, glCreateShader, (GLenum type)) \
+    X(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar **string, const GLint *length)) \
+    X(void, glCompileShader, (GLuint shader)) \
+    X(void, glGetShaderiv, (GLuint shader, GLenum pname, GLint *params)) \
+    X(GLuint, glCreateProgram, (void)) \
+    X(void, glAttachShader, (GLuint program, GLuint shader)) \
+    X(void, glBindAttribLocation, (GLuint program, GLuint index, const GLchar *name)) \
+    X(void, glLinkProgram, (GLuint program)) \
+    X(void, glGetProgramiv, (GLuint program, GLenum pname, GLint *params)) \
+    X(void, glUseProgram, (GLuint program)) \
+    X(GLint, glGetUniformLocation, (GLuint program, const GLchar *name)) \
+    X(void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)) \
+    X(void, glUniform4f, (GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)) \
+    X(void, glGenBuffers, (GLsizei n, GLuint *buffers)) \
+    X(void, glBindBuffer, (GLenum target, GLuint buffer)) \
+    X(void, glBufferData, (GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage)) \
+    X(void, glVertexAttribPointer, (GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *ptr)) \
+    X(void, glEnableVertexAttribArray, (GLuint index)) \
+    X(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)) \
+    X(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count))
+
+#define DECLARE_FUNCTION(ret, name, args) static ret (*p_##name) args;
+GLES2_FUNCTIONS(DECLARE_FUNCTION)
+
+#define NUM_OBJECTS     64
+#define GRID_SIZE       16      // the static mesh is a GRID_SIZE x GRID_SIZE grid
+#define NUM_STREAMED    256     // vertices of the streamed mesh
+
+static const char s_vertexShader[] =
+    "uniform mat4 u_mvp;\n"
+    "attribute vec4 a_position;\n"
+    "attribute vec4 a_color;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "    gl_Position = u_mvp * a_position;\n"
+    "    v_color = a_color;\n"
+    "}\n";
+
+static const char s_fragmentShader[] =
+    "precision mediump float;\n"
+    "uniform vec4 u_tint;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "    gl_FragColor = v_color * u_tint;\n"
+    "}\n";
+
+static GLuint s_program;
+static GLint s_mvpLocation;
+static GLint s_tintLocation;
+static GLuint s_buffers[2];     // vertices and indices of the static mesh
+static int s_numIndices;
+static GLfloat s_streamed[NUM_STREAMED * 2];
+
+static GLuint loadShader(GLenum type, const char *source)
+{
+    GLuint shader = p_glCreateShader(type);
+    GLint compiled = 0;
+
+    p_glShaderSource(shader, 1, &source, NULL);
+    p_glCompileShader(shader);
+    p_glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        fprintf(stderr, "Could not compile the shader\n");
+        return 0;
+    }
+    return shader;
+}
+
+static bool createProgram()
+{
+    GLuint vertexShader = loadShader(GL_VERTEX_SHADER, s_vertexShader);
+    GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, s_fragmentShader);
+    GLint linked = 0;
+
+    if (!vertexShader || !fragmentShader) {
+        return false;
+    }
+    s_program = p_glCreateProgram();
+    p_glAttachShader(s_program, vertexShader);
+    p_glAttachShader(s_program, fragmentShader);
+    p_glBindAttribLocation(s_program, 0, "a_position");
+    p_glBindAttribLocation(s_program, 1, "a_color");
+    p_glLinkProgram(s_program);
+    p_glGetProgramiv(s_program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        fprintf(stderr, "Could not link the program\n");
+        return false;
+    }
+    s_mvpLocation = p_glGetUniformLocation(s_program, "u_mvp");
+    s_tintLocation = p_glGetUniformLocation(s_program, "u_tint");
+    return true;
+}
+
+static void createMesh()
+{
+    GLfloat vertices[GRID_SIZE * GRID_SIZE][7];
+    GLushort indices[(GRID_SIZE - 1) * (GRID_SIZE - 1) * 6];
+
+    for (int y = 0; y < GRID_SIZE; y++) {
+        for (int x = 0; x < GRID_SIZE; x++) {
+            GLfloat *v = vertices[y * GRID_SIZE + x];
+            v[0] = (GLfloat)x / (GRID_SIZE - 1) - 0.5f;
+            v[1] = (GLfloat)y / (GRID_SIZE - 1) - 0.5f;
+            v[2] = 0;
+            v[3] = (GLfloat)x / GRID_SIZE;
+            v[4] = (GLfloat)y / GRID_SIZE;
+            v[5] = 0.5f;
+            v[6] = 1;
+        }
+    }
+
+    s_numIndices = 0;
+    for (int y = 0; y < GRID_SIZE - 1; y++) {
+        for (int x = 0; x < GRID_SIZE - 1; x++) {
+            GLushort i = y * GRID_SIZE + x;
+            indices[s_numIndices++] = i;
+            indices[s_numIndices++] = i + 1;
+            indices[s_numIndices++] = i + GRID_SIZE;
+            indices[s_numIndices++] = i + 1;
+            indices[s_numIndices++] = i + GRID_SIZE + 1;
+            indices[s_numIndices++] = i + GRID_SIZE;
+        }
+    }
+
+    p_glGenBuffers(2, s_buffers);
+    p_glBindBuffer(GL_ARRAY_BUFFER, s_buffers[0]);
+    p_glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    p_glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_buffers[1]);
+    p_glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+}
+
+static bool init(void *lib, int width, int height)
+{
+#define LOOKUP_FUNCTION(ret, name, args) \
+    if (!lookupGLFunction(lib, #name, (void **)&p_##name)) return false;
+    GLES2_FUNCTIONS(LOOKUP_FUNCTION)
+
+    if (!createProgram()) {
+        return false;
+    }
+    createMesh();
+
+    p_glViewport(0, 0, width, height);
+    p_glClearColor(0.1f, 0.2f, 0.3f, 1);
+    p_glEnable(GL_DEPTH_TEST);
+    p_glUseProgram(s_program);
+    p_glEnableVertexAttribArray(0);
+    return true;
+}
+
+// A rotation around Z followed by a translation, column major
+static void setTransform(GLfloat *m, float angle, float x, float y)
+{
+    float c = cosf(angle), s = sinf(angle);
+
+    memset(m, 0, 16 * sizeof(GLfloat));
+    m[0] = c * 0.2f;
+    m[1] = s * 0.2f;
+    m[4] = -s * 0.2f;
+    m[5] = c * 0.2f;
+    m[10] = 1;
+    m[12] = x;
+    m[13] = y;
+    m[15] = 1;
+}
+
+static void drawFrame(int frame)
+{
+    GLfloat mvp[16];
+
+    p_glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // The static mesh, from the buffer objects
+    p_glBindBuffer(GL_ARRAY_BUFFER, s_buffers[0]);
+    p_glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_buffers[1]);
+    p_glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(GLfloat), (const GLvoid *)0);
+    p_glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 7 * sizeof(GLfloat),
+                            (const GLvoid *)(3 * sizeof(GLfloat)));
+    p_glEnableVertexAttribArray(1);
+    for (int i = 0; i < NUM_OBJECTS; i++) {
+        setTransform(mvp, frame * 0.01f + i, (i % 8) * 0.25f - 0.875f, (i / 8) * 0.25f - 0.875f);
+        p_glUniformMatrix4fv(s_mvpLocation, 1, GL_FALSE, mvp);
+        p_glUniform4f(s_tintLocation, 1, (float)i / NUM_OBJECTS, 1, 1);
+        p_glDrawElements(GL_TRIANGLES, s_numIndices, GL_UNSIGNED_SHORT, (const GLvoid *)0);
+    }
+
+    // The streamed mesh, from client memory
+    for (int i = 0; i < NUM_STREAMED; i++) {
+        float a = 2 * M_PI * i / NUM_STREAMED + frame * 0.02f;
+        s_streamed[i * 2] = cosf(a) * (0.5f + 0.1f * sinf(a * 8));
+        s_streamed[i * 2 + 1] = sinf(a) * (0.5f + 0.1f * sinf(a * 8));
+    }
+    p_glBindBuffer(GL_ARRAY_BUFFER, 0);
+    p_glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, s_streamed);
+    setTransform(mvp, 0, 0, 0);
+    p_glUniformMatrix4fv(s_mvpLocation, 1, GL_FALSE, mvp);
+    p_glDrawArrays(GL_LINE_LOOP, 0, NUM_STREAMED);
+}
+
+const Workload gles2Workload = {
+    "gles2",
+    2,
+    "libGLESv2_emulation.so",
+    init,
+    drawFrame
+};
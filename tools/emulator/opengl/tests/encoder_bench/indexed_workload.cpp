@@ -0,0 +1,146 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "Workload.h"
+#include <math.h>
+#include <stdio.h>
+#include <GLES2/gl2.h>
+
+//
+// A mesh animated on the CPU: its vertices come from client memory and its
+// indices from a buffer object. It is drawn in bands, each band once per
+// pass, so the encoder needs the range of the same indices many times per
+// frame to send the vertices of a draw.
+//
+#define INDEXED_FUNCTIONS(X) \
+    X(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height)) \
+    X(void, glClear, (GLbitfield mask)) \
+    X(GLuint, glCreateShader, (GLenum type)) \
+    X(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar **string, const GLint *length)) \
+    X(void, glCompileShader, (GLuint shader)) \
+    X(GLuint, glCreateProgram, (void)) \
+    X(void, glAttachShader, (GLuint program, GLuint shader)) \
+    X(void, glBindAttribLocation, (GLuint program, GLuint index, const GLchar *name)) \
+    X(void, glLinkProgram, (GLuint program)) \
+    X(void, glUseProgram, (GLuint program)) \
+    X(GLint, glGetUniformLocation, (GLuint program, const GLchar *name)) \
+    X(void, glUniform4f, (GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)) \
+    X(void, glGenBuffers, (GLsizei n, GLuint *buffers)) \
+    X(void, glBindBuffer, (GLenum target, GLuint buffer)) \
+    X(void, glBufferData, (GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage)) \
+    X(void, glVertexAttribPointer, (GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *ptr)) \
+    X(void, glEnableVertexAttribArray, (GLuint index)) \
+    X(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices))
+
+#define DECLARE_FUNCTION(ret, name, args) static ret (*p_##name) args;
+INDEXED_FUNCTIONS(DECLARE_FUNCTION)
+
+#define GRID_SIZE       64      // the mesh is a GRID_SIZE x GRID_SIZE grid
+#define NUM_BANDS       8       // of rows of the grid, drawn separately
+#define NUM_PASSES      4
+
+static const char s_vertexShader[] =
+    "attribute vec4 a_position;\n"
+    "void main() {\n"
+    "    gl_Position = a_position;\n"
+    "}\n";
+
+static const char s_fragmentShader[] =
+    "precision mediump float;\n"
+    "uniform vec4 u_color;\n"
+    "void main() {\n"
+    "    gl_FragColor = u_color;\n"
+    "}\n";
+
+static GLint s_colorLocation;
+static GLuint s_indexBuffer;
+static GLfloat s_vertices[GRID_SIZE * GRID_SIZE][2];
+
+static GLuint loadShader(GLenum type, const char *source)
+{
+    GLuint shader = p_glCreateShader(type);
+
+    p_glShaderSource(shader, 1, &source, NULL);
+    p_glCompileShader(shader);
+    return shader;
+}
+
+static bool init(void *lib, int width, int height)
+{
+#define LOOKUP_FUNCTION(ret, name, args) \
+    if (!lookupGLFunction(lib, #name, (void **)&p_##name)) return false;
+    INDEXED_FUNCTIONS(LOOKUP_FUNCTION)
+
+    GLuint program = p_glCreateProgram();
+    p_glAttachShader(program, loadShader(GL_VERTEX_SHADER, s_vertexShader));
+    p_glAttachShader(program, loadShader(GL_FRAGMENT_SHADER, s_fragmentShader));
+    p_glBindAttribLocation(program, 0, "a_position");
+    p_glLinkProgram(program);
+    p_glUseProgram(program);
+    s_colorLocation = p_glGetUniformLocation(program, "u_color");
+
+    static GLushort indices[(GRID_SIZE - 1) * (GRID_SIZE - 1) * 6];
+    int n = 0;
+    for (int y = 0; y < GRID_SIZE - 1; y++) {
+        for (int x = 0; x < GRID_SIZE - 1; x++) {
+            GLushort i = y * GRID_SIZE + x;
+            indices[n++] = i;
+            indices[n++] = i + 1;
+            indices[n++] = i + GRID_SIZE;
+            indices[n++] = i + 1;
+            indices[n++] = i + GRID_SIZE + 1;
+            indices[n++] = i + GRID_SIZE;
+        }
+    }
+    p_glGenBuffers(1, &s_indexBuffer);
+    p_glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_indexBuffer);
+    p_glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    p_glViewport(0, 0, width, height);
+    p_glBindBuffer(GL_ARRAY_BUFFER, 0);
+    p_glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, s_vertices);
+    p_glEnableVertexAttribArray(0);
+    return true;
+}
+
+static void drawFrame(int frame)
+{
+    for (int y = 0; y < GRID_SIZE; y++) {
+        for (int x = 0; x < GRID_SIZE; x++) {
+            float wave = 0.02f * sinf(frame * 0.05f + x * 0.3f + y * 0.2f);
+            s_vertices[y * GRID_SIZE + x][0] = (float)x / (GRID_SIZE - 1) * 1.8f - 0.9f;
+            s_vertices[y * GRID_SIZE + x][1] = (float)y / (GRID_SIZE - 1) * 1.8f - 0.9f + wave;
+        }
+    }
+
+    p_glClear(GL_COLOR_BUFFER_BIT);
+    p_glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_indexBuffer);
+    const int bandIndices = (GRID_SIZE - 1) * (GRID_SIZE - 1) * 6 / NUM_BANDS;
+    for (int pass = 0; pass < NUM_PASSES; pass++) {
+        p_glUniform4f(s_colorLocation, 1, (float)pass / NUM_PASSES, 0, 0.25f);
+        for (int band = 0; band < NUM_BANDS; band++) {
+            p_glDrawElements(GL_TRIANGLES, bandIndices, GL_UNSIGNED_SHORT,
+                             (const GLvoid *)(band * bandIndices * sizeof(GLushort)));
+        }
+    }
+}
+
+const Workload indexedWorkload = {
+    "indexed",
+    2,
+    "libGLESv2_emulation.so",
+    init,
+    drawFrame
+};
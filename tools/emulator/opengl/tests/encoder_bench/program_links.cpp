@@ -0,0 +1,105 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+//
+// Program links, as an application does when it starts or recreates its
+// context: every program is built from its own pair of shaders, which only
+// differ by a comment, then linked and its uniforms looked up.
+//
+#include <stdio.h>
+#include <GLES2/gl2.h>
+#include "Workload.h"
+
+#define PROGRAM_FUNCTIONS(X) \
+    X(GLuint, glCreateShader, (GLenum type)) \
+    X(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar **string, const GLint *length)) \
+    X(void, glCompileShader, (GLuint shader)) \
+    X(void, glDeleteShader, (GLuint shader)) \
+    X(GLuint, glCreateProgram, (void)) \
+    X(void, glAttachShader, (GLuint program, GLuint shader)) \
+    X(void, glBindAttribLocation, (GLuint program, GLuint index, const GLchar *name)) \
+    X(void, glLinkProgram, (GLuint program)) \
+    X(GLint, glGetUniformLocation, (GLuint program, const GLchar *name)) \
+    X(void, glDeleteProgram, (GLuint program))
+
+#define DECLARE_FUNCTION(ret, name, args) static ret (*p_##name) args;
+PROGRAM_FUNCTIONS(DECLARE_FUNCTION)
+
+static const char s_vertexShader[] =
+    "// program %d\n"
+    "uniform mat4 u_mvp;\n"
+    "uniform vec3 u_light;\n"
+    "attribute vec4 a_position;\n"
+    "attribute vec3 a_normal;\n"
+    "varying float v_diffuse;\n"
+    "void main() {\n"
+    "    gl_Position = u_mvp * a_position;\n"
+    "    v_diffuse = max(dot(a_normal, u_light), 0.0);\n"
+    "}\n";
+
+static const char s_fragmentShader[] =
+    "// program %d\n"
+    "precision mediump float;\n"
+    "uniform vec4 u_tint;\n"
+    "uniform sampler2D u_texture;\n"
+    "varying float v_diffuse;\n"
+    "void main() {\n"
+    "    gl_FragColor = texture2D(u_texture, vec2(v_diffuse)) * u_tint;\n"
+    "}\n";
+
+static GLuint compileShader(GLenum type, const char *format, int id)
+{
+    char source[512];
+    const GLchar *sources[] = { source };
+
+    snprintf(source, sizeof(source), format, id);
+    GLuint shader = p_glCreateShader(type);
+    p_glShaderSource(shader, 1, sources, NULL);
+    p_glCompileShader(shader);
+    return shader;
+}
+
+bool linkPrograms(void *lib, int count)
+{
+#define LOOKUP_FUNCTION(ret, name, args) \
+    if (!lookupGLFunction(lib, #name, (void **)&p_##name)) return false;
+    PROGRAM_FUNCTIONS(LOOKUP_FUNCTION)
+
+    for (int i = 0; i < count; i++) {
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, s_vertexShader, i);
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, s_fragmentShader, i);
+        GLuint program = p_glCreateProgram();
+        if (!vertexShader || !fragmentShader || !program) {
+            fprintf(stderr, "Could not create program %d\n", i);
+            return false;
+        }
+        p_glAttachShader(program, vertexShader);
+        p_glAttachShader(program, fragmentShader);
+        p_glBindAttribLocation(program, 0, "a_position");
+        p_glBindAttribLocation(program, 1, "a_normal");
+        p_glLinkProgram(program);
+
+        if (p_glGetUniformLocation(program, "u_mvp") < 0 ||
+            p_glGetUniformLocation(program, "u_texture") < 0) {
+            fprintf(stderr, "Program %d has no uniforms\n", i);
+            return false;
+        }
+        p_glDeleteShader(vertexShader);
+        p_glDeleteShader(fragmentShader);
+        p_glDeleteProgram(program);
+    }
+    return true;
+}
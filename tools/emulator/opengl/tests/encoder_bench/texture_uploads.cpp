@@ -0,0 +1,76 @@
+/*
+* Copyright (C) 2012 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+//
+// Texture streaming, as a video player does: every frame is decoded into a
+// buffer of the application, then uploaded to the same texture.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <GLES2/gl2.h>
+#include "Workload.h"
+
+#define TEXTURE_FUNCTIONS(X) \
+    X(void, glGenTextures, (GLsizei n, GLuint *textures)) \
+    X(void, glBindTexture, (GLenum target, GLuint texture)) \
+    X(void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels)) \
+    X(void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)) \
+    X(void, glDeleteTextures, (GLsizei n, const GLuint *textures)) \
+    X(void, glFinish, (void)) \
+    X(GLenum, glGetError, (void))
+
+#define DECLARE_FUNCTION(ret, name, args) static ret (*p_##name) args;
+TEXTURE_FUNCTIONS(DECLARE_FUNCTION)
+
+// Stands for the decoder: writes every pixel of the frame
+static void decodeFrame(uint32_t *pixels, int count, int frame)
+{
+    uint32_t value = frame * 0x01010101u;
+    for (int i = 0; i < count; i++) {
+        pixels[i] = value + i;
+    }
+}
+
+bool streamTexture(void *lib, int width, int height, int frames)
+{
+#define LOOKUP_FUNCTION(ret, name, args) \
+    if (!lookupGLFunction(lib, #name, (void **)&p_##name)) return false;
+    TEXTURE_FUNCTIONS(LOOKUP_FUNCTION)
+
+    uint32_t *pixels = (uint32_t *)malloc(width * height * sizeof(uint32_t));
+    if (!pixels) {
+        fprintf(stderr, "Could not allocate a %dx%d frame\n", width, height);
+        return false;
+    }
+
+    GLuint texture;
+    p_glGenTextures(1, &texture);
+    p_glBindTexture(GL_TEXTURE_2D, texture);
+    p_glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    for (int i = 0; i < frames; i++) {
+        decodeFrame(pixels, width * height, i);
+        p_glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                          GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+
+    // the last frame has been sent once glFinish() returns
+    p_glDeleteTextures(1, &texture);
+    p_glFinish();
+    free(pixels);
+    return p_glGetError() == GL_NO_ERROR;
+}
@@ -53,6 +53,7 @@ LOCAL_SRC_FILES := \
 	Converters.cpp \
 	PreviewWindow.cpp \
 	CallbackNotifier.cpp \
+	CameraFrameTiming.cpp \
 	QemuClient.cpp \
 	JpegCompressor.cpp \
     EmulatedCamera2.cpp \
@@ -60,6 +61,7 @@ LOCAL_SRC_FILES := \
 	EmulatedQemuCamera2.cpp \
 	fake-pipeline2/Scene.cpp \
 	fake-pipeline2/Sensor.cpp \
+	fake-pipeline2/LatencyHistogram.cpp \
 	fake-pipeline2/JpegCompressor.cpp
 
 
@@ -70,3 +72,41 @@ LOCAL_MODULE := camera.goldfish
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Headless benchmark that drives the camera HAL with stub preview windows and
+# stream queues, and reports frame rate and latency for every camera.
+#
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera-hal-benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	camera_hal_benchmark.cpp \
+	fake-pipeline2/LatencyHistogram.cpp
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	libutils \
+	libhardware \
+	libui \
+	libcamera_metadata
+LOCAL_C_INCLUDES += $(call include-path-for, camera)
+include $(BUILD_EXECUTABLE)
+
+# Protocol test for the frame streaming of the qemu camera client, against a
+# fake camera service on the other end of a socket pair.
+#
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera-stream-test
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += -fno-short-enums -DQEMU_HARDWARE
+LOCAL_SRC_FILES := \
+	camera_stream_test.cpp \
+	QemuClient.cpp
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	libutils \
+	libcamera_client
+LOCAL_C_INCLUDES += \
+	frameworks/native/include/media/hardware \
+	$(LOCAL_PATH)/../../opengl/system/OpenglSystemCommon \
+	$(call include-path-for, camera)
+include $(BUILD_EXECUTABLE)
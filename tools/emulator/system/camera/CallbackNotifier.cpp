@@ -26,6 +26,7 @@
 #include "EmulatedCameraDevice.h"
 #include "CallbackNotifier.h"
 #include "JpegCompressor.h"
+#include "CameraFrameTiming.h"
 
 namespace android {
 
@@ -95,7 +96,8 @@ CallbackNotifier::CallbackNotifier()
       mMessageEnabler(0),
       mJpegQuality(90),
       mVideoRecEnabled(false),
-      mTakingPicture(false)
+      mTakingPicture(false),
+      mFrameTiming(NULL)
 {
 }
 
@@ -208,6 +210,8 @@ void CallbackNotifier::onNextFrameAvailable(const void* frame,
 {
     if (isMessageEnabled(CAMERA_MSG_VIDEO_FRAME) && isVideoRecordingEnabled() &&
             isNewVideoFrameTime(timestamp)) {
+        CameraFrameTiming::ScopedStageTimer timer(
+                mFrameTiming, CameraFrameTiming::STAGE_CALLBACK);
         camera_memory_t* cam_buff =
             mGetMemoryCB(-1, camera_dev->getFrameBufferSize(), 1, NULL);
         if (NULL != cam_buff && NULL != cam_buff->data) {
@@ -220,6 +224,8 @@ void CallbackNotifier::onNextFrameAvailable(const void* frame,
     }
 
     if (isMessageEnabled(CAMERA_MSG_PREVIEW_FRAME)) {
+        CameraFrameTiming::ScopedStageTimer timer(
+                mFrameTiming, CameraFrameTiming::STAGE_CALLBACK);
         camera_memory_t* cam_buff =
             mGetMemoryCB(-1, camera_dev->getFrameBufferSize(), 1, NULL);
         if (NULL != cam_buff && NULL != cam_buff->data) {
@@ -249,10 +255,15 @@ void CallbackNotifier::onNextFrameAvailable(const void* frame,
             /* Compress the frame to JPEG. Note that when taking pictures, we
              * have requested camera device to provide us with NV21 frames. */
             NV21JpegCompressor compressor;
+            const nsecs_t jpeg_start = systemTime(SYSTEM_TIME_MONOTONIC);
             status_t res =
                 compressor.compressRawImage(frame, camera_dev->getFrameWidth(),
                                             camera_dev->getFrameHeight(),
                                             mJpegQuality);
+            if (mFrameTiming != NULL) {
+                mFrameTiming->record(CameraFrameTiming::STAGE_JPEG,
+                        systemTime(SYSTEM_TIME_MONOTONIC) - jpeg_start);
+            }
             if (res == NO_ERROR) {
                 camera_memory_t* jpeg_buff =
                     mGetMemoryCB(-1, compressor.getCompressedSize(), 1, NULL);
@@ -25,6 +25,7 @@
 namespace android {
 
 class EmulatedCameraDevice;
+class CameraFrameTiming;
 
 /* Manages callbacks set via set_callbacks, enable_msg_type, and disable_msg_type
  * camera HAL API.
@@ -180,6 +181,13 @@ public:
         mJpegQuality = jpeg_quality;
     }
 
+    /* Sets statistics that callback delivery and JPEG compression are timed
+     * with. Can be NULL to disable timing. */
+    void setFrameTiming(CameraFrameTiming* timing)
+    {
+        mFrameTiming = timing;
+    }
+
     /****************************************************************************
      * Private API
      ***************************************************************************/
@@ -226,6 +234,9 @@ protected:
 
     /* Picture taking status. */
     bool                            mTakingPicture;
+
+    /* Frame timing statistics, or NULL if not collected. */
+    CameraFrameTiming*              mFrameTiming;
 };
 
 }; /* namespace android */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Contains implementation of a class CameraFrameTiming that collects per-stage
+ * frame timing statistics for the emulated camera devices.
+ */
+
+#include <cutils/atomic.h>
+#include "CameraFrameTiming.h"
+
+namespace android {
+
+CameraFrameTiming::CameraFrameTiming()
+{
+    reset();
+}
+
+void CameraFrameTiming::reset()
+{
+    for (int n = 0; n < STAGE_COUNT; n++) {
+        mStages[n].reset();
+    }
+    mEpoch = systemTime(SYSTEM_TIME_MONOTONIC);
+    android_atomic_release_store(0, &mFirstFrameMs);
+    android_atomic_release_store(0, &mLastFrameMs);
+    android_atomic_release_store(0, &mFrameCount);
+}
+
+void CameraFrameTiming::record(Stage stage, nsecs_t latency)
+{
+    if (stage >= 0 && stage < STAGE_COUNT) {
+        mStages[stage].record(latency);
+    }
+}
+
+void CameraFrameTiming::onFrameDelivered(nsecs_t timestamp)
+{
+    const int32_t ms = static_cast<int32_t>((timestamp - mEpoch) / 1000000LL);
+    if (android_atomic_acquire_load(&mFrameCount) == 0) {
+        android_atomic_release_store(ms, &mFirstFrameMs);
+    }
+    android_atomic_release_store(ms, &mLastFrameMs);
+    android_atomic_inc(&mFrameCount);
+}
+
+int32_t CameraFrameTiming::getFrameCount() const
+{
+    return android_atomic_acquire_load(&mFrameCount);
+}
+
+float CameraFrameTiming::getFrameRate() const
+{
+    const int32_t frames = getFrameCount();
+    const int32_t elapsed_ms = android_atomic_acquire_load(&mLastFrameMs) -
+                               android_atomic_acquire_load(&mFirstFrameMs);
+    if (frames < 2 || elapsed_ms <= 0) {
+        return 0;
+    }
+    return (frames - 1) * 1000.0f / elapsed_ms;
+}
+
+void CameraFrameTiming::dump(String8& result) const
+{
+    result.appendFormat("      Frames delivered: %d (%.2f fps)\n",
+                        getFrameCount(), getFrameRate());
+    for (int n = 0; n < STAGE_COUNT; n++) {
+        String8 name;
+        name.appendFormat("        %-20s", getStageName(static_cast<Stage>(n)));
+        mStages[n].dump(result, name.string());
+    }
+}
+
+const char* CameraFrameTiming::getStageName(Stage stage)
+{
+    switch (stage) {
+        case STAGE_CAPTURE:
+            return "Capture";
+        case STAGE_CONVERT:
+            return "Convert";
+        case STAGE_PREVIEW:
+            return "Preview enqueue";
+        case STAGE_CALLBACK:
+            return "Callback delivery";
+        case STAGE_JPEG:
+            return "JPEG compression";
+        default:
+            return "Unknown";
+    }
+}
+
+}; /* namespace android */
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HW_EMULATOR_CAMERA_CAMERA_FRAME_TIMING_H
+#define HW_EMULATOR_CAMERA_CAMERA_FRAME_TIMING_H
+
+/*
+ * Contains declaration of a class CameraFrameTiming that collects per-stage
+ * frame timing statistics for the emulated camera devices.
+ */
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include "fake-pipeline2/LatencyHistogram.h"
+
+namespace android {
+
+/* Collects timing of the stages a frame passes through on its way from the
+ * camera device to the framework.
+ *
+ * Every stage has its own latency histogram, and delivered frames are counted
+ * to derive the effective frame rate. All recording is lock-free, so the stages
+ * can be timed from the worker thread without adding contention with the
+ * camera API calls that dump the statistics.
+ */
+class CameraFrameTiming {
+public:
+    /* Frame processing stages that are timed. */
+    enum Stage {
+        /* Producing a frame in the camera device framebuffer. */
+        STAGE_CAPTURE,
+        /* Converting a frame to RGB for the preview window. */
+        STAGE_CONVERT,
+        /* Pushing a frame to the preview window, including the conversion. */
+        STAGE_PREVIEW,
+        /* Delivering preview / video frame data callbacks. */
+        STAGE_CALLBACK,
+        /* Compressing a picture to JPEG. */
+        STAGE_JPEG,
+
+        STAGE_COUNT
+    };
+
+    /* Times a stage for the lifetime of the object. */
+    class ScopedStageTimer {
+    public:
+        /* Param:
+         *  timing - Statistics to record to. Can be NULL, in which case
+         *      nothing is recorded.
+         *  stage - Stage that is being timed.
+         */
+        ScopedStageTimer(CameraFrameTiming* timing, Stage stage)
+            : mTiming(timing),
+              mStage(stage),
+              mStartTime(systemTime(SYSTEM_TIME_MONOTONIC))
+        {
+        }
+
+        ~ScopedStageTimer()
+        {
+            if (mTiming != NULL) {
+                mTiming->record(mStage,
+                                systemTime(SYSTEM_TIME_MONOTONIC) - mStartTime);
+            }
+        }
+
+    private:
+        CameraFrameTiming*  mTiming;
+        Stage               mStage;
+        nsecs_t             mStartTime;
+    };
+
+    /* Constructs CameraFrameTiming instance. */
+    CameraFrameTiming();
+
+    /* Discards all collected statistics. */
+    void reset();
+
+    /* Records time spent in a stage. Safe to call from any thread. */
+    void record(Stage stage, nsecs_t latency);
+
+    /* Counts a frame delivered to the framework.
+     * Param:
+     *  timestamp - Frame timestamp (SYSTEM_TIME_MONOTONIC).
+     */
+    void onFrameDelivered(nsecs_t timestamp);
+
+    /* Gets number of frames delivered since the last reset. */
+    int32_t getFrameCount() const;
+
+    /* Gets effective frame rate since the last reset, or 0 if fewer than two
+     * frames have been delivered. */
+    float getFrameRate() const;
+
+    /* Gets latency histogram for a stage. */
+    const LatencyHistogram& getStageLatency(Stage stage) const
+    {
+        return mStages[stage];
+    }
+
+    /* Appends the collected statistics to the result. */
+    void dump(String8& result) const;
+
+    /* Gets human readable name of a stage. */
+    static const char* getStageName(Stage stage);
+
+private:
+    /* Per-stage latency histograms. */
+    LatencyHistogram    mStages[STAGE_COUNT];
+
+    /* Time of the last reset. Frame times below are in milliseconds relative
+     * to it, so they fit in 32-bit atomics. */
+    nsecs_t             mEpoch;
+
+    /* Number of frames delivered. */
+    volatile int32_t    mFrameCount;
+
+    /* Times of the first and the last delivered frames. */
+    volatile int32_t    mFirstFrameMs;
+    volatile int32_t    mLastFrameMs;
+};
+
+}; /* namespace android */
+
+#endif  /* HW_EMULATOR_CAMERA_CAMERA_FRAME_TIMING_H */
@@ -65,12 +65,16 @@ EmulatedCamera::EmulatedCamera(int cameraId,
                 &common,
                 module),
           mPreviewWindow(),
-          mCallbackNotifier()
+          mCallbackNotifier(),
+          mFrameTiming()
 {
     /* camera_device v1 fields. */
     common.close = EmulatedCamera::close;
     ops = &mDeviceOps;
     priv = this;
+
+    mPreviewWindow.setFrameTiming(&mFrameTiming);
+    mCallbackNotifier.setFrameTiming(&mFrameTiming);
 }
 
 EmulatedCamera::~EmulatedCamera()
@@ -170,6 +174,8 @@ void EmulatedCamera::onNextFrameAvailable(const void* frame,
                                           nsecs_t timestamp,
                                           EmulatedCameraDevice* camera_dev)
 {
+    mFrameTiming.onFrameDelivered(timestamp);
+
     /* Notify the preview window first. */
     mPreviewWindow.onNextFrameAvailable(frame, timestamp, camera_dev);
 
@@ -524,8 +530,13 @@ status_t EmulatedCamera::dumpCamera(int fd)
 {
     ALOGV("%s", __FUNCTION__);
 
-    /* TODO: Future enhancements. */
-    return -EINVAL;
+    String8 result;
+    result.appendFormat("    Camera HAL device: EmulatedCamera %d\n",
+                        mCameraID);
+    mFrameTiming.dump(result);
+    write(fd, result.string(), result.size());
+
+    return NO_ERROR;
 }
 
 /****************************************************************************
@@ -611,6 +622,9 @@ status_t EmulatedCamera::doStartPreview()
         return res;
     }
 
+    /* Frame statistics are collected per preview session. */
+    mFrameTiming.reset();
+
     res = camera_dev->startDeliveringFrames(false);
     if (res != NO_ERROR) {
         camera_dev->stopDevice();
@@ -31,6 +31,7 @@
 #include "EmulatedCameraDevice.h"
 #include "PreviewWindow.h"
 #include "CallbackNotifier.h"
+#include "CameraFrameTiming.h"
 
 namespace android {
 
@@ -99,6 +100,13 @@ public:
      */
     virtual void onCameraDeviceError(int err);
 
+    /* Gets frame timing statistics collected for this camera.
+     * Camera device uses them to time frame capture and conversion. */
+    CameraFrameTiming* getFrameTiming()
+    {
+        return &mFrameTiming;
+    }
+
     /****************************************************************************
      * Camera API implementation
      ***************************************************************************/
@@ -374,6 +382,9 @@ protected:
     /* Callback notifier. */
     CallbackNotifier                mCallbackNotifier;
 
+    /* Frame timing statistics, reported by dumpCamera. */
+    CameraFrameTiming               mFrameTiming;
+
 private:
     /* Registered callbacks implementing camera API. */
     static camera_device_ops_t      mDeviceOps;
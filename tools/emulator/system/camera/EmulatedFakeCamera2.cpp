@@ -35,11 +35,11 @@ const int64_t USEC = 1000LL;
 const int64_t MSEC = USEC * 1000LL;
 const int64_t SEC = MSEC * 1000LL;
 
-const uint32_t EmulatedFakeCamera2::kAvailableFormats[4] = {
+const uint32_t EmulatedFakeCamera2::kAvailableFormats[5] = {
         HAL_PIXEL_FORMAT_RAW_SENSOR,
         HAL_PIXEL_FORMAT_BLOB,
         HAL_PIXEL_FORMAT_RGBA_8888,
-        //        HAL_PIXEL_FORMAT_YV12,
+        HAL_PIXEL_FORMAT_YV12,
         HAL_PIXEL_FORMAT_YCrCb_420_SP
 };
 
@@ -140,10 +140,23 @@ status_t EmulatedFakeCamera2::connectCamera(hw_device_t** device) {
     status_t res;
     ALOGV("%s", __FUNCTION__);
 
+    size_t pipelineDepth = kDefaultPipelineDepth;
+    char prop[PROPERTY_VALUE_MAX];
+    if (property_get("qemu.camera2.pipeline_depth", prop, NULL) > 0) {
+        int depth = atoi(prop);
+        if (depth > 0) {
+            pipelineDepth = depth;
+        } else {
+            ALOGW("%s: Ignoring invalid pipeline depth '%s'", __FUNCTION__,
+                    prop);
+        }
+    }
+    ALOGV("%s: Pipeline depth %d", __FUNCTION__, pipelineDepth);
+
     mConfigureThread = new ConfigureThread(this);
-    mReadoutThread = new ReadoutThread(this);
+    mReadoutThread = new ReadoutThread(this, pipelineDepth);
     mControlThread = new ControlThread(this);
-    mSensor = new Sensor(this);
+    mSensor = new Sensor(this, pipelineDepth);
     mJpegCompressor = new JpegCompressor(this);
 
     mNextStreamId = 1;
@@ -611,6 +624,13 @@ int EmulatedFakeCamera2::dump(int fd) {
             id, s.width, s.height, s.format, s.stride);
     }
 
+    if (mSensor != NULL) {
+        result.appendFormat("      Pipeline:\n");
+        mSensor->dump(result);
+        mReadoutThread->dump(result);
+        mJpegCompressor->dump(result);
+    }
+
     write(fd, result.string(), result.size());
 
     return NO_ERROR;
@@ -1077,21 +1097,23 @@ bool EmulatedFakeCamera2::ConfigureThread::getBuffers() {
     return true;
 }
 
-EmulatedFakeCamera2::ReadoutThread::ReadoutThread(EmulatedFakeCamera2 *parent):
+EmulatedFakeCamera2::ReadoutThread::ReadoutThread(EmulatedFakeCamera2 *parent,
+        size_t pipelineDepth):
         Thread(false),
         mParent(parent),
         mRunning(false),
         mActive(false),
+        mInFlightQueueSize(pipelineDepth + 1),
         mRequestCount(0),
         mRequest(NULL),
         mBuffers(NULL) {
-    mInFlightQueue = new InFlightQueue[kInFlightQueueSize];
+    mInFlightQueue = new InFlightQueue[mInFlightQueueSize];
     mInFlightHead = 0;
     mInFlightTail = 0;
 }
 
 EmulatedFakeCamera2::ReadoutThread::~ReadoutThread() {
-    delete mInFlightQueue;
+    delete[] mInFlightQueue;
 }
 
 status_t EmulatedFakeCamera2::ReadoutThread::readyToRun() {
@@ -1127,7 +1149,7 @@ bool EmulatedFakeCamera2::ReadoutThread::waitForReady(nsecs_t timeout) {
 }
 
 bool EmulatedFakeCamera2::ReadoutThread::readyForNextCapture() {
-    return (mInFlightTail + 1) % kInFlightQueueSize != mInFlightHead;
+    return (mInFlightTail + 1) % mInFlightQueueSize != mInFlightHead;
 }
 
 void EmulatedFakeCamera2::ReadoutThread::setNextOperation(
@@ -1144,7 +1166,7 @@ void EmulatedFakeCamera2::ReadoutThread::setNextOperation(
     mInFlightQueue[mInFlightTail].isCapture = isCapture;
     mInFlightQueue[mInFlightTail].request = request;
     mInFlightQueue[mInFlightTail].buffers = buffers;
-    mInFlightTail = (mInFlightTail + 1) % kInFlightQueueSize;
+    mInFlightTail = (mInFlightTail + 1) % mInFlightQueueSize;
     mRequestCount++;
 
     if (!mActive) {
@@ -1164,7 +1186,7 @@ bool EmulatedFakeCamera2::ReadoutThread::isStreamInUse(uint32_t id) {
             if ( (*(mInFlightQueue[i].buffers))[j].streamId == (int)id )
                 return true;
         }
-        i = (i + 1) % kInFlightQueueSize;
+        i = (i + 1) % mInFlightQueueSize;
     }
 
 
@@ -1183,6 +1205,10 @@ int EmulatedFakeCamera2::ReadoutThread::getInProgressCount() {
     return mRequestCount;
 }
 
+void EmulatedFakeCamera2::ReadoutThread::dump(String8 &result) {
+    mProcessLatency.dump(result, "        Post-process        ");
+}
+
 bool EmulatedFakeCamera2::ReadoutThread::threadLoop() {
     static const nsecs_t kWaitPerLoop = 10000000L; // 10 ms
     status_t res;
@@ -1217,7 +1243,7 @@ bool EmulatedFakeCamera2::ReadoutThread::threadLoop() {
                 mBuffers  = mInFlightQueue[mInFlightHead].buffers;
                 mInFlightQueue[mInFlightHead].request = NULL;
                 mInFlightQueue[mInFlightHead].buffers = NULL;
-                mInFlightHead = (mInFlightHead + 1) % kInFlightQueueSize;
+                mInFlightHead = (mInFlightHead + 1) % mInFlightQueueSize;
                 ALOGV("Ready to read out request %p, %d buffers",
                         mRequest, mBuffers->size());
             }
@@ -1235,6 +1261,7 @@ bool EmulatedFakeCamera2::ReadoutThread::threadLoop() {
 
         if (!gotFrame) return true;
     }
+    nsecs_t processStartTime = systemTime();
 
     Mutex::Autolock iLock(mInternalsMutex);
 
@@ -1380,6 +1407,7 @@ bool EmulatedFakeCamera2::ReadoutThread::threadLoop() {
         mParent->mJpegCompressor->start(mBuffers, captureTime);
         mBuffers = NULL;
     }
+    mProcessLatency.record(systemTime() - processStartTime);
 
     Mutex::Autolock l(mInputMutex);
     mRequestCount--;
@@ -224,7 +224,7 @@ private:
 
     class ReadoutThread: public Thread {
       public:
-        ReadoutThread(EmulatedFakeCamera2 *parent);
+        ReadoutThread(EmulatedFakeCamera2 *parent, size_t pipelineDepth);
         ~ReadoutThread();
 
         status_t readyToRun();
@@ -237,6 +237,8 @@ private:
                 Buffers *buffers);
         bool isStreamInUse(uint32_t id);
         int getInProgressCount();
+
+        void dump(String8 &result);
       private:
         EmulatedFakeCamera2 *mParent;
 
@@ -253,7 +255,8 @@ private:
 
         bool mActive;
 
-        static const int kInFlightQueueSize = 4;
+        // One more than the pipeline depth; one slot is always left empty
+        const size_t mInFlightQueueSize;
         struct InFlightQueue {
             bool isCapture;
             camera_metadata_t *request;
@@ -272,6 +275,8 @@ private:
         camera_metadata_t *mRequest;
         Buffers *mBuffers;
 
+        // Time from sensor frame delivery to output buffers being enqueued
+        LatencyHistogram mProcessLatency;
     };
 
     // 3A management thread (auto-exposure, focus, white balance)
@@ -378,6 +383,9 @@ private:
     static const uint32_t kMaxJpegStreamCount = 1;
     static const uint32_t kMaxReprocessStreamCount = 2;
     static const uint32_t kMaxBufferCount = 4;
+    // Frames in flight between sensor exposure, readout and post-processing,
+    // unless overridden by the qemu.camera2.pipeline_depth property
+    static const size_t kDefaultPipelineDepth = 3;
     static const uint32_t kAvailableFormats[];
     static const uint32_t kAvailableRawSizes[];
     static const uint64_t kAvailableRawMinDurations[];
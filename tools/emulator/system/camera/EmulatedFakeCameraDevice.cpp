@@ -205,6 +205,9 @@ bool EmulatedFakeCameraDevice::inWorkerThread()
          * Time to generate a new frame.
          */
 
+        CameraFrameTiming::ScopedStageTimer timer(
+                mCameraHAL->getFrameTiming(), CameraFrameTiming::STAGE_CAPTURE);
+
 #if EFCD_ROTATE_FRAME
         const int frame_type = rotateFrame();
         switch (frame_type) {
@@ -30,7 +30,9 @@ namespace android {
 EmulatedQemuCameraDevice::EmulatedQemuCameraDevice(EmulatedQemuCamera* camera_hal)
     : EmulatedCameraDevice(camera_hal),
       mQemuClient(),
-      mPreviewFrame(NULL)
+      mPreviewFrame(NULL),
+      mStreamWhiteBalanceScale(NULL),
+      mStreamExposureCompensation(0.0f)
 {
 }
 
@@ -173,6 +175,20 @@ status_t EmulatedQemuCameraDevice::startDevice(int width,
              reinterpret_cast<const char*>(&mPixelFormat),
              mFrameWidth, mFrameHeight);
         mState = ECDS_STARTED;
+
+        /* Prefer having the host push frames into our framebuffers over
+         * querying every frame. Falls back to 'frame' queries if the emulator
+         * doesn't support streaming. */
+        if (mQemuClient.queryStartStream(mFrameBufferSize, mTotalPixels * 4,
+                                         mWhiteBalanceScale[0],
+                                         mWhiteBalanceScale[1],
+                                         mWhiteBalanceScale[2],
+                                         mExposureCompensation) == NO_ERROR) {
+            ALOGV("%s: Qemu camera device '%s' is streaming frames",
+                 __FUNCTION__, (const char*)mDeviceName);
+            mStreamWhiteBalanceScale = mWhiteBalanceScale;
+            mStreamExposureCompensation = mExposureCompensation;
+        }
     } else {
         ALOGE("%s: Unable to start device '%s' for %.4s[%dx%d] frames",
              __FUNCTION__, (const char*)mDeviceName,
@@ -193,6 +209,17 @@ status_t EmulatedQemuCameraDevice::stopDevice()
         return NO_ERROR;
     }
 
+    /* Stop streaming first: the connection carries only frame records until
+     * the stream has ended. */
+    if (mQemuClient.isStreaming()) {
+        const status_t stream_res = mQemuClient.queryStopStream();
+        ALOGE_IF(stream_res != NO_ERROR, "%s: Unable to stop streaming: %s",
+                __FUNCTION__, strerror(stream_res));
+        ALOGV("%s: Received %d streamed frames, %d dropped by the host",
+             __FUNCTION__, mQemuClient.getStreamedFrameCount(),
+             mQemuClient.getDroppedFrameCount());
+    }
+
     /* Stop the actual camera device. */
     status_t res = mQemuClient.queryStop();
     if (res == NO_ERROR) {
@@ -233,6 +260,10 @@ status_t EmulatedQemuCameraDevice::getCurrentPreviewFrame(void* buffer)
 
 bool EmulatedQemuCameraDevice::inWorkerThread()
 {
+    if (mQemuClient.isStreaming()) {
+        return receiveStreamedFrame();
+    }
+
     /* Wait till FPS timeout expires, or thread exit message is received. */
     WorkerThread::SelectRes res =
         getWorkerThread()->Select(-1, 1000000 / mEmulatedFPS);
@@ -242,6 +273,7 @@ bool EmulatedQemuCameraDevice::inWorkerThread()
     }
 
     /* Query frames from the service. */
+    const nsecs_t capture_start = systemTime(SYSTEM_TIME_MONOTONIC);
     status_t query_res = mQemuClient.queryFrame(mCurrentFrame, mPreviewFrame,
                                                  mFrameBufferSize,
                                                  mTotalPixels * 4,
@@ -252,6 +284,8 @@ bool EmulatedQemuCameraDevice::inWorkerThread()
     if (query_res == NO_ERROR) {
         /* Timestamp the current frame, and notify the camera HAL. */
         mCurFrameTimestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+        mCameraHAL->getFrameTiming()->record(CameraFrameTiming::STAGE_CAPTURE,
+                mCurFrameTimestamp - capture_start);
         mCameraHAL->onNextFrameAvailable(mCurrentFrame, mCurFrameTimestamp, this);
         return true;
     } else {
@@ -262,4 +296,51 @@ bool EmulatedQemuCameraDevice::inWorkerThread()
     }
 }
 
+bool EmulatedQemuCameraDevice::receiveStreamedFrame()
+{
+    /* The host paces the stream: wait till the next frame record arrives, or
+     * thread exit message is received. */
+    WorkerThread::SelectRes res =
+        getWorkerThread()->Select(mQemuClient.getPipeFD(), 0);
+    if (res == WorkerThread::EXIT_THREAD) {
+        ALOGV("%s: Worker thread has been terminated.", __FUNCTION__);
+        return false;
+    } else if (res != WorkerThread::READY) {
+        ALOGE("%s: Unable to wait for streamed frame", __FUNCTION__);
+        mCameraHAL->onCameraDeviceError(CAMERA_ERROR_SERVER_DIED);
+        return false;
+    }
+
+    /* Forward white balance / exposure changes to the host. */
+    if (mStreamWhiteBalanceScale != mWhiteBalanceScale ||
+        mStreamExposureCompensation != mExposureCompensation) {
+        mQemuClient.sendStreamParams(mWhiteBalanceScale[0],
+                                     mWhiteBalanceScale[1],
+                                     mWhiteBalanceScale[2],
+                                     mExposureCompensation);
+        mStreamWhiteBalanceScale = mWhiteBalanceScale;
+        mStreamExposureCompensation = mExposureCompensation;
+    }
+
+    const nsecs_t capture_start = systemTime(SYSTEM_TIME_MONOTONIC);
+    const status_t frame_res =
+        mQemuClient.receiveStreamFrame(mCurrentFrame, mPreviewFrame);
+    if (frame_res == NO_ERROR) {
+        /* Timestamp the current frame, and notify the camera HAL. */
+        mCurFrameTimestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+        mCameraHAL->getFrameTiming()->record(CameraFrameTiming::STAGE_CAPTURE,
+                mCurFrameTimestamp - capture_start);
+        mCameraHAL->onNextFrameAvailable(mCurrentFrame, mCurFrameTimestamp, this);
+        return true;
+    } else if (frame_res == EAGAIN) {
+        /* Malformed frame has been skipped. */
+        return true;
+    } else {
+        ALOGE("%s: Unable to receive streamed video frame: %s",
+             __FUNCTION__, strerror(frame_res));
+        mCameraHAL->onCameraDeviceError(CAMERA_ERROR_SERVER_DIED);
+        return false;
+    }
+}
+
 }; /* namespace android */
@@ -96,6 +96,10 @@ protected:
     /* Implementation of the worker thread routine. */
     bool inWorkerThread();
 
+private:
+    /* Worker thread routine used while the host streams frames. */
+    bool receiveStreamedFrame();
+
     /***************************************************************************
      * Qemu camera device data members
      **************************************************************************/
@@ -111,6 +115,11 @@ private:
     /* Current preview framebuffer. */
     uint32_t*           mPreviewFrame;
 
+    /* White balance scale and exposure compensation last sent to the service
+     * while frames are streamed. Used to detect parameter changes. */
+    const float*        mStreamWhiteBalanceScale;
+    float               mStreamExposureCompensation;
+
     /* Emulated FPS (frames per second).
      * We will emulate 50 FPS. */
     static const int    mEmulatedFPS = 50;
@@ -26,6 +26,7 @@
 #include <ui/GraphicBufferMapper.h>
 #include "EmulatedCameraDevice.h"
 #include "PreviewWindow.h"
+#include "CameraFrameTiming.h"
 
 namespace android {
 
@@ -34,7 +35,8 @@ PreviewWindow::PreviewWindow()
       mLastPreviewed(0),
       mPreviewFrameWidth(0),
       mPreviewFrameHeight(0),
-      mPreviewEnabled(false)
+      mPreviewEnabled(false),
+      mFrameTiming(NULL)
 {
 }
 
@@ -112,6 +114,9 @@ void PreviewWindow::onNextFrameAvailable(const void* frame,
         return;
     }
 
+    CameraFrameTiming::ScopedStageTimer timer(mFrameTiming,
+                                              CameraFrameTiming::STAGE_PREVIEW);
+
     /* Make sure that preview window dimensions are OK with the camera device */
     if (adjustPreviewDimensions(camera_dev)) {
         /* Need to set / adjust buffer geometry for the preview window.
@@ -169,7 +174,12 @@ void PreviewWindow::onNextFrameAvailable(const void* frame,
 
     /* Frames come in in YV12/NV12/NV21 format. Since preview window doesn't
      * supports those formats, we need to obtain the frame in RGB565. */
+    const nsecs_t convert_start = systemTime(SYSTEM_TIME_MONOTONIC);
     res = camera_dev->getCurrentPreviewFrame(img);
+    if (mFrameTiming != NULL) {
+        mFrameTiming->record(CameraFrameTiming::STAGE_CONVERT,
+                             systemTime(SYSTEM_TIME_MONOTONIC) - convert_start);
+    }
     if (res == NO_ERROR) {
         /* Show it. */
         mPreviewWindow->set_timestamp(mPreviewWindow, timestamp);
@@ -25,6 +25,7 @@
 namespace android {
 
 class EmulatedCameraDevice;
+class CameraFrameTiming;
 
 /* Encapsulates functionality of a preview window set via set_preview_window
  * camera HAL API.
@@ -103,6 +104,13 @@ public:
                               nsecs_t timestamp,
                               EmulatedCameraDevice* camera_dev);
 
+    /* Sets statistics that frame conversion and enqueueing are timed with.
+     * Can be NULL to disable timing. */
+    void setFrameTiming(CameraFrameTiming* timing)
+    {
+        mFrameTiming = timing;
+    }
+
     /***************************************************************************
      * Private API
      **************************************************************************/
@@ -158,6 +166,9 @@ protected:
 
     /* Preview status. */
     bool                            mPreviewEnabled;
+
+    /* Frame timing statistics, or NULL if not collected. */
+    CameraFrameTiming*              mFrameTiming;
 };
 
 }; /* namespace android */
@@ -328,6 +328,27 @@ status_t QemuClient::receiveMessage(void** data, size_t* data_size)
     }
 }
 
+status_t QemuClient::receiveFully(void* data, size_t data_size)
+{
+    if (mPipeFD < 0) {
+        ALOGE("%s: Qemu client is not connected", __FUNCTION__);
+        return EINVAL;
+    }
+
+    uint8_t* dst = reinterpret_cast<uint8_t*>(data);
+    while (data_size != 0) {
+        const int rd_res = qemud_fd_read(mPipeFD, dst, data_size);
+        if (rd_res <= 0) {
+            ALOGE("%s: Unable to read %d bytes: %s",
+                 __FUNCTION__, data_size, rd_res ? strerror(errno) : "EOF");
+            return (rd_res && errno) ? errno : EIO;
+        }
+        dst += rd_res;
+        data_size -= rd_res;
+    }
+    return NO_ERROR;
+}
+
 status_t QemuClient::doQuery(QemuQuery* query)
 {
     /* Make sure that query has been successfuly constructed. */
@@ -432,15 +453,31 @@ const char CameraQemuClient::mQueryStart[]      = "start";
 const char CameraQemuClient::mQueryStop[]       = "stop";
 /* Get next video frame from the camera device. */
 const char CameraQemuClient::mQueryFrame[]      = "frame";
+/* Start pushing frames from the camera device. */
+const char CameraQemuClient::mQueryStartStream[]  = "stream";
+/* Stop pushing frames from the camera device. */
+const char CameraQemuClient::mQueryStopStream[]   = "streamstop";
+/* Update parameters for pushed frames. */
+const char CameraQemuClient::mQueryStreamParams[] = "streamparams";
 
 CameraQemuClient::CameraQemuClient()
-    : QemuClient()
+    : QemuClient(),
+      mStreaming(false),
+      mStreamVFrameSize(0),
+      mStreamPFrameSize(0),
+      mLastSequence(0),
+      mStreamedFrames(0),
+      mDroppedFrames(0),
+      mDiscardBuffer(NULL),
+      mDiscardBufferSize(0)
 {
 }
 
 CameraQemuClient::~CameraQemuClient()
 {
-
+    if (mDiscardBuffer != NULL) {
+        delete[] mDiscardBuffer;
+    }
 }
 
 status_t CameraQemuClient::queryConnect()
@@ -556,4 +593,153 @@ status_t CameraQemuClient::queryFrame(void* vframe,
     return NO_ERROR;
 }
 
+status_t CameraQemuClient::queryStartStream(size_t vframe_size,
+                                            size_t pframe_size,
+                                            float r_scale,
+                                            float g_scale,
+                                            float b_scale,
+                                            float exposure_comp)
+{
+    ALOGV("%s", __FUNCTION__);
+
+    if (mStreaming) {
+        ALOGW("%s: Frames are already being streamed", __FUNCTION__);
+        return NO_ERROR;
+    }
+
+    char query_str[256];
+    snprintf(query_str, sizeof(query_str),
+             "%s video=%d preview=%d whiteb=%g,%g,%g expcomp=%g",
+             mQueryStartStream, vframe_size, pframe_size,
+             r_scale, g_scale, b_scale, exposure_comp);
+    QemuQuery query(query_str);
+    doQuery(&query);
+    const status_t res = query.getCompletionStatus();
+    if (res != NO_ERROR) {
+        /* Not an error: older emulators don't know about streaming. */
+        ALOGV("%s: Frame streaming is not available: %s",
+             __FUNCTION__, query.mReplyData ? query.mReplyData :
+                                              "No error message");
+        return res;
+    }
+
+    mStreaming = true;
+    mStreamVFrameSize = vframe_size;
+    mStreamPFrameSize = pframe_size;
+    mLastSequence = 0;
+    mStreamedFrames = 0;
+    mDroppedFrames = 0;
+    return NO_ERROR;
+}
+
+status_t CameraQemuClient::queryStopStream()
+{
+    ALOGV("%s", __FUNCTION__);
+
+    if (!mStreaming) {
+        return NO_ERROR;
+    }
+
+    status_t res = sendMessage(mQueryStopStream, sizeof(mQueryStopStream));
+    if (res != NO_ERROR) {
+        return res;
+    }
+
+    /* Throw away frames that were pushed before the service saw the stop
+     * request, until the end of stream marker arrives. */
+    do {
+        res = receiveStreamFrame(NULL, NULL);
+    } while (res == NO_ERROR || res == EAGAIN);
+    ALOGV("%s: Stream stopped after %d frames, %d dropped by the host",
+         __FUNCTION__, mStreamedFrames, mDroppedFrames);
+
+    return (res == ENODATA) ? NO_ERROR : res;
+}
+
+status_t CameraQemuClient::sendStreamParams(float r_scale,
+                                            float g_scale,
+                                            float b_scale,
+                                            float exposure_comp)
+{
+    char query_str[256];
+    snprintf(query_str, sizeof(query_str), "%s whiteb=%g,%g,%g expcomp=%g",
+             mQueryStreamParams, r_scale, g_scale, b_scale, exposure_comp);
+    return sendMessage(query_str, strlen(query_str) + 1);
+}
+
+status_t CameraQemuClient::receiveStreamFrame(void* vframe, void* pframe)
+{
+    if (!mStreaming) {
+        ALOGE("%s: Frames are not being streamed", __FUNCTION__);
+        return EINVAL;
+    }
+
+    /* Frame record header: payload size, and sequence number. */
+    char header[17];
+    status_t res = receiveFully(header, 16);
+    if (res != NO_ERROR) {
+        return res;
+    }
+    header[16] = '\0';
+    char* end = NULL;
+    const uint32_t sequence = strtoul(header + 8, &end, 16);
+    header[8] = '\0';
+    char* size_end = NULL;
+    const size_t payload_size = strtoul(header, &size_end, 16);
+    if (*end != '\0' || *size_end != '\0') {
+        ALOGE("%s: Invalid frame record header", __FUNCTION__);
+        return EIO;
+    }
+
+    if (payload_size == 0) {
+        /* End of stream. */
+        mStreaming = false;
+        return ENODATA;
+    }
+
+    if (mStreamedFrames != 0 && sequence != mLastSequence + 1) {
+        mDroppedFrames += sequence - mLastSequence - 1;
+    }
+    mLastSequence = sequence;
+    mStreamedFrames++;
+
+    if (payload_size != mStreamVFrameSize + mStreamPFrameSize ||
+        vframe == NULL || (pframe == NULL && mStreamPFrameSize != 0)) {
+        if (vframe != NULL) {
+            ALOGW("%s: Skipping %d bytes frame record, expected %d bytes",
+                 __FUNCTION__, payload_size,
+                 mStreamVFrameSize + mStreamPFrameSize);
+        }
+        res = discardPayload(payload_size);
+        return (res == NO_ERROR) ? EAGAIN : res;
+    }
+
+    /* Receive frames straight into the caller's framebuffers. */
+    res = receiveFully(vframe, mStreamVFrameSize);
+    if (res == NO_ERROR && mStreamPFrameSize != 0) {
+        res = receiveFully(pframe, mStreamPFrameSize);
+    }
+    return res;
+}
+
+status_t CameraQemuClient::discardPayload(size_t payload_size)
+{
+    static const size_t kMaxDiscardChunk = 64 * 1024;
+
+    if (mDiscardBuffer == NULL) {
+        mDiscardBuffer = new uint8_t[kMaxDiscardChunk];
+        mDiscardBufferSize = kMaxDiscardChunk;
+    }
+    while (payload_size != 0) {
+        const size_t chunk = (payload_size < mDiscardBufferSize) ?
+                payload_size : mDiscardBufferSize;
+        const status_t res = receiveFully(mDiscardBuffer, chunk);
+        if (res != NO_ERROR) {
+            return res;
+        }
+        payload_size -= chunk;
+    }
+    return NO_ERROR;
+}
+
 }; /* namespace android */
@@ -264,6 +264,20 @@ public:
      */
     virtual status_t receiveMessage(void** data, size_t* data_size);
 
+    /* Receives exactly data_size bytes from the service into a caller-provided
+     * buffer, retrying on short reads.
+     * Param:
+     *  data, data_size - Buffer where to receive the data.
+     * Return:
+     *  NO_ERROR on success, or an appropriate error status on failure.
+     */
+    status_t receiveFully(void* data, size_t data_size);
+
+    /* Gets the qemu pipe handle, so callers can wait on incoming data. */
+    inline int getPipeFD() const {
+        return mPipeFD;
+    }
+
     /* Sends a query, and receives a response from the service.
      * Param:
      *  query - Query to send to the service. When this method returns, the query
@@ -415,6 +429,104 @@ public:
                         float b_scale,
                         float exposure_comp);
 
+    /****************************************************************************
+     * Frame streaming API
+     *
+     * Instead of a 'frame' query per frame, the client can ask the service to
+     * push frames continuously. Once streaming has started, every message from
+     * the service is a frame record:
+     *
+     *      <8 hex chars payload size><8 hex chars sequence number><payload>
+     *
+     * where the payload is the video frame immediately followed by the preview
+     * frame, with the sizes given when the stream was started, and sequence
+     * numbers increase by one for every frame the host has captured. Gaps in
+     * the sequence are frames the host dropped because the guest didn't keep
+     * up. A record with zero payload size marks the end of the stream, after
+     * which the connection returns to the query / reply mode.
+     * Hosts that don't support streaming reply 'ko' to the 'stream' query, in
+     * which case the client should keep using queryFrame.
+     ***************************************************************************/
+
+    /* Queries camera to start pushing frames.
+     * Param:
+     *  vframe_size, pframe_size - Sizes of the video and preview frames to push.
+     *  r_scale, g_scale, b_scale - White balance scale.
+     *  exposure_comp - Expsoure compensation.
+     * Return:
+     *  NO_ERROR if the service is now streaming, or an appropriate error status.
+     */
+    status_t queryStartStream(size_t vframe_size,
+                              size_t pframe_size,
+                              float r_scale,
+                              float g_scale,
+                              float b_scale,
+                              float exposure_comp);
+
+    /* Stops frame streaming, discarding frames that were already in flight.
+     * Return:
+     *  NO_ERROR on success, or an appropriate error status on failure.
+     */
+    status_t queryStopStream();
+
+    /* Updates white balance and exposure compensation for the frames that
+     * follow. The service doesn't reply to this message.
+     * Return:
+     *  NO_ERROR on success, or an appropriate error status on failure.
+     */
+    status_t sendStreamParams(float r_scale,
+                              float g_scale,
+                              float b_scale,
+                              float exposure_comp);
+
+    /* Receives the next streamed frame directly into the caller's buffers.
+     * Param:
+     *  vframe, pframe - Buffers for the video and preview frames, of the sizes
+     *      passed to queryStartStream. pframe can be NULL if the preview frame
+     *      size was zero.
+     * Return:
+     *  NO_ERROR on success, EAGAIN if a malformed frame was skipped, ENODATA if
+     *  the stream has ended, or an appropriate error status on failure.
+     */
+    status_t receiveStreamFrame(void* vframe, void* pframe);
+
+    /* Checks if frames are being streamed by the service. */
+    inline bool isStreaming() const {
+        return mStreaming;
+    }
+
+    /* Gets number of frames received since the stream has started. */
+    inline uint32_t getStreamedFrameCount() const {
+        return mStreamedFrames;
+    }
+
+    /* Gets number of frames dropped by the host since the stream has started. */
+    inline uint32_t getDroppedFrameCount() const {
+        return mDroppedFrames;
+    }
+
+private:
+    /* Reads and discards payload_size bytes of a streamed frame record. */
+    status_t discardPayload(size_t payload_size);
+
+    /****************************************************************************
+     * Streaming data members
+     ***************************************************************************/
+
+    /* Whether the service is pushing frames. */
+    bool        mStreaming;
+    /* Expected video and preview frame sizes in each frame record. */
+    size_t      mStreamVFrameSize;
+    size_t      mStreamPFrameSize;
+    /* Sequence number of the last received frame. */
+    uint32_t    mLastSequence;
+    /* Frames received / dropped by the host since the stream has started. */
+    uint32_t    mStreamedFrames;
+    uint32_t    mDroppedFrames;
+    /* Reusable buffer for payloads that have to be thrown away. */
+    uint8_t*    mDiscardBuffer;
+    size_t      mDiscardBufferSize;
+
     /****************************************************************************
      * Names of the queries available for the emulated camera.
      ***************************************************************************/
@@ -430,6 +542,12 @@ private:
     static const char mQueryStop[];
     /* Query frame(s). */
     static const char mQueryFrame[];
+    /* Start streaming frames. */
+    static const char mQueryStartStream[];
+    /* Stop streaming frames. */
+    static const char mQueryStopStream[];
+    /* Update streaming parameters. */
+    static const char mQueryStreamParams[];
 };
 
 }; /* namespace android */
@@ -0,0 +1,680 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Headless benchmark for the emulated camera HAL.
+ *
+ * Loads the camera HAL module, and drives every camera it exposes without the
+ * camera service or a display: version 1.0 cameras (EmulatedFakeCamera,
+ * EmulatedQemuCamera) get a stub preview window, version 2.0 cameras
+ * (EmulatedFakeCamera2) get stub stream, request and frame queues. Buffers
+ * handed to the HAL come straight from gralloc, since the HAL locks them with
+ * GraphicBufferMapper. For each camera the achieved frame rate and the p50/p99
+ * frame latency are reported, followed by the HAL's own dump().
+ *
+ * Usage: camera-hal-benchmark [seconds-per-camera]
+ *
+ * The HAL version used by the fake cameras is controlled with the
+ * qemu.sf.back_camera_hal / qemu.sf.front_camera_hal properties.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <hardware/hardware.h>
+#include <hardware/camera.h>
+#include <hardware/camera2.h>
+#include <system/camera_metadata.h>
+#include <ui/GraphicBufferAllocator.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include "fake-pipeline2/LatencyHistogram.h"
+
+using namespace android;
+
+/* Default benchmark duration for each camera. */
+static const int kDefaultSeconds = 5;
+
+/* Frame size used for both camera versions. */
+static const int kFrameWidth = 640;
+static const int kFrameHeight = 480;
+
+/* Number of buffers in the stub preview window. */
+static const int kPreviewBufferCount = 4;
+
+/* Statistics collected for one camera. */
+struct BenchStats {
+    BenchStats() : frames(0), startTime(0), endTime(0) {}
+
+    void start() {
+        frames = 0;
+        latency.reset();
+        startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+
+    void onFrame(nsecs_t timestamp) {
+        const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (timestamp > 0 && timestamp <= now) {
+            latency.record(now - timestamp);
+        }
+        frames++;
+    }
+
+    void stop() {
+        endTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+
+    void report(int id, const char* kind) const {
+        const double seconds = (endTime - startTime) / 1e9;
+        printf("camera %d (%s): %d frames in %.2f s, %.2f fps,"
+               " latency p50 <= %.3f ms, p99 <= %.3f ms, max %.3f ms\n",
+               id, kind, frames, seconds,
+               seconds > 0 ? frames / seconds : 0.0,
+               latency.percentile(50) / 1e6, latency.percentile(99) / 1e6,
+               latency.max() / 1e6);
+    }
+
+    int                 frames;
+    nsecs_t             startTime;
+    nsecs_t             endTime;
+    LatencyHistogram    latency;
+};
+
+/****************************************************************************
+ * Version 1.0 camera
+ ***************************************************************************/
+
+/* Preview window that cycles through a few gralloc buffers, and only counts
+ * the frames enqueued to it. */
+struct StubPreviewWindow {
+    /* Must be the first member: the HAL passes it back to the callbacks. */
+    preview_stream_ops_t    ops;
+
+    BenchStats*             stats;
+    buffer_handle_t         buffers[kPreviewBufferCount];
+    int                     stride;
+    int                     next;
+    nsecs_t                 timestamp;
+
+    static StubPreviewWindow* from(struct preview_stream_ops* w) {
+        return reinterpret_cast<StubPreviewWindow*>(w);
+    }
+
+    void freeBuffers() {
+        for (int n = 0; n < kPreviewBufferCount; n++) {
+            if (buffers[n] != NULL) {
+                GraphicBufferAllocator::get().free(buffers[n]);
+                buffers[n] = NULL;
+            }
+        }
+    }
+
+    static int dequeue_buffer(struct preview_stream_ops* w,
+                              buffer_handle_t** buffer, int* stride) {
+        StubPreviewWindow* self = from(w);
+        if (self->buffers[self->next] == NULL) {
+            return -ENOMEM;
+        }
+        *buffer = &self->buffers[self->next];
+        *stride = self->stride;
+        self->next = (self->next + 1) % kPreviewBufferCount;
+        return 0;
+    }
+
+    static int enqueue_buffer(struct preview_stream_ops* w,
+                              buffer_handle_t* buffer) {
+        StubPreviewWindow* self = from(w);
+        self->stats->onFrame(self->timestamp);
+        return 0;
+    }
+
+    static int cancel_buffer(struct preview_stream_ops* w,
+                             buffer_handle_t* buffer) {
+        return 0;
+    }
+
+    static int set_buffer_count(struct preview_stream_ops* w, int count) {
+        return 0;
+    }
+
+    static int set_buffers_geometry(struct preview_stream_ops* w,
+                                    int width, int height, int format) {
+        StubPreviewWindow* self = from(w);
+        self->freeBuffers();
+        for (int n = 0; n < kPreviewBufferCount; n++) {
+            int32_t stride = 0;
+            status_t res = GraphicBufferAllocator::get().alloc(
+                    width, height, format,
+                    GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN,
+                    &self->buffers[n], &stride);
+            if (res != NO_ERROR) {
+                fprintf(stderr, "Unable to allocate %dx%d preview buffer: %d\n",
+                        width, height, res);
+                self->freeBuffers();
+                return res;
+            }
+            self->stride = stride;
+        }
+        self->next = 0;
+        return 0;
+    }
+
+    static int set_crop(struct preview_stream_ops* w,
+                        int left, int top, int right, int bottom) {
+        return 0;
+    }
+
+    static int set_usage(struct preview_stream_ops* w, int usage) {
+        return 0;
+    }
+
+    static int set_swap_interval(struct preview_stream_ops* w, int interval) {
+        return 0;
+    }
+
+    static int get_min_undequeued_buffer_count(
+            const struct preview_stream_ops* w, int* count) {
+        *count = 0;
+        return 0;
+    }
+
+    static int lock_buffer(struct preview_stream_ops* w,
+                           buffer_handle_t* buffer) {
+        return 0;
+    }
+
+    static int set_timestamp(struct preview_stream_ops* w, int64_t timestamp) {
+        from(w)->timestamp = timestamp;
+        return 0;
+    }
+
+    StubPreviewWindow(BenchStats* s)
+        : stats(s), stride(0), next(0), timestamp(0) {
+        memset(&ops, 0, sizeof(ops));
+        memset(buffers, 0, sizeof(buffers));
+        ops.dequeue_buffer = dequeue_buffer;
+        ops.enqueue_buffer = enqueue_buffer;
+        ops.cancel_buffer = cancel_buffer;
+        ops.set_buffer_count = set_buffer_count;
+        ops.set_buffers_geometry = set_buffers_geometry;
+        ops.set_crop = set_crop;
+        ops.set_usage = set_usage;
+        ops.set_swap_interval = set_swap_interval;
+        ops.get_min_undequeued_buffer_count = get_min_undequeued_buffer_count;
+        ops.lock_buffer = lock_buffer;
+        ops.set_timestamp = set_timestamp;
+    }
+
+    ~StubPreviewWindow() {
+        freeBuffers();
+    }
+};
+
+/* State shared with the camera 1.0 callbacks. */
+struct Camera1Callbacks {
+    Camera1Callbacks() : previewCallbacks(0), gotPicture(false) {}
+
+    Mutex       lock;
+    Condition   pictureTaken;
+    int         previewCallbacks;
+    bool        gotPicture;
+};
+
+static void camera1_release_memory(struct camera_memory* mem)
+{
+    free(mem->data);
+    delete mem;
+}
+
+static camera_memory_t* camera1_get_memory(int fd, size_t buf_size,
+                                           unsigned int num_bufs, void* user)
+{
+    camera_memory_t* mem = new camera_memory_t;
+    mem->size = buf_size * num_bufs;
+    mem->data = malloc(mem->size);
+    mem->handle = NULL;
+    mem->release = camera1_release_memory;
+    return mem;
+}
+
+static void camera1_notify(int32_t msg_type, int32_t ext1, int32_t ext2,
+                           void* user)
+{
+}
+
+static void camera1_data(int32_t msg_type, const camera_memory_t* data,
+                         unsigned int index, camera_frame_metadata_t* metadata,
+                         void* user)
+{
+    Camera1Callbacks* cb = reinterpret_cast<Camera1Callbacks*>(user);
+    Mutex::Autolock l(cb->lock);
+    if (msg_type == CAMERA_MSG_PREVIEW_FRAME) {
+        cb->previewCallbacks++;
+    } else if (msg_type == CAMERA_MSG_COMPRESSED_IMAGE) {
+        cb->gotPicture = true;
+        cb->pictureTaken.signal();
+    }
+}
+
+static void camera1_data_timestamp(nsecs_t timestamp, int32_t msg_type,
+                                   const camera_memory_t* data,
+                                   unsigned int index, void* user)
+{
+    const_cast<camera_memory_t*>(data)->release(
+            const_cast<camera_memory_t*>(data));
+}
+
+static int benchCamera1(int id, hw_device_t* device, int seconds)
+{
+    camera_device_t* dev = reinterpret_cast<camera_device_t*>(device);
+    BenchStats stats;
+    StubPreviewWindow window(&stats);
+    Camera1Callbacks cb;
+
+    dev->ops->set_callbacks(dev, camera1_notify, camera1_data,
+                            camera1_data_timestamp, camera1_get_memory, &cb);
+    dev->ops->enable_msg_type(dev, CAMERA_MSG_PREVIEW_FRAME |
+                                   CAMERA_MSG_COMPRESSED_IMAGE);
+
+    char* params = dev->ops->get_parameters(dev);
+    if (params != NULL) {
+        dev->ops->put_parameters(dev, params);
+    }
+
+    int res = dev->ops->set_preview_window(dev, &window.ops);
+    if (res != 0) {
+        fprintf(stderr, "camera %d: set_preview_window failed: %d\n", id, res);
+        return res;
+    }
+
+    stats.start();
+    res = dev->ops->start_preview(dev);
+    if (res != 0) {
+        fprintf(stderr, "camera %d: start_preview failed: %d\n", id, res);
+        return res;
+    }
+    sleep(seconds);
+    stats.stop();
+
+    /* Take one picture so JPEG compression is timed too. */
+    res = dev->ops->take_picture(dev);
+    if (res == 0) {
+        Mutex::Autolock l(cb.lock);
+        if (!cb.gotPicture) {
+            cb.pictureTaken.waitRelative(cb.lock, seconds2ns(5));
+        }
+        if (!cb.gotPicture) {
+            fprintf(stderr, "camera %d: picture was not delivered\n", id);
+        }
+    } else {
+        fprintf(stderr, "camera %d: take_picture failed: %d\n", id, res);
+    }
+    dev->ops->stop_preview(dev);
+
+    stats.report(id, "HAL v1.0");
+    {
+        Mutex::Autolock l(cb.lock);
+        printf("  %d preview frame callbacks\n", cb.previewCallbacks);
+    }
+    fflush(stdout);
+    dev->ops->dump(dev, STDOUT_FILENO);
+
+    dev->ops->set_preview_window(dev, NULL);
+    dev->ops->release(dev);
+    return 0;
+}
+
+/****************************************************************************
+ * Version 2.0 camera
+ ***************************************************************************/
+
+struct StubCamera2Queues;
+
+/* HAL callback tables, each paired with the object the callbacks act on. */
+struct StubStreamOps {
+    camera2_stream_ops_t                ops;
+    StubCamera2Queues*                  owner;
+};
+struct StubRequestQueueOps {
+    camera2_request_queue_src_ops_t     ops;
+    StubCamera2Queues*                  owner;
+};
+struct StubFrameQueueOps {
+    camera2_frame_queue_dst_ops_t       ops;
+    StubCamera2Queues*                  owner;
+};
+
+/* Output stream backed by gralloc buffers, with request and frame queues that
+ * keep submitting the same repeating preview request. */
+struct StubCamera2Queues {
+    StubStreamOps           stream;
+    StubRequestQueueOps     requests;
+    StubFrameQueueOps       frames;
+
+    BenchStats*             stats;
+    camera_metadata_t*      request;
+    Vector<buffer_handle_t> buffers;
+    Vector<bool>            dequeued;
+    volatile bool           stopping;
+    Mutex                   lock;
+    int                     metadataFrames;
+
+    static StubCamera2Queues* fromStream(const camera2_stream_ops_t* w) {
+        return reinterpret_cast<const StubStreamOps*>(w)->owner;
+    }
+
+    static StubCamera2Queues* fromRequests(
+            const camera2_request_queue_src_ops_t* q) {
+        return reinterpret_cast<const StubRequestQueueOps*>(q)->owner;
+    }
+
+    static StubCamera2Queues* fromFrames(
+            const camera2_frame_queue_dst_ops_t* q) {
+        return reinterpret_cast<const StubFrameQueueOps*>(q)->owner;
+    }
+
+    /* Stream ops */
+
+    static int dequeue_buffer(const camera2_stream_ops_t* w,
+                              buffer_handle_t** buffer) {
+        StubCamera2Queues* self = fromStream(w);
+        Mutex::Autolock l(self->lock);
+        for (size_t n = 0; n < self->buffers.size(); n++) {
+            if (!self->dequeued[n]) {
+                self->dequeued.editItemAt(n) = true;
+                *buffer = &self->buffers.editItemAt(n);
+                return 0;
+            }
+        }
+        return -ENOMEM;
+    }
+
+    void returnBuffer(buffer_handle_t* buffer) {
+        Mutex::Autolock l(lock);
+        for (size_t n = 0; n < buffers.size(); n++) {
+            if (&buffers[n] == buffer) {
+                dequeued.editItemAt(n) = false;
+                return;
+            }
+        }
+    }
+
+    static int enqueue_buffer(const camera2_stream_ops_t* w,
+                              int64_t timestamp, buffer_handle_t* buffer) {
+        StubCamera2Queues* self = fromStream(w);
+        self->stats->onFrame(timestamp);
+        self->returnBuffer(buffer);
+        return 0;
+    }
+
+    static int cancel_buffer(const camera2_stream_ops_t* w,
+                             buffer_handle_t* buffer) {
+        fromStream(w)->returnBuffer(buffer);
+        return 0;
+    }
+
+    static int set_crop(const camera2_stream_ops_t* w,
+                        int left, int top, int right, int bottom) {
+        return 0;
+    }
+
+    /* Request queue ops */
+
+    static int request_count(const camera2_request_queue_src_ops_t* q) {
+        return fromRequests(q)->stopping ? 0 : 1;
+    }
+
+    static int dequeue_request(const camera2_request_queue_src_ops_t* q,
+                               camera_metadata_t** buffer) {
+        StubCamera2Queues* self = fromRequests(q);
+        *buffer = self->stopping ? NULL : clone_camera_metadata(self->request);
+        return 0;
+    }
+
+    static int free_request(const camera2_request_queue_src_ops_t* q,
+                            camera_metadata_t* old_buffer) {
+        free_camera_metadata(old_buffer);
+        return 0;
+    }
+
+    /* Frame queue ops */
+
+    static int dequeue_frame(const camera2_frame_queue_dst_ops_t* q,
+                             size_t data_entries, size_t data_bytes,
+                             camera_metadata_t** buffer) {
+        *buffer = allocate_camera_metadata(data_entries, data_bytes);
+        return *buffer != NULL ? 0 : -ENOMEM;
+    }
+
+    static int cancel_frame(const camera2_frame_queue_dst_ops_t* q,
+                            camera_metadata_t* buffer) {
+        free_camera_metadata(buffer);
+        return 0;
+    }
+
+    static int enqueue_frame(const camera2_frame_queue_dst_ops_t* q,
+                             camera_metadata_t* filled_buffer) {
+        StubCamera2Queues* self = fromFrames(q);
+        {
+            Mutex::Autolock l(self->lock);
+            self->metadataFrames++;
+        }
+        free_camera_metadata(filled_buffer);
+        return 0;
+    }
+
+    StubCamera2Queues(BenchStats* s)
+        : stats(s), request(NULL), stopping(false), metadataFrames(0) {
+        memset(&stream, 0, sizeof(stream));
+        memset(&requests, 0, sizeof(requests));
+        memset(&frames, 0, sizeof(frames));
+        stream.ops.dequeue_buffer = dequeue_buffer;
+        stream.ops.enqueue_buffer = enqueue_buffer;
+        stream.ops.cancel_buffer = cancel_buffer;
+        stream.ops.set_crop = set_crop;
+        stream.owner = this;
+        requests.ops.request_count = request_count;
+        requests.ops.dequeue_request = dequeue_request;
+        requests.ops.free_request = free_request;
+        requests.owner = this;
+        frames.ops.dequeue_frame = dequeue_frame;
+        frames.ops.cancel_frame = cancel_frame;
+        frames.ops.enqueue_frame = enqueue_frame;
+        frames.owner = this;
+    }
+
+    ~StubCamera2Queues() {
+        for (size_t n = 0; n < buffers.size(); n++) {
+            GraphicBufferAllocator::get().free(buffers[n]);
+        }
+        if (request != NULL) {
+            free_camera_metadata(request);
+        }
+    }
+};
+
+static void camera2_notify(int32_t msg_type, int32_t ext1, int32_t ext2,
+                           int32_t ext3, void* user)
+{
+    if (msg_type == CAMERA2_MSG_ERROR) {
+        fprintf(stderr, "camera2 error notification: %d %d %d\n",
+                ext1, ext2, ext3);
+    }
+}
+
+/* Builds a preview request that outputs to the given stream. */
+static camera_metadata_t* buildCamera2Request(camera2_device_t* dev,
+                                              uint8_t stream_id)
+{
+    camera_metadata_t* defaults = NULL;
+    int res = dev->ops->construct_default_request(dev, CAMERA2_TEMPLATE_PREVIEW,
+                                                  &defaults);
+    if (res != 0 || defaults == NULL) {
+        fprintf(stderr, "Unable to construct default request: %d\n", res);
+        return NULL;
+    }
+
+    camera_metadata_t* request = allocate_camera_metadata(
+            get_camera_metadata_entry_count(defaults) + 1,
+            get_camera_metadata_data_count(defaults) + 16);
+    if (request != NULL &&
+        (append_camera_metadata(request, defaults) != 0 ||
+         add_camera_metadata_entry(request, ANDROID_REQUEST_OUTPUT_STREAMS,
+                                   &stream_id, 1) != 0)) {
+        free_camera_metadata(request);
+        request = NULL;
+    }
+    free_camera_metadata(defaults);
+    return request;
+}
+
+static int benchCamera2(int id, hw_device_t* device, int seconds)
+{
+    camera2_device_t* dev = reinterpret_cast<camera2_device_t*>(device);
+    BenchStats stats;
+    StubCamera2Queues queues(&stats);
+
+    dev->ops->set_notify_callback(dev, camera2_notify, NULL);
+    dev->ops->set_request_queue_src_ops(dev, &queues.requests.ops);
+    dev->ops->set_frame_queue_dst_ops(dev, &queues.frames.ops);
+
+    uint32_t stream_id, format_actual, usage, max_buffers;
+    int res = dev->ops->allocate_stream(dev, kFrameWidth, kFrameHeight,
+                                        HAL_PIXEL_FORMAT_RGBA_8888,
+                                        &queues.stream.ops, &stream_id,
+                                        &format_actual, &usage, &max_buffers);
+    if (res != 0) {
+        fprintf(stderr, "camera %d: allocate_stream failed: %d\n", id, res);
+        return res;
+    }
+
+    for (uint32_t n = 0; n < max_buffers; n++) {
+        buffer_handle_t handle;
+        int32_t stride;
+        res = GraphicBufferAllocator::get().alloc(kFrameWidth, kFrameHeight,
+                format_actual, usage | GRALLOC_USAGE_SW_READ_OFTEN,
+                &handle, &stride);
+        if (res != NO_ERROR) {
+            fprintf(stderr, "camera %d: unable to allocate stream buffer: %d\n",
+                    id, res);
+            dev->ops->release_stream(dev, stream_id);
+            return res;
+        }
+        queues.buffers.push_back(handle);
+        queues.dequeued.push_back(false);
+    }
+    res = dev->ops->register_stream_buffers(dev, stream_id,
+                                            queues.buffers.size(),
+                                            queues.buffers.editArray());
+    if (res != 0) {
+        fprintf(stderr, "camera %d: register_stream_buffers failed: %d\n",
+                id, res);
+        dev->ops->release_stream(dev, stream_id);
+        return res;
+    }
+
+    queues.request = buildCamera2Request(dev, stream_id);
+    if (queues.request == NULL) {
+        dev->ops->release_stream(dev, stream_id);
+        return -ENOMEM;
+    }
+
+    stats.start();
+    dev->ops->notify_request_queue_not_empty(dev);
+    sleep(seconds);
+    queues.stopping = true;
+    stats.stop();
+
+    /* Let the captures in flight drain before the buffers go away. */
+    for (int n = 0; n < 100 && dev->ops->get_in_progress_count(dev) > 0; n++) {
+        usleep(10000);
+    }
+
+    stats.report(id, "HAL v2.0");
+    {
+        Mutex::Autolock l(queues.lock);
+        printf("  %d metadata frames\n", queues.metadataFrames);
+    }
+    fflush(stdout);
+    dev->ops->dump(dev, STDOUT_FILENO);
+
+    dev->ops->release_stream(dev, stream_id);
+    return 0;
+}
+
+/****************************************************************************
+ * Main
+ ***************************************************************************/
+
+int main(int argc, char** argv)
+{
+    int seconds = kDefaultSeconds;
+    if (argc > 1) {
+        seconds = atoi(argv[1]);
+        if (seconds <= 0) {
+            fprintf(stderr, "Usage: %s [seconds-per-camera]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const hw_module_t* module = NULL;
+    if (hw_get_module(CAMERA_HARDWARE_MODULE_ID, &module) != 0) {
+        fprintf(stderr, "Unable to load camera HAL module\n");
+        return 1;
+    }
+    const camera_module_t* camera_module =
+        reinterpret_cast<const camera_module_t*>(module);
+
+    const int num = camera_module->get_number_of_cameras();
+    printf("%d camera(s), %d s each\n", num, seconds);
+
+    int failures = 0;
+    for (int id = 0; id < num; id++) {
+        struct camera_info info;
+        if (camera_module->get_camera_info(id, &info) != 0) {
+            fprintf(stderr, "camera %d: get_camera_info failed\n", id);
+            failures++;
+            continue;
+        }
+
+        char name[16];
+        snprintf(name, sizeof(name), "%d", id);
+        hw_device_t* device = NULL;
+        if (module->methods->open(module, name, &device) != 0 ||
+            device == NULL) {
+            fprintf(stderr, "camera %d: open failed\n", id);
+            failures++;
+            continue;
+        }
+
+        int res;
+        if (device->version == CAMERA_DEVICE_API_VERSION_2_0) {
+            res = benchCamera2(id, device, seconds);
+        } else {
+            res = benchCamera1(id, device, seconds);
+        }
+        if (res != 0) {
+            failures++;
+        }
+        device->close(device);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Protocol test for the frame streaming of CameraQemuClient.
+ *
+ * Each case connects a CameraQemuClient to a fake 'emulated camera' service,
+ * running in a thread on the other end of a socket pair instead of the qemu
+ * pipe. The fake service checks the queries it gets, and replies with the
+ * frame records of its script: in sequence, with gaps, of the wrong size,
+ * with a malformed header, or a 'ko' for hosts that don't stream. The client
+ * side checks the frames it receives, the dropped frame count, and that the
+ * connection is back in query / reply mode once the stream has stopped.
+ *
+ * Usage: camera-stream-test
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "EmulatedCamera.h"
+#include "QemuClient.h"
+
+using namespace android;
+
+/* Frame sizes used by the streams. */
+static const size_t kVideoSize = 4096;
+static const size_t kPreviewSize = 1024;
+
+/* Larger than the chunks discardPayload() reads. */
+static const size_t kOversizedRecord = 100000;
+
+/* Seconds before a stuck case aborts the test. */
+static const unsigned int kTimeout = 30;
+
+/* The client under test, connected to a socket instead of a qemu pipe. */
+class TestCameraClient : public CameraQemuClient {
+public:
+    void attach(int fd) {
+        mPipeFD = fd;
+    }
+};
+
+/* The end of the socket pair played by the host, and the script it runs. */
+struct FakeService {
+    int fd;
+    void (*script)(FakeService* service);
+    int failures;
+};
+
+static int sFailures = 0;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                    \
+                    __FILE__, __LINE__, #cond);                             \
+            sFailures++;                                                    \
+        }                                                                   \
+    } while (0)
+
+/* Same as CHECK, from the fake service thread. */
+#define HOST_CHECK(service, cond)                                           \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: host check failed: %s\n",               \
+                    __FILE__, __LINE__, #cond);                             \
+            (service)->failures++;                                          \
+        }                                                                   \
+    } while (0)
+
+/****************************************************************************
+ * Fake camera service
+ ***************************************************************************/
+
+static void hostWrite(int fd, const void* data, size_t size)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    while (size != 0) {
+        const ssize_t res = write(fd, p, size);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            fprintf(stderr, "%s: %s\n", __FUNCTION__, strerror(errno));
+            exit(1);
+        }
+        p += res;
+        size -= res;
+    }
+}
+
+/* Reads a zero-terminated query, or message, sent by the client. */
+static void hostReadQuery(int fd, char* query, size_t size)
+{
+    size_t len = 0;
+    for (;;) {
+        char c;
+        const ssize_t res = read(fd, &c, 1);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            fprintf(stderr, "%s: %s\n", __FUNCTION__,
+                    res ? strerror(errno) : "EOF");
+            exit(1);
+        }
+        if (len < size - 1) {
+            query[len++] = c;
+        }
+        if (c == '\0') {
+            break;
+        }
+    }
+    query[len] = '\0';
+}
+
+static bool startsWith(const char* str, const char* prefix)
+{
+    return !strncmp(str, prefix, strlen(prefix));
+}
+
+/* Replies "ok" / "ko" to a query, followed by ':' and the data if any.
+ * The reply goes in a single write, like the qemu pipe delivers it: the
+ * client reads the payload size, then the payload, with one read each. */
+static void hostReply(int fd, const char* status, const void* data,
+                      size_t size)
+{
+    char* reply = new char[8 + 3 + size];
+    snprintf(reply, 9, "%08x", (unsigned int)(3 + size));
+    memcpy(reply + 8, status, 2);
+    reply[10] = size ? ':' : '\0';
+    if (size != 0) {
+        memcpy(reply + 11, data, size);
+    }
+    hostWrite(fd, reply, 8 + 3 + size);
+    delete[] reply;
+}
+
+/* Fills a video frame with 'fill', and the preview frame after it with
+ * 'fill' + 1, so the client can tell them apart. */
+static void fillFrames(uint8_t* payload, uint8_t fill)
+{
+    memset(payload, fill, kVideoSize);
+    memset(payload + kVideoSize, fill + 1, kPreviewSize);
+}
+
+/* Pushes a frame record of 'size' bytes, filled for the sequence number. */
+static void hostRecord(int fd, uint32_t sequence, size_t size)
+{
+    char header[17];
+    snprintf(header, sizeof(header), "%08x%08x", (unsigned int)size, sequence);
+    hostWrite(fd, header, 16);
+    if (size == 0) {
+        return;
+    }
+
+    uint8_t* payload = new uint8_t[size];
+    if (size == kVideoSize + kPreviewSize) {
+        fillFrames(payload, (uint8_t)sequence);
+    } else {
+        memset(payload, 0xee, size);
+    }
+    hostWrite(fd, payload, size);
+    delete[] payload;
+}
+
+static void hostEndOfStream(int fd)
+{
+    hostRecord(fd, 0, 0);
+}
+
+/* Reads the 'stream' query, and accepts it. */
+static void hostAcceptStream(FakeService* service)
+{
+    char query[256];
+    hostReadQuery(service->fd, query, sizeof(query));
+    HOST_CHECK(service, startsWith(query, "stream video=4096 preview=1024 "));
+    hostReply(service->fd, "ok", NULL, 0);
+}
+
+/* Reads the 'stop' query the client sends once the stream is over, which
+ * only parses if the stream was drained up to its end. */
+static void hostAcceptStop(FakeService* service)
+{
+    char query[256];
+    hostReadQuery(service->fd, query, sizeof(query));
+    HOST_CHECK(service, !strcmp(query, "stop"));
+    hostReply(service->fd, "ok", NULL, 0);
+}
+
+static void* fakeServiceThread(void* arg)
+{
+    FakeService* service = reinterpret_cast<FakeService*>(arg);
+    service->script(service);
+    return NULL;
+}
+
+/****************************************************************************
+ * Test cases
+ ***************************************************************************/
+
+/* Checks that the frames of sequence 'sequence' were received. */
+static bool framesMatch(const uint8_t* vframe, const uint8_t* pframe,
+                        uint32_t sequence)
+{
+    for (size_t n = 0; n < kVideoSize; n++) {
+        if (vframe[n] != (uint8_t)sequence) {
+            return false;
+        }
+    }
+    for (size_t n = 0; n < kPreviewSize; n++) {
+        if (pframe[n] != (uint8_t)(sequence + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Frames in sequence, then a gap of two frames, a record of the wrong size,
+ * a parameter update, and frames still in flight when the stream stops. */
+static void streamScript(FakeService* service)
+{
+    const size_t frame = kVideoSize + kPreviewSize;
+    char query[256];
+
+    hostAcceptStream(service);
+    hostRecord(service->fd, 10, frame);
+    hostRecord(service->fd, 11, frame);
+    hostRecord(service->fd, 14, frame);
+    hostRecord(service->fd, 15, kOversizedRecord);
+    hostRecord(service->fd, 16, frame);
+
+    hostReadQuery(service->fd, query, sizeof(query));
+    HOST_CHECK(service, !strcmp(query, "streamparams whiteb=1,0.5,1 expcomp=2"));
+
+    /* pushed before the stop request is seen */
+    hostRecord(service->fd, 17, frame);
+    hostRecord(service->fd, 18, kOversizedRecord);
+    hostRecord(service->fd, 19, frame);
+
+    hostReadQuery(service->fd, query, sizeof(query));
+    HOST_CHECK(service, !strcmp(query, "streamstop"));
+    hostEndOfStream(service->fd);
+
+    hostAcceptStop(service);
+}
+
+static void testStream(TestCameraClient* client)
+{
+    uint8_t vframe[kVideoSize];
+    uint8_t pframe[kPreviewSize];
+
+    CHECK(client->queryStartStream(kVideoSize, kPreviewSize,
+                                   1.0f, 1.0f, 1.0f, 1.0f) == NO_ERROR);
+    CHECK(client->isStreaming());
+
+    CHECK(client->receiveStreamFrame(vframe, pframe) == NO_ERROR);
+    CHECK(framesMatch(vframe, pframe, 10));
+    CHECK(client->sendStreamParams(1.0f, 0.5f, 1.0f, 2.0f) == NO_ERROR);
+    CHECK(client->receiveStreamFrame(vframe, pframe) == NO_ERROR);
+    CHECK(framesMatch(vframe, pframe, 11));
+    CHECK(client->getDroppedFrameCount() == 0);
+
+    CHECK(client->receiveStreamFrame(vframe, pframe) == NO_ERROR);
+    CHECK(framesMatch(vframe, pframe, 14));
+    CHECK(client->getDroppedFrameCount() == 2);
+
+    /* skipped whole, without touching the frames */
+    CHECK(client->receiveStreamFrame(vframe, pframe) == EAGAIN);
+    CHECK(framesMatch(vframe, pframe, 14));
+    CHECK(client->receiveStreamFrame(vframe, pframe) == NO_ERROR);
+    CHECK(framesMatch(vframe, pframe, 16));
+    CHECK(client->getStreamedFrameCount() == 5);
+
+    CHECK(client->queryStopStream() == NO_ERROR);
+    CHECK(!client->isStreaming());
+    CHECK(client->getStreamedFrameCount() == 8);
+    CHECK(client->getDroppedFrameCount() == 2);
+
+    CHECK(client->queryStop() == NO_ERROR);
+}
+
+/* The host ends the stream on its own. */
+static void endOfStreamScript(FakeService* service)
+{
+    hostAcceptStream(service);
+    hostRecord(service->fd, 1, kVideoSize + kPreviewSize);
+    hostEndOfStream(service->fd);
+    hostAcceptStop(service);
+}
+
+static void testEndOfStream(TestCameraClient* client)
+{
+    uint8_t vframe[kVideoSize];
+    uint8_t pframe[kPreviewSize];
+
+    CHECK(client->queryStartStream(kVideoSize, kPreviewSize,
+                                   1.0f, 1.0f, 1.0f, 1.0f) == NO_ERROR);
+    CHECK(client->receiveStreamFrame(vframe, pframe) == NO_ERROR);
+    CHECK(framesMatch(vframe, pframe, 1));
+    CHECK(client->receiveStreamFrame(vframe, pframe) == ENODATA);
+    CHECK(!client->isStreaming());
+
+    /* nothing left to drain, and no 'streamstop' is sent */
+    CHECK(client->queryStopStream() == NO_ERROR);
+    CHECK(client->queryStop() == NO_ERROR);
+}
+
+static void badHeaderScript(FakeService* service)
+{
+    hostAcceptStream(service);
+    hostWrite(service->fd, "0000140z00000001", 16);
+}
+
+static void testBadHeader(TestCameraClient* client)
+{
+    uint8_t vframe[kVideoSize];
+    uint8_t pframe[kPreviewSize];
+
+    CHECK(client->queryStartStream(kVideoSize, kPreviewSize,
+                                   1.0f, 1.0f, 1.0f, 1.0f) == NO_ERROR);
+    CHECK(client->receiveStreamFrame(vframe, pframe) == EIO);
+}
+
+/* A host which doesn't stream: the client falls back to 'frame' queries. */
+static void fallbackScript(FakeService* service)
+{
+    char query[256];
+
+    hostReadQuery(service->fd, query, sizeof(query));
+    HOST_CHECK(service, startsWith(query, "stream "));
+    static const char kUnknown[] = "unknown query";
+    hostReply(service->fd, "ko", kUnknown, sizeof(kUnknown));
+
+    hostReadQuery(service->fd, query, sizeof(query));
+    HOST_CHECK(service, startsWith(query, "frame video=4096 preview=1024 "));
+    uint8_t payload[kVideoSize + kPreviewSize];
+    fillFrames(payload, 0x21);
+    hostReply(service->fd, "ok", payload, sizeof(payload));
+}
+
+static void testFallback(TestCameraClient* client)
+{
+    uint8_t vframe[kVideoSize];
+    uint8_t pframe[kPreviewSize];
+
+    CHECK(client->queryStartStream(kVideoSize, kPreviewSize,
+                                   1.0f, 1.0f, 1.0f, 1.0f) != NO_ERROR);
+    CHECK(!client->isStreaming());
+    CHECK(client->queryFrame(vframe, pframe, kVideoSize, kPreviewSize,
+                             1.0f, 1.0f, 1.0f, 1.0f) == NO_ERROR);
+    CHECK(framesMatch(vframe, pframe, 0x21));
+}
+
+/* Runs a test case against a fake service running 'script'. */
+static void runCase(const char* name,
+                    void (*script)(FakeService* service),
+                    void (*test)(TestCameraClient* client))
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        fprintf(stderr, "socketpair: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    FakeService service;
+    service.fd = fds[1];
+    service.script = script;
+    service.failures = 0;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, fakeServiceThread, &service) != 0) {
+        fprintf(stderr, "Unable to start the fake camera service\n");
+        exit(1);
+    }
+
+    const int failures = sFailures;
+    {
+        TestCameraClient client;
+        client.attach(fds[0]);
+        test(&client);
+        /* the client closes its end */
+    }
+    pthread_join(thread, NULL);
+    close(fds[1]);
+
+    sFailures += service.failures;
+    printf("%-16s %s\n", name, (sFailures == failures) ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv)
+{
+    /* a failed case reports its checks, instead of dying on a write */
+    signal(SIGPIPE, SIG_IGN);
+    alarm(kTimeout);
+
+    runCase("stream", streamScript, testStream);
+    runCase("end of stream", endOfStreamScript, testEndOfStream);
+    runCase("bad header", badHeaderScript, testBadHeader);
+    runCase("fallback", fallbackScript, testFallback);
+
+    if (sFailures != 0) {
+        fprintf(stderr, "%d checks failed\n", sFailures);
+        return 1;
+    }
+    return 0;
+}
@@ -30,7 +30,8 @@ JpegCompressor::JpegCompressor(EmulatedFakeCamera2 *parent):
         mIsBusy(false),
         mParent(parent),
         mBuffers(NULL),
-        mCaptureTime(0) {
+        mCaptureTime(0),
+        mStartTime(0) {
 }
 
 JpegCompressor::~JpegCompressor() {
@@ -52,6 +53,7 @@ status_t JpegCompressor::start(Buffers *buffers,
 
         mBuffers = buffers;
         mCaptureTime = captureTime;
+        mStartTime = systemTime();
     }
 
     status_t res;
@@ -170,6 +172,7 @@ bool JpegCompressor::threadLoop() {
                 __FUNCTION__, mJpegBuffer.buffer, strerror(-res), res);
         mParent->signalError();
     }
+    mLatency.record(systemTime() - mStartTime);
 
     // All done
 
@@ -194,6 +197,10 @@ bool JpegCompressor::isStreamInUse(uint32_t id) {
     return false;
 }
 
+void JpegCompressor::dump(String8 &result) {
+    mLatency.dump(result, "        JPEG compression    ");
+}
+
 bool JpegCompressor::waitForDone(nsecs_t timeout) {
     Mutex::Autolock lock(mBusyMutex);
     status_t res = OK;
@@ -29,6 +29,7 @@
 #include "utils/Timers.h"
 
 #include "Base.h"
+#include "LatencyHistogram.h"
 
 #include <stdio.h>
 
@@ -58,6 +59,9 @@ class JpegCompressor: private Thread, public virtual RefBase {
 
     bool waitForDone(nsecs_t timeout);
 
+    // Append compression latency statistics to result
+    void dump(String8 &result);
+
     // TODO: Measure this
     static const size_t kMaxJpegSize = 300000;
 
@@ -73,6 +77,10 @@ class JpegCompressor: private Thread, public virtual RefBase {
     Buffers *mBuffers;
     nsecs_t mCaptureTime;
 
+    // Time from start() to the compressed buffer being enqueued
+    nsecs_t mStartTime;
+    LatencyHistogram mLatency;
+
     StreamBuffer mJpegBuffer, mAuxBuffer;
     bool mFoundJpeg, mFoundAux;
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/atomic.h>
+
+#include "LatencyHistogram.h"
+
+namespace android {
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    for (int i = 0; i < kNumBuckets; i++) {
+        android_atomic_release_store(0, &mBuckets[i]);
+    }
+    android_atomic_release_store(0, &mCount);
+    android_atomic_release_store(0, &mMaxUs);
+}
+
+void LatencyHistogram::record(nsecs_t latency) {
+    int64_t us = latency / 1000;
+    if (us < 0) us = 0;
+    if (us > 0x7FFFFFFF) us = 0x7FFFFFFF;
+
+    // Bucket index is the bit length of the sample in microseconds
+    int bucket = 0;
+    for (uint32_t v = (uint32_t)us; v != 0 && bucket < kNumBuckets - 1;
+         v >>= 1) {
+        bucket++;
+    }
+    android_atomic_inc(&mBuckets[bucket]);
+    android_atomic_inc(&mCount);
+
+    int32_t oldMax;
+    do {
+        oldMax = android_atomic_acquire_load(&mMaxUs);
+        if (oldMax >= us) break;
+    } while (android_atomic_cmpxchg(oldMax, (int32_t)us, &mMaxUs) != 0);
+}
+
+int32_t LatencyHistogram::count() const {
+    return android_atomic_acquire_load(&mCount);
+}
+
+nsecs_t LatencyHistogram::percentile(int percent) const {
+    int32_t total = count();
+    if (total == 0) return 0;
+
+    // Rank of the sample we are looking for, rounded up
+    int64_t rank = ((int64_t)total * percent + 99) / 100;
+    if (rank < 1) rank = 1;
+    int64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; i++) {
+        seen += android_atomic_acquire_load(&mBuckets[i]);
+        if (seen >= rank) {
+            nsecs_t bound = max();
+            if (i < kNumBuckets - 1 && (nsecs_t)(1LL << i) * 1000 < bound) {
+                bound = (nsecs_t)(1LL << i) * 1000;
+            }
+            return bound;
+        }
+    }
+    return max();
+}
+
+nsecs_t LatencyHistogram::max() const {
+    return (nsecs_t)android_atomic_acquire_load(&mMaxUs) * 1000;
+}
+
+void LatencyHistogram::dump(String8 &result, const char *name) const {
+    result.appendFormat("%s: %d samples, p50 <= %.3f ms, p99 <= %.3f ms,"
+            " max %.3f ms\n",
+            name, count(),
+            percentile(50) / 1e6, percentile(99) / 1e6, max() / 1e6);
+}
+
+} // namespace android
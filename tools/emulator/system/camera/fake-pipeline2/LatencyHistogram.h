@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A fixed-size latency histogram for timing the stages of the fake camera
+ * pipeline. Samples are binned into power-of-two microsecond buckets using
+ * atomic increments, so any thread can record without taking a lock, and the
+ * collected distribution can be printed from dump().
+ */
+
+#ifndef HW_EMULATOR_CAMERA2_LATENCY_HISTOGRAM_H
+#define HW_EMULATOR_CAMERA2_LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class LatencyHistogram {
+  public:
+    LatencyHistogram();
+
+    void reset();
+
+    // Record one sample. Safe to call from any thread.
+    void record(nsecs_t latency);
+
+    // Number of samples recorded so far
+    int32_t count() const;
+
+    // Upper bound of the bucket holding the given percentile (0-100), capped
+    // at the largest sample
+    nsecs_t percentile(int percent) const;
+
+    // Largest sample seen so far
+    nsecs_t max() const;
+
+    // Append a one-line summary of the distribution to result
+    void dump(String8 &result, const char *name) const;
+
+    // Bucket i counts samples in [2^(i-1), 2^i) us; the last bucket is open
+    static const int kNumBuckets = 25;
+
+  private:
+    volatile int32_t mBuckets[kNumBuckets];
+    volatile int32_t mCount;
+    volatile int32_t mMaxUs;
+};
+
+} // namespace android
+
+#endif // HW_EMULATOR_CAMERA2_LATENCY_HISTOGRAM_H
@@ -40,6 +40,8 @@ namespace android {
 #define K (Scene::SKY * Scene::NUM_CHANNELS)
 #define M (Scene::MOON * Scene::NUM_CHANNELS)
 
+const nsecs_t Scene::kSceneRefreshInterval = 1000000000LL; // 1 s
+
 const int Scene::kSceneWidth = 20;
 const int Scene::kSceneHeight = 20;
 
@@ -88,7 +90,9 @@ Scene::Scene(
         mSensorHeight(sensorHeightPx),
         mHour(12),
         mExposureDuration(0.033f),
-        mSensorSensitivity(sensorSensitivity)
+        mSensorSensitivity(sensorSensitivity),
+        mSceneDirty(true),
+        mSceneTime(0)
 {
     // Map scene to sensor pixels
     if (mSensorWidth > mSensorHeight) {
@@ -105,10 +109,29 @@ Scene::Scene(
     mFilterGb[0] = -0.9689f; mFilterGb[1] =  1.8758f; mFilterGb[2] =  0.0415f;
     mFilterB[0]  =  0.0557f; mFilterB[1]  = -0.2040f; mFilterB[2]  =  1.0570f;
 
-
+    mHandshakeX = 0;
+    mHandshakeY = 0;
+
+    // Lay out the material tiles. Tile column 0 corresponds to sensor column
+    // -mMapDiv; scene pixels outside the scene map reuse the edge cell.
+    mTileWidth = mSensorWidth + 2 * mMapDiv;
+    mMaterialTiles = new uint8_t[kSceneHeight * mTileWidth];
+    mElectronTiles = new uint32_t[kSceneHeight * kNumTileChannels * mTileWidth];
+    int tileStartX = mOffsetX - mMapDiv;
+    for (int sceneY = 0; sceneY < kSceneHeight; sceneY++) {
+        uint8_t *materialRow = mMaterialTiles + sceneY * mTileWidth;
+        for (int i = 0; i < mTileWidth; i++) {
+            int sceneX = (tileStartX + i) / mMapDiv;
+            if (sceneX < 0) sceneX = 0;
+            if (sceneX >= kSceneWidth) sceneX = kSceneWidth - 1;
+            materialRow[i] = kScene[sceneY * kSceneWidth + sceneX];
+        }
+    }
 }
 
 Scene::~Scene() {
+    delete[] mMaterialTiles;
+    delete[] mElectronTiles;
 }
 
 void Scene::setColorFilterXYZ(
@@ -120,11 +143,15 @@ void Scene::setColorFilterXYZ(
     mFilterGr[0] = grX; mFilterGr[1] = grY; mFilterGr[2] = grZ;
     mFilterGb[0] = gbX; mFilterGb[1] = gbY; mFilterGb[2] = gbZ;
     mFilterB[0]  = bX;  mFilterB[1]  = bY;  mFilterB[2]  = bZ;
+    mSceneDirty = true;
 }
 
 void Scene::setHour(int hour) {
     ALOGV("Hour set to: %d", hour);
-    mHour = hour % 24;
+    if (mHour != hour % 24) {
+        mHour = hour % 24;
+        mSceneDirty = true;
+    }
 }
 
 int Scene::getHour() {
@@ -132,10 +159,31 @@ int Scene::getHour() {
 }
 
 void Scene::setExposureDuration(float seconds) {
-    mExposureDuration = seconds;
+    if (mExposureDuration != seconds) {
+        mExposureDuration = seconds;
+        mSceneDirty = true;
+    }
 }
 
 void Scene::calculateScene(nsecs_t time) {
+    // Illumination drifts slowly over the time of day, so material colors and
+    // readout tiles are reused across frames unless a parameter changed.
+    if (mSceneDirty || time < mSceneTime ||
+            time - mSceneTime >= kSceneRefreshInterval) {
+        calculateColors(time);
+        calculateTiles();
+        mSceneDirty = false;
+        mSceneTime = time;
+    }
+
+    // Shake viewpoint
+    mHandshakeX = rand() % mMapDiv/4 - mMapDiv/8;
+    mHandshakeY = rand() % mMapDiv/4 - mMapDiv/8;
+    // Set starting pixel
+    setReadoutPixel(0,0);
+}
+
+void Scene::calculateColors(nsecs_t time) {
     // Calculate time fractions for interpolation
     int timeIdx = mHour / kTimeStep;
     int nextTimeIdx = (timeIdx + 1) % (24 / kTimeStep);
@@ -320,11 +368,20 @@ void Scene::calculateScene(nsecs_t time) {
                 mCurrentColors[i*NUM_CHANNELS + 2],
                 mCurrentColors[i*NUM_CHANNELS + 3]);
     }
-    // Shake viewpoint
-    mHandshakeX = rand() % mMapDiv/4 - mMapDiv/8;
-    mHandshakeY = rand() % mMapDiv/4 - mMapDiv/8;
-    // Set starting pixel
-    setReadoutPixel(0,0);
+}
+
+void Scene::calculateTiles() {
+    for (int sceneY = 0; sceneY < kSceneHeight; sceneY++) {
+        const uint8_t *materialRow = mMaterialTiles + sceneY * mTileWidth;
+        uint32_t *tileRow =
+                mElectronTiles + sceneY * kNumTileChannels * mTileWidth;
+        for (int c = 0; c < kNumTileChannels; c++) {
+            uint32_t *channelRow = tileRow + c * mTileWidth;
+            for (int i = 0; i < mTileWidth; i++) {
+                channelRow[i] = mCurrentColors[materialRow[i] + c];
+            }
+        }
+    }
 }
 
 void Scene::setReadoutPixel(int x, int y) {
@@ -356,6 +413,15 @@ const uint32_t* Scene::getPixelElectrons() {
     return pixel;
 }
 
+const uint32_t* Scene::getRowElectrons(int y, int channel) {
+    int sceneY = (y + mOffsetY + mHandshakeY) / mMapDiv;
+    if (sceneY < 0) sceneY = 0;
+    if (sceneY >= kSceneHeight) sceneY = kSceneHeight - 1;
+    return mElectronTiles +
+            (sceneY * kNumTileChannels + channel) * mTileWidth +
+            mMapDiv + mHandshakeX;
+}
+
 // RGB->YUV, Jpeg standard
 const float Scene::kRgb2Yuv[12] = {
        0.299f,    0.587f,    0.114f,    0.f,
@@ -60,7 +60,9 @@ class Scene {
 
     // Calculate scene information for current hour and the time offset since
     // the hour. Must be called at least once before calling getLuminousExposure.
-    // Resets pixel readout location to 0,0
+    // Resets pixel readout location to 0,0. Material colors and readout tiles
+    // are only recomputed if the hour, exposure or color filters changed, or
+    // kSceneRefreshInterval has passed since they were last computed.
     void calculateScene(nsecs_t time);
 
     // Set sensor pixel readout location.
@@ -72,6 +74,11 @@ class Scene {
     // ColorChannels.
     const uint32_t* getPixelElectrons();
 
+    // Get sensor response for readout row y as a contiguous slice of
+    // sensor-width electron counts for one color filter channel (R, Gr, Gb or
+    // B). Served from precomputed tiles; valid until the next calculateScene.
+    const uint32_t* getRowElectrons(int y, int channel);
+
     enum ColorChannels {
         R = 0,
         Gr,
@@ -127,6 +134,23 @@ class Scene {
 
     uint32_t mCurrentColors[NUM_MATERIALS*NUM_CHANNELS];
 
+    // Readout tiles: for every scene row, the electron counts of each color
+    // filter channel laid out at sensor pixel resolution, with mMapDiv pixels
+    // of margin on either side to absorb handshake. A readout row is then just
+    // an offset into the tile of its scene row.
+    static const int kNumTileChannels = B + 1;
+    int mTileWidth;
+    // Material of each tile pixel, as an offset into mCurrentColors. Depends
+    // only on the scene geometry, so it is built once.
+    uint8_t *mMaterialTiles;
+    uint32_t *mElectronTiles;
+
+    bool mSceneDirty;
+    nsecs_t mSceneTime;
+
+    void calculateColors(nsecs_t time);
+    void calculateTiles();
+
     /**
      * Constants for scene definition. These are various degrees of approximate.
      */
@@ -170,6 +194,9 @@ class Scene {
     static const float kMaterials_xyY[NUM_MATERIALS][3];
     static const uint8_t kMaterialsFlags[NUM_MATERIALS];
 
+    // Longest time material colors are reused before being recomputed
+    static const nsecs_t kSceneRefreshInterval;
+
     static const int kSceneWidth;
     static const int kSceneHeight;
     static const uint8_t kScene[];
@@ -30,6 +30,7 @@
 #include "Sensor.h"
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include "system/camera_metadata.h"
 
 namespace android {
@@ -92,15 +93,58 @@ float sqrtf_approx(float r) {
     // symmetric about the real answer.
     const int32_t modifier = 0x1FBB4000;
 
-    int32_t r_i = *(int32_t*)(&r);
+    // memcpy instead of pointer casts keeps this strict-aliasing safe, and
+    // compiles down to plain register moves.
+    int32_t r_i;
+    memcpy(&r_i, &r, sizeof(r_i));
     r_i = (r_i >> 1) + modifier;
 
-    return *(float*)(&r_i);
+    float result;
+    memcpy(&result, &r_i, sizeof(result));
+    return result;
 }
 
+// Counter-based noise source: hashes a pixel counter into a uniformly
+// distributed 32-bit value. Unlike rand(), there is no serial state, so noise
+// for a whole row can be computed in one vectorizable loop.
+static inline uint32_t noiseHash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// Scale electron counts to 8bpp with saturation, using the 64x fixed-point
+// gain. Plain array loop, so it vectorizes.
+static void scaleTo8bpp(const uint32_t *counts, uint32_t scale64x,
+        uint8_t *out, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t count = counts[i] * scale64x;
+        out[i] = count < 255*64 ? count / 64 : 255;
+    }
+}
+
+// RGB->YCbCr, Jpeg standard, in 8.8 fixed point
+static inline uint8_t rgbToY(uint32_t r, uint32_t g, uint32_t b) {
+    return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+static inline uint8_t rgbToCb(uint32_t r, uint32_t g, uint32_t b) {
+    int32_t cb = (-43 * (int32_t)r - 85 * (int32_t)g + 128 * (int32_t)b
+            + 32896) >> 8;
+    return cb < 255 ? cb : 255;
+}
+
+static inline uint8_t rgbToCr(uint32_t r, uint32_t g, uint32_t b) {
+    int32_t cr = (128 * (int32_t)r - 107 * (int32_t)g - 21 * (int32_t)b
+            + 32896) >> 8;
+    return cr < 255 ? cr : 255;
+}
 
 
-Sensor::Sensor(EmulatedFakeCamera2 *parent):
+Sensor::Sensor(EmulatedFakeCamera2 *parent, size_t pipelineDepth):
         Thread(false),
         mParent(parent),
         mGotVSync(false),
@@ -108,21 +152,38 @@ Sensor::Sensor(EmulatedFakeCamera2 *parent):
         mFrameDuration(kFrameDurationRange[0]),
         mGainFactor(kDefaultSensitivity),
         mNextBuffers(NULL),
-        mCapturedBuffers(NULL),
-        mScene(kResolution[0], kResolution[1], kElectronsPerLuxSecond)
+        mExposedFrames(pipelineDepth),
+        mReadoutFrames(pipelineDepth),
+        mScene(kResolution[0], kResolution[1], kElectronsPerLuxSecond),
+        mNoiseSeed(0)
 {
+    mRowCounts = new uint32_t[kResolution[0]];
+    mRowR = new uint8_t[kResolution[0]];
+    mRowG = new uint8_t[kResolution[0]];
+    mRowB = new uint8_t[kResolution[0]];
 
+    mReadoutThread = new ReadoutThread(this);
 }
 
 Sensor::~Sensor() {
     shutDown();
+    delete[] mRowCounts;
+    delete[] mRowR;
+    delete[] mRowG;
+    delete[] mRowB;
 }
 
 status_t Sensor::startUp() {
     ALOGV("%s: E", __FUNCTION__);
 
     int res;
-    mCapturedBuffers = NULL;
+    res = mReadoutThread->run("EmulatedFakeCamera2::SensorReadout",
+            ANDROID_PRIORITY_URGENT_DISPLAY);
+    if (res != OK) {
+        ALOGE("Unable to start up sensor readout thread: %d", res);
+        return res;
+    }
+
     res = run("EmulatedFakeCamera2::Sensor",
             ANDROID_PRIORITY_URGENT_DISPLAY);
 
@@ -139,6 +200,11 @@ status_t Sensor::shutDown() {
     res = requestExitAndWait();
     if (res != OK) {
         ALOGE("Unable to shut down sensor capture thread: %d", res);
+        return res;
+    }
+    res = mReadoutThread->requestExitAndWait();
+    if (res != OK) {
+        ALOGE("Unable to shut down sensor readout thread: %d", res);
     }
     return res;
 }
@@ -185,26 +251,42 @@ bool Sensor::waitForVSync(nsecs_t reltime) {
 
 bool Sensor::waitForNewFrame(nsecs_t reltime,
         nsecs_t *captureTime) {
-    Mutex::Autolock lock(mReadoutMutex);
-    uint8_t *ret;
-    if (mCapturedBuffers == NULL) {
-        int res;
-        res = mReadoutAvailable.waitRelative(mReadoutMutex, reltime);
-        if (res == TIMED_OUT) {
-            return false;
-        } else if (res != OK || mCapturedBuffers == NULL) {
-            ALOGE("Error waiting for sensor readout signal: %d", res);
-            return false;
+    Frame frame;
+    if (!mReadoutFrames.pop(&frame)) {
+        Mutex::Autolock lock(mReadoutMutex);
+        if (!mReadoutFrames.pop(&frame)) {
+            int res;
+            res = mReadoutAvailable.waitRelative(mReadoutMutex, reltime);
+            if (res == TIMED_OUT) {
+                return false;
+            } else if (res != OK) {
+                ALOGE("Error waiting for sensor readout signal: %d", res);
+                return false;
+            }
+            if (!mReadoutFrames.pop(&frame)) return false;
         }
-    } else {
+    }
+    {
+        // Let the readout thread know there's room again
+        Mutex::Autolock lock(mReadoutMutex);
         mReadoutComplete.signal();
     }
+    mDeliveryLatency.record(systemTime() - frame.queueTime);
 
-    *captureTime = mCaptureTime;
-    mCapturedBuffers = NULL;
+    *captureTime = frame.captureTime;
     return true;
 }
 
+void Sensor::dump(String8 &result) {
+    result.appendFormat("      Sensor pipeline depth %d, queued: exposed %d,"
+            " read out %d\n",
+            mExposedFrames.capacity(), mExposedFrames.size(),
+            mReadoutFrames.size());
+    mReadoutQueueLatency.dump(result, "        Expose -> readout wait");
+    mReadoutLatency.dump(result,      "        Readout             ");
+    mDeliveryLatency.dump(result,     "        Readout -> delivery ");
+}
+
 status_t Sensor::readyToRun() {
     ALOGV("Starting up sensor thread");
     mStartupTime = systemTime();
@@ -215,7 +297,9 @@ status_t Sensor::readyToRun() {
 
 bool Sensor::threadLoop() {
     /**
-     * Sensor capture operation main loop.
+     * Sensor exposure timing main loop. Only frame timing happens here; the
+     * image data is generated on the readout thread, so the work for all
+     * output buffers doesn't have to fit inside the frame period.
      *
      * Stages are out-of-order relative to a single frame's processing, but
      * in-order in time.
@@ -244,103 +328,45 @@ bool Sensor::threadLoop() {
     }
 
     /**
-     * Stage 3: Read out latest captured image
+     * Stage 3: Hand the latest exposed image to the readout thread
      */
 
-    Buffers *capturedBuffers = NULL;
-    nsecs_t captureTime = 0;
-
     nsecs_t startRealTime  = systemTime();
     // Stagefright cares about system time for timestamps, so base simulated
     // time on that.
     nsecs_t simulatedTime    = startRealTime;
     nsecs_t frameEndRealTime = startRealTime + frameDuration;
-    nsecs_t frameReadoutEndRealTime = startRealTime +
-            kRowReadoutTime * kResolution[1];
 
     if (mNextCapturedBuffers != NULL) {
         ALOGVV("Sensor starting readout");
-        // Pretend we're doing readout now; will signal once enough time has elapsed
-        capturedBuffers = mNextCapturedBuffers;
-        captureTime    = mNextCaptureTime;
-    }
-    simulatedTime += kRowReadoutTime + kMinVerticalBlank;
-
-    // TODO: Move this signal to another thread to simulate readout
-    // time properly
-    if (capturedBuffers != NULL) {
-        ALOGVV("Sensor readout complete");
-        Mutex::Autolock lock(mReadoutMutex);
-        if (mCapturedBuffers != NULL) {
-            ALOGV("Waiting for readout thread to catch up!");
-            mReadoutComplete.wait(mReadoutMutex);
+        Frame frame;
+        frame.buffers          = mNextCapturedBuffers;
+        frame.captureTime      = mNextCaptureTime;
+        frame.exposureDuration = mNextExposureDuration;
+        frame.gain             = mNextGain;
+        frame.queueTime        = startRealTime;
+        if (!mExposedFrames.push(frame)) {
+            Mutex::Autolock lock(mExposedMutex);
+            while (!mExposedFrames.push(frame)) {
+                ALOGV("Waiting for readout thread to catch up!");
+                mExposedSpace.waitRelative(mExposedMutex, frameDuration);
+                if (exitPending()) return false;
+            }
         }
-
-        mCapturedBuffers = capturedBuffers;
-        mCaptureTime = captureTime;
-        mReadoutAvailable.signal();
-        capturedBuffers = NULL;
+        Mutex::Autolock lock(mExposedMutex);
+        mExposedAvailable.signal();
+        mNextCapturedBuffers = NULL;
     }
+    simulatedTime += kRowReadoutTime + kMinVerticalBlank;
 
     /**
-     * Stage 2: Capture new image
+     * Stage 2: Start exposing new image
      */
 
     mNextCaptureTime = simulatedTime;
     mNextCapturedBuffers = nextBuffers;
-
-    if (mNextCapturedBuffers != NULL) {
-        ALOGVV("Starting next capture: Exposure: %f ms, gain: %d",
-                (float)exposureDuration/1e6, gain);
-        mScene.setExposureDuration((float)exposureDuration/1e9);
-        mScene.calculateScene(mNextCaptureTime);
-
-        // Might be adding more buffers, so size isn't constant
-        for (size_t i = 0; i < mNextCapturedBuffers->size(); i++) {
-            const StreamBuffer &b = (*mNextCapturedBuffers)[i];
-            ALOGVV("Sensor capturing buffer %d: stream %d,"
-                    " %d x %d, format %x, stride %d, buf %p, img %p",
-                    i, b.streamId, b.width, b.height, b.format, b.stride,
-                    b.buffer, b.img);
-            switch(b.format) {
-                case HAL_PIXEL_FORMAT_RAW_SENSOR:
-                    captureRaw(b.img, gain, b.stride);
-                    break;
-                case HAL_PIXEL_FORMAT_RGB_888:
-                    captureRGB(b.img, gain, b.stride);
-                    break;
-                case HAL_PIXEL_FORMAT_RGBA_8888:
-                    captureRGBA(b.img, gain, b.stride);
-                    break;
-                case HAL_PIXEL_FORMAT_BLOB:
-                    // Add auxillary buffer of the right size
-                    // Assumes only one BLOB (JPEG) buffer in
-                    // mNextCapturedBuffers
-                    StreamBuffer bAux;
-                    bAux.streamId = 0;
-                    bAux.width = b.width;
-                    bAux.height = b.height;
-                    bAux.format = HAL_PIXEL_FORMAT_RGB_888;
-                    bAux.stride = b.width;
-                    bAux.buffer = NULL;
-                    // TODO: Reuse these
-                    bAux.img = new uint8_t[b.width * b.height * 3];
-                    mNextCapturedBuffers->push_back(bAux);
-                    break;
-                case HAL_PIXEL_FORMAT_YCrCb_420_SP:
-                    captureNV21(b.img, gain, b.stride);
-                    break;
-                case HAL_PIXEL_FORMAT_YV12:
-                    // TODO:
-                    ALOGE("%s: Format %x is TODO", __FUNCTION__, b.format);
-                    break;
-                default:
-                    ALOGE("%s: Unknown format %x, no output", __FUNCTION__,
-                            b.format);
-                    break;
-            }
-        }
-    }
+    mNextExposureDuration = exposureDuration;
+    mNextGain = gain;
 
     ALOGVV("Sensor vertical blanking interval");
     nsecs_t workDoneRealTime = systemTime();
@@ -362,40 +388,148 @@ bool Sensor::threadLoop() {
     return true;
 };
 
+Sensor::ReadoutThread::ReadoutThread(Sensor *parent):
+        Thread(false),
+        mParent(parent) {
+}
+
+bool Sensor::ReadoutThread::threadLoop() {
+    static const nsecs_t kWaitPerLoop = 10000000L; // 10 ms
+    Sensor *p = mParent;
+
+    Frame frame;
+    if (!p->mExposedFrames.pop(&frame)) {
+        Mutex::Autolock lock(p->mExposedMutex);
+        if (!p->mExposedFrames.pop(&frame)) {
+            p->mExposedAvailable.waitRelative(p->mExposedMutex, kWaitPerLoop);
+            return true;
+        }
+    }
+    {
+        Mutex::Autolock lock(p->mExposedMutex);
+        p->mExposedSpace.signal();
+    }
+
+    nsecs_t startTime = systemTime();
+    p->mReadoutQueueLatency.record(startTime - frame.queueTime);
+    p->readoutFrame(frame);
+    frame.queueTime = systemTime();
+    p->mReadoutLatency.record(frame.queueTime - startTime);
+
+    if (!p->mReadoutFrames.push(frame)) {
+        Mutex::Autolock lock(p->mReadoutMutex);
+        while (!p->mReadoutFrames.push(frame)) {
+            ALOGV("Waiting for frame consumer to catch up!");
+            p->mReadoutComplete.waitRelative(p->mReadoutMutex, kWaitPerLoop);
+            if (exitPending()) return false;
+        }
+    }
+    ALOGVV("Sensor readout complete");
+    Mutex::Autolock lock(p->mReadoutMutex);
+    p->mReadoutAvailable.signal();
+    return true;
+}
+
+void Sensor::readoutFrame(const Frame &frame) {
+    ALOGVV("Reading out capture: Exposure: %f ms, gain: %d",
+            (float)frame.exposureDuration/1e6, frame.gain);
+    uint32_t gain = frame.gain;
+    Buffers *buffers = frame.buffers;
+    mScene.setExposureDuration((float)frame.exposureDuration/1e9);
+    mScene.calculateScene(frame.captureTime);
+    // Advance the noise counter past the previous frame's pixels
+    mNoiseSeed += kResolution[0] * kResolution[1];
+
+    // Might be adding more buffers, so size isn't constant
+    for (size_t i = 0; i < buffers->size(); i++) {
+        const StreamBuffer &b = (*buffers)[i];
+        ALOGVV("Sensor capturing buffer %d: stream %d,"
+                " %d x %d, format %x, stride %d, buf %p, img %p",
+                i, b.streamId, b.width, b.height, b.format, b.stride,
+                b.buffer, b.img);
+        switch(b.format) {
+            case HAL_PIXEL_FORMAT_RAW_SENSOR:
+                captureRaw(b.img, gain, b.stride);
+                break;
+            case HAL_PIXEL_FORMAT_RGB_888:
+                captureRGB(b.img, gain, b.stride);
+                break;
+            case HAL_PIXEL_FORMAT_RGBA_8888:
+                captureRGBA(b.img, gain, b.stride);
+                break;
+            case HAL_PIXEL_FORMAT_BLOB:
+                // Add auxillary buffer of the right size
+                // Assumes only one BLOB (JPEG) buffer in
+                // buffers
+                StreamBuffer bAux;
+                bAux.streamId = 0;
+                bAux.width = b.width;
+                bAux.height = b.height;
+                bAux.format = HAL_PIXEL_FORMAT_RGB_888;
+                bAux.stride = b.width;
+                bAux.buffer = NULL;
+                // TODO: Reuse these
+                bAux.img = new uint8_t[b.width * b.height * 3];
+                buffers->push_back(bAux);
+                break;
+            case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+                captureNV21(b.img, gain, b.stride);
+                break;
+            case HAL_PIXEL_FORMAT_YV12:
+                captureYV12(b.img, gain, b.stride);
+                break;
+            default:
+                ALOGE("%s: Unknown format %x, no output", __FUNCTION__,
+                        b.format);
+                break;
+        }
+    }
+}
+
 void Sensor::captureRaw(uint8_t *img, uint32_t gain, uint32_t stride) {
     float totalGain = gain/100.0 * kBaseGainFactor;
     float noiseVarGain =  totalGain * totalGain;
     float readNoiseVar = kReadNoiseVarBeforeGain * noiseVarGain
             + kReadNoiseVarAfterGain;
+    // Maps a 32-bit noise hash to a uniform sample in [-1.25, 1.25), scaled
+    // to roughly match gaussian/uniform noise stddev
+    const float kNoiseScale = 2.5f / 4294967296.f;
+    const uint32_t width = kResolution[0];
 
     int bayerSelect[4] = {Scene::R, Scene::Gr, Scene::Gb, Scene::B}; // RGGB
-    mScene.setReadoutPixel(0,0);
     for (unsigned int y = 0; y < kResolution[1]; y++ ) {
-        int *bayerRow = bayerSelect + (y & 0x1) * 2;
+        const int *bayerRow = bayerSelect + (y & 0x1) * 2;
         uint16_t *px = (uint16_t*)img + y * stride;
-        for (unsigned int x = 0; x < kResolution[0]; x++) {
-            uint32_t electronCount;
-            electronCount = mScene.getPixelElectrons()[bayerRow[x & 0x1]];
+        const uint32_t *evenElectrons = mScene.getRowElectrons(y, bayerRow[0]);
+        const uint32_t *oddElectrons = mScene.getRowElectrons(y, bayerRow[1]);
 
+        // Interleave the two mosaic channels of this row
+        for (unsigned int x = 0; x < width; x++) {
+            uint32_t electronCount =
+                    (x & 0x1) ? oddElectrons[x] : evenElectrons[x];
             // TODO: Better pixel saturation curve?
-            electronCount = (electronCount < kSaturationElectrons) ?
+            mRowCounts[x] = (electronCount < kSaturationElectrons) ?
                     electronCount : kSaturationElectrons;
+        }
+
+        // Gain, A/D saturation and noise over flat arrays; no loop-carried
+        // state so the compiler can vectorize this.
+        const uint32_t noiseCounter = mNoiseSeed + y * width;
+        for (unsigned int x = 0; x < width; x++) {
+            uint32_t electronCount = mRowCounts[x];
 
             // TODO: Better A/D saturation curve?
-            uint16_t rawCount = electronCount * totalGain;
+            uint32_t rawCount = electronCount * totalGain;
             rawCount = (rawCount < kMaxRawValue) ? rawCount : kMaxRawValue;
 
             // Calculate noise value
             // TODO: Use more-correct Gaussian instead of uniform noise
             float photonNoiseVar = electronCount * noiseVarGain;
             float noiseStddev = sqrtf_approx(readNoiseVar + photonNoiseVar);
-            // Scaled to roughly match gaussian/uniform noise stddev
-            float noiseSample = std::rand() * (2.5 / (1.0 + RAND_MAX)) - 1.25;
-
-            rawCount += kBlackLevel;
-            rawCount += noiseStddev * noiseSample;
+            float noiseSample =
+                    noiseHash(noiseCounter + x) * kNoiseScale - 1.25f;
 
-            *px++ = rawCount;
+            px[x] = rawCount + kBlackLevel + noiseStddev * noiseSample;
         }
         // TODO: Handle this better
         //simulatedTime += kRowReadoutTime;
@@ -403,6 +537,26 @@ void Sensor::captureRaw(uint8_t *img, uint32_t gain, uint32_t stride) {
     ALOGVV("Raw sensor image captured");
 }
 
+uint32_t Sensor::readRGBRow(uint32_t y, uint32_t inc, uint32_t scale64x) {
+    const uint32_t outWidth = kResolution[0] / inc;
+    const int channels[3] = {Scene::R, Scene::Gr, Scene::B};
+    uint8_t *outRows[3] = {mRowR, mRowG, mRowB};
+
+    for (int c = 0; c < 3; c++) {
+        // TODO: Perfect demosaicing is a cheat
+        const uint32_t *electrons = mScene.getRowElectrons(y, channels[c]);
+        if (inc == 1) {
+            scaleTo8bpp(electrons, scale64x, outRows[c], outWidth);
+            continue;
+        }
+        for (uint32_t x = 0, i = 0; i < outWidth; x += inc, i++) {
+            mRowCounts[i] = electrons[x];
+        }
+        scaleTo8bpp(mRowCounts, scale64x, outRows[c], outWidth);
+    }
+    return outWidth;
+}
+
 void Sensor::captureRGBA(uint8_t *img, uint32_t gain, uint32_t stride) {
     float totalGain = gain/100.0 * kBaseGainFactor;
     // In fixed-point math, calculate total scaling from electrons to 8bpp
@@ -411,21 +565,13 @@ void Sensor::captureRGBA(uint8_t *img, uint32_t gain, uint32_t stride) {
 
     for (unsigned int y = 0, outY = 0; y < kResolution[1]; y+=inc, outY++ ) {
         uint8_t *px = img + outY * stride * 4;
-        mScene.setReadoutPixel(0, y);
-        for (unsigned int x = 0; x < kResolution[0]; x+=inc) {
-            uint32_t rCount, gCount, bCount;
-            // TODO: Perfect demosaicing is a cheat
-            const uint32_t *pixel = mScene.getPixelElectrons();
-            rCount = pixel[Scene::R]  * scale64x;
-            gCount = pixel[Scene::Gr] * scale64x;
-            bCount = pixel[Scene::B]  * scale64x;
-
-            *px++ = rCount < 255*64 ? rCount / 64 : 255;
-            *px++ = gCount < 255*64 ? gCount / 64 : 255;
-            *px++ = bCount < 255*64 ? bCount / 64 : 255;
-            *px++ = 255;
-            for (unsigned int j = 1; j < inc; j++)
-                mScene.getPixelElectrons();
+        uint32_t outWidth = readRGBRow(y, inc, scale64x);
+        for (unsigned int x = 0; x < outWidth; x++) {
+            px[0] = mRowR[x];
+            px[1] = mRowG[x];
+            px[2] = mRowB[x];
+            px[3] = 255;
+            px += 4;
         }
         // TODO: Handle this better
         //simulatedTime += kRowReadoutTime;
@@ -440,21 +586,13 @@ void Sensor::captureRGB(uint8_t *img, uint32_t gain, uint32_t stride) {
     uint32_t inc = kResolution[0] / stride;
 
     for (unsigned int y = 0, outY = 0; y < kResolution[1]; y += inc, outY++ ) {
-        mScene.setReadoutPixel(0, y);
         uint8_t *px = img + outY * stride * 3;
-        for (unsigned int x = 0; x < kResolution[0]; x += inc) {
-            uint32_t rCount, gCount, bCount;
-            // TODO: Perfect demosaicing is a cheat
-            const uint32_t *pixel = mScene.getPixelElectrons();
-            rCount = pixel[Scene::R]  * scale64x;
-            gCount = pixel[Scene::Gr] * scale64x;
-            bCount = pixel[Scene::B]  * scale64x;
-
-            *px++ = rCount < 255*64 ? rCount / 64 : 255;
-            *px++ = gCount < 255*64 ? gCount / 64 : 255;
-            *px++ = bCount < 255*64 ? bCount / 64 : 255;
-            for (unsigned int j = 1; j < inc; j++)
-                mScene.getPixelElectrons();
+        uint32_t outWidth = readRGBRow(y, inc, scale64x);
+        for (unsigned int x = 0; x < outWidth; x++) {
+            px[0] = mRowR[x];
+            px[1] = mRowG[x];
+            px[2] = mRowB[x];
+            px += 3;
         }
         // TODO: Handle this better
         //simulatedTime += kRowReadoutTime;
@@ -467,35 +605,61 @@ void Sensor::captureNV21(uint8_t *img, uint32_t gain, uint32_t stride) {
     // In fixed-point math, calculate total scaling from electrons to 8bpp
     int scale64x = 64 * totalGain * 255 / kMaxRawValue;
 
-    // TODO: Make full-color
     uint32_t inc = kResolution[0] / stride;
     uint32_t outH = kResolution[1] / inc;
-    for (unsigned int y = 0, outY = 0, outUV = outH;
-         y < kResolution[1]; y+=inc, outY++, outUV ) {
+    // Interleaved Cr/Cb plane follows the Y plane, at half vertical resolution
+    uint8_t *imgVU = img + outH * stride;
+    for (unsigned int y = 0, outY = 0; y < kResolution[1]; y+=inc, outY++) {
+        uint32_t outWidth = readRGBRow(y, inc, scale64x);
         uint8_t *pxY = img + outY * stride;
-        mScene.setReadoutPixel(0,y);
-        for (unsigned int x = 0; x < kResolution[0]; x+=inc) {
-            uint32_t rCount, gCount, bCount;
-            // TODO: Perfect demosaicing is a cheat
-            const uint32_t *pixel = mScene.getPixelElectrons();
-            rCount = pixel[Scene::R]  * scale64x;
-            gCount = pixel[Scene::Gr] * scale64x;
-            bCount = pixel[Scene::B]  * scale64x;
-            uint32_t avg = (rCount + gCount + bCount) / 3;
-            *pxY++ = avg < 255*64 ? avg / 64 : 255;
-            for (unsigned int j = 1; j < inc; j++)
-                mScene.getPixelElectrons();
+        for (unsigned int x = 0; x < outWidth; x++) {
+            pxY[x] = rgbToY(mRowR[x], mRowG[x], mRowB[x]);
         }
-    }
-    for (unsigned int y = 0, outY = outH; y < kResolution[1]/2; y+=inc, outY++) {
-        uint8_t *px = img + outY * stride;
-        for (unsigned int x = 0; x < kResolution[0]; x+=inc) {
-            // UV to neutral
-            *px++ = 128;
-            *px++ = 128;
+        if (outY & 0x1) continue;
+        // Chroma is sampled from even rows, averaging horizontal pairs
+        uint8_t *pxVU = imgVU + (outY / 2) * stride;
+        for (unsigned int x = 0; x + 1 < outWidth; x += 2) {
+            uint32_t r = (mRowR[x] + mRowR[x + 1] + 1) >> 1;
+            uint32_t g = (mRowG[x] + mRowG[x + 1] + 1) >> 1;
+            uint32_t b = (mRowB[x] + mRowB[x + 1] + 1) >> 1;
+            pxVU[x]     = rgbToCr(r, g, b);
+            pxVU[x + 1] = rgbToCb(r, g, b);
         }
     }
     ALOGVV("NV21 sensor image captured");
 }
 
+void Sensor::captureYV12(uint8_t *img, uint32_t gain, uint32_t stride) {
+    float totalGain = gain/100.0 * kBaseGainFactor;
+    // In fixed-point math, calculate total scaling from electrons to 8bpp
+    int scale64x = 64 * totalGain * 255 / kMaxRawValue;
+
+    uint32_t inc = kResolution[0] / stride;
+    uint32_t outH = kResolution[1] / inc;
+    // Planar Y, then Cr, then Cb; chroma stride is half the luma stride
+    // rounded up to 16 bytes, per the YV12 definition.
+    uint32_t strideC = ((stride / 2) + 15) & ~15;
+    uint8_t *imgCr = img + outH * stride;
+    uint8_t *imgCb = imgCr + (outH / 2) * strideC;
+    for (unsigned int y = 0, outY = 0; y < kResolution[1]; y+=inc, outY++) {
+        uint32_t outWidth = readRGBRow(y, inc, scale64x);
+        uint8_t *pxY = img + outY * stride;
+        for (unsigned int x = 0; x < outWidth; x++) {
+            pxY[x] = rgbToY(mRowR[x], mRowG[x], mRowB[x]);
+        }
+        if (outY & 0x1) continue;
+        // Chroma is sampled from even rows, averaging horizontal pairs
+        uint8_t *pxCr = imgCr + (outY / 2) * strideC;
+        uint8_t *pxCb = imgCb + (outY / 2) * strideC;
+        for (unsigned int x = 0; x + 1 < outWidth; x += 2) {
+            uint32_t r = (mRowR[x] + mRowR[x + 1] + 1) >> 1;
+            uint32_t g = (mRowG[x] + mRowG[x + 1] + 1) >> 1;
+            uint32_t b = (mRowB[x] + mRowB[x + 1] + 1) >> 1;
+            pxCr[x / 2] = rgbToCr(r, g, b);
+            pxCb[x / 2] = rgbToCb(r, g, b);
+        }
+    }
+    ALOGVV("YV12 sensor image captured");
+}
+
 } // namespace android
@@ -76,9 +76,12 @@
 #include "utils/Thread.h"
 #include "utils/Mutex.h"
 #include "utils/Timers.h"
+#include "utils/String8.h"
 
 #include "Scene.h"
 #include "Base.h"
+#include "SpscQueue.h"
+#include "LatencyHistogram.h"
 
 namespace android {
 
@@ -87,7 +90,9 @@ class EmulatedFakeCamera2;
 class Sensor: private Thread, public virtual RefBase {
   public:
 
-    Sensor(EmulatedFakeCamera2 *parent);
+    // pipelineDepth bounds the number of frames that can be queued between
+    // exposure and readout, and between readout and the frame consumer.
+    Sensor(EmulatedFakeCamera2 *parent, size_t pipelineDepth);
     ~Sensor();
 
     /*
@@ -134,6 +139,9 @@ class Sensor: private Thread, public virtual RefBase {
     bool waitForNewFrame(nsecs_t reltime,
             nsecs_t *captureTime);
 
+    // Append pipeline queue state and per-stage latencies to result
+    void dump(String8 &result);
+
     /**
      * Static sensor characteristics
      */
@@ -185,20 +193,55 @@ class Sensor: private Thread, public virtual RefBase {
 
     // End of control parameters
 
-    Mutex mReadoutMutex; // Lock before accessing readout variables
-    // Start of readout variables
+    /**
+     * The sensor runs as a pipeline of threads: the sensor thread times
+     * exposures, the readout thread generates image data for exposed frames,
+     * and the consumer (waitForNewFrame) post-processes read out frames. Frames
+     * move between them through lock-free queues; the mutexes below are only
+     * used to sleep when a queue is empty or full.
+     */
+    struct Frame {
+        Buffers  *buffers;
+        nsecs_t   captureTime;
+        uint64_t  exposureDuration;
+        uint32_t  gain;
+        // Real time the frame entered its current queue
+        nsecs_t   queueTime;
+    };
+
+    // Sensor thread -> readout thread
+    SpscQueue<Frame> mExposedFrames;
+    Mutex     mExposedMutex;
+    Condition mExposedAvailable;
+    Condition mExposedSpace;
+
+    // Readout thread -> waitForNewFrame
+    SpscQueue<Frame> mReadoutFrames;
+    Mutex     mReadoutMutex;
     Condition mReadoutAvailable;
     Condition mReadoutComplete;
-    Buffers  *mCapturedBuffers;
-    nsecs_t   mCaptureTime;
-    // End of readout variables
+
+    // Per-stage latencies
+    LatencyHistogram mReadoutQueueLatency;
+    LatencyHistogram mReadoutLatency;
+    LatencyHistogram mDeliveryLatency;
+
+    class ReadoutThread: public Thread {
+      public:
+        ReadoutThread(Sensor *parent);
+      private:
+        Sensor *mParent;
+        virtual bool threadLoop();
+    };
+    sp<ReadoutThread> mReadoutThread;
 
     // Time of sensor startup, used for simulation zero-time point
     nsecs_t mStartupTime;
 
     /**
      * Inherited Thread virtual overrides, and members only used by the
-     * processing thread
+     * processing thread. Scene and capture kernels are only used by the
+     * readout thread.
      */
   private:
     virtual status_t readyToRun();
@@ -207,13 +250,33 @@ class Sensor: private Thread, public virtual RefBase {
 
     nsecs_t mNextCaptureTime;
     Buffers *mNextCapturedBuffers;
+    uint64_t mNextExposureDuration;
+    uint32_t mNextGain;
 
     Scene mScene;
 
+    // Generate image data for all buffers of an exposed frame
+    void readoutFrame(const Frame &frame);
+
+    // Per-row scratch space for the capture kernels, sized to the sensor
+    // width. Rows are read out of the scene as per-channel slices, then gain,
+    // saturation and packing run over flat arrays.
+    uint32_t *mRowCounts;
+    uint8_t *mRowR;
+    uint8_t *mRowG;
+    uint8_t *mRowB;
+    // Seed for the counter-based noise generator, changed every frame
+    uint32_t mNoiseSeed;
+
+    // Read out sensor row y, keeping every inc-th pixel, as 8-bit RGB in
+    // mRowR/G/B. Returns the number of output pixels.
+    uint32_t readRGBRow(uint32_t y, uint32_t inc, uint32_t scale64x);
+
     void captureRaw(uint8_t *img, uint32_t gain, uint32_t stride);
     void captureRGBA(uint8_t *img, uint32_t gain, uint32_t stride);
     void captureRGB(uint8_t *img, uint32_t gain, uint32_t stride);
     void captureNV21(uint8_t *img, uint32_t gain, uint32_t stride);
+    void captureYV12(uint8_t *img, uint32_t gain, uint32_t stride);
 };
 
 }
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A bounded single-producer, single-consumer queue used to hand frames between
+ * the stages of the fake camera pipeline. push() must only ever be called from
+ * one thread, and pop() from one other thread; neither takes a lock. Blocking
+ * when the queue is empty or full is left to the caller, which typically
+ * retries under a mutex/condition pair used only for sleeping and waking.
+ */
+
+#ifndef HW_EMULATOR_CAMERA2_SPSC_QUEUE_H
+#define HW_EMULATOR_CAMERA2_SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <cutils/atomic.h>
+
+namespace android {
+
+template <typename T>
+class SpscQueue {
+  public:
+    // Queue holding up to capacity items
+    SpscQueue(size_t capacity):
+            mSize(capacity + 1),
+            mHead(0),
+            mTail(0) {
+        mItems = new T[mSize];
+    }
+
+    ~SpscQueue() {
+        delete[] mItems;
+    }
+
+    // Producer side. Returns false if the queue is full.
+    bool push(const T &item) {
+        int32_t tail = mTail;
+        int32_t next = (tail + 1) % mSize;
+        if (next == android_atomic_acquire_load(&mHead)) return false;
+        mItems[tail] = item;
+        android_atomic_release_store(next, &mTail);
+        return true;
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool pop(T *item) {
+        int32_t head = mHead;
+        if (head == android_atomic_acquire_load(&mTail)) return false;
+        *item = mItems[head];
+        android_atomic_release_store((head + 1) % mSize, &mHead);
+        return true;
+    }
+
+    // Approximate when called concurrently with push or pop
+    size_t size() const {
+        int32_t head = android_atomic_acquire_load(&mHead);
+        int32_t tail = android_atomic_acquire_load(&mTail);
+        return (tail - head + mSize) % mSize;
+    }
+
+    size_t capacity() const {
+        return mSize - 1;
+    }
+
+  private:
+    SpscQueue(const SpscQueue &);
+    SpscQueue& operator=(const SpscQueue &);
+
+    // One slot is always left empty to tell a full queue from an empty one
+    const int32_t mSize;
+    T *mItems;
+
+    // Next slot to pop; written only by the consumer
+    volatile int32_t mHead;
+    // Next slot to push; written only by the producer
+    volatile int32_t mTail;
+};
+
+} // namespace android
+
+#endif // HW_EMULATOR_CAMERA2_SPSC_QUEUE_H
@@ -34,3 +34,14 @@ else
 LOCAL_MODULE := gps.goldfish
 endif
 include $(BUILD_SHARED_LIBRARY)
+
+# NMEA replay benchmark, feeds the GPS thread through a socket pair.
+# See gps_benchmark.c, run it with testdata/drive-10hz.nmea.
+#
+include $(CLEAR_VARS)
+LOCAL_MODULE := gps-benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += -DQEMU_HARDWARE
+LOCAL_SHARED_LIBRARIES := liblog libcutils libhardware
+LOCAL_SRC_FILES := gps_benchmark.c
+include $(BUILD_EXECUTABLE)
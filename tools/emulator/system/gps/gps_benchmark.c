@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* NMEA replay benchmark for the GPS HAL.
+ *
+ * The HAL's GPS thread is started on one end of a socket pair, in place
+ * of the qemud channel, and a recorded NMEA trace is written to the other
+ * end as fast as the thread consumes it. The benchmark reports how fast
+ * sentences are ingested and how many location callbacks result.
+ *
+ * testdata/drive-10hz.nmea is a 20 seconds trace with GGA and RMC
+ * sentences at 10 Hz, and GSA and GSV sentences at 1 Hz.
+ *
+ * usage: gps-benchmark <nmea-file> [loops]
+ */
+
+#include "gps_qemu.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/sockios.h>
+
+static pthread_mutex_t  _bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   _bench_cond = PTHREAD_COND_INITIALIZER;
+static long             _bench_fixes;
+
+static double
+bench_now(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench_location_cb(GpsLocation*  location)
+{
+    pthread_mutex_lock(&_bench_lock);
+    _bench_fixes += 1;
+    pthread_cond_signal(&_bench_cond);
+    pthread_mutex_unlock(&_bench_lock);
+}
+
+static pthread_t
+bench_create_thread_cb(const char*  name, void (*start)(void*), void*  arg)
+{
+    pthread_t  thread;
+
+    if (pthread_create(&thread, NULL, (void* (*)(void*))start, arg) != 0)
+        return 0;
+    return thread;
+}
+
+/* count the sentences and the distinct fix times of GGA and RMC
+ * sentences in a trace */
+static void
+bench_scan(const char*  data, int  len, long*  sentences, long*  fixes)
+{
+    const char*  p   = data;
+    const char*  end = data + len;
+    const char*  last_time = NULL;
+    int          last_len = 0;
+
+    *sentences = 0;
+    *fixes     = 0;
+
+    while (p < end) {
+        const char*  eol = memchr(p, '\n', end - p);
+        const char*  next = eol ? eol + 1 : end;
+
+        *sentences += 1;
+        if (next - p > 14 && (!memcmp(p+3, "GGA,", 4) || !memcmp(p+3, "RMC,", 4))) {
+            const char*  time = p + 7;
+            const char*  comma = memchr(time, ',', next - time);
+            int          time_len = comma ? comma - time : 0;
+
+            if (last_time == NULL || time_len != last_len ||
+                memcmp(time, last_time, time_len)) {
+                *fixes   += 1;
+                last_time = time;
+                last_len  = time_len;
+            }
+        }
+        p = next;
+    }
+}
+
+int
+main(int  argc, char**  argv)
+{
+    GpsState*     s = _gps_state;
+    GpsCallbacks  callbacks;
+    int           sv[2], loops = 50, nn;
+    long          sentences, fixes, expected;
+    char*         data;
+    int           len, fd;
+    struct stat   st;
+    double        start, elapsed;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <nmea-file> [loops]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2)
+        loops = atoi(argv[2]);
+
+    fd = open(argv[1], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "could not open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    len  = st.st_size;
+    data = malloc(len);
+    if (data == NULL || read(fd, data, len) != len) {
+        fprintf(stderr, "could not read %s\n", argv[1]);
+        return 1;
+    }
+    close(fd);
+
+    bench_scan(data, len, &sentences, &fixes);
+    expected = fixes * loops;
+
+    /* start the GPS thread like gps_state_init() does, on a socket
+     * pair instead of the qemud channel */
+    if (socketpair(AF_LOCAL, SOCK_STREAM, 0, sv) < 0 ||
+        socketpair(AF_LOCAL, SOCK_STREAM, 0, s->control) < 0) {
+        fprintf(stderr, "socketpair: %s\n", strerror(errno));
+        return 1;
+    }
+
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.size             = sizeof(callbacks);
+    callbacks.location_cb      = bench_location_cb;
+    callbacks.create_thread_cb = bench_create_thread_cb;
+
+    s->init      = 1;
+    s->fd        = sv[0];
+    s->callbacks = callbacks;
+    s->thread    = callbacks.create_thread_cb("gps_state_thread",
+                                              gps_state_thread, s);
+    if (!s->thread) {
+        fprintf(stderr, "could not create the gps thread\n");
+        return 1;
+    }
+
+    /* fixes that arrive before the thread processes CMD_START are
+     * coalesced, give it time to do so */
+    gps_state_start(s);
+    usleep(100000);
+
+    start = bench_now();
+    for (nn = 0; nn < loops; nn++) {
+        int  pos = 0;
+        while (pos < len) {
+            int  ret = write(sv[1], data + pos, len - pos);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0) {
+                fprintf(stderr, "write: %s\n", strerror(errno));
+                return 1;
+            }
+            pos += ret;
+        }
+    }
+
+    /* wait until the GPS thread has read everything, then for the
+     * fixes of the last block */
+    for (;;) {
+        int  pending = 0;
+        if (ioctl(sv[1], SIOCOUTQ, &pending) < 0 || pending == 0)
+            break;
+        usleep(100);
+    }
+
+    pthread_mutex_lock(&_bench_lock);
+    while (_bench_fixes < expected) {
+        struct timespec  deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 2;
+        if (pthread_cond_timedwait(&_bench_cond, &_bench_lock, &deadline) != 0)
+            break;
+    }
+    elapsed = bench_now() - start;
+    pthread_mutex_unlock(&_bench_lock);
+
+    printf("%s: %d bytes, %ld sentences, %ld fixes, %d loops\n",
+           argv[1], len, sentences, fixes, loops);
+    printf("  %8.1f MB/s %10.0f sentences/s %10.0f callbacks/s\n",
+           (double)len * loops / elapsed / (1024. * 1024.),
+           sentences * loops / elapsed, _bench_fixes / elapsed);
+    printf("  %ld location callbacks, %ld expected\n", _bench_fixes, expected);
+
+    gps_state_done(s);
+    close(sv[1]);
+
+    return (_bench_fixes >= expected) ? 0 : 1;
+}
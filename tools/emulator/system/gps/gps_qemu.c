@@ -67,11 +67,40 @@ typedef struct {
     Token   tokens[ MAX_NMEA_TOKENS ];
 } NmeaTokenizer;
 
+static int
+hex2int( int  c )
+{
+    if ((unsigned)(c - '0') < 10)
+        return c - '0';
+    if ((unsigned)(c - 'A') < 6)
+        return c - 'A' + 10;
+    if ((unsigned)(c - 'a') < 6)
+        return c - 'a' + 10;
+    return -1;
+}
+
+static void
+nmea_tokenizer_add( NmeaTokenizer*  t, const char*  p, const char*  end )
+{
+    if (t->count < MAX_NMEA_TOKENS) {
+        t->tokens[t->count].p   = p;
+        t->tokens[t->count].end = end;
+        t->count += 1;
+    }
+}
+
+/* split a sentence into tokens, empty ones included, and verify its
+ * checksum if it has one. returns the number of tokens, or -1 if the
+ * checksum doesn't match.
+ */
 static int
 nmea_tokenizer_init( NmeaTokenizer*  t, const char*  p, const char*  end )
 {
-    int    count = 0;
-    char*  q;
+    const char*  q;
+    const char*  start;
+    int          sum = 0, expected = -1;
+
+    t->count = 0;
 
     // the initial '$' is optional
     if (p < end && p[0] == '$')
@@ -84,33 +113,30 @@ nmea_tokenizer_init( NmeaTokenizer*  t, const char*  p, const char*  end )
             end -= 1;
     }
 
-    // get rid of checksum at the end of the sentecne
+    // get rid of checksum at the end of the sentence
     if (end >= p+3 && end[-3] == '*') {
+        int  hi = hex2int(end[-2]);
+        int  lo = hex2int(end[-1]);
+        if ((hi|lo) >= 0)
+            expected = (hi << 4) | lo;
         end -= 3;
     }
 
-    while (p < end) {
-        const char*  q = p;
-
-        q = memchr(p, ',', end-p);
-        if (q == NULL)
-            q = end;
-
-        if (q > p) {
-            if (count < MAX_NMEA_TOKENS) {
-                t->tokens[count].p   = p;
-                t->tokens[count].end = q;
-                count += 1;
-            }
+    // a single pass finds the tokens and computes the checksum
+    for (start = q = p; q < end; q++) {
+        sum ^= (unsigned char) *q;
+        if (*q == ',') {
+            nmea_tokenizer_add(t, start, q);
+            start = q + 1;
         }
-        if (q < end)
-            q += 1;
-
-        p = q;
     }
+    nmea_tokenizer_add(t, start, end);
 
-    t->count = count;
-    return count;
+    if (expected >= 0 && expected != sum) {
+        D("bad checksum: %02X instead of %02X", sum, expected);
+        return -1;
+    }
+    return t->count;
 }
 
 static Token
@@ -153,19 +179,65 @@ Fail:
     return -1;
 }
 
+/* parse a decimal number in place. NMEA fields are plain decimals
+ * without exponents, so they are read as an integer mantissa and a
+ * power of ten, which is exact for up to 15 significant digits.
+ */
 static double
 str2float( const char*  p, const char*  end )
 {
-    int   result = 0;
-    int   len    = end - p;
-    char  temp[16];
+    static const double  powers[16] = {
+        1e0, 1e1, 1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+    };
+    const char*  start    = p;
+    long long    mantissa = 0;
+    int          digits   = 0;
+    int          decimals = -1;
+    int          negative = 0;
+    double       result;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    for ( ; p < end; p++ ) {
+        int  c = *p;
+
+        if (c == '.' && decimals < 0) {
+            decimals = 0;
+            continue;
+        }
+
+        c -= '0';
+        if ((unsigned)c >= 10 || digits == 15)
+            goto Slow;
+
+        mantissa = mantissa*10 + c;
+        digits  += 1;
+        if (decimals >= 0)
+            decimals += 1;
+    }
+
+    result = (double) mantissa;
+    if (decimals > 0)
+        result /= powers[decimals];
 
-    if (len >= (int)sizeof(temp))
-        return 0.;
+    return negative ? -result : result;
 
-    memcpy( temp, p, len );
-    temp[len] = 0;
-    return strtod( temp, NULL );
+Slow:
+    {
+        int   len = end - start;
+        char  temp[32];
+
+        if (len >= (int)sizeof(temp))
+            return 0.;
+
+        memcpy( temp, start, len );
+        temp[len] = 0;
+        return strtod( temp, NULL );
+    }
 }
 
 /*****************************************************************/
@@ -184,37 +256,28 @@ typedef struct {
     int     utc_year;
     int     utc_mon;
     int     utc_day;
-    int     utc_diff;
     GpsLocation  fix;
     gps_location_callback  callback;
     char    in[ NMEA_MAX_SIZE+1 ];
 } NmeaReader;
 
 
-static void
-nmea_reader_update_utc_diff( NmeaReader*  r )
+/* return the number of days between 1970-01-01 and a given
+ * date of the Gregorian calendar.
+ */
+static long
+nmea_days_from_civil( int  year, int  mon, int  day )
 {
-    time_t         now = time(NULL);
-    struct tm      tm_local;
-    struct tm      tm_utc;
-    long           time_local, time_utc;
-
-    gmtime_r( &now, &tm_utc );
-    localtime_r( &now, &tm_local );
-
-    time_local = tm_local.tm_sec +
-                 60*(tm_local.tm_min +
-                 60*(tm_local.tm_hour +
-                 24*(tm_local.tm_yday +
-                 365*tm_local.tm_year)));
+    long      era;
+    unsigned  yoe, doy, doe;
 
-    time_utc = tm_utc.tm_sec +
-               60*(tm_utc.tm_min +
-               60*(tm_utc.tm_hour +
-               24*(tm_utc.tm_yday +
-               365*tm_utc.tm_year)));
+    year -= (mon <= 2);
+    era   = (year >= 0 ? year : year - 399) / 400;
+    yoe   = (unsigned)(year - era * 400);
+    doy   = (153 * (mon > 2 ? mon - 3 : mon + 9) + 2) / 5 + day - 1;
+    doe   = yoe * 365 + yoe / 4 - yoe / 100 + doy;
 
-    r->utc_diff = time_utc - time_local;
+    return era * 146097 + (long)doe - 719468;
 }
 
 
@@ -230,8 +293,6 @@ nmea_reader_init( NmeaReader*  r )
     r->utc_day  = -1;
     r->callback = NULL;
     r->fix.size = sizeof(r->fix);
-
-    nmea_reader_update_utc_diff( r );
 }
 
 
@@ -247,13 +308,15 @@ nmea_reader_set_callback( NmeaReader*  r, gps_location_callback  cb )
 }
 
 
+static void  nmea_reader_flush( NmeaReader*  r );
+
 static int
 nmea_reader_update_time( NmeaReader*  r, Token  tok )
 {
     int        hour, minute;
     double     seconds;
     struct tm  tm;
-    time_t     fix_time;
+    long long  fix_time;
 
     if (tok.p + 6 > tok.end)
         return -1;
@@ -271,16 +334,20 @@ nmea_reader_update_time( NmeaReader*  r, Token  tok )
     minute  = str2int(tok.p+2, tok.p+4);
     seconds = str2float(tok.p+4, tok.end);
 
-    tm.tm_hour  = hour;
-    tm.tm_min   = minute;
-    tm.tm_sec   = (int) seconds;
-    tm.tm_year  = r->utc_year - 1900;
-    tm.tm_mon   = r->utc_mon - 1;
-    tm.tm_mday  = r->utc_day;
-    tm.tm_isdst = -1;
+    if ((hour|minute) < 0)
+        return -1;
+
+    /* keep the fractional seconds, fixes can come at more than 1 Hz */
+    fix_time = nmea_days_from_civil(r->utc_year, r->utc_mon, r->utc_day);
+    fix_time = (fix_time*86400 + hour*3600 + minute*60) * 1000 +
+               (long long)(seconds*1000 + 0.5);
 
-    fix_time = mktime( &tm ) + r->utc_diff;
-    r->fix.timestamp = (long long)fix_time * 1000;
+    /* sentences with a new time start a new fix, send the
+     * previous one first */
+    if (r->fix.flags != 0 && r->fix.timestamp != fix_time)
+        nmea_reader_flush( r );
+
+    r->fix.timestamp = fix_time;
     return 0;
 }
 
@@ -417,21 +484,24 @@ nmea_reader_update_accuracy( NmeaReader*  r )
 
 
 static void
-nmea_reader_parse( NmeaReader*  r )
+nmea_reader_parse( NmeaReader*  r, const char*  p, const char*  end )
 {
-   /* we received a complete sentence, now parse it to generate
-    * a new GPS fix...
+   /* we received a complete sentence, now parse it to update
+    * the current GPS fix...
     */
     NmeaTokenizer  tzer[1];
     Token          tok;
 
-    D("Received: '%.*s'", r->pos, r->in);
-    if (r->pos < 9) {
+    D("Received: '%.*s'", end-p, p);
+    if (end - p < 9) {
         D("Too short. discarded.");
         return;
     }
 
-    nmea_tokenizer_init(tzer, r->in, r->in + r->pos);
+    if (nmea_tokenizer_init(tzer, p, end) < 0) {
+        D("Bad checksum. discarded.");
+        return;
+    }
 #if GPS_DEBUG
     {
         int  n;
@@ -498,11 +568,19 @@ nmea_reader_parse( NmeaReader*  r )
         tok.p -= 2;
         D("unknown sentence '%.*s", tok.end-tok.p, tok.p);
     }
+}
 
-    // Always update accuracy
-    nmea_reader_update_accuracy( r );
 
+/* send the current fix to the framework, if it changed since
+ * the last one.
+ */
+static void
+nmea_reader_flush( NmeaReader*  r )
+{
     if (r->fix.flags != 0) {
+        // Always update accuracy
+        nmea_reader_update_accuracy( r );
+
 #if GPS_DEBUG
         char   temp[256];
         char*  p   = temp;
@@ -540,27 +618,46 @@ nmea_reader_parse( NmeaReader*  r )
 }
 
 
+/* parse all complete sentences in a block of data received from
+ * the emulator. sentences that are entirely in the block are parsed
+ * in place, only partial ones are copied until their end arrives.
+ *
+ * a fix is sent when a sentence with a different time arrives, or at
+ * the end of the block, so the sentences describing the same fix
+ * (e.g. GGA and RMC) result in a single callback.
+ */
 static void
-nmea_reader_addc( NmeaReader*  r, int  c )
+nmea_reader_add( NmeaReader*  r, const char*  data, int  len )
 {
-    if (r->overflow) {
-        r->overflow = (c != '\n');
-        return;
-    }
+    const char*  p   = data;
+    const char*  end = data + len;
 
-    if (r->pos >= (int) sizeof(r->in)-1 ) {
-        r->overflow = 1;
-        r->pos      = 0;
-        return;
+    while (p < end) {
+        const char*  eol  = memchr(p, '\n', end - p);
+        const char*  next = eol ? eol + 1 : end;
+        int          size = next - p;
+
+        if (r->overflow) {
+            /* skip the rest of an oversized sentence */
+            r->overflow = (eol == NULL);
+        } else if (r->pos + size > NMEA_MAX_SIZE) {
+            D("sentence too long, discarded.");
+            r->overflow = (eol == NULL);
+            r->pos      = 0;
+        } else if (eol == NULL) {
+            memcpy( r->in + r->pos, p, size );
+            r->pos += size;
+        } else if (r->pos > 0) {
+            memcpy( r->in + r->pos, p, size );
+            nmea_reader_parse( r, r->in, r->in + r->pos + size );
+            r->pos = 0;
+        } else {
+            nmea_reader_parse( r, p, next );
+        }
+        p = next;
     }
 
-    r->in[r->pos] = (char)c;
-    r->pos       += 1;
-
-    if (c == '\n') {
-        nmea_reader_parse( r );
-        r->pos = 0;
-    }
+    nmea_reader_flush( r );
 }
 
 
@@ -742,10 +839,10 @@ gps_state_thread( void*  arg )
                 }
                 else if (fd == gps_fd)
                 {
-                    char  buff[32];
+                    char  buff[4096];
                     D("gps fd event");
                     for (;;) {
-                        int  nn, ret;
+                        int  ret;
 
                         ret = read( fd, buff, sizeof(buff) );
                         if (ret < 0) {
@@ -755,9 +852,10 @@ gps_state_thread( void*  arg )
                                 ALOGE("error while reading from gps daemon socket: %s:", strerror(errno));
                             break;
                         }
+                        if (ret == 0)
+                            break;
                         D("received %d bytes: %.*s", ret, ret, buff);
-                        for (nn = 0; nn < ret; nn++)
-                            nmea_reader_addc( reader, buff[nn] );
+                        nmea_reader_add( reader, buff, ret );
                     }
                     D("gps fd event end");
                 }
@@ -0,0 +1,709 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* This program benchmarks QEMUD pipes against other local transports.
+ *
+ * For each transport and message size, it measures:
+ *
+ *   - the round-trip latency of a message sent to an echo server,
+ *     reported as percentiles,
+ *
+ *   - the streaming throughput, with messages sent back-to-back while
+ *     the echoed data is read back.
+ *
+ * The transports are:
+ *
+ *   qemu   the "pingpong" QEMUD pipe service of the emulator
+ *   tcp    a TCP loopback connection to an echo server in this program
+ *   unix   a Unix socket connection to an echo server in this program
+ *   host   a TCP connection to test-libqemu-1 running on the host,
+ *          see -host below
+ *
+ * Several pipes can be used concurrently, each one from its own thread.
+ * The results are printed to stdout as comma-separated values, one line
+ * per measurement, progress and errors go to stderr.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include "test_util.h"
+
+#define  PIPE_NAME    "pingpong"
+
+#define  MAX_PIPES    64
+#define  MAX_SAMPLES  100000    /* per pipe and measurement */
+#define  MAX_CHUNK    65536     /* largest single read or write */
+
+char* progname;
+
+static void usage(int code)
+{
+    printf("Usage: %s [options]\n\n", progname);
+    printf(
+      "Valid options are:\n\n"
+      "  -? -h --help          Print this message\n"
+      "  -pipe <name>          Use pipe name (default: " PIPE_NAME ")\n"
+      "  -transports <list>    Comma-separated transports to compare,\n"
+      "                        among qemu,tcp,unix,host (default: qemu,tcp,unix)\n"
+      "  -host <port>          Port of test-libqemu-1 on the host (default: 8012)\n"
+      "  -min-size <size>      Smallest message size (default: 1)\n"
+      "  -max-size <size>      Largest message size (default: 16M)\n"
+      "  -step <factor>        Size multiplier between runs (default: 4)\n"
+      "  -pipes <count>        Number of concurrent pipes (default: 1)\n"
+      "  -time <seconds>       Duration of each measurement (default: 1)\n"
+      "\n"
+      "Sizes accept a K or M suffix.\n"
+      "\n"
+    );
+    exit(code);
+}
+
+/* Parse a size with an optional K or M suffix, returns -1 on error */
+static long
+parse_size(const char*  str)
+{
+    char*  end;
+    long   size = strtol(str, &end, 10);
+
+    if (*end == 'k' || *end == 'K') {
+        size *= 1024;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        size *= 1024*1024;
+        end++;
+    }
+    if (end == str || *end != '\0' || size <= 0)
+        return -1;
+    return size;
+}
+
+/*****************************************************************/
+/*****************************************************************/
+/*****                                                       *****/
+/*****       E C H O   S E R V E R                           *****/
+/*****                                                       *****/
+/*****************************************************************/
+/*****************************************************************/
+
+/* The tcp and unix transports connect to a server run by this program,
+ * which sends back anything it receives, like test-libqemu-1.
+ */
+static void*
+echo_client_thread(void*  arg)
+{
+    int    fd = (int)(intptr_t)arg;
+    char*  buff = malloc(MAX_CHUNK);
+
+    for (;;) {
+        int  ret = read(fd, buff, MAX_CHUNK);
+        int  pos = 0;
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+
+        while (pos < ret) {
+            int  ret2 = write(fd, buff + pos, ret - pos);
+            if (ret2 < 0 && errno == EINTR)
+                continue;
+            if (ret2 <= 0)
+                goto Exit;
+            pos += ret2;
+        }
+    }
+Exit:
+    free(buff);
+    close(fd);
+    return NULL;
+}
+
+static void*
+echo_server_thread(void*  arg)
+{
+    int  sock = (int)(intptr_t)arg;
+
+    for (;;) {
+        pthread_t  thread;
+        int        fd = accept(sock, NULL, NULL);
+
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            fprintf(stderr, "%s: accept: %s\n", __FUNCTION__, strerror(errno));
+            break;
+        }
+        if (pthread_create(&thread, NULL, echo_client_thread,
+                           (void*)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+/* Start an echo server on a listening socket */
+static int
+echo_server_start(int  sock)
+{
+    pthread_t  thread;
+
+    if (listen(sock, MAX_PIPES) < 0 ||
+        pthread_create(&thread, NULL, echo_server_thread,
+                       (void*)(intptr_t)sock) != 0) {
+        close(sock);
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+/* Start a TCP loopback echo server, returns its port or -1 */
+static int
+echo_server_tcp(void)
+{
+    struct sockaddr_in  addr;
+    socklen_t           addrlen = sizeof(addr);
+    int                 sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (sock < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        getsockname(sock, (struct sockaddr*)&addr, &addrlen) < 0) {
+        close(sock);
+        return -1;
+    }
+    if (echo_server_start(sock) < 0)
+        return -1;
+    return ntohs(addr.sin_port);
+}
+
+/* Start a Unix echo server in the abstract namespace, as 'path' */
+static int
+echo_server_unix(const char*  path)
+{
+    struct sockaddr_un  addr;
+    socklen_t           addrlen;
+    int                 sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    addrlen = offsetof(struct sockaddr_un, sun_path) + strlen(addr.sun_path);
+    addr.sun_path[0] = '\0';
+
+    if (bind(sock, (struct sockaddr*)&addr, addrlen) < 0) {
+        close(sock);
+        return -1;
+    }
+    return echo_server_start(sock);
+}
+
+/*****************************************************************/
+/*****************************************************************/
+/*****                                                       *****/
+/*****       M E A S U R E M E N T S                         *****/
+/*****                                                       *****/
+/*****************************************************************/
+/*****************************************************************/
+
+typedef enum {
+    TRANSPORT_QEMU = 0,
+    TRANSPORT_TCP,
+    TRANSPORT_UNIX,
+    TRANSPORT_HOST,
+    TRANSPORT_COUNT
+} Transport;
+
+static const char*  _transportNames[TRANSPORT_COUNT] = {
+    "qemu", "tcp", "unix", "host"
+};
+
+typedef struct {
+    const char*  pipeName;
+    int          tcpPort;
+    char         unixPath[64];
+    int          hostPort;
+} Endpoints;
+
+static int
+bench_open(Pipe*  pipe, Transport  transport, const Endpoints*  ep)
+{
+    int  ret, flags;
+
+    switch (transport) {
+    case TRANSPORT_QEMU: ret = pipe_openQemuPipe(pipe, ep->pipeName); break;
+    case TRANSPORT_TCP:  ret = pipe_openLoopback(pipe, ep->tcpPort); break;
+    case TRANSPORT_UNIX: ret = pipe_openUnix(pipe, ep->unixPath); break;
+    case TRANSPORT_HOST: ret = pipe_openSocket(pipe, ep->hostPort); break;
+    default:             ret = -1;
+    }
+    if (ret < 0)
+        return -1;
+
+    /* the measurements read and write at the same time, to avoid
+     * deadlocking with the echo server on large messages */
+    flags = fcntl(pipe->socket, F_GETFL);
+    fcntl(pipe->socket, F_SETFL, flags | O_NONBLOCK);
+    return 0;
+}
+
+typedef enum {
+    TEST_LATENCY = 0,
+    TEST_THROUGHPUT
+} Test;
+
+/* State of a single pipe during a measurement */
+typedef struct {
+    Pipe       pipe[1];
+    Test       test;
+    size_t     size;
+    double     duration;
+    uint8_t*   sendBuff;
+    uint8_t*   recvBuff;
+    double*    samples;     /* round-trip times, in seconds */
+    int        numSamples;
+    long long  bytes;       /* bytes sent and received back */
+    double     elapsed;
+    int        error;
+} Worker;
+
+static pthread_mutex_t  _startLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   _startCond = PTHREAD_COND_INITIALIZER;
+static int              _started;
+
+/* Send 'sendLen' bytes and receive 'recvLen' bytes on a non-blocking
+ * pipe, whichever is possible first. Returns 0 on success. */
+static int
+bench_transfer(Worker*  w, const uint8_t*  sendBuff, size_t  sendLen,
+               uint8_t*  recvBuff, size_t  recvLen)
+{
+    size_t  sent = 0, received = 0;
+
+    while (sent < sendLen || received < recvLen) {
+        struct pollfd  pfd;
+        int            ret;
+
+        if (sent < sendLen) {
+            size_t  avail = sendLen - sent;
+            if (avail > MAX_CHUNK)
+                avail = MAX_CHUNK;
+            ret = write(w->pipe->socket, sendBuff + sent, avail);
+            if (ret > 0) {
+                sent += ret;
+                continue;
+            }
+            if (ret == 0 || (errno != EAGAIN && errno != EINTR))
+                return -1;
+        }
+        if (received < recvLen) {
+            size_t  avail = recvLen - received;
+            if (avail > MAX_CHUNK)
+                avail = MAX_CHUNK;
+            ret = read(w->pipe->socket, recvBuff + received, avail);
+            if (ret > 0) {
+                received += ret;
+                continue;
+            }
+            if (ret == 0 || (errno != EAGAIN && errno != EINTR))
+                return -1;
+        }
+
+        pfd.fd      = w->pipe->socket;
+        pfd.events  = (sent < sendLen ? POLLOUT : 0) |
+                      (received < recvLen ? POLLIN : 0);
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+            return -1;
+    }
+    return 0;
+}
+
+/* Send messages one at a time, and wait for each one to come back */
+static int
+bench_latency(Worker*  w)
+{
+    double  start = now_secs(), t0, t1;
+
+    do {
+        t0 = now_secs();
+        if (bench_transfer(w, w->sendBuff, w->size, w->recvBuff, w->size) < 0)
+            return -1;
+        t1 = now_secs();
+
+        if (memcmp(w->sendBuff, w->recvBuff, w->size) != 0) {
+            fprintf(stderr, "Message content mismatch!\n");
+            return -1;
+        }
+        w->samples[w->numSamples++] = t1 - t0;
+        w->bytes += w->size;
+    } while (t1 - start < w->duration && w->numSamples < MAX_SAMPLES);
+
+    w->elapsed = t1 - start;
+    return 0;
+}
+
+/* Send messages back-to-back while reading back the echoed data, then
+ * wait for the last byte to come back */
+static int
+bench_throughput(Worker*  w)
+{
+    double     start = now_secs();
+    long long  sent = 0;
+    size_t     pos = 0;     /* position in the message being sent */
+    int        sending = 1;
+
+    while (sending || w->bytes < sent) {
+        struct pollfd  pfd;
+        int            progress = 0, ret;
+
+        if (sending) {
+            size_t  avail = w->size - pos;
+            if (avail > MAX_CHUNK)
+                avail = MAX_CHUNK;
+            ret = write(w->pipe->socket, w->sendBuff + pos, avail);
+            if (ret > 0) {
+                sent    += ret;
+                pos     += ret;
+                progress = 1;
+                if (pos == w->size) {
+                    pos     = 0;
+                    sending = (now_secs() - start < w->duration);
+                }
+            } else if (ret == 0 || (errno != EAGAIN && errno != EINTR)) {
+                return -1;
+            }
+        }
+        if (w->bytes < sent) {
+            size_t  avail = (w->size < MAX_CHUNK) ? w->size : MAX_CHUNK;
+            ret = read(w->pipe->socket, w->recvBuff, avail);
+            if (ret > 0) {
+                w->bytes += ret;
+                progress  = 1;
+            } else if (ret == 0 || (errno != EAGAIN && errno != EINTR)) {
+                return -1;
+            }
+        }
+        if (progress)
+            continue;
+
+        pfd.fd      = w->pipe->socket;
+        pfd.events  = (sending ? POLLOUT : 0) |
+                      (w->bytes < sent ? POLLIN : 0);
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+            return -1;
+    }
+
+    w->elapsed = now_secs() - start;
+    return 0;
+}
+
+static void*
+bench_worker_thread(void*  arg)
+{
+    Worker*  w = arg;
+
+    pthread_mutex_lock(&_startLock);
+    while (!_started)
+        pthread_cond_wait(&_startCond, &_startLock);
+    pthread_mutex_unlock(&_startLock);
+
+    if (w->test == TEST_LATENCY)
+        w->error = bench_latency(w);
+    else
+        w->error = bench_throughput(w);
+
+    return NULL;
+}
+
+static int
+compare_doubles(const void*  a, const void*  b)
+{
+    double  da = *(const double*)a;
+    double  db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static double
+percentile(const double*  sorted, int  count, double  p)
+{
+    return sorted[(int)(p * (count - 1) + 0.5)];
+}
+
+/* Run one measurement on 'numPipes' pipes concurrently, and print its
+ * results. Returns 0 on success. */
+static int
+bench_run(Transport  transport, const Endpoints*  ep, Test  test,
+          size_t  size, int  numPipes, double  duration)
+{
+    Worker     workers[MAX_PIPES];
+    pthread_t  threads[MAX_PIPES];
+    double*    samples = NULL;
+    int        numSamples = 0, nn, mm, status = 0;
+    long long  bytes = 0;
+    double     elapsed = 0.;
+
+    memset(workers, 0, sizeof(workers));
+    for (nn = 0; nn < numPipes; nn++)
+        workers[nn].pipe->socket = -1;
+    _started = 0;
+
+    for (nn = 0; nn < numPipes; nn++) {
+        Worker*  w = &workers[nn];
+
+        if (bench_open(w->pipe, transport, ep) < 0) {
+            status = -1;
+            break;
+        }
+        w->test     = test;
+        w->size     = size;
+        w->duration = duration;
+        w->sendBuff = malloc(size);
+        w->recvBuff = malloc(size);
+        if (test == TEST_LATENCY)
+            w->samples = malloc(MAX_SAMPLES * sizeof(double));
+
+        if (!w->sendBuff || !w->recvBuff ||
+            (test == TEST_LATENCY && !w->samples)) {
+            fprintf(stderr, "Not enough memory for %lu bytes messages\n",
+                    (unsigned long)size);
+            status = -1;
+            break;
+        }
+        for (mm = 0; mm < (int)size; mm++)
+            w->sendBuff[mm] = (uint8_t)(mm + nn);
+
+        if (pthread_create(&threads[nn], NULL, bench_worker_thread, w) != 0) {
+            status = -1;
+            break;
+        }
+    }
+
+    /* let the started threads go, even on error, so they can be joined */
+    pthread_mutex_lock(&_startLock);
+    _started = 1;
+    pthread_cond_broadcast(&_startCond);
+    pthread_mutex_unlock(&_startLock);
+
+    for (mm = 0; mm < nn; mm++)
+        pthread_join(threads[mm], NULL);
+
+    if (status == 0) {
+        for (nn = 0; nn < numPipes; nn++) {
+            if (workers[nn].error < 0) {
+                fprintf(stderr, "%s: %s transfer failed on pipe %d\n",
+                        _transportNames[transport],
+                        test == TEST_LATENCY ? "latency" : "throughput", nn);
+                status = -1;
+            }
+            bytes += workers[nn].bytes;
+            numSamples += workers[nn].numSamples;
+            if (workers[nn].elapsed > elapsed)
+                elapsed = workers[nn].elapsed;
+        }
+    }
+
+    if (status == 0 && test == TEST_LATENCY)
+        samples = malloc(numSamples * sizeof(double));
+
+    if (samples != NULL) {
+        numSamples = 0;
+        for (nn = 0; nn < numPipes; nn++) {
+            memcpy(samples + numSamples, workers[nn].samples,
+                   workers[nn].numSamples * sizeof(double));
+            numSamples += workers[nn].numSamples;
+        }
+        qsort(samples, numSamples, sizeof(double), compare_doubles);
+
+        printf("%s,latency,%d,%lu,%d,%.6f,%.3f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+               _transportNames[transport], numPipes, (unsigned long)size, numSamples,
+               elapsed, bytes / (1024.*1024.) / elapsed,
+               percentile(samples, numSamples, 0.00) * 1e6,
+               percentile(samples, numSamples, 0.50) * 1e6,
+               percentile(samples, numSamples, 0.90) * 1e6,
+               percentile(samples, numSamples, 0.99) * 1e6,
+               percentile(samples, numSamples, 1.00) * 1e6);
+        free(samples);
+    }
+    else if (status == 0) {
+        printf("%s,throughput,%d,%lu,%lld,%.6f,%.3f,,,,,\n",
+               _transportNames[transport], numPipes, (unsigned long)size,
+               bytes / (long long)size,
+               elapsed, bytes / (1024.*1024.) / elapsed);
+    }
+    fflush(stdout);
+
+    for (nn = 0; nn < numPipes; nn++) {
+        pipe_close(workers[nn].pipe);
+        free(workers[nn].sendBuff);
+        free(workers[nn].recvBuff);
+        free(workers[nn].samples);
+    }
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    Endpoints    ep[1];
+    const char*  transports = "qemu,tcp,unix";
+    long         minSize  = 1;
+    long         maxSize  = 16*1024*1024;
+    int          step     = 4;
+    int          numPipes = 1;
+    double       duration = 1.0;
+    int          enabled[TRANSPORT_COUNT];
+    int          nn, status = 0;
+    long         size;
+
+    /* Extract program name */
+    {
+        char* p = strrchr(argv[0], '/');
+        if (p == NULL)
+            progname = argv[0];
+        else
+            progname = p+1;
+    }
+
+    memset(ep, 0, sizeof(ep));
+    ep->pipeName = PIPE_NAME;
+    ep->hostPort = 8012;
+    snprintf(ep->unixPath, sizeof(ep->unixPath), "@libqemu-benchmark-%d",
+             (int)getpid());
+
+    /* Parse options */
+    while (argc > 1 && argv[1][0] == '-') {
+        char* arg = argv[1];
+        if (!strcmp(arg, "-?") || !strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+            usage(0);
+        }
+        if (argc < 3) {
+            fprintf(stderr, "%s option needs an argument! See --help for details.\n", arg);
+            exit(1);
+        }
+        if (!strcmp(arg, "-pipe")) {
+            ep->pipeName = argv[2];
+        } else if (!strcmp(arg, "-transports")) {
+            transports = argv[2];
+        } else if (!strcmp(arg, "-host")) {
+            ep->hostPort = atoi(argv[2]);
+            if (ep->hostPort <= 0 || ep->hostPort > 65535) {
+                fprintf(stderr, "Invalid port number: %s\n", argv[2]);
+                exit(2);
+            }
+        } else if (!strcmp(arg, "-min-size") || !strcmp(arg, "-max-size")) {
+            size = parse_size(argv[2]);
+            if (size < 0) {
+                fprintf(stderr, "Invalid byte size: %s\n", argv[2]);
+                exit(3);
+            }
+            if (arg[1] == 'm' && arg[2] == 'i')
+                minSize = size;
+            else
+                maxSize = size;
+        } else if (!strcmp(arg, "-step")) {
+            step = atoi(argv[2]);
+            if (step < 2) {
+                fprintf(stderr, "Invalid size step: %s\n", argv[2]);
+                exit(2);
+            }
+        } else if (!strcmp(arg, "-pipes")) {
+            numPipes = atoi(argv[2]);
+            if (numPipes <= 0 || numPipes > MAX_PIPES) {
+                fprintf(stderr, "Invalid pipe count: %s (1 to %d)\n",
+                        argv[2], MAX_PIPES);
+                exit(2);
+            }
+        } else if (!strcmp(arg, "-time")) {
+            duration = atof(argv[2]);
+            if (duration <= 0) {
+                fprintf(stderr, "Invalid duration: %s\n", argv[2]);
+                exit(2);
+            }
+        } else {
+            fprintf(stderr, "UNKNOWN OPTION: %s\n\n", arg);
+            usage(1);
+        }
+        argc -= 2;
+        argv += 2;
+    }
+
+    /* Check the transports */
+    for (nn = 0; nn < TRANSPORT_COUNT; nn++) {
+        const char*  p = transports;
+        int          len = strlen(_transportNames[nn]);
+
+        enabled[nn] = 0;
+        while (p != NULL) {
+            if (!strncmp(p, _transportNames[nn], len) &&
+                (p[len] == ',' || p[len] == '\0'))
+                enabled[nn] = 1;
+            p = strchr(p, ',');
+            if (p != NULL)
+                p++;
+        }
+    }
+
+    if (enabled[TRANSPORT_TCP]) {
+        ep->tcpPort = echo_server_tcp();
+        if (ep->tcpPort < 0) {
+            fprintf(stderr, "Could not start tcp echo server: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+    if (enabled[TRANSPORT_UNIX] && echo_server_unix(ep->unixPath) < 0) {
+        fprintf(stderr, "Could not start unix echo server: %s\n", strerror(errno));
+        return 1;
+    }
+
+    printf("transport,test,pipes,size,messages,seconds,mb_per_sec,"
+           "min_us,p50_us,p90_us,p99_us,max_us\n");
+
+    for (nn = 0; nn < TRANSPORT_COUNT; nn++) {
+        if (!enabled[nn])
+            continue;
+
+        for (size = minSize; size <= maxSize; size *= step) {
+            fprintf(stderr, "%s: %ld bytes x %d pipes\n",
+                    _transportNames[nn], size, numPipes);
+            if (bench_run(nn, ep, TEST_LATENCY, size, numPipes, duration) < 0 ||
+                bench_run(nn, ep, TEST_THROUGHPUT, size, numPipes, duration) < 0) {
+                status = 1;
+                break;
+            }
+        }
+    }
+    return status;
+}
@@ -15,7 +15,9 @@
  */
 
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
@@ -37,14 +39,14 @@ double now_secs(void)
 {
     struct timeval tv;
     gettimeofday(&tv, NULL);
-    return tv.sec + (double)tv.usec/1e6;
+    return tv.tv_sec + (double)tv.tv_usec/1e6;
 }
 #endif
 
-int
-pipe_openSocket( Pipe*  pipe, int port )
+static int
+pipe_openTcp( Pipe*  pipe, uint32_t ip, int port )
 {
-    static int           fd;
+    int                 fd, n = 1;
     struct sockaddr_in  addr;
 
     pipe->socket = -1;
@@ -58,11 +60,59 @@ pipe_openSocket( Pipe*  pipe, int port )
     memset(&addr, 0, sizeof(addr));
     addr.sin_family      = AF_INET;
     addr.sin_port        = htons(port);
-    addr.sin_addr.s_addr = htonl(0x0a000202);
+    addr.sin_addr.s_addr = htonl(ip);
 
     if ( connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ) {
-        fprintf(stderr, "%s: Can't connect to tcp:local:%d: %s\n",
-                __FUNCTION__, port, strerror(errno));
+        fprintf(stderr, "%s: Can't connect to tcp:%08x:%d: %s\n",
+                __FUNCTION__, ip, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    /* Don't let Nagle's algorithm delay small messages */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &n, sizeof(n));
+
+    pipe->socket = fd;
+    return 0;
+}
+
+int
+pipe_openSocket( Pipe*  pipe, int port )
+{
+    return pipe_openTcp(pipe, 0x0a000202, port);
+}
+
+int
+pipe_openLoopback( Pipe*  pipe, int port )
+{
+    return pipe_openTcp(pipe, INADDR_LOOPBACK, port);
+}
+
+int
+pipe_openUnix( Pipe*  pipe, const char* path )
+{
+    int                 fd;
+    struct sockaddr_un  addr;
+    socklen_t           addrlen;
+
+    pipe->socket = -1;
+
+    fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if (fd < 0) {
+        fprintf(stderr, "%s: Can't create socket!!\n", __FUNCTION__);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    addrlen = offsetof(struct sockaddr_un, sun_path) + strlen(addr.sun_path);
+    if (addr.sun_path[0] == '@')
+        addr.sun_path[0] = '\0';
+
+    if ( connect(fd, (struct sockaddr*)&addr, addrlen) < 0 ) {
+        fprintf(stderr, "%s: Can't connect to unix:%s: %s\n",
+                __FUNCTION__, path, strerror(errno));
         close(fd);
         return -1;
     }
@@ -127,6 +177,21 @@ pipe_recv( Pipe*  pipe, void* buff, size_t bufflen )
     return ret;
 }
 
+int
+pipe_recvAll( Pipe*  pipe, void* buff, size_t bufflen )
+{
+    uint8_t*  ptr = buff;
+
+    while (bufflen > 0) {
+        int  ret = pipe_recv(pipe, ptr, bufflen);
+        if (ret < 0)
+            return -1;
+        ptr     += ret;
+        bufflen -= ret;
+    }
+    return 0;
+}
+
 void
 pipe_close( Pipe*  pipe )
 {
@@ -26,10 +26,18 @@ typedef struct {
     int  socket;
 } Pipe;
 
+/* Connect to a TCP port of the host, as seen from the emulated system */
 int  pipe_openSocket( Pipe*  pipe, int port );
+/* Connect to a TCP port of the local loopback interface */
+int  pipe_openLoopback( Pipe*  pipe, int port );
+/* Connect to a Unix socket. A path starting with '@' is in the
+ * abstract namespace. */
+int  pipe_openUnix( Pipe*  pipe, const char* path );
 int  pipe_openQemuPipe( Pipe*  pipe, const char* pipename );
 int  pipe_send( Pipe*  pipe, const void* buff, size_t  bufflen );
 int  pipe_recv( Pipe*  pipe, void* buff, size_t bufflen );
+/* Receive exactly 'bufflen' bytes */
+int  pipe_recvAll( Pipe*  pipe, void* buff, size_t bufflen );
 void pipe_close( Pipe*  pipe );
 
 #endif /* TEST_UTIL_H */
@@ -28,3 +28,14 @@ LOCAL_SRC_FILES := test_guest_2.c test_util.c
 LOCAL_MODULE_TAGS := tests
 LOCAL_STATIC_LIBRARIES := libcutils
 include $(BUILD_EXECUTABLE)
+
+# The benchmark compares the latency and throughput of QEMUD pipes
+# with TCP loopback and Unix sockets, over a range of message sizes.
+# Results are printed as comma-separated values, see test_benchmark.c.
+#
+include $(CLEAR_VARS)
+LOCAL_MODULE := test-libqemu-benchmark
+LOCAL_SRC_FILES := test_benchmark.c test_util.c
+LOCAL_MODULE_TAGS := tests
+LOCAL_STATIC_LIBRARIES := libcutils
+include $(BUILD_EXECUTABLE)
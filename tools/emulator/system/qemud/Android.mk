@@ -14,7 +14,29 @@ LOCAL_SRC_FILES:= \
 
 LOCAL_SHARED_LIBRARIES := \
 	libcutils \
+	liblog \
 
 LOCAL_MODULE:= qemud
 
 include $(BUILD_EXECUTABLE)
+
+# Loopback throughput benchmark, runs the multiplexer over socket pairs
+# on a Linux host. See qemud_benchmark.c.
+#
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	qemud_benchmark.c
+
+LOCAL_STATIC_LIBRARIES := \
+	libcutils \
+	liblog \
+
+LOCAL_LDLIBS := -lrt
+
+LOCAL_MODULE:= qemud-benchmark
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
+endif
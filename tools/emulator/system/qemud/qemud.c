@@ -6,7 +6,9 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <termios.h>
+#include <unistd.h>
 #include <cutils/sockets.h>
 
 /*
@@ -84,9 +86,10 @@
 #define  DEBUG     0
 #define  T_ACTIVE  0  /* set to 1 to dump traffic */
 
+#define  LOG_TAG  "qemud"
+#include <cutils/log.h>
+
 #if DEBUG
-#  define LOG_TAG  "qemud"
-#  include <cutils/log.h>
 #  define  D(...)   ALOGD(__VA_ARGS__)
 #else
 #  define  D(...)  ((void)0)
@@ -217,12 +220,24 @@ fd_read(int  fd, void*  to, int  len)
 }
 
 static int
-fd_write(int  fd, const void*  from, int  len)
+fd_readv(int  fd, const struct iovec*  iov, int  iovcnt)
 {
     int  ret;
 
     do {
-        ret = write(fd, from, len);
+        ret = readv(fd, iov, iovcnt);
+    } while (ret < 0 && errno == EINTR);
+
+    return ret;
+}
+
+static int
+fd_writev(int  fd, const struct iovec*  iov, int  iovcnt)
+{
+    int  ret;
+
+    do {
+        ret = writev(fd, iov, iovcnt);
     } while (ret < 0 && errno == EINTR);
 
     return ret;
@@ -234,7 +249,7 @@ fd_setnonblock(int  fd)
     int  ret, flags;
 
     do {
-        flags = fcntl(fd, F_GETFD);
+        flags = fcntl(fd, F_GETFL);
     } while (flags < 0 && errno == EINTR);
 
     if (flags < 0) {
@@ -243,7 +258,7 @@ fd_setnonblock(int  fd)
     }
 
     do {
-        ret = fcntl(fd, F_SETFD, flags | O_NONBLOCK);
+        ret = fcntl(fd, F_SETFL, flags | O_NONBLOCK);
     } while (ret < 0 && errno == EINTR);
 
     if (ret < 0) {
@@ -292,11 +307,17 @@ fd_accept(int  fd)
 /* the current implementation uses Linux's epoll facility
  * the event mask we use are simply combinations of EPOLLIN
  * EPOLLOUT, EPOLLHUP and EPOLLERR
+ *
+ * EPOLLET can be enabled too, to make a file descriptor
+ * edge-triggered. Its event handler must then read or write
+ * until the operation would block, since it won't be called
+ * again before that. Note that re-enabling an event always
+ * re-checks the file descriptor's state.
  */
 #include <sys/epoll.h>
 
-#define  MAX_CHANNELS  16
-#define  MAX_EVENTS    (MAX_CHANNELS+1)  /* each channel + the serial fd */
+#define  MAX_CHANNELS  256  /* channel numbers are 8-bit */
+#define  MAX_EVENTS    64   /* events handled per epoll_wait() call */
 
 /* the event handler function type, 'user' is a user-specific
  * opaque pointer passed to looper_add().
@@ -305,58 +326,82 @@ typedef void (*EventFunc)( void*  user, int  events );
 
 /* bit flags for the LoopHook structure.
  *
- * HOOK_PENDING means that an event happened on the
- * corresponding file descriptor.
- *
- * HOOK_CLOSING is used to delay-close monitored
- * file descriptors.
+ * HOOK_CLOSING means that the hook was unregistered while
+ * events for it may still be waiting to be dispatched.
  */
 enum {
-    HOOK_PENDING = (1 << 0),
     HOOK_CLOSING = (1 << 1),
 };
 
 /* A LoopHook structure is used to monitor a given
  * file descriptor and record its event handler.
+ *
+ * hooks never move in memory, so epoll can hand them back
+ * to us directly. they are recycled through a free list,
+ * but only after the events that may point to them have
+ * been dispatched.
  */
-typedef struct {
+typedef struct LoopHook  LoopHook;
+
+struct LoopHook {
     int        fd;
     int        wanted;  /* events we are monitoring */
-    int        events;  /* events that occured */
     int        state;   /* see HOOK_XXX constants */
     void*      ev_user; /* user-provided handler parameter */
     EventFunc  ev_func; /* event handler callback */
-} LoopHook;
+    LoopHook*  next;    /* in the closed or free list */
+};
 
 /* Looper is the main object modeling a looper object
  */
 typedef struct {
     int                  epoll_fd;
     int                  num_fds;
-    int                  max_fds;
-    struct epoll_event*  events;
-    LoopHook*            hooks;
+    int                  max_fds;     /* size of 'hooks' */
+    LoopHook**           hooks;       /* indexed by file descriptor */
+    LoopHook*            closed;      /* unregistered, not dispatched yet */
+    LoopHook*            free_hooks;  /* ready for reuse */
+    struct epoll_event   events[MAX_EVENTS];
 } Looper;
 
 /* initialize a looper object */
 static void
 looper_init( Looper*  l )
 {
-    l->epoll_fd = epoll_create(4);
-    l->num_fds  = 0;
-    l->max_fds  = 0;
-    l->events   = NULL;
-    l->hooks    = NULL;
+    l->epoll_fd   = epoll_create(4);
+    l->num_fds    = 0;
+    l->max_fds    = 0;
+    l->hooks      = NULL;
+    l->closed     = NULL;
+    l->free_hooks = NULL;
+}
+
+static void
+looper_free_list( LoopHook*  hook )
+{
+    while (hook != NULL) {
+        LoopHook*  next = hook->next;
+        xfree(hook);
+        hook = next;
+    }
 }
 
 /* finalize a looper object */
 static void
 looper_done( Looper*  l )
 {
-    xfree(l->events);
+    int  n;
+
+    for (n = 0; n < l->max_fds; n++)
+        xfree(l->hooks[n]);
     xfree(l->hooks);
-    l->max_fds = 0;
-    l->num_fds = 0;
+    looper_free_list(l->closed);
+    looper_free_list(l->free_hooks);
+    l->hooks      = NULL;
+    l->closed     = NULL;
+    l->free_hooks = NULL;
+    l->max_fds    = 0;
+    l->num_fds    = 0;
 
     close(l->epoll_fd);
     l->epoll_fd  = -1;
@@ -368,37 +413,25 @@ looper_done( Looper*  l )
 static LoopHook*
 looper_find( Looper*  l, int  fd )
 {
-    LoopHook*  hook = l->hooks;
-    LoopHook*  end  = hook + l->num_fds;
+    if (fd < 0 || fd >= l->max_fds)
+        return NULL;
 
-    for ( ; hook < end; hook++ ) {
-        if (hook->fd == fd)
-            return hook;
-    }
-    return NULL;
+    return l->hooks[fd];
 }
 
-/* grow the arrays in the looper object */
+/* grow the hooks table so it can be indexed by 'fd' */
 static void
-looper_grow( Looper*  l )
+looper_grow( Looper*  l, int  fd )
 {
     int  old_max = l->max_fds;
-    int  new_max = old_max + (old_max >> 1) + 4;
-    int  n;
-
-    xrenew( l->events, new_max );
-    xrenew( l->hooks,  new_max );
-    l->max_fds = new_max;
+    int  new_max = old_max + (old_max >> 1) + 16;
 
-    /* now change the handles to all events */
-    for (n = 0; n < l->num_fds; n++) {
-        struct epoll_event ev;
-        LoopHook*          hook = l->hooks + n;
+    if (new_max <= fd)
+        new_max = fd + 1;
 
-        ev.events   = hook->wanted;
-        ev.data.ptr = hook;
-        epoll_ctl( l->epoll_fd, EPOLL_CTL_MOD, hook->fd, &ev );
-    }
+    xrenew( l->hooks, new_max );
+    memset( l->hooks + old_max, 0, (new_max - old_max)*sizeof(l->hooks[0]) );
+    l->max_fds = new_max;
 }
 
 /* register a file descriptor and its event handler.
@@ -410,17 +443,23 @@ looper_add( Looper*  l, int  fd, EventFunc  func, void*  user )
     struct epoll_event  ev;
     LoopHook*           hook;
 
-    if (l->num_fds >= l->max_fds)
-        looper_grow(l);
+    if (fd >= l->max_fds)
+        looper_grow(l, fd);
 
-    hook = l->hooks + l->num_fds;
+    hook = l->free_hooks;
+    if (hook != NULL)
+        l->free_hooks = hook->next;
+    else
+        xnew(hook);
 
     hook->fd      = fd;
     hook->ev_user = user;
     hook->ev_func = func;
     hook->state   = 0;
     hook->wanted  = 0;
-    hook->events  = 0;
+    hook->next    = NULL;
+
+    l->hooks[fd] = hook;
 
     fd_setnonblock(fd);
 
@@ -442,10 +481,16 @@ looper_del( Looper*  l, int  fd )
         D( "%s: invalid fd: %d", __FUNCTION__, fd );
         return;
     }
-    /* don't remove the hook yet */
-    hook->state |= HOOK_CLOSING;
 
     epoll_ctl( l->epoll_fd, EPOLL_CTL_DEL, fd, NULL );
+
+    /* the fd can be reused right away, but don't recycle the
+     * hook until the current events have been dispatched */
+    l->hooks[fd] = NULL;
+    l->num_fds  -= 1;
+    hook->state |= HOOK_CLOSING;
+    hook->next   = l->closed;
+    l->closed    = hook;
 }
 
 /* enable monitoring of certain events for a file
@@ -498,6 +543,17 @@ looper_disable( Looper*  l, int  fd, int  events )
     }
 }
 
+/* return the events currently monitored for a file
+ * descriptor, or 0 if it isn't registered.
+ */
+static int
+looper_wanted( Looper*  l, int  fd )
+{
+    LoopHook*  hook = looper_find( l, fd );
+
+    return hook ? hook->wanted : 0;
+}
+
 /* wait until an event occurs on one of the registered file
  * descriptors. Only returns in case of error !!
  */
@@ -508,7 +564,7 @@ looper_loop( Looper*  l )
         int  n, count;
 
         do {
-            count = epoll_wait( l->epoll_fd, l->events, l->num_fds, -1 );
+            count = epoll_wait( l->epoll_fd, l->events, MAX_EVENTS, -1 );
         } while (count < 0 && errno == EINTR);
 
         if (count < 0) {
@@ -521,39 +577,22 @@ looper_loop( Looper*  l )
             continue;
         }
 
-        /* mark all pending hooks */
+        /* execute hook callbacks. a callback may unregister
+         * any hook, including ones that still have events in
+         * the array, these are skipped */
         for (n = 0; n < count; n++) {
             LoopHook*  hook = l->events[n].data.ptr;
-            hook->state  = HOOK_PENDING;
-            hook->events = l->events[n].events;
-        }
 
-        /* execute hook callbacks. this may change the 'hooks'
-         * and 'events' array, as well as l->num_fds, so be careful */
-        for (n = 0; n < l->num_fds; n++) {
-            LoopHook*  hook = l->hooks + n;
-            if (hook->state & HOOK_PENDING) {
-                hook->state &= ~HOOK_PENDING;
-                hook->ev_func( hook->ev_user, hook->events );
-            }
+            if (!(hook->state & HOOK_CLOSING))
+                hook->ev_func( hook->ev_user, l->events[n].events );
         }
 
-        /* now remove all the hooks that were closed by
-         * the callbacks */
-        for (n = 0; n < l->num_fds;) {
-            struct epoll_event ev;
-            LoopHook*  hook = l->hooks + n;
-
-            if (!(hook->state & HOOK_CLOSING)) {
-                n++;
-                continue;
-            }
-
-            hook[0]     = l->hooks[l->num_fds-1];
-            l->num_fds -= 1;
-            ev.events   = hook->wanted;
-            ev.data.ptr = hook;
-            epoll_ctl( l->epoll_fd, EPOLL_CTL_MOD, hook->fd, &ev );
+        /* nothing refers to the closed hooks anymore */
+        while (l->closed != NULL) {
+            LoopHook*  hook = l->closed;
+            l->closed     = hook->next;
+            hook->next    = l->free_hooks;
+            l->free_hooks = hook;
         }
     }
 }
@@ -638,33 +677,75 @@ quote( const void*  data, int  len )
 
 typedef struct Packet   Packet;
 
+/* maximum size of data read from a client socket in one go */
 #define  MAX_PAYLOAD  4000
 
+/* maximum size of a serial packet payload, limited by the 4 hex chars
+ * used to encode its length in the hex framing */
+#define  MAX_SERIAL_PAYLOAD  0xffff
+
+/* size of the serial framing header that can be stored in a packet */
+#define  MAX_HEADER  6
+
 struct Packet {
     Packet*   next;
     int       len;
     int       channel;
-    uint8_t   data[ MAX_PAYLOAD ];
+    int       capacity;  /* size of the 'data' buffer */
+    int       sclass;    /* size class index, see packet_alloc() */
+    int       hlen;      /* framing header bytes, sent before 'data' */
+    uint8_t   header[ MAX_HEADER ];
+    uint8_t*  data;
+};
+
+/* packets are allocated with their payload in a single block, from a few
+ * size classes so that small control messages don't pin down a buffer
+ * large enough for a full serial payload.
+ */
+#define  PACKET_CLASSES  5
+
+static const int  _packet_class_sizes[PACKET_CLASSES] = {
+    64, 512, MAX_PAYLOAD, 16384, MAX_SERIAL_PAYLOAD
 };
 
 /* we expect to alloc/free a lot of packets during
  * operations so use a single linked list of free packets
- * to keep things speedy and simple.
+ * per size class to keep things speedy and simple.
+ *
+ * the lists are capped so that a burst of traffic doesn't
+ * pin down its peak memory usage forever.
  */
-static Packet*   _free_packets;
+static Packet*   _free_packets[PACKET_CLASSES];
+static int       _free_counts[PACKET_CLASSES];
 
-/* Allocate a packet */
+#define  MAX_FREE_BYTES  (256*1024)  /* per size class */
+
+/* Allocate a packet that can hold at least 'size' payload bytes */
 static Packet*
-packet_alloc(void)
+packet_alloc( int  size )
 {
-    Packet*  p = _free_packets;
+    Packet*  p;
+    int      sclass = 0;
+
+    while (sclass < PACKET_CLASSES-1 && _packet_class_sizes[sclass] < size)
+        sclass++;
+
+    if (size > _packet_class_sizes[sclass])
+        fatal( "%s: %d bytes packet is too large", __FUNCTION__, size );
+
+    p = _free_packets[sclass];
     if (p != NULL) {
-        _free_packets = p->next;
+        _free_packets[sclass] = p->next;
+        _free_counts[sclass] -= 1;
     } else {
-        xnew(p);
+        p = xalloc(sizeof(*p) + _packet_class_sizes[sclass]);
+        p->data     = (uint8_t*)(p + 1);
+        p->capacity = _packet_class_sizes[sclass];
+        p->sclass   = sclass;
     }
     p->next    = NULL;
     p->len     = 0;
+    p->hlen    = 0;
     p->channel = -1;
     return p;
 }
@@ -678,8 +759,14 @@ packet_free( Packet*  *ppacket )
 {
     Packet*  p = *ppacket;
     if (p) {
-        p->next       = _free_packets;
-        _free_packets = p;
+        int  sclass = p->sclass;
+        if ((_free_counts[sclass] + 1) * _packet_class_sizes[sclass] > MAX_FREE_BYTES) {
+            free(p);
+        } else {
+            p->next = _free_packets[sclass];
+            _free_packets[sclass] = p;
+            _free_counts[sclass] += 1;
+        }
         *ppacket = NULL;
     }
 }
@@ -745,16 +832,54 @@ receiver_close( Receiver*  r )
 typedef struct FDHandler      FDHandler;
 typedef struct FDHandlerList  FDHandlerList;
 
+/* a function that reads incoming data from a file descriptor by itself,
+ * see fdhandler_set_reader(). returns the result of the read call.
+ */
+typedef int (*ReadFunc)( void*  user, int  fd );
+
+/* a function called when the outgoing queue of a FDHandler goes over
+ * its high mark (full is 1), then back under its low mark (full is 0),
+ * see fdhandler_set_flow().
+ */
+typedef void (*FlowFunc)( void*  user, int  full );
+
+/* max number of queued packets sent by a single write call */
+#define  MAX_WRITE_PACKETS  16
+
 struct FDHandler {
     int             fd;
     FDHandlerList*  list;
     char            closing;
     Receiver        receiver[1];
 
+    /* optional direct reader, replaces the default packet reads */
+    ReadFunc        reader;
+    void*           reader_user;
+
     /* queue of outgoing packets */
     int             out_pos;
     Packet*         out_first;
     Packet**        out_ptail;
+    int             out_count;   /* packets in the queue */
+    int             out_bytes;   /* unsent bytes in the queue */
+
+    /* flow control, see fdhandler_set_flow() */
+    int             high_mark;
+    int             low_mark;
+    char            full;
+    FlowFunc        flow;
+    void*           flow_user;
+
+    /* queue statistics */
+    int             max_count;     /* deepest queue, in packets */
+    int             max_bytes;     /* deepest queue, in bytes */
+    int             sent_packets;
+    int             sent_writes;   /* write calls used to send them */
+    int             full_count;    /* times the high mark was reached */
+
+    /* set while fdhandler_event() runs, tells it the
+     * handler was closed by one of its callbacks */
+    char*           pclosed;
 
     FDHandler*      next;
     FDHandler**     pref;
@@ -823,6 +948,13 @@ fdhandler_close( FDHandler*  f )
     /* notify receiver */
     receiver_close(f->receiver);
 
+    /* the queue is going away, release whoever was waiting on it */
+    if (f->full) {
+        f->full = 0;
+        if (f->flow)
+            f->flow( f->flow_user, 0 );
+    }
+
     /* remove the handler from its list */
     fdhandler_remove(f);
 
@@ -842,6 +974,9 @@ fdhandler_close( FDHandler*  f )
         f->fd = -1;
     }
 
+    if (f->pclosed)
+        *f->pclosed = 1;
+
     f->list = NULL;
     xfree(f);
 }
@@ -860,8 +995,10 @@ fdhandler_shutdown( FDHandler*  f )
 
     if (f->out_first != NULL && !f->closing)
     {
-        /* move the handler to the 'closing' list */
+        /* move the handler to the 'closing' list, it only
+         * flushes its queue from now on */
         f->closing = 1;
+        looper_disable( f->list->looper, f->fd, EPOLLIN );
         fdhandler_remove(f);
         fdhandler_prepend(f, &f->list->closing);
         return;
@@ -882,18 +1019,130 @@ fdhandler_enqueue( FDHandler*  f, Packet*  p )
     f->out_ptail[0] = p;
     f->out_ptail    = &p->next;
 
+    f->out_count += 1;
+    f->out_bytes += p->hlen + p->len;
+    if (f->out_count > f->max_count)
+        f->max_count = f->out_count;
+    if (f->out_bytes > f->max_bytes)
+        f->max_bytes = f->out_bytes;
+
     if (first == NULL) {
         f->out_pos = 0;
         looper_enable( f->list->looper, f->fd, EPOLLOUT );
     }
+
+    if (f->high_mark > 0 && !f->full && f->out_bytes >= f->high_mark) {
+        f->full        = 1;
+        f->full_count += 1;
+        if (f->flow)
+            f->flow( f->flow_user, 1 );
+    }
+}
+
+/* send as many queued packets as possible with a single write call.
+ * returns the result of the write call. note that this closes and
+ * frees a closing FDHandler once its queue is flushed.
+ */
+static int
+fdhandler_write( FDHandler*  f )
+{
+    struct iovec  iov[ 2*MAX_WRITE_PACKETS ];
+    int           niov = 0, pos = f->out_pos, len, ret;
+    Packet*       p;
+
+    /* each packet needs up to two entries, one for its framing header
+     * and one for its payload, so nothing is joined before sending.
+     * 'out_pos' covers the header of the first packet, then its payload */
+    for (p = f->out_first; p != NULL && niov + 2 <= 2*MAX_WRITE_PACKETS; p = p->next) {
+        if (pos < p->hlen) {
+            iov[niov].iov_base = p->header + pos;
+            iov[niov].iov_len  = p->hlen - pos;
+            niov++;
+        }
+        if (p->len > 0) {
+            int  dpos = (pos > p->hlen) ? pos - p->hlen : 0;
+            iov[niov].iov_base = p->data + dpos;
+            iov[niov].iov_len  = p->len - dpos;
+            niov++;
+        }
+        pos = 0;
+    }
+
+    if ((len = fd_writev(f->fd, iov, niov)) < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            D("%s: can't send: %s", __FUNCTION__, strerror(errno));
+        return -1;
+    }
+
+    ret             = len;
+    f->sent_writes += 1;
+    f->out_bytes   -= len;
+
+    /* release the packets that were completely sent */
+    len += f->out_pos;
+    while ((p = f->out_first) != NULL && len >= p->hlen + p->len) {
+        len -= p->hlen + p->len;
+        f->out_first     = p->next;
+        f->out_count    -= 1;
+        f->sent_packets += 1;
+        packet_free(&p);
+    }
+    f->out_pos = len;
+
+    if (f->out_first == NULL) {
+        f->out_ptail = &f->out_first;
+        looper_disable( f->list->looper, f->fd, EPOLLOUT );
+    }
+
+    if (f->full && f->out_bytes <= f->low_mark) {
+        f->full = 0;
+        if (f->flow)
+            f->flow( f->flow_user, 0 );
+    }
+
+    /* a closing handler goes away once its queue is flushed */
+    if (f->closing && f->out_first == NULL)
+        fdhandler_close(f);
+
+    return ret;
 }
 
+/* read incoming data once and pass it to the receiver.
+ * returns the result of the read call.
+ */
+static int
+fdhandler_read( FDHandler*  f )
+{
+    Packet*  p;
+    int      len;
 
-/* FDHandler file descriptor event callback for read/write ops */
+    if (f->reader != NULL)
+        return f->reader( f->reader_user, f->fd );
+
+    p = packet_alloc(MAX_PAYLOAD);
+    if ((len = fd_read(f->fd, p->data, MAX_PAYLOAD)) > 0) {
+        p->len     = len;
+        p->channel = -101;  /* special debug value, not used */
+        receiver_post( f->receiver, p );
+    } else {
+        packet_free(&p);
+    }
+    return len;
+}
+
+
+/* FDHandler file descriptor event callback for read/write ops.
+ * the file descriptor is edge-triggered, so both directions are
+ * drained until they would block. the receiver and flow callbacks
+ * can close the handler at any point, which sets 'closed'.
+ */
 static void
 fdhandler_event( FDHandler*  f, int  events )
 {
-   int  len;
+    Looper*  looper = f->list->looper;
+    char     closed = 0;
+
+    f->pclosed = &closed;
 
     /* in certain cases, it's possible to have both EPOLLIN and
      * EPOLLHUP at the same time. This indicates that there is incoming
@@ -903,16 +1152,24 @@ fdhandler_event( FDHandler*  f, int  events )
      */
 
     if (events & EPOLLIN) {
-        Packet*  p = packet_alloc();
-        int      len;
+        /* stop early if flow control paused reading, re-enabling
+         * EPOLLIN will report the remaining data */
+        while (looper_wanted(looper, f->fd) & EPOLLIN) {
+            int  len = fdhandler_read(f);
 
-        if ((len = fd_read(f->fd, p->data, MAX_PAYLOAD)) < 0) {
-            D("%s: can't recv: %s", __FUNCTION__, strerror(errno));
-            packet_free(&p);
-        } else if (len > 0) {
-            p->len     = len;
-            p->channel = -101;  /* special debug value, not used */
-            receiver_post( f->receiver, p );
+            if (closed)
+                return;
+
+            if (len == 0) {
+                /* end of stream, there won't be another edge */
+                events |= EPOLLHUP;
+                break;
+            }
+            if (len < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    D("%s: can't recv: %s", __FUNCTION__, strerror(errno));
+                break;
+            }
         }
     }
 
@@ -923,26 +1180,18 @@ fdhandler_event( FDHandler*  f, int  events )
         return;
     }
 
-    if (events & EPOLLOUT && f->out_first) {
-        Packet*  p = f->out_first;
-        int      avail, len;
+    if (events & EPOLLOUT) {
+        while (f->out_first != NULL) {
+            int  len = fdhandler_write(f);
 
-        avail = p->len - f->out_pos;
-        if ((len = fd_write(f->fd, p->data + f->out_pos, avail)) < 0) {
-            D("%s: can't send: %s", __FUNCTION__, strerror(errno));
-        } else {
-            f->out_pos += len;
-            if (f->out_pos >= p->len) {
-                f->out_pos   = 0;
-                f->out_first = p->next;
-                packet_free(&p);
-                if (f->out_first == NULL) {
-                    f->out_ptail = &f->out_first;
-                    looper_disable( f->list->looper, f->fd, EPOLLOUT );
-                }
-            }
+            if (closed)
+                return;
+            if (len < 0)
+                break;
         }
     }
+
+    f->pclosed = NULL;
 }
 
 
@@ -960,15 +1209,42 @@ fdhandler_new( int             fd,
     f->out_first   = NULL;
     f->out_ptail   = &f->out_first;
     f->out_pos     = 0;
+    f->reader      = NULL;
 
     fdhandler_prepend(f, &list->active);
 
     looper_add( list->looper, fd, (EventFunc) fdhandler_event, f );
-    looper_enable( list->looper, fd, EPOLLIN );
+    looper_enable( list->looper, fd, EPOLLIN|EPOLLET );
 
     return f;
 }
 
+/* Bound the outgoing queue of a FDHandler: 'flow' is called with 1
+ * when the queue reaches 'high_mark' bytes, then with 0 when it drains
+ * back to 'low_mark' bytes. The caller is expected to stop feeding the
+ * queue in between.
+ */
+static void
+fdhandler_set_flow( FDHandler*  f, int  high_mark, int  low_mark,
+                    FlowFunc  flow, void*  user )
+{
+    f->high_mark = high_mark;
+    f->low_mark  = low_mark;
+    f->flow      = flow;
+    f->flow_user = user;
+}
+
+/* Make a FDHandler call 'reader' when its file descriptor becomes
+ * readable, instead of reading packets and posting them to its receiver.
+ * This lets the caller read data directly where it belongs.
+ */
+static void
+fdhandler_set_reader( FDHandler*  f, ReadFunc  reader, void*  user )
+{
+    f->reader      = reader;
+    f->reader_user = user;
+}
+
 
 /* event callback function to monitor accepts() on server sockets.
  * the convention used here is that the receiver will receive a
@@ -979,7 +1255,7 @@ fdhandler_accept_event( FDHandler*  f, int  events )
 {
     if (events & EPOLLIN) {
         /* this is an accept - send a dummy packet to the receiver */
-        Packet*  p = packet_alloc();
+        Packet*  p = packet_alloc(1);
 
         D("%s: accepting on fd %d", __FUNCTION__, f->fd);
         p->data[0] = 1;
@@ -1032,13 +1308,30 @@ fdhandler_new_accept( int             fd,
  ** used on the serial port connection.
  **/
 
-/* each packet is made of a 6 byte header followed by a payload
- * the header looks like:
+/* each packet is made of a 6 byte header followed by a payload.
+ * there are two header formats. the original one looks like:
  *
  *   offset   size    description
  *       0       2    a 2-byte hex string for the channel number
- *       4       4    a 4-char hex string for the size of the payload
+ *       2       4    a 4-char hex string for the size of the payload
  *       6       n    the payload itself
+ *
+ * the binary one, told apart by its first byte which is never
+ * a hex char, looks like:
+ *
+ *   offset   size    description
+ *       0       1    BINARY_MAGIC
+ *       1       1    the channel number
+ *       2       2    the size of the payload, little-endian
+ *       4       2    reserved, must be 0
+ *       6       n    the payload itself
+ *
+ * qemud parses both formats at any time, but only sends binary
+ * headers once the emulator has said it understands them: on
+ * startup, qemud sends "framing:binary" through the control
+ * channel. newer emulators answer with "ok:framing:binary", older
+ * ones with "ko:unknown command", in which case hex headers are
+ * used as before.
  */
 #define  HEADER_SIZE    6
 #define  CHANNEL_OFFSET 0
@@ -1046,22 +1339,29 @@ fdhandler_new_accept( int             fd,
 #define  CHANNEL_SIZE   2
 #define  LENGTH_SIZE    4
 
+#define  BINARY_MAGIC   0x80
+
 #define  CHANNEL_CONTROL  0
 
 /* The Serial object receives data from the serial port,
  * extracts the payload size and channel index, then sends
  * the resulting messages as a packet to a generic receiver.
  *
+ * Payloads are read straight into the packet that is posted
+ * to the receiver, sized after the header.
+ *
  * You can also use serial_send to send a packet through
  * the serial port.
  */
 typedef struct Serial {
     FDHandler*  fdhandler;   /* used to monitor serial port fd */
     Receiver    receiver[1]; /* send payload there */
-    int         in_len;      /* current bytes in input packet */
+    int         in_len;      /* bytes read in current header or payload */
     int         in_datalen;  /* payload size, or 0 when reading header */
     int         in_channel;  /* extracted channel number */
-    Packet*     in_packet;   /* used to read incoming packets */
+    Packet*     in_packet;   /* payload destination, NULL when reading header */
+    uint8_t     in_header[HEADER_SIZE];
+    char        out_binary;  /* send binary headers ? */
 } Serial;
 
 
@@ -1075,82 +1375,101 @@ serial_fd_close( Serial*  s )
 static void
 serial_dump( Packet*  p, const char*  funcname )
 {
-    T("%s: %03d bytes: '%s'",
-      funcname, p->len, quote(p->data, p->len));
+    T("%s: channel %d: %03d bytes: '%s'",
+      funcname, p->channel, p->len, quote(p->data, p->len));
 }
 
-/* a callback called when a packet arrives from the serial port's FDHandler.
- *
- * This will essentially parse the header, extract the channel number and
- * the payload size and store them in 'in_datalen' and 'in_channel'.
- *
- * After that, the payload is sent to the receiver once completed.
+/* extract the payload size and channel number from a complete header,
+ * and prepare the packet receiving the payload.
  */
 static void
-serial_fd_receive( Serial*  s, Packet*  p )
+serial_parse_header( Serial*  s )
 {
-    int      rpos  = 0, rcount = p->len;
-    Packet*  inp   = s->in_packet;
-    int      inpos = s->in_len;
+    const uint8_t*  h = s->in_header;
 
-    serial_dump( p, __FUNCTION__ );
+    if (h[0] == BINARY_MAGIC) {
+        s->in_channel = h[1];
+        s->in_datalen = h[2] | (h[3] << 8);
+    } else {
+        s->in_datalen = hex2int( h + LENGTH_OFFSET,  LENGTH_SIZE );
+        s->in_channel = hex2int( h + CHANNEL_OFFSET, CHANNEL_SIZE );
+    }
+    s->in_len = 0;
 
-    while (rpos < rcount)
-    {
-        int  avail = rcount - rpos;
-
-        /* first, try to read the header */
-        if (s->in_datalen == 0) {
-            int  wanted = HEADER_SIZE - inpos;
-            if (avail > wanted)
-                avail = wanted;
-
-            memcpy( inp->data + inpos, p->data + rpos, avail );
-            inpos += avail;
-            rpos  += avail;
-
-            if (inpos == HEADER_SIZE) {
-                s->in_datalen = hex2int( inp->data + LENGTH_OFFSET,  LENGTH_SIZE );
-                s->in_channel = hex2int( inp->data + CHANNEL_OFFSET, CHANNEL_SIZE );
-
-                if (s->in_datalen <= 0) {
-                    D("ignoring %s packet from serial port",
-                      s->in_datalen ? "empty" : "malformed");
-                    s->in_datalen = 0;
-                }
+    if (s->in_datalen <= 0) {
+        D("ignoring %s packet from serial port",
+          s->in_datalen ? "malformed" : "empty");
+        s->in_datalen = 0;
+        return;
+    }
 
-                //D("received %d bytes packet for channel %d", s->in_datalen, s->in_channel);
-                inpos = 0;
-            }
-        }
-        else /* then, populate the packet itself */
-        {
-            int   wanted = s->in_datalen - inpos;
-
-            if (avail > wanted)
-                avail = wanted;
-
-            memcpy( inp->data + inpos, p->data + rpos, avail );
-            inpos += avail;
-            rpos  += avail;
-
-            if (inpos == s->in_datalen) {
-                if (s->in_channel < 0) {
-                    D("ignoring %d bytes addressed to channel %d",
-                       inpos, s->in_channel);
-                } else {
-                    inp->len     = inpos;
-                    inp->channel = s->in_channel;
-                    receiver_post( s->receiver, inp );
-                    s->in_packet  = inp = packet_alloc();
-                }
-                s->in_datalen = 0;
-                inpos         = 0;
-            }
-        }
+    //D("received %d bytes packet for channel %d", s->in_datalen, s->in_channel);
+    s->in_packet = packet_alloc( s->in_datalen );
+}
+
+/* a callback called when the serial port's fd is readable.
+ *
+ * When a header is expected, only the header is read. Otherwise, the
+ * rest of the payload is read directly into the packet that will be
+ * posted, along with the header of the next packet if it's available.
+ */
+static int
+serial_fd_read( Serial*  s, int  fd )
+{
+    Packet*       p = s->in_packet;
+    struct iovec  iov[2];
+    int           niov, len, avail;
+
+    if (p == NULL) {
+        iov[0].iov_base = s->in_header + s->in_len;
+        iov[0].iov_len  = HEADER_SIZE - s->in_len;
+        niov = 1;
+    } else {
+        iov[0].iov_base = p->data + s->in_len;
+        iov[0].iov_len  = s->in_datalen - s->in_len;
+        iov[1].iov_base = s->in_header;
+        iov[1].iov_len  = HEADER_SIZE;
+        niov = 2;
     }
-    s->in_len = inpos;
-    packet_free(&p);
+
+    len = fd_readv( fd, iov, niov );
+    if (len <= 0)
+        return len;
+
+    if (p == NULL) {
+        s->in_len += len;
+        if (s->in_len == HEADER_SIZE)
+            serial_parse_header(s);
+        return len;
+    }
+
+    avail = s->in_datalen - s->in_len;
+    if (len < avail) {
+        s->in_len += len;
+        return len;
+    }
+
+    /* the payload is complete, anything past it is the next header */
+    p->len        = s->in_datalen;
+    p->channel    = s->in_channel;
+    s->in_packet  = NULL;
+    s->in_datalen = 0;
+    s->in_len     = len - avail;
+
+    serial_dump( p, __FUNCTION__ );
+
+    if (p->channel < 0) {
+        D("ignoring %d bytes addressed to channel %d",
+           p->len, p->channel);
+        packet_free(&p);
+    } else {
+        receiver_post( s->receiver, p );
+    }
+
+    if (s->in_len == HEADER_SIZE)
+        serial_parse_header(s);
+
+    return len;
 }
 
 
@@ -1161,19 +1480,24 @@ serial_fd_receive( Serial*  s, Packet*  p )
 static void
 serial_send( Serial*  s, Packet*  p )
 {
-    Packet*  h = packet_alloc();
-
     //D("sending to serial %d bytes from channel %d: '%.*s'", p->len, p->channel, p->len, p->data);
 
-    /* insert a small header before this packet */
-    h->len = HEADER_SIZE;
-    int2hex( p->len,     h->data + LENGTH_OFFSET,  LENGTH_SIZE );
-    int2hex( p->channel, h->data + CHANNEL_OFFSET, CHANNEL_SIZE );
+    /* the header is sent from the packet itself, before the payload */
+    p->hlen = HEADER_SIZE;
+    if (s->out_binary) {
+        p->header[0] = BINARY_MAGIC;
+        p->header[1] = (uint8_t) p->channel;
+        p->header[2] = (uint8_t) p->len;
+        p->header[3] = (uint8_t)(p->len >> 8);
+        p->header[4] = 0;
+        p->header[5] = 0;
+    } else {
+        int2hex( p->len,     p->header + LENGTH_OFFSET,  LENGTH_SIZE );
+        int2hex( p->channel, p->header + CHANNEL_OFFSET, CHANNEL_SIZE );
+    }
 
-    serial_dump( h, __FUNCTION__ );
     serial_dump( p, __FUNCTION__ );
 
-    fdhandler_enqueue( s->fdhandler, h );
     fdhandler_enqueue( s->fdhandler, p );
 }
 
@@ -1188,16 +1512,19 @@ serial_init( Serial*         s,
     Receiver  recv;
 
     recv.user  = s;
-    recv.post  = (PostFunc)  serial_fd_receive;
+    recv.post  = NULL;
     recv.close = (CloseFunc) serial_fd_close;
 
     s->receiver[0] = receiver[0];
 
     s->fdhandler = fdhandler_new( fd, list, &recv );
+    fdhandler_set_reader( s->fdhandler, (ReadFunc) serial_fd_read, s );
+
     s->in_len     = 0;
     s->in_datalen = 0;
     s->in_channel = 0;
-    s->in_packet  = packet_alloc();
+    s->in_packet  = NULL;
+    s->out_binary = 0;
 }
 
 
@@ -1234,16 +1561,44 @@ struct Client {
 
 struct Multiplexer {
     Client*        clients;
+    Client*        channels[MAX_CHANNELS];  /* clients indexed by channel */
     int            last_channel;
+    int            full_clients;  /* clients whose queue is over its high mark */
+    char           serial_full;   /* serial queue is over its high mark */
     Serial         serial[1];
     Looper         looper[1];
     FDHandlerList  fdhandlers[1];
 };
 
+/* outgoing queue limits, in bytes. when a client's queue reaches its high
+ * mark, reading from the serial port stops until it drains back to the
+ * low mark. when the serial queue reaches its high mark, reading from all
+ * clients stops in the same way.
+ */
+#define  CLIENT_HIGH_MARK   (64*1024)
+#define  CLIENT_LOW_MARK    (16*1024)
+#define  SERIAL_HIGH_MARK   (256*1024)
+#define  SERIAL_LOW_MARK    (64*1024)
+
 
 static int   multiplexer_open_channel( Multiplexer*  mult, Packet*  p );
 static void  multiplexer_close_channel( Multiplexer*  mult, int  channel );
 static void  multiplexer_serial_send( Multiplexer* mult, int  channel, Packet*  p );
+static void  multiplexer_client_flow( Multiplexer*  mult, int  full );
+
+/* change the channel of a client, -1 means none */
+static void
+client_set_channel( Client*  c, int  channel )
+{
+    Multiplexer*  mult = c->multiplexer;
+
+    if (c->channel >= 0 && mult->channels[c->channel] == c)
+        mult->channels[c->channel] = NULL;
+
+    c->channel = channel;
+    if (channel >= 0)
+        mult->channels[channel] = c;
+}
 
 static void
 client_dump( Client*  c, Packet*  p, const char*  funcname )
@@ -1262,7 +1617,12 @@ client_free( Client*  c )
     if (c->next)
         c->next->pref = c->pref;
 
-    c->channel    = -1;
+    if (c->fdhandler != NULL)
+        ALOGI("client %d closed: queue max %d packets / %d bytes, sent %d packets in %d writes, %d stalls",
+              c->channel, c->fdhandler->max_count, c->fdhandler->max_bytes,
+              c->fdhandler->sent_packets, c->fdhandler->sent_writes, c->fdhandler->full_count);
+
+    client_set_channel(c, -1);
     c->registered = 0;
 
     /* gently ask the FDHandler to shutdown to
@@ -1311,9 +1671,9 @@ client_fd_receive( Client*  c, Packet*  p )
      */
     D("%s: attempting registration for service '%.*s'",
       __FUNCTION__, p->len, p->data);
-    c->channel = multiplexer_open_channel(c->multiplexer, p);
+    client_set_channel(c, multiplexer_open_channel(c->multiplexer, p));
     if (c->channel < 0) {
-        D("%s: service name too long", __FUNCTION__);
+        D("%s: no channel for service", __FUNCTION__);
         goto BAD_CLIENT;
     }
     D("%s:    -> received channel id %d", __FUNCTION__, c->channel);
@@ -1344,7 +1704,7 @@ client_fd_close( Client*  c )
 static void
 client_registration( Client*  c, int  registered )
 {
-    Packet*  p = packet_alloc();
+    Packet*  p = packet_alloc(2);
 
     /* sends registration status to client */
     if (!registered) {
@@ -1364,7 +1724,7 @@ client_registration( Client*  c, int  registered )
     c->registered = registered;
     if (!registered) {
         /* allow the client to try registering another service */
-        c->channel = -1;
+        client_set_channel(c, -1);
     }
 }
 
@@ -1372,8 +1732,15 @@ client_registration( Client*  c, int  registered )
 static void
 client_send( Client*  c, Packet*  p )
 {
+    FDHandler*  f = c->fdhandler;
+    char        was_full = f->full;
+
     client_dump(c, p, __FUNCTION__);
-    fdhandler_enqueue(c->fdhandler, p);
+    fdhandler_enqueue(f, p);
+
+    if (f->full && !was_full)
+        ALOGW("client %d stalled: %d packets / %d bytes queued, pausing serial reads (stall %d)",
+              c->channel, f->out_count, f->out_bytes, f->full_count);
 }
 
 
@@ -1400,6 +1767,12 @@ client_new( Multiplexer*    mult,
     recv.close = (CloseFunc) client_fd_close;
 
     c->fdhandler = fdhandler_new( fd, pfdhandlers, &recv );
+    fdhandler_set_flow( c->fdhandler, CLIENT_HIGH_MARK, CLIENT_LOW_MARK,
+                        (FlowFunc) multiplexer_client_flow, mult );
+
+    /* don't read from new clients while the serial queue is full */
+    if (mult->serial_full)
+        looper_disable( pfdhandlers->looper, fd, EPOLLIN );
 
     /* add to client list */
     c->next   = *pclients;
@@ -1414,17 +1787,58 @@ client_new( Multiplexer*    mult,
 /**  GLOBAL MULTIPLEXER
  **/
 
+/* called when a client's outgoing queue goes over its high mark, or back
+ * under its low mark. the serial port carries all channels and can't be
+ * paused for a single one, so reading from it stops entirely until every
+ * client has caught up again. this trades some head-of-line blocking for
+ * bounded memory usage when a client doesn't read its socket.
+ */
+static void
+multiplexer_client_flow( Multiplexer*  mult, int  full )
+{
+    int  serial_fd = mult->serial->fdhandler->fd;
+
+    if (full) {
+        if (mult->full_clients++ == 0) {
+            D("%s: pausing serial reads", __FUNCTION__);
+            looper_disable( mult->looper, serial_fd, EPOLLIN );
+        }
+    } else {
+        if (--mult->full_clients == 0) {
+            D("%s: resuming serial reads", __FUNCTION__);
+            looper_enable( mult->looper, serial_fd, EPOLLIN );
+        }
+    }
+}
+
+/* called when the serial outgoing queue goes over its high mark, or back
+ * under its low mark. reading from clients stops in between.
+ */
+static void
+multiplexer_serial_flow( Multiplexer*  mult, int  full )
+{
+    Client*  c;
+
+    D("%s: %s client reads", __FUNCTION__, full ? "pausing" : "resuming");
+    mult->serial_full = full;
+    for (c = mult->clients; c != NULL; c = c->next) {
+        if (c->fdhandler == NULL)
+            continue;
+        if (full)
+            looper_disable( mult->looper, c->fdhandler->fd, EPOLLIN );
+        else
+            looper_enable( mult->looper, c->fdhandler->fd, EPOLLIN );
+    }
+}
+
 /* find a client by its channel */
 static Client*
 multiplexer_find_client( Multiplexer*  mult, int  channel )
 {
-    Client* c = mult->clients;
+    if (channel < 0 || channel >= MAX_CHANNELS)
+        return NULL;
 
-    for ( ; c != NULL; c = c->next ) {
-        if (c->channel == channel)
-            return c;
-    }
-    return NULL;
+    return mult->channels[channel];
 }
 
 /* handle control messages coming from the serial port
@@ -1471,6 +1885,15 @@ multiplexer_handle_control( Multiplexer*  mult, Packet*  p )
         goto EXIT;
     }
 
+    /* the emulator understands binary framing headers, use them
+     * from now on. See the SERIAL CONNECTION STATE section.
+     */
+    if (p->len == 17 && !memcmp(p->data, "ok:framing:binary", 17)) {
+        D("%s: switching to binary framing", __FUNCTION__);
+        mult->serial->out_binary = 1;
+        goto EXIT;
+    }
+
     /* A message that begins with "X00" is a probe sent by
      * the emulator used to detect which version of qemud it runs
      * against (in order to detect 1.0/1.1 system images. Just
@@ -1540,24 +1963,25 @@ multiplexer_serial_send( Multiplexer*  mult, int  channel, Packet*  p )
 static int
 multiplexer_open_channel( Multiplexer*  mult, Packet*  service )
 {
-    Packet*   p = packet_alloc();
-    int       len, channel;
-
-    /* find a free channel number, assume we don't have many
-     * clients here. */
-    {
-        Client*  c;
-    TRY_AGAIN:
-        channel = (++mult->last_channel) & 0xff;
-
-        for (c = mult->clients; c != NULL; c = c->next)
-            if (c->channel == channel)
-                goto TRY_AGAIN;
+    Packet*   p;
+    int       len, channel, n;
+
+    /* find a free channel number, the control channel excluded */
+    for (n = 0; n < MAX_CHANNELS; n++) {
+        channel = (++mult->last_channel) & (MAX_CHANNELS-1);
+        if (channel != CHANNEL_CONTROL && mult->channels[channel] == NULL)
+            break;
+    }
+    if (n == MAX_CHANNELS) {
+        D("%s: no free channel", __FUNCTION__);
+        return -1;
     }
 
-    len = snprintf((char*)p->data, sizeof p->data, "connect:%.*s:%02x", service->len, service->data, channel);
-    if (len >= (int)sizeof(p->data)) {
-        D("%s: weird, service name too long (%d > %d)", __FUNCTION__, len, sizeof(p->data));
+    p = packet_alloc(MAX_PAYLOAD);
+
+    len = snprintf((char*)p->data, p->capacity, "connect:%.*s:%02x", service->len, service->data, channel);
+    if (len >= p->capacity) {
+        D("%s: weird, service name too long (%d > %d)", __FUNCTION__, len, p->capacity);
         packet_free(&p);
         return -1;
     }
@@ -1572,11 +1996,12 @@ multiplexer_open_channel( Multiplexer*  mult, Packet*  service )
 static void
 multiplexer_close_channel( Multiplexer*  mult, int  channel )
 {
-    Packet*  p   = packet_alloc();
-    int      len = snprintf((char*)p->data, sizeof(p->data), "disconnect:%02x", channel);
+    Packet*  p   = packet_alloc(16);
+    int      len = snprintf((char*)p->data, p->capacity, "disconnect:%02x", channel);
 
-    if (len > (int)sizeof(p->data)) {
+    if (len >= p->capacity) {
         /* should not happen */
+        packet_free(&p);
         return;
     }
 
@@ -1586,6 +2011,22 @@ multiplexer_close_channel( Multiplexer*  mult, int  channel )
     serial_send(mult->serial, p);
 }
 
+/* ask the emulator whether it understands binary framing headers,
+ * the answer is handled in multiplexer_handle_control().
+ */
+static void
+multiplexer_negotiate_framing( Multiplexer*  mult )
+{
+    static const char  request[] = "framing:binary";
+    Packet*            p = packet_alloc(sizeof(request)-1);
+
+    memcpy( p->data, request, sizeof(request)-1 );
+    p->len     = sizeof(request)-1;
+    p->channel = CHANNEL_CONTROL;
+
+    serial_send(mult->serial, p);
+}
+
 /* this function is used when a new connection happens on the control
  * socket.
  */
@@ -1610,15 +2051,47 @@ multiplexer_control_close( Multiplexer*  m )
 }
 
 static void
-multiplexer_init( Multiplexer*  m, const char*  serial_dev )
+multiplexer_init_fds( Multiplexer*  m, int  serial_fd, int  control_fd )
 {
-    int       fd, control_fd;
     Receiver  recv;
 
     /* initialize looper and fdhandlers list */
     looper_init( m->looper );
     fdhandler_list_init( m->fdhandlers, m->looper );
 
+    /* initialize the serial reader/writer */
+    recv.user  = m;
+    recv.post  = (PostFunc)  multiplexer_serial_receive;
+    recv.close = (CloseFunc) multiplexer_serial_close;
+
+    serial_init( m->serial, serial_fd, m->fdhandlers, &recv );
+
+    m->full_clients = 0;
+    m->serial_full  = 0;
+    fdhandler_set_flow( m->serial->fdhandler, SERIAL_HIGH_MARK, SERIAL_LOW_MARK,
+                        (FlowFunc) multiplexer_serial_flow, m );
+
+    /* monitor the qemud control socket, if any */
+    if (control_fd >= 0) {
+        recv.user  = m;
+        recv.post  = (PostFunc)  multiplexer_control_accept;
+        recv.close = (CloseFunc) multiplexer_control_close;
+
+        fdhandler_new_accept( control_fd, m->fdhandlers, &recv );
+    }
+
+    /* initialize clients list */
+    m->clients = NULL;
+    memset( m->channels, 0, sizeof(m->channels) );
+
+    multiplexer_negotiate_framing( m );
+}
+
+static void
+multiplexer_init( Multiplexer*  m, const char*  serial_dev )
+{
+    int  fd, control_fd;
+
     /* open the serial port */
     do {
         fd = open(serial_dev, O_RDWR);
@@ -1636,32 +2109,23 @@ multiplexer_init( Multiplexer*  m, const char*  serial_dev )
         tcsetattr( fd, TCSANOW, &ios );
     }
 
-    /* initialize the serial reader/writer */
-    recv.user  = m;
-    recv.post  = (PostFunc)  multiplexer_serial_receive;
-    recv.close = (CloseFunc) multiplexer_serial_close;
-
-    serial_init( m->serial, fd, m->fdhandlers, &recv );
-
     /* open the qemud control socket */
-    recv.user  = m;
-    recv.post  = (PostFunc)  multiplexer_control_accept;
-    recv.close = (CloseFunc) multiplexer_control_close;
-
-    fd = android_get_control_socket(CONTROL_SOCKET_NAME);
-    if (fd < 0) {
+    control_fd = android_get_control_socket(CONTROL_SOCKET_NAME);
+    if (control_fd < 0) {
         fatal("couldn't get fd for control socket '%s'", CONTROL_SOCKET_NAME);
     }
 
-    fdhandler_new_accept( fd, m->fdhandlers, &recv );
-
-    /* initialize clients list */
-    m->clients = NULL;
+    multiplexer_init_fds( m, fd, control_fd );
 }
 
 /** MAIN LOOP
  **/
 
+/* qemud_benchmark.c includes this file to run the multiplexer over
+ * socket pairs, and provides its own main()
+ */
+#ifndef QEMUD_NO_MAIN
+
 static Multiplexer  _multiplexer[1];
 
 int  main( void )
@@ -1717,3 +2181,4 @@ int  main( void )
     D( "unexpected termination !!" );
     return 0;
 }
+#endif /* !QEMUD_NO_MAIN */
@@ -0,0 +1,529 @@
+/* Loopback throughput benchmark for the qemud multiplexer.
+ *
+ * The multiplexer from qemud.c runs in a child process, with a socket
+ * pair in place of the serial port and one socket pair per client in
+ * place of the accepted /dev/socket/qemud connections. The parent
+ * process plays both the emulator, on the other end of the serial
+ * socket pair, and the clients.
+ *
+ * For each framing mode (hex headers, or binary headers negotiated at
+ * startup) and payload size, the benchmark measures the throughput of
+ * emulator -> clients and clients -> emulator transfers.
+ *
+ * Idle clients can be registered next to the active ones, to check that
+ * the cost of an event doesn't depend on the number of connections.
+ *
+ * usage: qemud-benchmark [megabytes-per-run [num-clients [idle-clients]]]
+ */
+
+#define  QEMUD_NO_MAIN
+#include "qemud.c"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define  BENCH_SERVICE      "bench"
+#define  BENCH_MAX_CLIENTS  (MAX_CHANNELS-1)  /* all but the control channel */
+
+static const int  _bench_sizes[] = { 64, 1024, MAX_PAYLOAD };
+
+static double
+bench_now( void )
+{
+    struct timespec  ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* wait until a non-blocking fd is ready */
+static void
+bench_wait( int  fd, int  events )
+{
+    struct pollfd  pfd;
+
+    pfd.fd     = fd;
+    pfd.events = events;
+    while (poll( &pfd, 1, -1 ) < 0 && errno == EINTR)
+        ;
+}
+
+static void
+bench_setnonblock( int  fd )
+{
+    int  flags = fcntl( fd, F_GETFL );
+    if (flags < 0 || fcntl( fd, F_SETFL, flags | O_NONBLOCK ) < 0)
+        fatal( "%s: %s", __FUNCTION__, strerror(errno) );
+}
+
+/* write a whole buffer, waiting for room as needed */
+static void
+bench_write( int  fd, const void*  data, int  len )
+{
+    const uint8_t*  p = data;
+
+    while (len > 0) {
+        int  ret = write( fd, p, len );
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                bench_wait( fd, POLLOUT );
+                continue;
+            }
+            fatal( "%s: %s", __FUNCTION__, strerror(errno) );
+        }
+        p   += ret;
+        len -= ret;
+    }
+}
+
+/* read a whole buffer, waiting for data as needed */
+static void
+bench_read( int  fd, void*  data, int  len )
+{
+    uint8_t*  p = data;
+
+    while (len > 0) {
+        int  ret = read( fd, p, len );
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                bench_wait( fd, POLLIN );
+                continue;
+            }
+            fatal( "%s: %s", __FUNCTION__, strerror(errno) );
+        }
+        if (ret == 0)
+            fatal( "%s: unexpected end of stream", __FUNCTION__ );
+        p   += ret;
+        len -= ret;
+    }
+}
+
+/* frame a serial packet the way the emulator does */
+static int
+bench_frame( uint8_t*  to, int  channel, const void*  data, int  len,
+             int  binary )
+{
+    if (binary) {
+        to[0] = BINARY_MAGIC;
+        to[1] = (uint8_t) channel;
+        to[2] = (uint8_t) len;
+        to[3] = (uint8_t)(len >> 8);
+        to[4] = 0;
+        to[5] = 0;
+    } else {
+        int2hex( channel, to + CHANNEL_OFFSET, CHANNEL_SIZE );
+        int2hex( len,     to + LENGTH_OFFSET,  LENGTH_SIZE );
+    }
+    memcpy( to + HEADER_SIZE, data, len );
+    return HEADER_SIZE + len;
+}
+
+/* read one framed serial packet sent by qemud, in either format.
+ * returns the payload length. */
+static int
+bench_read_frame( int  fd, int*  channel, uint8_t*  data )
+{
+    uint8_t  h[HEADER_SIZE];
+    int      len;
+
+    bench_read( fd, h, HEADER_SIZE );
+    if (h[0] == BINARY_MAGIC) {
+        *channel = h[1];
+        len      = h[2] | (h[3] << 8);
+    } else {
+        *channel = hex2int( h + CHANNEL_OFFSET, CHANNEL_SIZE );
+        len      = hex2int( h + LENGTH_OFFSET,  LENGTH_SIZE );
+    }
+    if (len < 0 || *channel < 0)
+        fatal( "%s: malformed header", __FUNCTION__ );
+
+    bench_read( fd, data, len );
+    return len;
+}
+
+static void
+bench_send_control( int  fd, const char*  msg, int  binary )
+{
+    uint8_t  buff[HEADER_SIZE + 64];
+    int      len = bench_frame( buff, CHANNEL_CONTROL, msg, strlen(msg), binary );
+    bench_write( fd, buff, len );
+}
+
+typedef struct {
+    int  serial_fd;
+    int  client_fds[BENCH_MAX_CLIENTS];
+    int  channels[BENCH_MAX_CLIENTS];
+    int  num_clients;  /* active clients, first in the arrays */
+    int  num_total;    /* active + idle clients */
+    int  binary;
+    pid_t  pid;
+} Bench;
+
+/* start a multiplexer in a child process, then perform the framing
+ * negotiation and register the clients like the emulator would */
+static void
+bench_start( Bench*  b, int  num_clients, int  num_idle, int  binary )
+{
+    int      serial[2], n;
+    int      num_total = num_clients + num_idle;
+    int      qemud_fds[BENCH_MAX_CLIENTS];
+    uint8_t  data[MAX_SERIAL_PAYLOAD];
+    int      channel, len;
+
+    if (socketpair( AF_UNIX, SOCK_STREAM, 0, serial ) < 0)
+        fatal( "socketpair: %s", strerror(errno) );
+
+    for (n = 0; n < num_total; n++) {
+        int  pair[2];
+        if (socketpair( AF_UNIX, SOCK_STREAM, 0, pair ) < 0)
+            fatal( "socketpair: %s", strerror(errno) );
+        b->client_fds[n] = pair[0];
+        qemud_fds[n]     = pair[1];
+    }
+    b->num_clients = num_clients;
+    b->num_total   = num_total;
+    b->binary      = binary;
+    b->serial_fd   = serial[0];
+
+    b->pid = fork();
+    if (b->pid < 0)
+        fatal( "fork: %s", strerror(errno) );
+
+    if (b->pid == 0) {
+        Multiplexer*  m = xalloc0(sizeof(*m));
+
+        close( serial[0] );
+        for (n = 0; n < num_total; n++)
+            close( b->client_fds[n] );
+
+        multiplexer_init_fds( m, serial[1], -1 );
+        for (n = 0; n < num_total; n++)
+            client_new( m, qemud_fds[n], m->fdhandlers, &m->clients );
+
+        looper_loop( m->looper );
+        _exit(0);
+    }
+
+    close( serial[1] );
+    bench_setnonblock( b->serial_fd );
+    for (n = 0; n < num_total; n++) {
+        close( qemud_fds[n] );
+        bench_setnonblock( b->client_fds[n] );
+    }
+
+    /* framing negotiation */
+    len = bench_read_frame( b->serial_fd, &channel, data );
+    if (channel != CHANNEL_CONTROL || len != 14 ||
+        memcmp( data, "framing:binary", 14 ))
+        fatal( "%s: unexpected framing request", __FUNCTION__ );
+
+    bench_send_control( b->serial_fd,
+                        binary ? "ok:framing:binary" : "ko:unknown command",
+                        0 );
+
+    /* client registration, one at a time so channels match clients */
+    for (n = 0; n < num_total; n++) {
+        char  reply[32];
+        char  status[2];
+
+        bench_write( b->client_fds[n], BENCH_SERVICE,
+                     sizeof(BENCH_SERVICE)-1 );
+
+        len = bench_read_frame( b->serial_fd, &channel, data );
+        if (channel != CHANNEL_CONTROL ||
+            len != (int)sizeof("connect:" BENCH_SERVICE ":00")-1 ||
+            memcmp( data, "connect:" BENCH_SERVICE ":", 14 ))
+            fatal( "%s: unexpected connect request", __FUNCTION__ );
+
+        b->channels[n] = hex2int( data + 14, 2 );
+        snprintf( reply, sizeof(reply), "ok:connect:%02x", b->channels[n] );
+        bench_send_control( b->serial_fd, reply, binary );
+
+        bench_read( b->client_fds[n], status, 2 );
+        if (memcmp( status, "OK", 2 ))
+            fatal( "%s: client registration failed", __FUNCTION__ );
+    }
+}
+
+static void
+bench_stop( Bench*  b )
+{
+    int  n;
+
+    kill( b->pid, SIGKILL );
+    waitpid( b->pid, NULL, 0 );
+
+    close( b->serial_fd );
+    for (n = 0; n < b->num_total; n++)
+        close( b->client_fds[n] );
+}
+
+/* send 'total' bytes to each client through the serial port, in packets
+ * of 'size' bytes, and return the elapsed time */
+static double
+bench_to_clients( Bench*  b, int  size, long  total )
+{
+    int            n, npackets = total / size;
+    long           remaining = (long)npackets * size * b->num_clients;
+    int            sent = 0;
+    uint8_t*       frame = xalloc( (HEADER_SIZE + size) * b->num_clients );
+    int            frame_len = 0, frame_pos = 0;
+    uint8_t        payload[MAX_PAYLOAD];
+    uint8_t        sink[65536];
+    struct pollfd  fds[BENCH_MAX_CLIENTS + 1];
+    double         start = bench_now();
+
+    memset( payload, 0x5a, sizeof(payload) );
+
+    while (remaining > 0) {
+        /* one packet per client in each serial write */
+        if (frame_pos == frame_len && sent < npackets) {
+            frame_len = 0;
+            for (n = 0; n < b->num_clients; n++)
+                frame_len += bench_frame( frame + frame_len, b->channels[n],
+                                          payload, size, b->binary );
+            frame_pos = 0;
+            sent++;
+        }
+
+        for (n = 0; n < b->num_clients; n++) {
+            fds[n].fd     = b->client_fds[n];
+            fds[n].events = POLLIN;
+        }
+        fds[n].fd     = b->serial_fd;
+        fds[n].events = (frame_pos < frame_len) ? POLLOUT : 0;
+
+        if (poll( fds, b->num_clients + 1, -1 ) < 0) {
+            if (errno == EINTR)
+                continue;
+            fatal( "poll: %s", strerror(errno) );
+        }
+
+        for (n = 0; n < b->num_clients; n++) {
+            if (fds[n].revents & POLLIN) {
+                int  ret = read( b->client_fds[n], sink, sizeof(sink) );
+                if (ret <= 0)
+                    fatal( "%s: client read failed", __FUNCTION__ );
+                remaining -= ret;
+            }
+        }
+        if (fds[n].revents & POLLOUT) {
+            int  ret = write( b->serial_fd, frame + frame_pos,
+                              frame_len - frame_pos );
+            if (ret < 0 && errno != EINTR && errno != EAGAIN)
+                fatal( "%s: serial write failed", __FUNCTION__ );
+            if (ret > 0)
+                frame_pos += ret;
+        }
+    }
+
+    free( frame );
+    return bench_now() - start;
+}
+
+/* send 'total' bytes from each client in writes of 'size' bytes, and
+ * return the elapsed time once the emulator side received everything */
+static double
+bench_from_clients( Bench*  b, int  size, long  total )
+{
+    int            n;
+    long           to_send[BENCH_MAX_CLIENTS];
+    long           remaining = total * b->num_clients;
+    uint8_t        payload[MAX_PAYLOAD];
+    uint8_t        data[MAX_SERIAL_PAYLOAD];
+    struct pollfd  fds[BENCH_MAX_CLIENTS + 1];
+    double         start = bench_now();
+
+    memset( payload, 0xa5, sizeof(payload) );
+    for (n = 0; n < b->num_clients; n++)
+        to_send[n] = total;
+
+    while (remaining > 0) {
+        for (n = 0; n < b->num_clients; n++) {
+            fds[n].fd     = b->client_fds[n];
+            fds[n].events = (to_send[n] > 0) ? POLLOUT : 0;
+        }
+        fds[n].fd     = b->serial_fd;
+        fds[n].events = POLLIN;
+
+        if (poll( fds, b->num_clients + 1, -1 ) < 0) {
+            if (errno == EINTR)
+                continue;
+            fatal( "poll: %s", strerror(errno) );
+        }
+
+        for (n = 0; n < b->num_clients; n++) {
+            if (fds[n].revents & POLLOUT) {
+                int  len = (to_send[n] < size) ? (int)to_send[n] : size;
+                int  ret = write( b->client_fds[n], payload, len );
+                if (ret < 0 && errno != EINTR && errno != EAGAIN)
+                    fatal( "%s: client write failed", __FUNCTION__ );
+                if (ret > 0)
+                    to_send[n] -= ret;
+            }
+        }
+        if (fds[n].revents & POLLIN) {
+            int  channel;
+            remaining -= bench_read_frame( b->serial_fd, &channel, data );
+        }
+    }
+
+    return bench_now() - start;
+}
+
+/* send packets to a client that doesn't read its socket, until qemud
+ * stops reading the serial port. then let the client catch up and check
+ * that everything is delivered. returns the number of bytes that were
+ * accepted before the serial port stalled */
+static long
+bench_stalled_client( Bench*  b, int  size )
+{
+    uint8_t        frame[HEADER_SIZE + MAX_PAYLOAD];
+    uint8_t        payload[MAX_PAYLOAD];
+    uint8_t        sink[65536];
+    int            frame_len, frame_pos = 0;
+    long           accepted = 0, received = 0;
+    struct pollfd  pfd;
+
+    memset( payload, 0x3c, sizeof(payload) );
+    frame_len = bench_frame( frame, b->channels[0], payload, size, b->binary );
+
+    /* fill until the serial port doesn't drain for 200ms */
+    for (;;) {
+        int  ret;
+
+        pfd.fd     = b->serial_fd;
+        pfd.events = POLLOUT;
+        ret = poll( &pfd, 1, 200 );
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        if (accepted > 16 * CLIENT_HIGH_MARK)
+            fatal( "%s: serial port never paused", __FUNCTION__ );
+
+        ret = write( b->serial_fd, frame + frame_pos, frame_len - frame_pos );
+        if (ret < 0 && errno != EINTR && errno != EAGAIN)
+            fatal( "%s: serial write failed", __FUNCTION__ );
+        if (ret > 0) {
+            frame_pos += ret;
+            if (frame_pos == frame_len) {
+                frame_pos = 0;
+                accepted += size;
+            }
+        }
+    }
+
+    /* finish the current frame, then drain the client */
+    while (frame_pos > 0 || received < accepted) {
+        struct pollfd  fds[2];
+
+        fds[0].fd     = b->client_fds[0];
+        fds[0].events = POLLIN;
+        fds[1].fd     = b->serial_fd;
+        fds[1].events = (frame_pos > 0) ? POLLOUT : 0;
+
+        if (poll( fds, 2, 5000 ) <= 0)
+            fatal( "%s: client stream stalled", __FUNCTION__ );
+
+        if (fds[0].revents & POLLIN) {
+            int  ret = read( b->client_fds[0], sink, sizeof(sink) );
+            if (ret <= 0)
+                fatal( "%s: client read failed", __FUNCTION__ );
+            received += ret;
+        }
+        if (fds[1].revents & POLLOUT) {
+            int  ret = write( b->serial_fd, frame + frame_pos,
+                              frame_len - frame_pos );
+            if (ret > 0) {
+                frame_pos += ret;
+                if (frame_pos == frame_len) {
+                    frame_pos = 0;
+                    accepted += size;
+                }
+            }
+        }
+    }
+    if (received != accepted)
+        fatal( "%s: received %ld bytes, expected %ld", __FUNCTION__,
+               received, accepted );
+
+    return accepted;
+}
+
+static void
+bench_report( const char*  what, int  size, int  num_clients, long  total,
+              double  seconds )
+{
+    double  mb = (double)total * num_clients / (1024. * 1024.);
+
+    printf( "  %-16s %5d bytes: %8.1f MB/s %10.0f packets/s\n",
+            what, size, mb / seconds,
+            (double)total * num_clients / size / seconds );
+}
+
+int
+main( int  argc, char**  argv )
+{
+    long  total = 16L * 1024 * 1024;
+    int   num_clients = 4;
+    int   num_idle = 0;
+    int   binary, n;
+
+    if (argc > 1)
+        total = atol(argv[1]) * 1024L * 1024L;
+    if (argc > 2)
+        num_clients = atoi(argv[2]);
+    if (argc > 3)
+        num_idle = atoi(argv[3]);
+
+    if (total <= 0 || num_clients <= 0 || num_idle < 0 ||
+        num_clients + num_idle > BENCH_MAX_CLIENTS) {
+        fprintf( stderr, "usage: %s [megabytes-per-run [num-clients [idle-clients]]]\n"
+                         "       with at most %d clients in total\n",
+                 argv[0], BENCH_MAX_CLIENTS );
+        return 1;
+    }
+
+    signal( SIGPIPE, SIG_IGN );
+
+    for (binary = 0; binary < 2; binary++) {
+        printf( "%s framing, %d clients (+%d idle), %ld MB per client:\n",
+                binary ? "binary" : "hex", num_clients, num_idle,
+                total / (1024 * 1024) );
+
+        for (n = 0; n < (int)(sizeof(_bench_sizes)/sizeof(_bench_sizes[0])); n++) {
+            int     size = _bench_sizes[n];
+            long    run_total = (total / size) * size;
+            Bench   b;
+            double  t;
+
+            bench_start( &b, num_clients, num_idle, binary );
+            t = bench_to_clients( &b, size, run_total );
+            bench_report( "emulator->client", size, num_clients, run_total, t );
+            bench_stop( &b );
+
+            bench_start( &b, num_clients, num_idle, binary );
+            t = bench_from_clients( &b, size, run_total );
+            bench_report( "client->emulator", size, num_clients, run_total, t );
+            bench_stop( &b );
+        }
+
+        {
+            Bench  b;
+            long   accepted;
+
+            bench_start( &b, 1, num_idle, binary );
+            accepted = bench_stalled_client( &b, MAX_PAYLOAD );
+            printf( "  stalled client: serial paused after %ld KB\n",
+                    accepted / 1024 );
+            bench_stop( &b );
+        }
+    }
+    return 0;
+}
@@ -28,3 +28,13 @@ else
 LOCAL_MODULE := sensors.goldfish
 endif
 include $(BUILD_SHARED_LIBRARY)
+
+# Event delivery benchmark, feeds the HAL's poll() through a socket pair.
+# See sensors_benchmark.c.
+#
+include $(CLEAR_VARS)
+LOCAL_MODULE := sensors-benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+LOCAL_SRC_FILES := sensors_benchmark.c
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Event delivery benchmark for the sensors HAL.
+ *
+ * A child process plays the emulator and writes sensor updates for the
+ * accelerometer, magnetic field and orientation sensors, each followed by
+ * a sync, to one end of a socket pair. The HAL's poll() reads them from
+ * the other end, with the same code that reads the qemud channel.
+ *
+ * Each run is repeated with text and binary messages, and with poll()
+ * asked for a single event at a time or for a full array of events.
+ *
+ * usage: sensors-benchmark [num-syncs]
+ */
+
+#include "sensors_qemu.c"
+
+#include <stdio.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define  BENCH_SENSORS     3   /* sensor updates per sync */
+#define  BENCH_BATCH       64  /* syncs per write from the emulator */
+
+static double
+bench_now(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* append a qemud channel message to 'buff', returns its new size */
+static int
+bench_message(char*  buff, int  pos, const void*  msg, int  len)
+{
+    char  header[MSG_HEADER_SIZE+1];
+
+    snprintf(header, sizeof header, "%04x", len);
+    memcpy(buff + pos, header, MSG_HEADER_SIZE);
+    memcpy(buff + pos + MSG_HEADER_SIZE, msg, len);
+    return pos + MSG_HEADER_SIZE + len;
+}
+
+/* append the messages of a single sync period */
+static int
+bench_sync(char*  buff, int  pos, int  binary, int64_t  time_us)
+{
+    static const float  values[BENCH_SENSORS][3] = {
+        { 0.12f, 9.78f, 0.81f },
+        { 22.5f, -5.25f, -43.1f },
+        { 12.0f, -3.5f, 1.25f },
+    };
+    static const int  ids[BENCH_SENSORS] = {
+        ID_ACCELERATION, ID_MAGNETIC_FIELD, ID_ORIENTATION
+    };
+    static const char*  names[BENCH_SENSORS] = {
+        "acceleration", "magnetic", "orientation"
+    };
+    char  msg[128];
+    int   nn, len;
+
+    if (binary) {
+        len = 0;
+        for (nn = 0; nn < BENCH_SENSORS; nn++) {
+            msg[len++] = BINARY_SENSOR + ids[nn] - ID_BASE;
+            msg[len++] = 3;
+            memcpy(msg + len, values[nn], sizeof(values[nn]));
+            len += sizeof(values[nn]);
+        }
+        msg[len++] = (char)BINARY_SYNC;
+        memcpy(msg + len, &time_us, sizeof(time_us));
+        len += sizeof(time_us);
+        return bench_message(buff, pos, msg, len);
+    }
+
+    for (nn = 0; nn < BENCH_SENSORS; nn++) {
+        len = snprintf(msg, sizeof msg, "%s:%g:%g:%g", names[nn],
+                       values[nn][0], values[nn][1], values[nn][2]);
+        pos = bench_message(buff, pos, msg, len);
+    }
+    len = snprintf(msg, sizeof msg, "sync:%lld", (long long)time_us);
+    return bench_message(buff, pos, msg, len);
+}
+
+/* write 'num_syncs' sync periods to 'fd', BENCH_BATCH at a time */
+static void
+bench_feed(int  fd, int  binary, int  num_syncs)
+{
+    static char  buff[BENCH_BATCH * 256];
+    int64_t      time_us = 1000;
+    int          sent = 0;
+
+    while (sent < num_syncs) {
+        int  pos = 0, nn, done = 0;
+
+        for (nn = 0; nn < BENCH_BATCH && sent < num_syncs; nn++, sent++) {
+            pos = bench_sync(buff, pos, binary, time_us);
+            time_us += 5000;  /* 200 Hz */
+        }
+        while (done < pos) {
+            int  ret = write(fd, buff + done, pos - done);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+                return;
+            done += ret;
+        }
+    }
+}
+
+/* run a single benchmark, returns 0 on success */
+static int
+bench_run(int  binary, int  count, int  num_syncs)
+{
+    struct hw_device_t*            device;
+    struct sensors_poll_device_t*  dev;
+    native_handle_t*               handle;
+    sensors_event_t                events[16];
+    int                            sv[2];
+    long                           expected = (long)num_syncs * BENCH_SENSORS;
+    long                           received = 0, calls = 0;
+    double                         start, elapsed;
+    pid_t                          pid;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        fprintf(stderr, "socketpair: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (open_sensors(&HAL_MODULE_INFO_SYM.common, SENSORS_HARDWARE_POLL,
+                     &device) != 0) {
+        fprintf(stderr, "could not open the sensors device\n");
+        return -1;
+    }
+    dev = (struct sensors_poll_device_t*)device;
+
+    /* hand our end of the socket pair to the HAL, in place of the
+     * qemud channel */
+    handle = native_handle_create(1, 0);
+    handle->data[0] = sv[0];
+    data__data_open(dev, handle);
+
+    pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "fork: %s\n", strerror(errno));
+        return -1;
+    }
+    if (pid == 0) {
+        close(((SensorPoll*)dev)->events_fd);
+        bench_feed(sv[1], binary, num_syncs);
+        _exit(0);
+    }
+    close(sv[1]);
+
+    start = bench_now();
+    while (received < expected) {
+        int  ret = dev->poll(dev, events, count);
+        if (ret <= 0) {
+            fprintf(stderr, "poll failed after %ld events\n", received);
+            break;
+        }
+        received += ret;
+        calls    += 1;
+    }
+    elapsed = bench_now() - start;
+
+    waitpid(pid, NULL, 0);
+    dev->common.close(&dev->common);
+
+    printf("  %-6s count=%-2d %10.0f events/s %6.2f events/poll\n",
+           binary ? "binary" : "text", count, received / elapsed,
+           calls ? (double)received / calls : 0.);
+
+    return (received == expected) ? 0 : -1;
+}
+
+int
+main(int  argc, char**  argv)
+{
+    int  num_syncs = 200000;
+    int  binary, status = 0;
+
+    if (argc > 1)
+        num_syncs = atoi(argv[1]);
+
+    if (num_syncs <= 0) {
+        fprintf(stderr, "usage: %s [num-syncs]\n", argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("%d syncs of %d sensors:\n", num_syncs, BENCH_SENSORS);
+    for (binary = 0; binary < 2; binary++) {
+        status |= bench_run(binary, 1, num_syncs);
+        status |= bench_run(binary, 16, num_syncs);
+    }
+    return status ? 1 : 0;
+}
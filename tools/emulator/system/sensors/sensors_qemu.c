@@ -32,6 +32,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <cutils/log.h>
 #include <cutils/native_handle.h>
@@ -111,6 +112,64 @@ _sensorIdFromName( const char*  name )
     return -1;
 }
 
+/** SENSORS MESSAGES
+ **
+ ** The emulator sends one message per sensor value, followed
+ ** by a "sync:<time>" message once all sensors were updated.
+ ** Messages are text by default:
+ **
+ **   acceleration:<x>:<y>:<z>
+ **   magnetic:<x>:<y>:<z>
+ **   orientation:<azimuth>:<pitch>:<roll>
+ **   temperature:<celsius>
+ **   proximity:<value>
+ **   sync:<time>                time in micro-seconds
+ **   wake                       only used to exit a poll() call
+ **
+ ** After we send "set-format:binary", the emulator can also send
+ ** all values of a sync period as a single message of packed
+ ** records, with little-endian values:
+ **
+ **   0x80+<sensor> <count> <float32 x count>
+ **   0xff <int64 time>          must be the last record
+ **
+ ** Both formats can be mixed, since text messages never start
+ ** with a byte >= 0x80.
+ **/
+
+#define  MSG_SENSOR   0
+#define  MSG_SYNC     1
+#define  MSG_WAKE     2
+
+/* text messages, keyed on the text before the first ':' */
+static const struct {
+    const char*  prefix;
+    int          prefixlen;
+    int          type;
+    int          id;
+    int          count;  /* number of float values */
+} _sensorMessages[] =
+{
+#define MSG_(prefix,type,id,count)  { prefix, sizeof(prefix)-1, type, id, count },
+    MSG_("acceleration", MSG_SENSOR, ID_ACCELERATION, 3)
+    MSG_("magnetic", MSG_SENSOR, ID_MAGNETIC_FIELD, 3)
+    MSG_("orientation", MSG_SENSOR, ID_ORIENTATION, 3)
+    MSG_("temperature", MSG_SENSOR, ID_TEMPERATURE, 1)
+    MSG_("proximity", MSG_SENSOR, ID_PROXIMITY, 1)
+    MSG_("sync", MSG_SYNC, -1, 0)
+    MSG_("wake", MSG_WAKE, -1, 0)
+#undef  MSG_
+};
+
+#define  NUM_SENSOR_MESSAGES  (int)(sizeof(_sensorMessages)/sizeof(_sensorMessages[0]))
+
+#define  BINARY_SENSOR     0x80
+#define  BINARY_SYNC       0xff
+
+/* qemud channel messages start with their payload size in 4 hex digits */
+#define  MSG_HEADER_SIZE   4
+#define  MSG_BUFFER_SIZE   4096
+
 /** SENSORS POLL DEVICE
  **
  ** This one is used to read sensor data from the hardware.
@@ -122,11 +181,19 @@ typedef struct SensorPoll {
     struct sensors_poll_device_t  device;
     sensors_event_t               sensors[MAX_NUM_SENSORS];
     int                           events_fd;
-    uint32_t                      pendingSensors;
+    uint32_t                      pendingSensors;  /* synced, not returned yet */
+    uint32_t                      newSensors;      /* updated since last sync */
     int64_t                       timeStart;
     int64_t                       timeOffset;
     int                           fd;
     uint32_t                      active_sensors;
+
+    /* messages from the emulator, read as many at a time as
+     * possible. see data__read() */
+    int                           in_pos;
+    int                           in_len;
+    int                           in_skip;   /* bytes of an oversized message */
+    char                          in_buff[MSG_BUFFER_SIZE];
 } SensorPoll;
 
 /* this must return a file descriptor that will be used to read
@@ -140,6 +207,11 @@ control__open_data_source(struct sensors_poll_device_t *dev)
 
     if (ctl->fd < 0) {
         ctl->fd = qemud_channel_open(SENSORS_SERVICE_NAME);
+
+        /* ask for binary records, emulators that don't support
+         * them ignore this and keep sending text messages */
+        if (ctl->fd >= 0)
+            qemud_channel_send(ctl->fd, "set-format:binary", -1);
     }
     D("%s: fd=%d", __FUNCTION__, ctl->fd);
     handle = native_handle_create(1, 0);
@@ -237,8 +309,12 @@ data__data_open(struct sensors_poll_device_t *dev, native_handle_t* handle)
         data->sensors[i].acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
     }
     data->pendingSensors = 0;
+    data->newSensors     = 0;
     data->timeStart      = 0;
     data->timeOffset     = 0;
+    data->in_pos         = 0;
+    data->in_len         = 0;
+    data->in_skip        = 0;
 
     data->events_fd = dup(handle->data[0]);
     D("%s: dev=%p fd=%d (was %d)", __FUNCTION__, dev, data->events_fd, handle->data[0]);
@@ -259,141 +335,263 @@ data__data_close(struct sensors_poll_device_t *dev)
     return 0;
 }
 
+/* read as many messages as are available from the emulator,
+ * blocking until at least one byte arrives. returns the result
+ * of the read call.
+ */
 static int
-pick_sensor(SensorPoll*       data,
-            sensors_event_t*  values)
+data__read(SensorPoll*  data)
 {
-    uint32_t mask = SUPPORTED_SENSORS;
-    while (mask) {
-        uint32_t i = 31 - __builtin_clz(mask);
-        mask &= ~(1<<i);
-        if (data->pendingSensors & (1<<i)) {
-            data->pendingSensors &= ~(1<<i);
-            *values = data->sensors[i];
-            values->sensor = i;
-            values->version = sizeof(*values);
-
-            D("%s: %d [%f, %f, %f]", __FUNCTION__,
-                    i,
-                    values->data[0],
-                    values->data[1],
-                    values->data[2]);
-            return i;
+    int  len;
+
+    /* move the partial message, if any, to the start of the buffer */
+    if (data->in_pos > 0) {
+        data->in_len -= data->in_pos;
+        memmove(data->in_buff, data->in_buff + data->in_pos, data->in_len);
+        data->in_pos = 0;
+    }
+
+    do {
+        len = read(data->events_fd, data->in_buff + data->in_len,
+                   sizeof(data->in_buff) - data->in_len);
+    } while (len < 0 && errno == EINTR);
+
+    if (len > 0)
+        data->in_len += len;
+
+    return len;
+}
+
+/* return the next complete message in the input buffer, or
+ * NULL if there is none.
+ */
+static const char*
+data__next_message(SensorPoll*  data, int*  plen)
+{
+    for (;;) {
+        char*  header = data->in_buff + data->in_pos;
+        int    avail  = data->in_len - data->in_pos;
+        int    size, nn;
+
+        /* drop what's left of a message too large for the buffer */
+        if (data->in_skip > 0) {
+            int  skip = (avail < data->in_skip) ? avail : data->in_skip;
+            data->in_pos  += skip;
+            data->in_skip -= skip;
+            if (data->in_skip > 0)
+                return NULL;
+            continue;
+        }
+
+        if (avail < MSG_HEADER_SIZE)
+            return NULL;
+
+        size = 0;
+        for (nn = 0; nn < MSG_HEADER_SIZE; nn++) {
+            int  c = header[nn];
+            if (c >= '0' && c <= '9')
+                c -= '0';
+            else if (c >= 'a' && c <= 'f')
+                c -= 'a' - 10;
+            else if (c >= 'A' && c <= 'F')
+                c -= 'A' - 10;
+            else {
+                E("%s: invalid message header, dropping %d bytes",
+                  __FUNCTION__, avail);
+                data->in_pos = data->in_len;
+                return NULL;
+            }
+            size = (size << 4) | c;
+        }
+
+        if (size > MSG_BUFFER_SIZE - MSG_HEADER_SIZE) {
+            E("%s: ignoring %d bytes message", __FUNCTION__, size);
+            data->in_pos += MSG_HEADER_SIZE;
+            data->in_skip = size;
+            continue;
         }
+
+        if (avail < MSG_HEADER_SIZE + size)
+            return NULL;
+
+        data->in_pos += MSG_HEADER_SIZE + size;
+        *plen = size;
+        return header + MSG_HEADER_SIZE;
     }
-    ALOGE("No sensor to return!!! pendingSensors=%08x", data->pendingSensors);
-    // we may end-up in a busy loop, slow things down, just in case.
-    usleep(100000);
-    return -EINVAL;
 }
 
+/* set the timestamp of all sensors updated since the last sync,
+ * and make them pending. 'event_time' is in micro-seconds and
+ * corresponds to the VM time when the real poll occured.
+ */
+static void
+data__sync(SensorPoll*  data, int64_t  event_time)
+{
+    uint32_t  new_sensors = data->newSensors;
+    int64_t   t;
+
+    if (!new_sensors) {
+        D("huh ? sync without any sensor data ?");
+        return;
+    }
+
+    t = event_time * 1000LL;  /* convert to nano-seconds */
+
+    /* use the time at the first sync: as the base for later
+     * time values */
+    if (data->timeStart == 0) {
+        data->timeStart  = data__now_ns();
+        data->timeOffset = data->timeStart - t;
+    }
+    t += data->timeOffset;
+
+    while (new_sensors) {
+        uint32_t i = 31 - __builtin_clz(new_sensors);
+        new_sensors &= ~(1<<i);
+        data->sensors[i].timestamp = t;
+    }
+    data->pendingSensors |= data->newSensors;
+    data->newSensors      = 0;
+}
+
+/* parse a text message. returns its MSG_XXX type, or -1 if
+ * it isn't supported.
+ */
 static int
-data__poll(struct sensors_poll_device_t *dev, sensors_event_t* values)
+data__parse_text(SensorPoll*  data, const char*  msg, int  len)
 {
-    SensorPoll*  data = (void*)dev;
-    int fd = data->events_fd;
+    char         buff[256];
+    const char*  colon;
+    char*        p;
+    char*        end;
+    int          nn, kk, prefixlen;
+
+    if (len >= (int)sizeof(buff)) {
+        D("huh ? message too long");
+        return -1;
+    }
+    memcpy(buff, msg, len);
+    buff[len] = 0;
 
-    D("%s: data=%p", __FUNCTION__, dev);
+    colon     = memchr(buff, ':', len);
+    prefixlen = colon ? colon - buff : len;
 
-    // there are pending sensors, returns them now...
-    if (data->pendingSensors) {
-        return pick_sensor(data, values);
+    for (nn = 0; nn < NUM_SENSOR_MESSAGES; nn++) {
+        if (_sensorMessages[nn].prefixlen == prefixlen &&
+            !memcmp(_sensorMessages[nn].prefix, buff, prefixlen))
+            break;
+    }
+    if (nn == NUM_SENSOR_MESSAGES) {
+        D("huh ? unsupported command");
+        return -1;
     }
 
-    // wait until we get a complete event for an enabled sensor
-    uint32_t new_sensors = 0;
+    p = colon ? (char*)colon + 1 : buff + len;
 
-    while (1) {
-        /* read the next event */
-        char     buff[256];
-        int      len = qemud_channel_recv(data->events_fd, buff, sizeof buff-1);
-        float    params[3];
-        int64_t  event_time;
+    switch (_sensorMessages[nn].type) {
+    case MSG_SENSOR: {
+        int    id = _sensorMessages[nn].id;
+        float  params[3];
 
-        if (len < 0) {
-            E("%s: len=%d, errno=%d: %s", __FUNCTION__, len, errno, strerror(errno));
-            return -errno;
+        for (kk = 0; kk < _sensorMessages[nn].count; kk++) {
+            if (kk > 0) {
+                if (*p != ':')
+                    return -1;
+                p++;
+            }
+            params[kk] = strtof(p, &end);
+            if (end == p)
+                return -1;
+            p = end;
         }
+        /* all sensor values alias the 'data' array of the event */
+        memcpy(data->sensors[id].data, params, kk*sizeof(params[0]));
+        data->newSensors |= (1 << id);
+        return MSG_SENSOR;
+    }
 
-        buff[len] = 0;
+    case MSG_SYNC: {
+        int64_t  event_time = strtoll(p, &end, 10);
+        if (end == p)
+            return -1;
+        data__sync(data, event_time);
+        return MSG_SYNC;
+    }
 
-        /* "wake" is sent from the emulator to exit this loop. */
-        if (!strcmp((const char*)data, "wake")) {
-            return 0x7FFFFFFF;
-        }
+    default:
+        return _sensorMessages[nn].type;
+    }
+}
 
-        /* "acceleration:<x>:<y>:<z>" corresponds to an acceleration event */
-        if (sscanf(buff, "acceleration:%g:%g:%g", params+0, params+1, params+2) == 3) {
-            new_sensors |= SENSORS_ACCELERATION;
-            data->sensors[ID_ACCELERATION].acceleration.x = params[0];
-            data->sensors[ID_ACCELERATION].acceleration.y = params[1];
-            data->sensors[ID_ACCELERATION].acceleration.z = params[2];
-            continue;
-        }
+/* parse a binary message, see the SENSORS MESSAGES section above.
+ * returns MSG_SYNC if it contained a sync record, MSG_SENSOR if it
+ * didn't, or -1 if it was malformed.
+ */
+static int
+data__parse_binary(SensorPoll*  data, const char*  msg, int  len)
+{
+    const uint8_t*  p   = (const uint8_t*)msg;
+    const uint8_t*  end = p + len;
 
-        /* "orientation:<azimuth>:<pitch>:<roll>" is sent when orientation changes */
-        if (sscanf(buff, "orientation:%g:%g:%g", params+0, params+1, params+2) == 3) {
-            new_sensors |= SENSORS_ORIENTATION;
-            data->sensors[ID_ORIENTATION].orientation.azimuth = params[0];
-            data->sensors[ID_ORIENTATION].orientation.pitch   = params[1];
-            data->sensors[ID_ORIENTATION].orientation.roll    = params[2];
-            continue;
-        }
+    while (p < end) {
+        int  type = *p++;
 
-        /* "magnetic:<x>:<y>:<z>" is sent for the params of the magnetic field */
-        if (sscanf(buff, "magnetic:%g:%g:%g", params+0, params+1, params+2) == 3) {
-            new_sensors |= SENSORS_MAGNETIC_FIELD;
-            data->sensors[ID_MAGNETIC_FIELD].magnetic.x = params[0];
-            data->sensors[ID_MAGNETIC_FIELD].magnetic.y = params[1];
-            data->sensors[ID_MAGNETIC_FIELD].magnetic.z = params[2];
-            continue;
-        }
+        if (type == BINARY_SYNC) {
+            int64_t  event_time;
 
-        /* "temperature:<celsius>" */
-        if (sscanf(buff, "temperature:%g", params+0) == 1) {
-            new_sensors |= SENSORS_TEMPERATURE;
-            data->sensors[ID_TEMPERATURE].temperature = params[0];
-            continue;
+            if (end - p != (int)sizeof(event_time))
+                return -1;
+            memcpy(&event_time, p, sizeof(event_time));
+            data__sync(data, event_time);
+            return MSG_SYNC;
         }
 
-        /* "proximity:<value>" */
-        if (sscanf(buff, "proximity:%g", params+0) == 1) {
-            new_sensors |= SENSORS_PROXIMITY;
-            data->sensors[ID_PROXIMITY].distance = params[0];
-            continue;
-        }
+        if (type >= BINARY_SENSOR && type < BINARY_SENSOR + MAX_NUM_SENSORS) {
+            int  id = ID_BASE + (type - BINARY_SENSOR);
+            int  count;
 
-        /* "sync:<time>" is sent after a series of sensor events.
-         * where 'time' is expressed in micro-seconds and corresponds
-         * to the VM time when the real poll occured.
-         */
-        if (sscanf(buff, "sync:%lld", &event_time) == 1) {
-            if (new_sensors) {
-                data->pendingSensors = new_sensors;
-                int64_t t = event_time * 1000LL;  /* convert to nano-seconds */
-
-                /* use the time at the first sync: as the base for later
-                 * time values */
-                if (data->timeStart == 0) {
-                    data->timeStart  = data__now_ns();
-                    data->timeOffset = data->timeStart - t;
-                }
-                t += data->timeOffset;
-
-                while (new_sensors) {
-                    uint32_t i = 31 - __builtin_clz(new_sensors);
-                    new_sensors &= ~(1<<i);
-                    data->sensors[i].timestamp = t;
-                }
-                return pick_sensor(data, values);
-            } else {
-                D("huh ? sync without any sensor data ?");
-            }
+            if (p >= end)
+                return -1;
+            count = *p++;
+            if (count > 3 || end - p < count*(int)sizeof(float))
+                return -1;
+
+            memcpy(data->sensors[id].data, p, count*sizeof(float));
+            data->newSensors |= (1 << id);
+            p += count*sizeof(float);
             continue;
         }
-        D("huh ? unsupported command");
+
+        return -1;
     }
-    return -1;
+    return MSG_SENSOR;
+}
+
+/* copy pending sensor events to 'values'. returns the number of
+ * events copied.
+ */
+static int
+data__pick_sensors(SensorPoll*       data,
+                   sensors_event_t*  values,
+                   int               count)
+{
+    int  n = 0;
+
+    while (data->pendingSensors && n < count) {
+        uint32_t i = 31 - __builtin_clz(data->pendingSensors);
+        data->pendingSensors &= ~(1<<i);
+        values[n] = data->sensors[i];
+        values[n].sensor  = i;
+        values[n].version = sizeof(values[n]);
+
+        D("%s: %d [%f, %f, %f]", __FUNCTION__,
+                i,
+                values[n].data[0],
+                values[n].data[1],
+                values[n].data[2]);
+        n++;
+    }
+    return n;
 }
 
 static int
@@ -426,25 +624,57 @@ static int poll__close(struct hw_device_t* dev)
     return 0;
 }
 
+/* fill 'data' with as many events as are available, blocking
+ * only until the first one arrives.
+ */
 static int poll__poll(struct sensors_poll_device_t *dev,
             sensors_event_t* data, int count)
 {
     SensorPoll*  datadev = (void*)dev;
-    int ret;
-    int i;
+    int n = 0;
     D("%s: dev=%p data=%p count=%d ", __FUNCTION__, dev, data, count);
 
-    for (i = 0; i < count; i++)  {
-        ret = data__poll(dev, data);
-        data++;
-        if (ret > MAX_NUM_SENSORS || ret < 0) {
-           return i;
+    for (;;) {
+        const char*  msg;
+        int          len;
+
+        /* return the events of the last sync first */
+        n += data__pick_sensors(datadev, data + n, count - n);
+        if (n == count)
+            return n;
+
+        /* then parse the messages that were already read, until
+         * the next sync */
+        while ((msg = data__next_message(datadev, &len)) != NULL) {
+            int  type;
+
+            if (len > 0 && (uint8_t)msg[0] >= BINARY_SENSOR)
+                type = data__parse_binary(datadev, msg, len);
+            else
+                type = data__parse_text(datadev, msg, len);
+
+            /* "wake" is sent from the emulator to exit this loop. */
+            if (type == MSG_WAKE)
+                return n;
+
+            if (type == MSG_SYNC && datadev->pendingSensors)
+                break;
         }
-        if (!datadev->pendingSensors) {
-           return i + 1;
+        if (datadev->pendingSensors)
+            continue;
+
+        /* only block when there is nothing to return */
+        if (n > 0)
+            return n;
+
+        len = data__read(datadev);
+        if (len <= 0) {
+            int  err = (len < 0) ? errno : EIO;
+            E("%s: len=%d, errno=%d: %s", __FUNCTION__, len, err,
+              len < 0 ? strerror(err) : "end of stream");
+            return -err;
         }
     }
-    return count;
 }
 
 static int poll__activate(struct sensors_poll_device_t *dev,
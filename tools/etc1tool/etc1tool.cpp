@@ -12,11 +12,23 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <dirent.h>
 #include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <png.h>
 #include <ETC1/etc1.h>
@@ -41,6 +53,11 @@ void usage(char* message, ...) {
             stderr,
             "%s infile [--help | --encode | --encodeNoHeader | --decode] [--showDifference difffile] [-o outfile]\n",
             gpExeName);
+    fprintf(
+            stderr,
+            "%s --batch infile|indir... [--fileList listfile] [--encode | --encodeNoHeader | --decode] [-o outdir]\n",
+            gpExeName);
+    fprintf(stderr, "%s --benchmark infile...\n", gpExeName);
     fprintf(stderr, "\tDefault is --encode\n");
     fprintf(stderr, "\t\t--help           print this usage information.\n");
     fprintf(stderr,
@@ -54,9 +71,25 @@ void usage(char* message, ...) {
             "\t\t--showDifference difffile    Write difference between original and encoded\n");
     fprintf(stderr,
             "\t\t                             image to difffile. (Only valid when encoding).\n");
+    fprintf(stderr,
+            "\t\t--batch          process several files. Directories are replaced by the\n");
+    fprintf(stderr,
+            "\t\t                 .png (or .pkm when decoding) files they contain.\n");
+    fprintf(stderr,
+            "\t\t--fileList listfile  process the files listed in listfile, one per line.\n");
+    fprintf(stderr,
+            "\t\t                 Implies --batch.\n");
+    fprintf(stderr,
+            "\t\t--threads count  number of encoding threads. Default is the number of CPUs.\n");
+    fprintf(stderr,
+            "\t\t--benchmark      report the encoding speed of each infile for 1 thread\n");
+    fprintf(stderr,
+            "\t\t                 up to the number of encoding threads. No file is written.\n");
     fprintf(stderr,
             "\tIf outfile is not specified, an outfile path is constructed from infile,\n");
     fprintf(stderr, "\twith the apropriate suffix (.pkm or .png).\n");
+    fprintf(stderr,
+            "\tIn batch mode, -o specifies the directory the outfiles are written to.\n");
     exit(1);
 }
 
@@ -129,17 +162,35 @@ int fread_big_endian_uint16(png_uint_32* data, FILE* pIn) {
     return 0;
 }
 
-// Read a PNG file into a contiguous buffer.
+// A buffer reused across the files of a batch. It only grows.
+struct ReusableBuffer {
+    etc1_byte* pData;
+    etc1_uint32 capacity;
+};
+
+// Returns NULL if out of memory.
+static
+etc1_byte* reserveBuffer(ReusableBuffer* pBuffer, etc1_uint32 size) {
+    if (size > pBuffer->capacity) {
+        delete[] pBuffer->pData;
+        pBuffer->pData = new etc1_byte[size];
+        pBuffer->capacity = pBuffer->pData ? size : 0;
+    }
+    return pBuffer->pData;
+}
+
+// Read a PNG file as RGB888 into a contiguous buffer.
+// libpng decodes the rows in place, there is no intermediate copy.
 // Returns non-zero if an error occurred.
-// caller has to delete[] *ppImageData when done with the image.
 
-int read_PNG_File(const char* pInput, etc1_byte** ppImageData,
+int read_PNG_File(const char* pInput, ReusableBuffer* pBuffer,
         etc1_uint32* pWidth, etc1_uint32* pHeight) {
     FILE* pIn = NULL;
     png_structp png_ptr = NULL;
     png_infop info_ptr = NULL;
     png_infop end_info = NULL;
-    png_bytep* row_pointers = NULL; // Does not need to be deallocated.
+    // Set after setjmp(), and needed after a longjmp().
+    png_bytep* volatile row_pointers = NULL;
     png_uint_32 width = 0;
     png_uint_32 height = 0;
     png_uint_32 stride = 0;
@@ -186,38 +237,47 @@ int read_PNG_File(const char* pInput, etc1_byte** ppImageData,
 
     png_init_io(png_ptr, pIn);
     png_set_sig_bytes(png_ptr, PNG_HEADER_SIZE);
-    png_read_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY
-            | PNG_TRANSFORM_STRIP_16 | PNG_TRANSFORM_STRIP_ALPHA
-            | PNG_TRANSFORM_PACKING, NULL);
-
-    row_pointers = png_get_rows(png_ptr, info_ptr);
+    png_read_info(png_ptr, info_ptr);
     {
         int bit_depth, color_type;
         png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth,
                 &color_type, NULL, NULL, NULL);
+        if (color_type == PNG_COLOR_TYPE_PALETTE || bit_depth < 8) {
+            png_set_expand(png_ptr);
+        }
+        if (!(color_type & PNG_COLOR_MASK_COLOR)) {
+            png_set_gray_to_rgb(png_ptr);
+        }
     }
+    png_set_strip_16(png_ptr);
+    png_set_strip_alpha(png_ptr);
+    png_read_update_info(png_ptr, info_ptr);
 
     stride = 3 * width;
+    if (png_get_rowbytes(png_ptr, info_ptr) != stride) {
+        fprintf(stderr, "%s: unsupported PNG format.\n", pInput);
+        goto exit;
+    }
 
-    pSourceImage = new etc1_byte[stride * height];
-    if (! pSourceImage) {
+    pSourceImage = reserveBuffer(pBuffer, stride * height);
+    row_pointers = new png_bytep[height];
+    if (! pSourceImage || ! row_pointers) {
         fprintf(stderr, "Out of memory.\n");
         goto exit;
     }
 
     for (etc1_uint32 y = 0; y < height; y++) {
-        memcpy(pSourceImage + y * stride, row_pointers[y], stride);
+        row_pointers[y] = pSourceImage + y * stride;
     }
+    png_read_image(png_ptr, row_pointers);
+    png_read_end(png_ptr, end_info);
 
     *pWidth = width;
     *pHeight = height;
-    *ppImageData = pSourceImage;
 
     result = 0;
     exit:
-    if (result) {
-        delete[] pSourceImage;
-    }
+    delete[] row_pointers;
     if (png_ptr) {
         png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
     }
@@ -307,10 +367,216 @@ int readPKMFile(const char* pInput, etc1_byte** ppImageData,
 }
 
 
+// Encodes images with a pool of threads. Each image is split into rows
+// of 4x4 blocks, which the threads take in turn and encode independently
+// with etc1_encode_image().
+
+struct EncodeJob {
+    const etc1_byte* pIn;
+    etc1_uint32 width;
+    etc1_uint32 height;
+    etc1_uint32 stride;
+    etc1_byte* pOut;
+    etc1_uint32 blockRows;
+    volatile etc1_uint32 nextBlockRow;
+};
+
+struct EncoderPool {
+    int threadCount;
+#ifdef HAVE_PTHREADS
+    pthread_t* pThreads;
+    pthread_mutex_t mutex;
+    pthread_cond_t jobCond;
+    pthread_cond_t doneCond;
+    EncodeJob* pJob;
+    etc1_uint32 jobGeneration;
+    int busyThreads;
+    bool quit;
+#endif
+};
+
+static
+void runEncodeJob(EncodeJob* pJob) {
+    etc1_uint32 encodedRowSize = etc1_get_encoded_data_size(pJob->width, 4);
+    for (;;) {
+#ifdef HAVE_PTHREADS
+        etc1_uint32 blockRow = __sync_fetch_and_add(&pJob->nextBlockRow, 1);
+#else
+        etc1_uint32 blockRow = pJob->nextBlockRow++;
+#endif
+        if (blockRow >= pJob->blockRows) {
+            break;
+        }
+        etc1_uint32 y = blockRow * 4;
+        etc1_uint32 rows = pJob->height - y < 4 ? pJob->height - y : 4;
+        etc1_encode_image(pJob->pIn + y * pJob->stride, pJob->width, rows, 3,
+                pJob->stride, pJob->pOut + blockRow * encodedRowSize);
+    }
+}
+
+#ifdef HAVE_PTHREADS
+static
+void* encoderThread(void* arg) {
+    EncoderPool* pPool = (EncoderPool*) arg;
+    etc1_uint32 generation = 0;
+
+    pthread_mutex_lock(&pPool->mutex);
+    for (;;) {
+        while (!pPool->quit && pPool->jobGeneration == generation) {
+            pthread_cond_wait(&pPool->jobCond, &pPool->mutex);
+        }
+        if (pPool->quit) {
+            break;
+        }
+        generation = pPool->jobGeneration;
+        EncodeJob* pJob = pPool->pJob;
+        pthread_mutex_unlock(&pPool->mutex);
+
+        runEncodeJob(pJob);
+
+        pthread_mutex_lock(&pPool->mutex);
+        if (--pPool->busyThreads == 0) {
+            pthread_cond_signal(&pPool->doneCond);
+        }
+    }
+    pthread_mutex_unlock(&pPool->mutex);
+    return NULL;
+}
+#endif
+
+// Returns the number of CPUs, at least 1.
+static
+int getCpuCount() {
+#ifdef _SC_NPROCESSORS_ONLN
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > 0) {
+        return (int) count;
+    }
+#endif
+    return 1;
+}
+
+// The calling thread is one of the threadCount encoding threads.
+static
+void initEncoderPool(EncoderPool* pPool, int threadCount) {
+    memset(pPool, 0, sizeof(*pPool));
+    pPool->threadCount = 1;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_init(&pPool->mutex, NULL);
+    pthread_cond_init(&pPool->jobCond, NULL);
+    pthread_cond_init(&pPool->doneCond, NULL);
+    pPool->pThreads = new pthread_t[threadCount];
+    for (int i = 1; i < threadCount; i++) {
+        if (pthread_create(&pPool->pThreads[i - 1], NULL, encoderThread, pPool)) {
+            fprintf(stderr, "Could not create encoding thread: %d\n", errno);
+            break;
+        }
+        pPool->threadCount++;
+    }
+#endif
+}
+
+static
+void destroyEncoderPool(EncoderPool* pPool) {
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&pPool->mutex);
+    pPool->quit = true;
+    pthread_cond_broadcast(&pPool->jobCond);
+    pthread_mutex_unlock(&pPool->mutex);
+    for (int i = 0; i < pPool->threadCount - 1; i++) {
+        pthread_join(pPool->pThreads[i], NULL);
+    }
+    delete[] pPool->pThreads;
+    pthread_cond_destroy(&pPool->doneCond);
+    pthread_cond_destroy(&pPool->jobCond);
+    pthread_mutex_destroy(&pPool->mutex);
+#endif
+}
+
+// Same as etc1_encode_image(pIn, width, height, 3, stride, pOut), using
+// all the threads of the pool.
+static
+void encodeImage(EncoderPool* pPool, const etc1_byte* pIn, etc1_uint32 width,
+        etc1_uint32 height, etc1_uint32 stride, etc1_byte* pOut) {
+    EncodeJob job;
+    job.pIn = pIn;
+    job.width = width;
+    job.height = height;
+    job.stride = stride;
+    job.pOut = pOut;
+    job.blockRows = (height + 3) / 4;
+    job.nextBlockRow = 0;
+
+#ifdef HAVE_PTHREADS
+    if (pPool->threadCount > 1) {
+        pthread_mutex_lock(&pPool->mutex);
+        pPool->pJob = &job;
+        pPool->jobGeneration++;
+        pPool->busyThreads = pPool->threadCount - 1;
+        pthread_cond_broadcast(&pPool->jobCond);
+        pthread_mutex_unlock(&pPool->mutex);
+
+        runEncodeJob(&job);
+
+        pthread_mutex_lock(&pPool->mutex);
+        while (pPool->busyThreads > 0) {
+            pthread_cond_wait(&pPool->doneCond, &pPool->mutex);
+        }
+        pthread_mutex_unlock(&pPool->mutex);
+        return;
+    }
+#endif
+    runEncodeJob(&job);
+}
+
+// State shared by the files of a batch.
+struct EncodeContext {
+    EncoderPool pool;
+    ReusableBuffer sourceImage;
+    ReusableBuffer encodedData;
+    ReusableBuffer diffImage;
+};
+
+// Write the squared difference between pA and pB, times 8 and clamped to
+// 255, to pDiff. Any difference of 6 or more clamps, so the squares of
+// clamped differences fit in 16 bits.
+static
+void computeDifference(const etc1_byte* pA, const etc1_byte* pB, etc1_byte* pDiff,
+        etc1_uint32 size) {
+    etc1_uint32 i = 0;
+#ifdef __SSE2__
+    const __m128i six = _mm_set1_epi8(6);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (pA + i));
+        __m128i b = _mm_loadu_si128((const __m128i*) (pB + i));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        diff = _mm_min_epu8(diff, six);
+        __m128i lo = _mm_unpacklo_epi8(diff, zero);
+        __m128i hi = _mm_unpackhi_epi8(diff, zero);
+        lo = _mm_slli_epi16(_mm_mullo_epi16(lo, lo), 3);
+        hi = _mm_slli_epi16(_mm_mullo_epi16(hi, hi), 3);
+        _mm_storeu_si128((__m128i*) (pDiff + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < size; i++) {
+        int diff = pA[i] - pB[i];
+        diff *= diff;
+        diff <<= 3;
+        if (diff < 0) {
+            diff = 0;
+        } else if (diff > 255) {
+            diff = 255;
+        }
+        pDiff[i] = (png_byte) diff;
+    }
+}
+
 // Encode the file.
 // Returns non-zero if an error occurred.
 
-int encode(const char* pInput, const char* pOutput, bool bEmitHeader, const char* pDiffFile) {
+int encode(EncodeContext* pContext, const char* pInput, const char* pOutput,
+        bool bEmitHeader, const char* pDiffFile) {
     FILE* pOut = NULL;
     etc1_uint32 width = 0;
     etc1_uint32 height = 0;
@@ -320,19 +586,19 @@ int encode(const char* pInput, const char* pOutput, bool bEmitHeader, const char
     etc1_byte* pEncodedData = 0;
     etc1_byte* pDiffImage = 0; // Used for differencing
 
-    if (read_PNG_File(pInput, &pSourceImage, &width, &height)) {
+    if (read_PNG_File(pInput, &pContext->sourceImage, &width, &height)) {
         goto exit;
     }
+    pSourceImage = pContext->sourceImage.pData;
 
     encodedSize = etc1_get_encoded_data_size(width, height);
-    pEncodedData = new etc1_byte[encodedSize];
+    pEncodedData = reserveBuffer(&pContext->encodedData, encodedSize);
     if (!pEncodedData) {
         fprintf(stderr, "Out of memory.\n");
         goto exit;
     }
 
-    etc1_encode_image(pSourceImage,
-            width, height, 3, width * 3, pEncodedData);
+    encodeImage(&pContext->pool, pSourceImage, width, height, width * 3, pEncodedData);
 
     if ((pOut = fopen(pOutput, "wb")) == NULL) {
         fprintf(stderr, "Could not open output file %s: %d\n", pOutput, errno);
@@ -357,45 +623,31 @@ int encode(const char* pInput, const char* pOutput, bool bEmitHeader, const char
         goto exit;
     }
 
-    fclose(pOut);
+    if (fclose(pOut)) {
+        pOut = NULL;
+        fprintf(stderr, "Could not write output file %s: %d\n", pOutput, errno);
+        goto exit;
+    }
     pOut = NULL;
 
     if (pDiffFile) {
-        etc1_uint32 outWidth;
-        etc1_uint32 outHeight;
-        if (readPKMFile(pOutput, &pDiffImage, &outWidth, &outHeight)) {
+        // Decode the encoded data we already have rather than the output file.
+        pDiffImage = reserveBuffer(&pContext->diffImage, width * height * 3);
+        if (!pDiffImage) {
+            fprintf(stderr, "Out of memory.\n");
             goto exit;
         }
-        if (outWidth != width || outHeight != height) {
-            fprintf(stderr, "Output file has incorrect bounds: %u, %u != %u, %u\n",
-                    outWidth, outHeight, width, height);
+        etc1_decode_image(pEncodedData, pDiffImage, width, height, 3, width * 3);
+        computeDifference(pSourceImage, pDiffImage, pDiffImage, width * height * 3);
+        if (writePNGFile(pDiffFile, width, height, pDiffImage, 3 * width)) {
             goto exit;
         }
-        const etc1_byte* pSrc = pSourceImage;
-        etc1_byte* pDest = pDiffImage;
-        etc1_uint32 size = width * height * 3;
-        for (etc1_uint32 i = 0; i < size; i++) {
-            int diff = *pSrc++ - *pDest;
-            diff *= diff;
-            diff <<= 3;
-            if (diff < 0) {
-                diff = 0;
-            } else if (diff > 255) {
-                diff = 255;
-            }
-            *pDest++ = (png_byte) diff;
-        }
-        writePNGFile(pDiffFile, outWidth, outHeight, pDiffImage, 3 * outWidth);
     }
 
     // Success
     result = 0;
 
     exit:
-    delete[] pSourceImage;
-    delete[] pEncodedData;
-    delete[] pDiffImage;
-
     if (pOut) {
         fclose(pOut);
     }
@@ -472,6 +724,181 @@ int decode(const char* pInput, const char* pOutput) {
     return result;
 }
 
+// Returns true if pPath ends with pExtension, ignoring case.
+static
+bool hasExtension(const char* pPath, const char* pExtension) {
+    size_t pathLen = strlen(pPath);
+    size_t extensionLen = strlen(pExtension);
+    return pathLen > extensionLen
+            && strcasecmp(pPath + pathLen - extensionLen, pExtension) == 0;
+}
+
+// A growable list of paths, which owns them.
+struct PathList {
+    char** ppPaths;
+    int count;
+    int capacity;
+};
+
+static
+void addPath(PathList* pList, const char* pPath) {
+    if (pList->count == pList->capacity) {
+        int capacity = pList->capacity ? 2 * pList->capacity : 64;
+        char** ppPaths = new char*[capacity];
+        memcpy(ppPaths, pList->ppPaths, pList->count * sizeof(char*));
+        delete[] pList->ppPaths;
+        pList->ppPaths = ppPaths;
+        pList->capacity = capacity;
+    }
+    pList->ppPaths[pList->count] = new char[strlen(pPath) + 1];
+    strcpy(pList->ppPaths[pList->count], pPath);
+    pList->count++;
+}
+
+static
+void freePathList(PathList* pList) {
+    for (int i = 0; i < pList->count; i++) {
+        delete[] pList->ppPaths[i];
+    }
+    delete[] pList->ppPaths;
+}
+
+static
+int comparePaths(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+// Adds pPath to pList, or the files of directory pPath that have the
+// given extension, in sorted order.
+// Returns non-zero if an error occurred.
+static
+int addInput(PathList* pList, const char* pPath, const char* pExtension) {
+    struct stat st;
+    if (stat(pPath, &st) || !S_ISDIR(st.st_mode)) {
+        addPath(pList, pPath);
+        return 0;
+    }
+
+    DIR* pDir = opendir(pPath);
+    if (!pDir) {
+        fprintf(stderr, "Could not open directory %s: %d\n", pPath, errno);
+        return -1;
+    }
+    int first = pList->count;
+    struct dirent* pEntry;
+    while ((pEntry = readdir(pDir)) != NULL) {
+        if (hasExtension(pEntry->d_name, pExtension)) {
+            char* pFile = new char[strlen(pPath) + strlen(pEntry->d_name) + 2];
+            sprintf(pFile, "%s/%s", pPath, pEntry->d_name);
+            addPath(pList, pFile);
+            delete[] pFile;
+        }
+    }
+    closedir(pDir);
+    qsort(pList->ppPaths + first, pList->count - first, sizeof(char*), comparePaths);
+    return 0;
+}
+
+// Adds the paths listed in pListFile, one per line.
+// Returns non-zero if an error occurred.
+static
+int addFileList(PathList* pList, const char* pListFile) {
+    FILE* pIn = fopen(pListFile, "r");
+    if (!pIn) {
+        fprintf(stderr, "Could not open file list %s: %d\n", pListFile, errno);
+        return -1;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), pIn)) {
+        size_t len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        if (len > 0) {
+            addPath(pList, line);
+        }
+    }
+    fclose(pIn);
+    return 0;
+}
+
+// Builds the output path of pInput: the input path with the extension
+// replaced, in directory pOutputDir if it isn't NULL.
+// Caller has to delete[] the result. Returns NULL on error.
+static
+char* makeOutputPath(const char* pInput, const char* pOutputDir, const char* pExtension) {
+    const char* pName = pInput;
+    if (pOutputDir) {
+        const char* pSlash = strrchr(pInput, '/');
+        if (pSlash) {
+            pName = pSlash + 1;
+        }
+    }
+    size_t buffSize = (pOutputDir ? strlen(pOutputDir) + 1 : 0) + strlen(pName)
+            + strlen(pExtension) + 1;
+    char* pOutput = new char[buffSize];
+    if (pOutputDir) {
+        sprintf(pOutput, "%s/%s", pOutputDir, pName);
+    } else {
+        strcpy(pOutput, pName);
+    }
+    if (changeExtension(pOutput, buffSize, pExtension)) {
+        delete[] pOutput;
+        return NULL;
+    }
+    return pOutput;
+}
+
+static
+double getTime() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Reports the encoding speed of pInput with 1, 2, 4... threads, up to
+// threadCount.
+// Returns non-zero if an error occurred.
+static
+int benchmark(EncodeContext* pContext, const char* pInput, int threadCount) {
+    etc1_uint32 width = 0;
+    etc1_uint32 height = 0;
+
+    if (read_PNG_File(pInput, &pContext->sourceImage, &width, &height)) {
+        return -1;
+    }
+    etc1_byte* pEncodedData = reserveBuffer(&pContext->encodedData,
+            etc1_get_encoded_data_size(width, height));
+    if (!pEncodedData) {
+        fprintf(stderr, "Out of memory.\n");
+        return -1;
+    }
+
+    printf("%s: %ux%u\n", pInput, width, height);
+    for (int threads = 1;; threads = threads * 2 < threadCount ? threads * 2 : threadCount) {
+        EncoderPool pool;
+        initEncoderPool(&pool, threads);
+
+        // Encode for at least a second
+        int images = 0;
+        double start = getTime();
+        double elapsed;
+        do {
+            encodeImage(&pool, pContext->sourceImage.pData, width, height, width * 3,
+                    pEncodedData);
+            images++;
+            elapsed = getTime() - start;
+        } while (elapsed < 1.0);
+
+        printf("  %2d threads: %8.2f Mpixels/s\n", pool.threadCount,
+                (double) width * height * images / elapsed / 1e6);
+        destroyEncoderPool(&pool);
+
+        if (threads >= threadCount) {
+            break;
+        }
+    }
+    return 0;
+}
+
 void multipleEncodeDecodeCheck(bool* pbEncodeDecodeSeen) {
     if (*pbEncodeDecodeSeen) {
         usage("At most one occurrence of --encode --encodeNoHeader or --decode is allowed.\n");
@@ -481,16 +908,21 @@ void multipleEncodeDecodeCheck(bool* pbEncodeDecodeSeen) {
 
 int main(int argc, char** argv) {
     gpExeName = argv[0];
-    const char* pInput = NULL;
     const char* pOutput = NULL;
     const char* pDiffFile = NULL;
-    char* pOutputFileBuff = NULL;
+    const char* pFileList = NULL;
+    PathList inputs;
+    memset(&inputs, 0, sizeof(inputs));
+    int threadCount = getCpuCount();
+    int failures = 0;
 
     bool bEncodeDecodeSeen = false;
     bool bEncode = false;
     bool bEncodeHeader = false;
     bool bDecode = false;
     bool bShowDifference = false;
+    bool bBatch = false;
+    bool bBenchmark = false;
 
     for (int i = 1; i < argc; i++) {
         const char* pArg = argv[i];
@@ -527,6 +959,23 @@ int main(int argc, char** argv) {
                         usage("Expected difffile after --showDifference");
                     }
                     pDiffFile = argv[++i];
+                } else if (strcmp(pArg, "--batch") == 0) {
+                    bBatch = true;
+                } else if (strcmp(pArg, "--fileList") == 0) {
+                    if (pFileList != NULL) {
+                        usage("Only one --fileList option allowed.\n");
+                    }
+                    if (i + 1 >= argc) {
+                        usage("Expected listfile after --fileList");
+                    }
+                    pFileList = argv[++i];
+                    bBatch = true;
+                } else if (strcmp(pArg, "--threads") == 0) {
+                    if (i + 1 >= argc || (threadCount = atoi(argv[++i])) <= 0) {
+                        usage("Expected a thread count after --threads");
+                    }
+                } else if (strcmp(pArg, "--benchmark") == 0) {
+                    bBenchmark = true;
                 } else if (strcmp(pArg, "--help") == 0) {
                     usage( NULL);
                 } else {
@@ -539,12 +988,12 @@ int main(int argc, char** argv) {
                 break;
             }
         } else {
-            if (pInput != NULL) {
+            if (inputs.count > 0 && !bBatch && !bBenchmark) {
                 usage(
                         "Only one input file allowed. Already have %s, now see %s",
-                        pInput, pArg);
+                        inputs.ppPaths[0], pArg);
             }
-            pInput = pArg;
+            addPath(&inputs, pArg);
         }
     }
 
@@ -555,29 +1004,90 @@ int main(int argc, char** argv) {
     if ((! bEncode) && bShowDifference) {
         usage("--showDifference is only valid when encoding.");
     }
-
-    if (!pInput) {
-        usage("Expected an input file.");
+    if (bBatch && bShowDifference) {
+        usage("--showDifference is not valid in batch mode.");
+    }
+    if (bBenchmark && (bBatch || bDecode || pOutput || bShowDifference)) {
+        usage("--benchmark only takes input files.");
     }
 
-    if (!pOutput) {
-        const char* kDefaultExtension = bEncode ? ".pkm" : ".png";
-        size_t buffSize = strlen(pInput) + strlen(kDefaultExtension) + 1;
-        pOutputFileBuff = new char[buffSize];
-        strcpy(pOutputFileBuff, pInput);
-        if (changeExtension(pOutputFileBuff, buffSize, kDefaultExtension)) {
-            usage("Could not change extension of input file name: %s\n", pInput);
+    if (bBatch) {
+        // Expand the directories and the file list
+        PathList files;
+        memset(&files, 0, sizeof(files));
+        for (int i = 0; i < inputs.count; i++) {
+            if (addInput(&files, inputs.ppPaths[i], bEncode ? ".png" : ".pkm")) {
+                failures++;
+            }
+        }
+        if (pFileList && addFileList(&files, pFileList)) {
+            failures++;
         }
-        pOutput = pOutputFileBuff;
+        freePathList(&inputs);
+        inputs = files;
     }
 
-    if (bEncode) {
-        encode(pInput, pOutput, bEncodeHeader, pDiffFile);
-    } else {
-        decode(pInput, pOutput);
+    if (inputs.count == 0 && failures == 0) {
+        usage("Expected an input file.");
     }
 
-    delete[] pOutputFileBuff;
+    EncodeContext context;
+    memset(&context, 0, sizeof(context));
+    if (bEncode && !bBenchmark) {
+        initEncoderPool(&context.pool, threadCount);
+    }
 
-    return 0;
+    for (int i = 0; i < inputs.count; i++) {
+        const char* pInput = inputs.ppPaths[i];
+
+        if (bBenchmark) {
+            if (benchmark(&context, pInput, threadCount)) {
+                failures++;
+            }
+            continue;
+        }
+
+        char* pOutputFileBuff = NULL;
+        const char* pOutputFile = pOutput;
+        if (bBatch || !pOutputFile) {
+            const char* kDefaultExtension = bEncode ? ".pkm" : ".png";
+            pOutputFileBuff = makeOutputPath(pInput, bBatch ? pOutput : NULL,
+                    kDefaultExtension);
+            if (!pOutputFileBuff) {
+                if (!bBatch) {
+                    usage("Could not change extension of input file name: %s\n", pInput);
+                }
+                fprintf(stderr, "Could not change extension of input file name: %s\n", pInput);
+                failures++;
+                continue;
+            }
+            pOutputFile = pOutputFileBuff;
+        }
+
+        int result;
+        if (bEncode) {
+            result = encode(&context, pInput, pOutputFile, bEncodeHeader, pDiffFile);
+        } else {
+            result = decode(pInput, pOutputFile);
+        }
+        if (result) {
+            failures++;
+        }
+
+        delete[] pOutputFileBuff;
+    }
+
+    if (bEncode && !bBenchmark) {
+        destroyEncoderPool(&context.pool);
+    }
+    delete[] context.sourceImage.pData;
+    delete[] context.encodedData.pData;
+    delete[] context.diffImage.pData;
+    freePathList(&inputs);
+
+    if (bBatch && failures) {
+        fprintf(stderr, "%d of the files could not be processed.\n", failures);
+        return 1;
+    }
+    return (bBenchmark && failures) ? 1 : 0;
 }